@@ -84,17 +84,30 @@ atomic_sub_uint64(uint64_t *p, uint64_t x)
 {
 	return (__sync_sub_and_fetch(p, x));
 }
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	return __sync_val_compare_and_swap(v, old, _new);
+}
 #elif (defined(_MSC_VER))
+/* InterlockedExchangeAdd returns the old value, all functions here return the new one */
 ATOMIC_INLINE uint64_t
 atomic_add_uint64(uint64_t *p, uint64_t x)
 {
-	return (InterlockedExchangeAdd64(p, x));
+	return (InterlockedExchangeAdd64((int64_t *)p, (int64_t)x) + x);
 }
 
 ATOMIC_INLINE uint64_t
 atomic_sub_uint64(uint64_t *p, uint64_t x)
 {
-	return (InterlockedExchangeAdd64(p, -((int64_t)x)));
+	return (InterlockedExchangeAdd64((int64_t *)p, -((int64_t)x)) - x);
+}
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	return InterlockedCompareExchange64((int64_t *)v, _new, old);
 }
 #elif (defined(__APPLE__))
 ATOMIC_INLINE uint64_t
@@ -108,28 +121,57 @@ atomic_sub_uint64(uint64_t *p, uint64_t x)
 {
 	return (uint64_t)(OSAtomicAdd64(-((int64_t)x), (int64_t *)p));
 }
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	/* return the value seen by the swap, a value read before or after it
+	 * may already have been changed by another thread */
+	while (!OSAtomicCompareAndSwap64Barrier((int64_t)old, (int64_t)_new, (int64_t *)v)) {
+		uint64_t cur_val = *(volatile uint64_t *)v;
+		if (cur_val != old) {
+			return cur_val;
+		}
+	}
+	return old;
+}
 #  elif (defined(__amd64__) || defined(__x86_64__))
 ATOMIC_INLINE uint64_t
 atomic_add_uint64(uint64_t *p, uint64_t x)
 {
+	uint64_t ret = x;
 	asm volatile (
 	    "lock; xaddq %0, %1;"
-	    : "+r" (x), "=m" (*p) /* Outputs. */
+	    : "+r" (ret), "=m" (*p) /* Outputs. */
 	    : "m" (*p) /* Inputs. */
 	    );
-	return (x);
+	/* xadd gives the old value */
+	return (ret + x);
 }
 
 ATOMIC_INLINE uint64_t
 atomic_sub_uint64(uint64_t *p, uint64_t x)
 {
-	x = (uint64_t)(-(int64_t)x);
+	uint64_t ret = (uint64_t)(-(int64_t)x);
 	asm volatile (
 	    "lock; xaddq %0, %1;"
-	    : "+r" (x), "=m" (*p) /* Outputs. */
+	    : "+r" (ret), "=m" (*p) /* Outputs. */
 	    : "m" (*p) /* Inputs. */
 	    );
-	return (x);
+	return (ret - x);
+}
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	uint64_t ret;
+	asm volatile (
+	    "lock; cmpxchgq %2,%1"
+	    : "=a" (ret), "+m" (*v) /* Outputs. */
+	    : "r" (_new), "0" (old) /* Inputs. */
+	    : "memory"
+	    );
+	return ret;
 }
 #  elif (defined(JEMALLOC_ATOMIC9))
 ATOMIC_INLINE uint64_t
@@ -151,6 +193,22 @@ atomic_sub_uint64(uint64_t *p, uint64_t x)
 
 	return (atomic_fetchadd_long(p, (unsigned long)(-(long)x)) - x);
 }
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	assert(sizeof(uint64_t) == sizeof(unsigned long));
+
+	/* return the value seen by the swap, a value read before or after it
+	 * may already have been changed by another thread */
+	while (!atomic_cmpset_long(v, (unsigned long)old, (unsigned long)_new)) {
+		uint64_t cur_val = *(volatile uint64_t *)v;
+		if (cur_val != old) {
+			return cur_val;
+		}
+	}
+	return old;
+}
 #  elif (defined(JE_FORCE_SYNC_COMPARE_AND_SWAP_8))
 ATOMIC_INLINE uint64_t
 atomic_add_uint64(uint64_t *p, uint64_t x)
@@ -163,6 +221,12 @@ atomic_sub_uint64(uint64_t *p, uint64_t x)
 {
 	return (__sync_sub_and_fetch(p, x));
 }
+
+ATOMIC_INLINE uint64_t
+atomic_cas_uint64(uint64_t *v, uint64_t old, uint64_t _new)
+{
+	return __sync_val_compare_and_swap(v, old, _new);
+}
 #  else
 #    error "Missing implementation for 64-bit atomic operations"
 #  endif
@@ -182,17 +246,30 @@ atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
 	return (__sync_sub_and_fetch(p, x));
 }
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	return __sync_val_compare_and_swap(v, old, _new);
+}
 #elif (defined(_MSC_VER))
+/* InterlockedExchangeAdd returns the old value, all functions here return the new one */
 ATOMIC_INLINE uint32_t
 atomic_add_uint32(uint32_t *p, uint32_t x)
 {
-	return (InterlockedExchangeAdd(p, x));
+	return (InterlockedExchangeAdd((long *)p, (long)x) + x);
 }
 
 ATOMIC_INLINE uint32_t
 atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
-	return (InterlockedExchangeAdd(p, -((int32_t)x)));
+	return (InterlockedExchangeAdd((long *)p, -((long)x)) - x);
+}
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	return InterlockedCompareExchange((long *)v, _new, old);
 }
 #elif (defined(__APPLE__))
 ATOMIC_INLINE uint32_t
@@ -206,28 +283,57 @@ atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
 	return (uint32_t)(OSAtomicAdd32(-((int32_t)x), (int32_t *)p));
 }
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	/* return the value seen by the swap, a value read before or after it
+	 * may already have been changed by another thread */
+	while (!OSAtomicCompareAndSwap32Barrier((int32_t)old, (int32_t)_new, (int32_t *)v)) {
+		uint32_t cur_val = *(volatile uint32_t *)v;
+		if (cur_val != old) {
+			return cur_val;
+		}
+	}
+	return old;
+}
 #elif (defined(__i386__) || defined(__amd64__) || defined(__x86_64__))
 ATOMIC_INLINE uint32_t
 atomic_add_uint32(uint32_t *p, uint32_t x)
 {
+	uint32_t ret = x;
 	asm volatile (
 	    "lock; xaddl %0, %1;"
-	    : "+r" (x), "=m" (*p) /* Outputs. */
+	    : "+r" (ret), "=m" (*p) /* Outputs. */
 	    : "m" (*p) /* Inputs. */
 	    );
-	return (x);
+	/* xadd gives the old value */
+	return (ret + x);
 }
 
 ATOMIC_INLINE uint32_t
 atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
-	x = (uint32_t)(-(int32_t)x);
+	uint32_t ret = (uint32_t)(-(int32_t)x);
 	asm volatile (
 	    "lock; xaddl %0, %1;"
-	    : "+r" (x), "=m" (*p) /* Outputs. */
+	    : "+r" (ret), "=m" (*p) /* Outputs. */
 	    : "m" (*p) /* Inputs. */
 	    );
-	return (x);
+	return (ret - x);
+}
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	uint32_t ret;
+	asm volatile (
+	    "lock; cmpxchgl %2,%1"
+	    : "=a" (ret), "+m" (*v) /* Outputs. */
+	    : "r" (_new), "0" (old) /* Inputs. */
+	    : "memory"
+	    );
+	return ret;
 }
 #elif (defined(JEMALLOC_ATOMIC9))
 ATOMIC_INLINE uint32_t
@@ -241,6 +347,20 @@ atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
 	return (atomic_fetchadd_32(p, (uint32_t)(-(int32_t)x)) - x);
 }
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	/* return the value seen by the swap, a value read before or after it
+	 * may already have been changed by another thread */
+	while (!atomic_cmpset_32(v, old, _new)) {
+		uint32_t cur_val = *(volatile uint32_t *)v;
+		if (cur_val != old) {
+			return cur_val;
+		}
+	}
+	return old;
+}
 #elif (defined(JE_FORCE_SYNC_COMPARE_AND_SWAP_4))
 ATOMIC_INLINE uint32_t
 atomic_add_uint32(uint32_t *p, uint32_t x)
@@ -253,6 +373,12 @@ atomic_sub_uint32(uint32_t *p, uint32_t x)
 {
 	return (__sync_sub_and_fetch(p, x));
 }
+
+ATOMIC_INLINE uint32_t
+atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _new)
+{
+	return __sync_val_compare_and_swap(v, old, _new);
+}
 #else
 #  error "Missing implementation for 32-bit atomic operations"
 #endif
@@ -285,6 +411,20 @@ atomic_sub_z(size_t *p, size_t x)
 #endif
 }
 
+ATOMIC_INLINE size_t
+atomic_cas_z(size_t *v, size_t old, size_t _new)
+{
+	assert(sizeof(size_t) == 1 << LG_SIZEOF_PTR);
+
+#if (LG_SIZEOF_PTR == 3)
+	return ((size_t)atomic_cas_uint64((uint64_t *)v, (uint64_t)old,
+	    (uint64_t)_new));
+#elif (LG_SIZEOF_PTR == 2)
+	return ((size_t)atomic_cas_uint32((uint32_t *)v, (uint32_t)old,
+	    (uint32_t)_new));
+#endif
+}
+
 /******************************************************************************/
 /* unsigned operations. */
 ATOMIC_INLINE unsigned
@@ -0,0 +1,102 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file atomic_spin.h
+ *
+ * Spin locks on a uint32_t, for critical sections of a few instructions only,
+ * shared by the per-thread caches of guardedalloc and BLI_mempool.
+ */
+
+#ifndef __ATOMIC_SPIN_H__
+#define __ATOMIC_SPIN_H__
+
+#include "atomic_ops.h"
+
+ATOMIC_INLINE bool
+atomic_spin_trylock(uint32_t *lock)
+{
+	return (atomic_cas_uint32(lock, 0, 1) == 0);
+}
+
+ATOMIC_INLINE void
+atomic_spin_lock(uint32_t *lock)
+{
+	while (!atomic_spin_trylock(lock)) {
+		/* spin */
+	}
+}
+
+ATOMIC_INLINE void
+atomic_spin_unlock(uint32_t *lock)
+{
+#if defined(__GNUC__)
+	/* a release store is enough, no need for a locked instruction */
+	__sync_lock_release(lock);
+#else
+	atomic_cas_uint32(lock, 1, 0);
+#endif
+}
+
+/**
+ * Index in [0, \a tot) a thread prefers, from the address of its stack.
+ * Thread local storage isn't used since not all supported compilers have it,
+ * and a call to get the thread id costs more than the locked section itself.
+ *
+ * Every thread runs on its own stack, so the address of a local variable
+ * (rounded to 64KB) tells threads apart. When a deep call moves it to another
+ * index, the thread simply prefers another lock.
+ */
+ATOMIC_INLINE unsigned int
+atomic_spin_thread_index(unsigned int tot)
+{
+	const uint64_t id = (uint64_t)((uintptr_t)&tot >> 16);
+
+	/* Fibonacci hashing, the high bits of the product are spread best,
+	 * map those to [0, tot) with a multiply instead of a modulo */
+	const uint64_t hash = (id * 0x9E3779B97F4A7C15ull) >> 32;
+
+	return (unsigned int)((hash * tot) >> 32);
+}
+
+/**
+ * Lock one of \a tot locks placed \a stride bytes apart (in an array of caches)
+ * and return its index.
+ *
+ * The lock of #atomic_spin_thread_index is tried first,
+ * when it's taken the others are tried in turn.
+ */
+ATOMIC_INLINE unsigned int
+atomic_spin_lock_any(uint32_t *locks, size_t stride, unsigned int tot)
+{
+	const unsigned int index = atomic_spin_thread_index(tot);
+	unsigned int i;
+
+	for (;;) {
+		for (i = 0; i < tot; i++) {
+			const unsigned int index_test = (index + i) % tot;
+
+			if (atomic_spin_trylock((uint32_t *)((char *)locks + stride * index_test))) {
+				return index_test;
+			}
+		}
+	}
+}
+
+#endif /* __ATOMIC_SPIN_H__ */
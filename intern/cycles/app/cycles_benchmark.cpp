@@ -0,0 +1,863 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+/* Cycles Benchmark
+ *
+ * Renders a set of procedurally generated XML scenes with fixed settings on
+ * the CPU device, once for each kernel variant the CPU supports, and reports
+ * timings as JSON so results can be compared between builds. Ray counts are
+ * only available when Cycles is built with WITH_CYCLES_RAY_STATS, otherwise
+ * they are reported as zero. */
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "bvh.h"
+#include "bvh_params.h"
+#include "buffers.h"
+#include "camera.h"
+#include "device.h"
+#include "integrator.h"
+#include "mesh.h"
+#include "object.h"
+#include "scene.h"
+#include "session.h"
+
+#include "util_args.h"
+#include "util_foreach.h"
+#include "util_path.h"
+#include "util_progress.h"
+#include "util_string.h"
+#include "util_system.h"
+#include "util_time.h"
+#include "util_types.h"
+
+#include "cycles_xml.h"
+
+CCL_NAMESPACE_BEGIN
+
+struct Options {
+	int width, height;
+	int samples;
+	int seed;
+	int threads;
+	bool use_packet_tracing;
+	string scenes;
+	string kernels;
+	string servers;
+	int local_servers;
+	string output;
+	bool quiet;
+} options;
+
+struct BenchmarkResult {
+	string scene;
+	string kernel;
+	int num_servers;
+	size_t num_objects;
+	size_t num_triangles;
+	size_t num_curves;
+	double load_time;
+	double sync_time;
+	double bvh_build_time;
+	double render_time;
+	uint64_t num_rays;
+	/* camera rays per second, indexed by occlusion and packets */
+	double bvh_rays_per_second[2][2];
+	/* render speedup over one network server, zero for local rendering */
+	double scaling;
+};
+
+/* Procedural Scenes */
+
+static float benchmark_random(uint *state)
+{
+	/* simple LCG, so scenes are the same on every platform */
+	*state = *state * 1103515245 + 12345;
+	return ((*state >> 8) & 0xFFFFFF)/(float)0x1000000;
+}
+
+static string xml_float3(float3 f)
+{
+	return string_printf("%g %g %g", f.x, f.y, f.z);
+}
+
+static string xml_mesh(const vector<float3>& P, const vector<int>& nverts, const vector<int>& verts,
+	const string& attributes = "")
+{
+	string xml = "<mesh " + attributes + " P=\"";
+
+	for(size_t i = 0; i < P.size(); i++)
+		xml += xml_float3(P[i]) + " ";
+
+	xml += "\" nverts=\"";
+
+	for(size_t i = 0; i < nverts.size(); i++)
+		xml += string_printf("%d ", nverts[i]);
+
+	xml += "\" verts=\"";
+
+	for(size_t i = 0; i < verts.size(); i++)
+		xml += string_printf("%d ", verts[i]);
+
+	return xml + "\"/>\n";
+}
+
+static string xml_box(float3 min, float3 max, bool open_front = false)
+{
+	vector<float3> P;
+	vector<int> nverts, verts;
+
+	for(int i = 0; i < 8; i++)
+		P.push_back(make_float3((i & 1)? max.x: min.x, (i & 2)? max.y: min.y, (i & 4)? max.z: min.z));
+
+	const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+	                         {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+
+	for(int i = 0; i < 6; i++) {
+		/* first face is the one facing the camera */
+		if(open_front && i == 0)
+			continue;
+
+		nverts.push_back(4);
+		for(int j = 0; j < 4; j++)
+			verts.push_back(faces[i][j]);
+	}
+
+	return xml_mesh(P, nverts, verts);
+}
+
+static void sphere_geometry(int segments, int rings, float radius,
+	vector<float3>& P, vector<int>& nverts, vector<int>& verts)
+{
+	/* poles and rings in between */
+	P.push_back(make_float3(0.0f, radius, 0.0f));
+
+	for(int r = 1; r < rings; r++) {
+		float theta = M_PI_F*r/rings;
+
+		for(int s = 0; s < segments; s++) {
+			float phi = 2.0f*M_PI_F*s/segments;
+			P.push_back(radius*make_float3(sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi)));
+		}
+	}
+
+	P.push_back(make_float3(0.0f, -radius, 0.0f));
+
+	int bottom = P.size() - 1;
+
+	for(int s = 0; s < segments; s++) {
+		int s1 = (s + 1) % segments;
+
+		/* triangle fans at the poles */
+		nverts.push_back(3);
+		verts.push_back(0);
+		verts.push_back(1 + s1);
+		verts.push_back(1 + s);
+
+		nverts.push_back(3);
+		verts.push_back(bottom);
+		verts.push_back(1 + (rings - 2)*segments + s);
+		verts.push_back(1 + (rings - 2)*segments + s1);
+
+		/* quads in between */
+		for(int r = 0; r < rings - 2; r++) {
+			nverts.push_back(4);
+			verts.push_back(1 + r*segments + s);
+			verts.push_back(1 + r*segments + s1);
+			verts.push_back(1 + (r + 1)*segments + s1);
+			verts.push_back(1 + (r + 1)*segments + s);
+		}
+	}
+}
+
+static string xml_sphere(float3 center, float radius, int segments, int rings, const string& attributes = "")
+{
+	vector<float3> P;
+	vector<int> nverts, verts;
+
+	sphere_geometry(segments, rings, radius, P, nverts, verts);
+
+	return "<transform translate=\"" + xml_float3(center) + "\">\n" +
+	       xml_mesh(P, nverts, verts, attributes) +
+	       "</transform>\n";
+}
+
+static string xml_scene_header(const string& shaders)
+{
+	return
+		"<transform translate=\"0 0 -6\">\n"
+		"	<camera type=\"perspective\" fov=\"45\"/>\n"
+		"</transform>\n"
+		"<integrator max_bounce=\"8\" min_bounce=\"3\"/>\n"
+		"<background>\n"
+		"	<background name=\"bg\" color=\"0.2 0.2 0.25\" strength=\"1.0\"/>\n"
+		"	<connect from=\"bg background\" to=\"output surface\"/>\n"
+		"</background>\n"
+		"<shader name=\"diffuse\">\n"
+		"	<diffuse_bsdf name=\"d\" color=\"0.8 0.8 0.8\"/>\n"
+		"	<connect from=\"d bsdf\" to=\"output surface\"/>\n"
+		"</shader>\n"
+		"<shader name=\"lamp\">\n"
+		"	<emission name=\"e\" color=\"1 1 1\" strength=\"100\"/>\n"
+		"	<connect from=\"e emission\" to=\"output surface\"/>\n"
+		"</shader>\n" +
+		shaders +
+		"<state shader=\"lamp\">\n"
+		"	<light type=\"0\" P=\"0 1.5 0\" size=\"0.25\"/>\n"
+		"</state>\n";
+}
+
+static string xml_room()
+{
+	return "<state shader=\"diffuse\">\n" +
+	       xml_box(make_float3(-2.0f, -2.0f, -2.0f), make_float3(2.0f, 2.0f, 2.0f), true) +
+	       "</state>\n";
+}
+
+static string benchmark_scene_diffuse_box()
+{
+	/* closed room with diffuse objects, mostly indirect light */
+	return xml_scene_header("") +
+	       xml_room() +
+	       "<state shader=\"diffuse\">\n" +
+	       xml_sphere(make_float3(-0.8f, -1.3f, 0.5f), 0.7f, 64, 32) +
+	       xml_sphere(make_float3(0.9f, -1.5f, -0.3f), 0.5f, 64, 32) +
+	       xml_box(make_float3(-0.5f, -2.0f, 1.0f), make_float3(0.5f, -0.5f, 1.8f)) +
+	       "</state>\n";
+}
+
+static string benchmark_scene_hair()
+{
+	/* sphere covered in curves */
+	string shaders =
+		"<shader name=\"hair\">\n"
+		"	<hair_bsdf name=\"h\" color=\"0.6 0.4 0.2\" roughnessu=\"0.2\" roughnessv=\"0.5\"/>\n"
+		"	<connect from=\"h bsdf\" to=\"output surface\"/>\n"
+		"</shader>\n";
+
+	const int num_curves = 20000;
+	const int num_keys = 4;
+	uint rng = 1;
+	string P, nkeys;
+
+	for(int i = 0; i < num_curves; i++) {
+		/* random root on the sphere, growing outwards with some noise */
+		float3 N = make_float3(benchmark_random(&rng)*2.0f - 1.0f,
+		                       benchmark_random(&rng)*2.0f - 1.0f,
+		                       benchmark_random(&rng)*2.0f - 1.0f);
+		N = (len(N) > 0.0f)? normalize(N): make_float3(0.0f, 1.0f, 0.0f);
+
+		float3 co = N;
+
+		for(int k = 0; k < num_keys; k++) {
+			P += xml_float3(co) + " ";
+
+			float3 offset = make_float3(benchmark_random(&rng) - 0.5f,
+			                            benchmark_random(&rng) - 0.5f,
+			                            benchmark_random(&rng) - 0.5f);
+			co += 0.12f*N + 0.04f*offset;
+		}
+
+		nkeys += string_printf("%d ", num_keys);
+	}
+
+	return xml_scene_header(shaders) +
+	       xml_room() +
+	       "<state shader=\"diffuse\">\n" +
+	       xml_sphere(make_float3(0.0f, 0.0f, 0.0f), 1.0f, 64, 32) +
+	       "</state>\n"
+	       "<state shader=\"hair\">\n"
+	       "<curves P=\"" + P + "\" nkeys=\"" + nkeys + "\" radius=\"0.004\"/>\n"
+	       "</state>\n";
+}
+
+static string benchmark_scene_instancing()
+{
+	/* many randomly transformed instances of one mesh */
+	string xml = xml_scene_header("") + "<state shader=\"diffuse\">\n";
+	uint rng = 2;
+
+	xml += xml_sphere(make_float3(0.0f, 0.0f, 0.0f), 0.12f, 24, 12, "name=\"rock\"");
+
+	for(int z = 0; z < 20; z++) {
+		for(int y = 0; y < 16; y++) {
+			for(int x = 0; x < 16; x++) {
+				float3 co = make_float3(-1.9f + 3.8f*(x + benchmark_random(&rng))/16.0f,
+				                        -1.9f + 3.8f*(y + benchmark_random(&rng))/16.0f,
+				                        -1.0f + 2.9f*(z + benchmark_random(&rng))/20.0f);
+				float angle = 360.0f*benchmark_random(&rng);
+				float scale = 0.5f + benchmark_random(&rng);
+
+				xml += string_printf(
+					"<transform translate=\"%s\" rotate=\"%g 0.3 1 0.2\" scale=\"%g %g %g\">"
+					"<instance mesh=\"rock\"/></transform>\n",
+					xml_float3(co).c_str(), angle, scale, scale*0.6f, scale);
+			}
+		}
+	}
+
+	return xml + "</state>\n" + xml_room();
+}
+
+static string benchmark_scene_volume()
+{
+	/* scattering box lit from inside the room */
+	string shaders =
+		"<shader name=\"smoke\">\n"
+		"	<scatter_volume name=\"s\" color=\"0.8 0.8 0.8\" density=\"1.5\"/>\n"
+		"	<connect from=\"s volume\" to=\"output volume\"/>\n"
+		"</shader>\n";
+
+	return xml_scene_header(shaders) +
+	       xml_room() +
+	       "<state shader=\"smoke\">\n" +
+	       xml_box(make_float3(-1.2f, -2.0f, -1.0f), make_float3(1.2f, 0.5f, 1.0f)) +
+	       "</state>\n"
+	       "<state shader=\"diffuse\">\n" +
+	       xml_sphere(make_float3(0.0f, -1.4f, 0.0f), 0.5f, 64, 32) +
+	       "</state>\n";
+}
+
+static string benchmark_scene_sss()
+{
+	/* spheres with subsurface scattering */
+	string shaders =
+		"<shader name=\"skin\">\n"
+		"	<subsurface_scattering name=\"s\" color=\"0.9 0.6 0.5\" scale=\"0.2\"/>\n"
+		"	<connect from=\"s bssrdf\" to=\"output surface\"/>\n"
+		"</shader>\n";
+
+	return xml_scene_header(shaders) +
+	       xml_room() +
+	       "<state shader=\"skin\" interpolation=\"smooth\">\n" +
+	       xml_sphere(make_float3(-1.0f, -1.3f, 0.0f), 0.7f, 64, 32) +
+	       xml_sphere(make_float3(0.8f, -1.4f, 0.5f), 0.6f, 64, 32) +
+	       xml_sphere(make_float3(0.0f, 0.2f, 0.8f), 0.5f, 64, 32) +
+	       "</state>\n";
+}
+
+struct BenchmarkScene {
+	const char *name;
+	string (*generate)();
+};
+
+static BenchmarkScene benchmark_scenes[] = {
+	{"diffuse_box", benchmark_scene_diffuse_box},
+	{"hair", benchmark_scene_hair},
+	{"instancing", benchmark_scene_instancing},
+	{"volume", benchmark_scene_volume},
+	{"sss", benchmark_scene_sss},
+	{NULL, NULL}};
+
+static const char *benchmark_kernels[] = {"none", "sse2", "sse3", "sse41", "avx", "avx2", NULL};
+
+/* Benchmark */
+
+static bool benchmark_selected(const string& list, const string& name)
+{
+	if(list == "")
+		return true;
+
+	vector<string> tokens;
+	string_split(tokens, list, ",");
+
+	foreach(string& token, tokens)
+		if(token == name)
+			return true;
+
+	return false;
+}
+
+/* network device is only compiled in with WITH_NETWORK, without it
+ * Device::create returns NULL */
+static bool benchmark_network_available()
+{
+	vector<DeviceType>& types = Device::available_types();
+
+	foreach(DeviceType type, types)
+		if(type == DEVICE_NETWORK)
+			return true;
+
+	return false;
+}
+
+/* device rendering on the first num servers from the list */
+static DeviceInfo benchmark_network_device(const vector<string>& servers, int num)
+{
+	DeviceInfo info;
+
+	info.type = DEVICE_NETWORK;
+	info.description = "Network Device";
+	info.advanced_shading = true;
+	info.pack_images = false;
+
+	if(num == 1) {
+		info.id = servers[0];
+		return info;
+	}
+
+	DeviceInfo multi_info;
+
+	multi_info.type = DEVICE_MULTI;
+	multi_info.description = "Multi Network Device";
+	multi_info.id = "MULTI";
+	multi_info.advanced_shading = true;
+	multi_info.pack_images = false;
+
+	for(int i = 0; i < num; i++) {
+		info.id = servers[i];
+		info.num = i;
+		multi_info.multi_devices.push_back(info);
+	}
+
+	return multi_info;
+}
+
+/* Local Servers
+ *
+ * To measure the scaling of the network device without a render farm, a
+ * number of cycles_server processes can be started on this machine, on
+ * consecutive ports and with the CPU threads divided between them. */
+
+static const int BENCHMARK_SERVER_PORT = 5130;
+
+struct BenchmarkServer {
+#ifndef _WIN32
+	pid_t pid;
+	FILE *output;
+#endif
+	int port;
+};
+
+static bool benchmark_server_start(const string& path, int port, int threads, BenchmarkServer& server)
+{
+#ifndef _WIN32
+	int fd[2];
+
+	if(pipe(fd) != 0)
+		return false;
+
+	string port_str = string_printf("%d", port);
+	string threads_str = string_printf("%d", threads);
+	pid_t pid = fork();
+
+	if(pid == 0) {
+		/* server writes to the pipe, so we know when it's listening */
+		dup2(fd[1], STDOUT_FILENO);
+		close(fd[0]);
+		close(fd[1]);
+
+		execl(path.c_str(), path.c_str(), "--port", port_str.c_str(), "--threads", threads_str.c_str(), (char*)NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	close(fd[1]);
+
+	if(pid < 0) {
+		close(fd[0]);
+		return false;
+	}
+
+	server.pid = pid;
+	server.output = fdopen(fd[0], "r");
+	server.port = port;
+
+	/* wait until listening, end of output means the server exited. the pipe
+	 * stays open while it runs, it would get SIGPIPE writing to it otherwise */
+	char line[256];
+
+	while(fgets(line, sizeof(line), server.output))
+		if(strncmp(line, "Listening", 9) == 0)
+			return true;
+
+	waitpid(pid, NULL, 0);
+	fclose(server.output);
+
+	return false;
+#else
+	(void)path;
+	(void)port;
+	(void)threads;
+	(void)server;
+
+	return false;
+#endif
+}
+
+static void benchmark_server_stop(BenchmarkServer& server)
+{
+#ifndef _WIN32
+	kill(server.pid, SIGTERM);
+	waitpid(server.pid, NULL, 0);
+	fclose(server.output);
+#else
+	(void)server;
+#endif
+}
+
+static bool benchmark_kernel_supported(const string& kernel)
+{
+	if(kernel == "sse2") return system_cpu_support_sse2();
+	if(kernel == "sse3") return system_cpu_support_sse3();
+	if(kernel == "sse41") return system_cpu_support_sse41();
+	if(kernel == "avx") return system_cpu_support_avx();
+	if(kernel == "avx2") return system_cpu_support_avx2();
+
+	return true;
+}
+
+static void benchmark_run(BenchmarkScene& bscene, const string& xml, const string& kernel,
+	DeviceInfo& device_info, BenchmarkResult& result)
+{
+	SceneParams scene_params;
+	SessionParams session_params;
+
+	session_params.device = device_info;
+	session_params.background = true;
+	session_params.samples = options.samples;
+	session_params.threads = options.threads;
+	session_params.use_packet_tracing = options.use_packet_tracing;
+
+	result.scene = bscene.name;
+	result.kernel = kernel;
+	result.num_servers = (device_info.type == DEVICE_NETWORK)? 1: device_info.multi_devices.size();
+	result.scaling = 0.0;
+
+	/* load scene */
+	double t0 = time_dt();
+
+	Scene *scene = new Scene(scene_params, device_info);
+	xml_read_memory(scene, xml.c_str());
+
+	scene->integrator->seed = options.seed;
+	scene->integrator->tag_update(scene);
+	scene->camera->width = options.width;
+	scene->camera->height = options.height;
+	scene->camera->compute_auto_viewplane();
+
+	result.load_time = time_dt() - t0;
+
+	/* sync scene to device, done here rather than in the session so it
+	 * can be timed separately from rendering */
+	Session *session = new Session(session_params);
+
+	BufferParams buffer_params;
+	buffer_params.width = options.width;
+	buffer_params.height = options.height;
+	buffer_params.full_width = options.width;
+	buffer_params.full_height = options.height;
+
+	session->scene = scene;
+	session->reset(buffer_params, options.samples);
+
+	t0 = time_dt();
+	scene->device_update(session->device, session->progress);
+	result.sync_time = time_dt() - t0;
+
+	/* build the top level BVH once more on its own */
+	BVHParams bparams;
+	bparams.top_level = true;
+	bparams.use_qbvh = scene->params.use_qbvh;
+	bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
+
+	BVH *bvh = BVH::create(bparams, scene->objects);
+
+	t0 = time_dt();
+	bvh->build(session->progress);
+	result.bvh_build_time = time_dt() - t0;
+
+	delete bvh;
+
+	/* camera ray throughput of the scene BVH, single rays and packets,
+	 * zero for devices that can't run it */
+	for(int occlusion = 0; occlusion < 2; occlusion++) {
+		for(int packets = 0; packets < 2; packets++) {
+			t0 = time_dt();
+			int num = session->device->bvh_benchmark(options.width, options.height, packets != 0, occlusion != 0);
+			result.bvh_rays_per_second[occlusion][packets] = num/max(time_dt() - t0, 1e-9);
+		}
+	}
+
+	result.num_objects = scene->objects.size();
+	result.num_triangles = 0;
+	result.num_curves = 0;
+
+	foreach(Object *object, scene->objects) {
+		result.num_triangles += object->mesh->triangles.size();
+		result.num_curves += object->mesh->curves.size();
+	}
+
+	/* render */
+	t0 = time_dt();
+	session->start();
+	session->wait();
+	result.render_time = time_dt() - t0;
+	result.num_rays = session->stats.num_rays;
+
+	/* also frees the scene */
+	delete session;
+}
+
+static void benchmark_write_json(FILE *f, const vector<BenchmarkResult>& results)
+{
+	fprintf(f, "{\n");
+	fprintf(f, "  \"cpu\": \"%s\",\n", system_cpu_brand_string().c_str());
+	fprintf(f, "  \"threads\": %d,\n", (options.threads)? options.threads: system_cpu_thread_count());
+	fprintf(f, "  \"width\": %d,\n", options.width);
+	fprintf(f, "  \"height\": %d,\n", options.height);
+	fprintf(f, "  \"samples\": %d,\n", options.samples);
+	fprintf(f, "  \"seed\": %d,\n", options.seed);
+	fprintf(f, "  \"packet_tracing\": %s,\n", (options.use_packet_tracing)? "true": "false");
+	fprintf(f, "  \"local_servers\": %d,\n", options.local_servers);
+	fprintf(f, "  \"results\": [\n");
+
+	for(size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& r = results[i];
+		double num_samples = (double)options.width*options.height*options.samples;
+		double render_time = max(r.render_time, 1e-9);
+
+		fprintf(f, "    {\n");
+		fprintf(f, "      \"scene\": \"%s\",\n", r.scene.c_str());
+		fprintf(f, "      \"kernel\": \"%s\",\n", r.kernel.c_str());
+		fprintf(f, "      \"servers\": %d,\n", r.num_servers);
+		if(r.scaling > 0.0)
+			fprintf(f, "      \"scaling\": %.3f,\n", r.scaling);
+		fprintf(f, "      \"objects\": %d,\n", (int)r.num_objects);
+		fprintf(f, "      \"triangles\": %d,\n", (int)r.num_triangles);
+		fprintf(f, "      \"curves\": %d,\n", (int)r.num_curves);
+		fprintf(f, "      \"load_time\": %.6f,\n", r.load_time);
+		fprintf(f, "      \"sync_time\": %.6f,\n", r.sync_time);
+		fprintf(f, "      \"bvh_build_time\": %.6f,\n", r.bvh_build_time);
+		fprintf(f, "      \"render_time\": %.6f,\n", r.render_time);
+		fprintf(f, "      \"bvh_rays_per_second\": %.1f,\n", r.bvh_rays_per_second[0][0]);
+		fprintf(f, "      \"bvh_packet_rays_per_second\": %.1f,\n", r.bvh_rays_per_second[0][1]);
+		fprintf(f, "      \"bvh_occlusion_rays_per_second\": %.1f,\n", r.bvh_rays_per_second[1][0]);
+		fprintf(f, "      \"bvh_packet_occlusion_rays_per_second\": %.1f,\n", r.bvh_rays_per_second[1][1]);
+		fprintf(f, "      \"samples_per_second\": %.1f,\n", num_samples/render_time);
+		fprintf(f, "      \"rays\": %llu,\n", (unsigned long long)r.num_rays);
+		fprintf(f, "      \"rays_per_second\": %.1f\n", r.num_rays/render_time);
+		fprintf(f, "    }%s\n", (i + 1 < results.size())? ",": "");
+	}
+
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+}
+
+static void options_parse(int argc, const char **argv)
+{
+	options.width = 256;
+	options.height = 256;
+	options.samples = 16;
+	options.seed = 0;
+	options.threads = 0;
+	options.use_packet_tracing = false;
+	options.local_servers = 0;
+	options.quiet = false;
+
+	bool help = false;
+	ArgParse ap;
+
+	ap.options ("Usage: cycles_benchmark [options]",
+		"--samples %d", &options.samples, "Number of samples to render",
+		"--width %d", &options.width, "Image width in pixels",
+		"--height %d", &options.height, "Image height in pixels",
+		"--seed %d", &options.seed, "Seed for the sampling pattern",
+		"--threads %d", &options.threads, "CPU rendering threads",
+		"--packets", &options.use_packet_tracing, "Trace camera rays in packets",
+		"--scenes %s", &options.scenes, "Comma separated scenes to render: diffuse_box, hair, instancing, volume, sss",
+		"--kernels %s", &options.kernels, "Comma separated kernels to use: none, sse2, sse3, sse41, avx, avx2",
+		"--servers %s", &options.servers, "Comma separated host:port addresses of running cycles_server processes, to measure scaling from 1 to N servers",
+		"--local-servers %d", &options.local_servers, "Start N cycles_server processes on this machine, sharing the CPU threads, to measure scaling from 1 to N servers",
+		"--output %s", &options.output, "File path to write JSON results to, instead of standard output",
+		"--quiet", &options.quiet, "Don't print progress messages",
+		"--help", &help, "Print help message",
+		NULL);
+
+	if(ap.parse(argc, argv) < 0) {
+		fprintf(stderr, "%s\n", ap.geterror().c_str());
+		ap.usage();
+		exit(EXIT_FAILURE);
+	}
+	else if(help) {
+		ap.usage();
+		exit(EXIT_SUCCESS);
+	}
+	else if(options.samples <= 0 || options.width <= 0 || options.height <= 0) {
+		fprintf(stderr, "Invalid samples or resolution\n");
+		exit(EXIT_FAILURE);
+	}
+	else if((options.servers != "" || options.local_servers > 0) && !benchmark_network_available()) {
+		fprintf(stderr, "Network device not available, build with WITH_CYCLES_NETWORK to use --servers\n");
+		exit(EXIT_FAILURE);
+	}
+	else if(options.servers != "" && options.local_servers > 0) {
+		fprintf(stderr, "Use either --servers or --local-servers\n");
+		exit(EXIT_FAILURE);
+	}
+#ifdef _WIN32
+	else if(options.local_servers > 0) {
+		fprintf(stderr, "--local-servers is not supported on Windows\n");
+		exit(EXIT_FAILURE);
+	}
+#endif
+}
+
+CCL_NAMESPACE_END
+
+using namespace ccl;
+
+int main(int argc, const char **argv)
+{
+	path_init();
+	options_parse(argc, argv);
+
+	/* find CPU device */
+	vector<DeviceInfo>& devices = Device::available_devices();
+	DeviceInfo device_info;
+	bool device_available = false;
+
+	foreach(DeviceInfo& device, devices) {
+		if(device.type == DEVICE_CPU) {
+			device_info = device;
+			device_available = true;
+			break;
+		}
+	}
+
+	if(!device_available) {
+		fprintf(stderr, "No CPU device available\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* servers to measure network scaling with, started separately, for
+	 * example as multiple cycles_server processes with --port, or here */
+	vector<string> servers;
+	vector<BenchmarkServer> local_servers;
+
+	if(options.servers != "")
+		string_split(servers, options.servers, ",");
+
+	if(options.local_servers > 0) {
+		string server_path = path_join(path_dirname(argv[0]), "cycles_server");
+		int threads = (options.threads)? options.threads: system_cpu_thread_count();
+		int server_threads = max(threads/options.local_servers, 1);
+
+		for(int i = 0; i < options.local_servers; i++) {
+			BenchmarkServer server;
+
+			if(!benchmark_server_start(server_path, BENCHMARK_SERVER_PORT + i, server_threads, server)) {
+				fprintf(stderr, "Failed to start %s on port %d\n", server_path.c_str(), BENCHMARK_SERVER_PORT + i);
+
+				foreach(BenchmarkServer& local_server, local_servers)
+					benchmark_server_stop(local_server);
+
+				exit(EXIT_FAILURE);
+			}
+
+			local_servers.push_back(server);
+			servers.push_back(string_printf("127.0.0.1:%d", server.port));
+		}
+	}
+
+	vector<BenchmarkResult> results;
+
+	for(int i = 0; benchmark_scenes[i].name; i++) {
+		BenchmarkScene& bscene = benchmark_scenes[i];
+
+		if(!benchmark_selected(options.scenes, bscene.name))
+			continue;
+
+		string xml = bscene.generate();
+
+		for(int k = 0; benchmark_kernels[k]; k++) {
+			string kernel = benchmark_kernels[k];
+
+			if(!benchmark_selected(options.kernels, kernel))
+				continue;
+
+			system_cpu_limit_instruction_set(kernel);
+
+			if(!benchmark_kernel_supported(kernel))
+				continue;
+
+			BenchmarkResult result;
+			benchmark_run(bscene, xml, kernel, device_info, result);
+			results.push_back(result);
+
+			if(!options.quiet) {
+				fprintf(stderr, "%s (%s): sync %.2fs, render %.2fs, %.2f Mrays/s, "
+					"BVH %.2f Mrays/s single, %.2f Mrays/s packets\n",
+					result.scene.c_str(), result.kernel.c_str(), result.sync_time, result.render_time,
+					result.num_rays/max(result.render_time, 1e-9)*1e-6,
+					result.bvh_rays_per_second[0][0]*1e-6, result.bvh_rays_per_second[0][1]*1e-6);
+			}
+		}
+
+		system_cpu_limit_instruction_set("");
+
+		/* scaling over network servers */
+		double single_server_time = 0.0;
+
+		for(int num = 1; num <= (int)servers.size(); num++) {
+			DeviceInfo network_info = benchmark_network_device(servers, num);
+
+			BenchmarkResult result;
+			benchmark_run(bscene, xml, "network", network_info, result);
+
+			if(num == 1)
+				single_server_time = result.render_time;
+
+			result.scaling = single_server_time/max(result.render_time, 1e-9);
+			results.push_back(result);
+
+			if(!options.quiet) {
+				fprintf(stderr, "%s (network, %d servers): sync %.2fs, render %.2fs, %.2fx of 1 server\n",
+					result.scene.c_str(), num, result.sync_time, result.render_time, result.scaling);
+			}
+		}
+	}
+
+	system_cpu_limit_instruction_set("");
+
+	foreach(BenchmarkServer& server, local_servers)
+		benchmark_server_stop(server);
+
+	/* write results */
+	FILE *f = stdout;
+
+	if(options.output != "") {
+		f = fopen(options.output.c_str(), "w");
+
+		if(!f) {
+			fprintf(stderr, "Can't write to %s\n", options.output.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	benchmark_write_json(f, results);
+
+	if(f != stdout)
+		fclose(f);
+
+	return 0;
+}
+
@@ -36,6 +36,7 @@ int main(int argc, const char **argv)
 	string devicename = "cpu";
 	bool list = false;
 	int threads = 0;
+	int port = 0;
 
 	vector<DeviceType>& types = Device::available_types();
 
@@ -53,6 +54,7 @@ int main(int argc, const char **argv)
 		"--device %s", &devicename, ("Devices to use: " + devicelist).c_str(),
 		"--list-devices", &list, "List information about all available devices",
 		"--threads %d", &threads, "Number of threads to use for CPU device",
+		"--port %d", &port, "Port to listen on, to run multiple servers on one machine",
 		NULL);
 
 	if(ap.parse(argc, argv) < 0) {
@@ -92,7 +94,7 @@ int main(int argc, const char **argv)
 		Stats stats;
 		Device *device = Device::create(device_info, stats, true);
 		printf("Cycles Server with device: %s\n", device->info.description.c_str());
-		device->server_run();
+		device->server_run(port);
 		delete device;
 	}
 
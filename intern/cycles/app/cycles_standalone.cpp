@@ -23,6 +23,7 @@
 #include "session.h"
 
 #include "util_args.h"
+#include "util_debug.h"
 #include "util_foreach.h"
 #include "util_function.h"
 #include "util_path.h"
@@ -326,6 +327,7 @@ static void options_parse(int argc, const char **argv)
 	/* parse options */
 	ArgParse ap;
 	bool help = false;
+	bool debug = false;
 
 	ap.options ("Usage: cycles [options] file.xml",
 		"%*", files_parse, "",
@@ -341,6 +343,7 @@ static void options_parse(int argc, const char **argv)
 		"--width  %d", &options.width, "Window width in pixel",
 		"--height %d", &options.height, "Window height in pixel",
 		"--list-devices", &list, "List information about all available devices",
+		"--debug", &debug, "Print debug information, such as shader optimization statistics",
 		"--help", &help, "Print help message",
 		NULL);
 
@@ -366,6 +369,8 @@ static void options_parse(int argc, const char **argv)
 		exit(EXIT_SUCCESS);
 	}
 
+	debug_set_verbose(debug);
+
 	if(ssname == "osl")
 		options.scene_params.shadingsystem = SceneParams::OSL;
 	else if(ssname == "svm")
@@ -302,6 +302,7 @@ static void xml_read_integrator(const XMLReadState& state, pugi::xml_node node)
 	xml_read_int(&integrator->volume_homogeneous_sampling, node, "volume_homogeneous_sampling");
 	xml_read_float(&integrator->volume_step_size, node, "volume_step_size");
 	xml_read_int(&integrator->volume_max_steps, node, "volume_max_steps");
+	xml_read_bool(&integrator->use_volume_majorant, node, "use_volume_majorant");
 	
 	/* Various Settings */
 	xml_read_bool(&integrator->no_caustics, node, "no_caustics");
@@ -841,6 +842,12 @@ static void xml_read_mesh(const XMLReadState& state, pugi::xml_node node)
 
 	mesh->displacement_method = state.displacement_method;
 
+	/* name for instancing */
+	string name;
+
+	if(xml_read_string(&name, node, "name"))
+		mesh->name = ustring(name);
+
 	/* read vertices and polygons, RIB style */
 	vector<float3> P;
 	vector<int> verts, nverts;
@@ -920,6 +927,72 @@ static void xml_read_mesh(const XMLReadState& state, pugi::xml_node node)
 	mesh->attributes.remove(ATTR_STD_VERTEX_NORMAL);
 }
 
+/* Instance */
+
+static void xml_read_instance(const XMLReadState& state, pugi::xml_node node)
+{
+	/* find mesh by name */
+	string name;
+	Mesh *mesh = NULL;
+
+	xml_read_string(&name, node, "mesh");
+
+	foreach(Mesh *other, state.scene->meshes) {
+		if(other->name == name) {
+			mesh = other;
+			break;
+		}
+	}
+
+	if(!mesh) {
+		fprintf(stderr, "Unknown mesh \"%s\".\n", name.c_str());
+		return;
+	}
+
+	/* create object sharing the mesh */
+	Object *object = new Object();
+	object->mesh = mesh;
+	object->tfm = state.tfm;
+	state.scene->objects.push_back(object);
+}
+
+/* Curves */
+
+static void xml_read_curves(const XMLReadState& state, pugi::xml_node node)
+{
+	/* add mesh */
+	Mesh *mesh = xml_add_mesh(state.scene, state.tfm);
+	mesh->used_shaders.push_back(state.shader);
+
+	/* read keys with radius, either per key or one for all, and number of
+	 * keys per curve */
+	vector<float3> P;
+	vector<float> radius;
+	vector<int> nkeys;
+
+	xml_read_float3_array(P, node, "P");
+	xml_read_float_array(radius, node, "radius");
+	xml_read_int_array(nkeys, node, "nkeys");
+
+	for(size_t i = 0; i < P.size(); i++) {
+		float r = (radius.size() == P.size())? radius[i]: (radius.size())? radius[0]: 0.01f;
+		mesh->add_curve_key(P[i], r);
+	}
+
+	/* create curves */
+	int first_key = 0;
+
+	for(size_t i = 0; i < nkeys.size(); i++) {
+		if(nkeys[i] < 2 || first_key + nkeys[i] > (int)P.size()) {
+			fprintf(stderr, "Invalid number of curve keys.\n");
+			break;
+		}
+
+		mesh->add_curve(first_key, nkeys[i], state.shader);
+		first_key += nkeys[i];
+	}
+}
+
 /* Patch */
 
 static void xml_read_patch(const XMLReadState& state, pugi::xml_node node)
@@ -1109,6 +1182,12 @@ static void xml_read_scene(const XMLReadState& state, pugi::xml_node scene_node)
 		else if(string_iequals(node.name(), "mesh")) {
 			xml_read_mesh(state, node);
 		}
+		else if(string_iequals(node.name(), "instance")) {
+			xml_read_instance(state, node);
+		}
+		else if(string_iequals(node.name(), "curves")) {
+			xml_read_curves(state, node);
+		}
 		else if(string_iequals(node.name(), "patch")) {
 			xml_read_patch(state, node);
 		}
@@ -1163,7 +1242,7 @@ static void xml_read_include(const XMLReadState& state, const string& src)
 
 /* File */
 
-void xml_read_file(Scene *scene, const char *filepath)
+static XMLReadState xml_init_state(Scene *scene, const string& base)
 {
 	XMLReadState state;
 
@@ -1172,12 +1251,41 @@ void xml_read_file(Scene *scene, const char *filepath)
 	state.shader = scene->default_surface;
 	state.smooth = false;
 	state.dicing_rate = 0.1f;
-	state.base = path_dirname(filepath);
+	state.displacement_method = Mesh::DISPLACE_BUMP;
+	state.base = base;
+
+	return state;
+}
+
+void xml_read_file(Scene *scene, const char *filepath)
+{
+	XMLReadState state = xml_init_state(scene, path_dirname(filepath));
 
 	xml_read_include(state, path_filename(filepath));
 
 	scene->params.bvh_type = SceneParams::BVH_STATIC;
 }
 
+void xml_read_memory(Scene *scene, const char *buffer)
+{
+	/* parse XML document from memory, includes are relative to the
+	 * working directory */
+	pugi::xml_document doc;
+	pugi::xml_parse_result parse_result;
+
+	parse_result = doc.load_buffer(buffer, strlen(buffer));
+
+	if(!parse_result) {
+		fprintf(stderr, "XML read error: %s\n", parse_result.description());
+		exit(EXIT_FAILURE);
+	}
+
+	XMLReadState state = xml_init_state(scene, "");
+
+	xml_read_scene(state, doc);
+
+	scene->params.bvh_type = SceneParams::BVH_STATIC;
+}
+
 CCL_NAMESPACE_END
 
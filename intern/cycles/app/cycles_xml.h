@@ -22,6 +22,7 @@ CCL_NAMESPACE_BEGIN
 class Scene;
 
 void xml_read_file(Scene *scene, const char *filepath);
+void xml_read_memory(Scene *scene, const char *buffer);
 
 CCL_NAMESPACE_END
 
@@ -25,7 +25,7 @@ def init():
     path = os.path.dirname(__file__)
     user_path = os.path.dirname(os.path.abspath(bpy.utils.user_resource('CONFIG', '')))
 
-    _cycles.init(path, user_path)
+    _cycles.init(path, user_path, bpy.app.debug_cycles)
 
 
 def create(engine, data, scene, region=0, v3d=0, rv3d=0, preview_osl=False):
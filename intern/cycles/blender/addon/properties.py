@@ -21,7 +21,8 @@ from bpy.props import (BoolProperty,
                        EnumProperty,
                        FloatProperty,
                        IntProperty,
-                       PointerProperty)
+                       PointerProperty,
+                       StringProperty)
 
 # enums
 
@@ -265,6 +266,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default=True,
                 )
 
+        cls.use_light_tree = BoolProperty(
+                name="Light Tree",
+                description="Pick lights by distance and orientation to the shading point, "
+                            "reducing noise in scenes with many lights",
+                default=False,
+                )
+
         cls.no_caustics = BoolProperty(
                 name="No Caustics",
                 description="Leave out caustics, resulting in a darker image with less noise",
@@ -355,6 +363,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 min=2, max=65536
                 )
 
+        cls.use_volume_majorant = BoolProperty(
+                name="Majorant Tracking",
+                description="Skip empty space and track through smoke domains using a coarse grid of "
+                            "the density, instead of stepping through them, when the volume shader allows",
+                default=False,
+                )
+
         cls.film_exposure = FloatProperty(
                 name="Exposure",
                 description="Image brightness scale",
@@ -405,6 +420,48 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default=0.0,
                 )
 
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Stop sampling parts of the image that are below the noise threshold, "
+                            "only used for final renders without progressive refine",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Noise Threshold",
+                description="Relative noise level below which a region of the image stops sampling, "
+                            "lower values give less noise at the cost of render time",
+                min=0.0001, max=1.0,
+                default=0.01,
+                precision=4,
+                )
+
+        cls.use_denoising = BoolProperty(
+                name="Denoising",
+                description="Filter noise from the final render after all tiles are done, "
+                            "guided by normal, albedo and depth",
+                default=False,
+                )
+        cls.denoising_radius = IntProperty(
+                name="Radius",
+                description="Size of the filter window in pixels, larger values "
+                            "remove more low frequency noise but are slower",
+                min=1, max=25,
+                default=8,
+                )
+        cls.denoising_strength = FloatProperty(
+                name="Strength",
+                description="How much color differences are filtered, relative to the estimated noise",
+                min=0.0, max=8.0,
+                default=2.0,
+                )
+        cls.denoising_feature_strength = FloatProperty(
+                name="Feature Strength",
+                description="How much normal, albedo and depth differences are filtered, "
+                            "higher values blur more across edges and texture detail",
+                min=0.01, max=10.0,
+                default=1.0,
+                )
+
         cls.debug_tile_size = IntProperty(
                 name="Tile Size",
                 description="",
@@ -450,11 +507,36 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Use BVH spatial splits: longer builder time, faster render",
                 default=False,
                 )
+        cls.debug_use_packet_tracing = BoolProperty(
+                name="Use Packet Tracing",
+                description="Trace camera rays of neighboring pixels together on the CPU, "
+                            "faster for scenes without motion blur or hair",
+                default=False,
+                )
+        cls.bvh_refit_threshold = FloatProperty(
+                name="Refit Threshold",
+                description="With persistent data, rebuild the BVH of deforming meshes instead of refitting it, "
+                            "once it becomes this many times slower to traverse (0 to always refit)",
+                min=0.0, max=10.0,
+                default=1.5,
+                )
         cls.use_cache = BoolProperty(
                 name="Cache BVH",
                 description="Cache last built BVH to disk for faster re-render if no geometry changed",
                 default=False,
                 )
+        cls.use_texture_cache = BoolProperty(
+                name="Texture Cache",
+                description="Read image textures from disk on demand in tiles and mip levels, instead of loading "
+                            "them fully into memory (CPU only, works best with tiled and mipmapped .tx files)",
+                default=False,
+                )
+        cls.texture_cache_size = IntProperty(
+                name="Cache Size",
+                description="Maximum memory in megabytes used by the texture cache",
+                min=16, max=65536,
+                default=1024,
+                )
         cls.tile_order = EnumProperty(
                 name="Tile Order",
                 description="Tile order for rendering",
@@ -470,6 +552,21 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                             "but time can be saved by manually stopping the render when the noise is low enough)",
                 default=False,
                 )
+        cls.checkpoint_path = StringProperty(
+                name="Checkpoint",
+                description="File to periodically store finished tiles of final renders in, "
+                            "a render using an existing file continues from the tiles in it, "
+                            "also when rendering with more samples unless using Correlated Multi-Jitter "
+                            "(leave empty to disable)",
+                subtype='FILE_PATH',
+                default="",
+                )
+        cls.checkpoint_interval = FloatProperty(
+                name="Checkpoint Interval",
+                description="Time in seconds between flushing finished tiles to the checkpoint on disk",
+                min=1.0, max=86400.0,
+                default=300.0,
+                )
 
     @classmethod
     def unregister(cls):
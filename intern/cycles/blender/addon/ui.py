@@ -128,6 +128,22 @@ class CyclesRender_PT_sampling(CyclesButtonsPanel, Panel):
         sub.prop(cscene, "seed")
         sub.prop(cscene, "sample_clamp_direct")
         sub.prop(cscene, "sample_clamp_indirect")
+        sub.prop(cscene, "use_light_tree")
+
+        sub = col.column(align=True)
+        sub.prop(cscene, "use_adaptive_sampling")
+        sub.active = not cscene.use_progressive_refine
+        row = sub.row()
+        row.active = cscene.use_adaptive_sampling
+        row.prop(cscene, "adaptive_threshold")
+
+        sub = col.column(align=True)
+        sub.prop(cscene, "use_denoising")
+        sub = sub.column(align=True)
+        sub.active = cscene.use_denoising
+        sub.prop(cscene, "denoising_radius")
+        sub.prop(cscene, "denoising_strength")
+        sub.prop(cscene, "denoising_feature_strength")
 
         if cscene.progressive == 'PATH':
             col = split.column()
@@ -182,6 +198,7 @@ class CyclesRender_PT_volume_sampling(CyclesButtonsPanel, Panel):
         sub.label("Heterogeneous:")
         sub.prop(cscene, "volume_step_size")
         sub.prop(cscene, "volume_max_steps")
+        sub.prop(cscene, "use_volume_majorant")
 
         sub = split.column(align=True)
         sub.label("Homogeneous:")
@@ -319,11 +336,31 @@ class CyclesRender_PT_performance(CyclesButtonsPanel, Panel):
         col.label(text="Final Render:")
         col.prop(cscene, "use_cache")
         col.prop(rd, "use_persistent_data", text="Persistent Images")
+        sub = col.column()
+        sub.active = rd.use_persistent_data
+        sub.prop(cscene, "bvh_refit_threshold")
+
+        col.separator()
+
+        col.label(text="Checkpoint:")
+        col.prop(cscene, "checkpoint_path", text="")
+        sub = col.column()
+        sub.active = cscene.checkpoint_path != "" and not cscene.use_progressive_refine
+        sub.prop(cscene, "checkpoint_interval", text="Interval")
+
+        col.separator()
+
+        col.label(text="Images:")
+        col.prop(cscene, "use_texture_cache")
+        sub = col.column(align=True)
+        sub.active = cscene.use_texture_cache
+        sub.prop(cscene, "texture_cache_size")
 
         col.separator()
 
         col.label(text="Acceleration structure:")
         col.prop(cscene, "debug_use_spatial_splits")
+        col.prop(cscene, "debug_use_packet_tracing")
 
 
 class CyclesRender_PT_layer_options(CyclesButtonsPanel, Panel):
@@ -27,22 +27,117 @@
 #include "subd_split.h"
 
 #include "util_foreach.h"
+#include "util_hash.h"
 
 #include "mikktspace.h"
 
 CCL_NAMESPACE_BEGIN
 
+/* Mesh Export
+ *
+ * Mesh data read from RNA in the main thread, so that conversion to a Cycles
+ * mesh can run in a task without accessing Blender data. Only data needed by
+ * the shaders is exported, which means the hash covers attribute requests as
+ * well. */
+
+struct BlenderMeshExport {
+	struct Layer {
+		Layer() : active_render(false), need_data(false), need_tangent(false), need_tangent_sign(false) {}
+
+		string name;
+		bool active_render;
+		bool need_data;
+		bool need_tangent;
+		bool need_tangent_sign;
+		vector<float3> data; /* 4 per face */
+	};
+
+	BlenderMeshExport(Mesh *mesh_, const vector<uint>& used_shaders_)
+	: mesh(mesh_), used_shaders(used_shaders_), use_loop_normals(false), need_generated_transform(false),
+	  had_curves(false)
+	{
+	}
+
+	Mesh *mesh;
+	vector<uint> used_shaders;
+
+	vector<float3> verts;
+	vector<float3> vert_normals;
+	vector<float3> generated;
+
+	vector<int4> faces;
+	vector<int> nverts;
+	vector<int> face_shader;
+	vector<uchar> face_smooth;
+	vector<float3> face_normals;
+
+	bool use_loop_normals;
+	vector<float3> loop_normals; /* 4 per face */
+
+	vector<Layer> vertex_colors;
+	vector<Layer> uv_layers;
+
+	bool need_generated_transform;
+	Transform generated_transform;
+
+	/* mesh data before conversion, to test if the BVH needs a rebuild */
+	vector<Mesh::Triangle> old_triangles;
+	bool had_curves;
+
+	uint64_t hash() const;
+};
+
+template<typename T>
+static uint64_t hash_vector(const vector<T>& v, uint64_t seed)
+{
+	return hash_data((v.size())? &v[0]: NULL, sizeof(T)*v.size(), seed);
+}
+
+static uint64_t hash_layer(const BlenderMeshExport::Layer& layer, uint64_t seed)
+{
+	int flags = (layer.active_render << 0) | (layer.need_data << 1) | (layer.need_tangent << 2) | (layer.need_tangent_sign << 3);
+
+	seed = hash_data(layer.name.c_str(), layer.name.size(), seed);
+	seed = hash_data(&flags, sizeof(flags), seed);
+
+	return hash_vector(layer.data, seed);
+}
+
+uint64_t BlenderMeshExport::hash() const
+{
+	uint64_t h = hash_vector(used_shaders, 0);
+
+	h = hash_vector(verts, h);
+	h = hash_vector(vert_normals, h);
+	h = hash_vector(generated, h);
+	h = hash_vector(faces, h);
+	h = hash_vector(face_shader, h);
+	h = hash_vector(face_smooth, h);
+	h = hash_vector(loop_normals, h);
+
+	foreach(const Layer& layer, vertex_colors)
+		h = hash_layer(layer, h);
+	foreach(const Layer& layer, uv_layers)
+		h = hash_layer(layer, h);
+
+	if(need_generated_transform)
+		h = hash_data(&generated_transform, sizeof(generated_transform), h);
+
+	/* never zero, that is used for meshes without hash */
+	return (h)? h: 1;
+}
+
 /* Tangent Space */
 
 struct MikkUserData {
-	MikkUserData(const BL::Mesh mesh_, const BL::MeshTextureFaceLayer layer_, int num_faces_)
-	: mesh(mesh_), layer(layer_), num_faces(num_faces_)
+	MikkUserData(const BlenderMeshExport *mesh_export_, const BlenderMeshExport::Layer *layer_, int num_faces_)
+	: mesh_export(mesh_export_), layer(layer_), num_faces(num_faces_)
 	{
 		tangent.resize(num_faces*4);
 	}
 
-	BL::Mesh mesh;
-	BL::MeshTextureFaceLayer layer;
+	const BlenderMeshExport *mesh_export;
+	const BlenderMeshExport::Layer *layer;
 	int num_faces;
 	vector<float4> tangent;
 };
@@ -56,19 +151,14 @@ static int mikk_get_num_faces(const SMikkTSpaceContext *context)
 static int mikk_get_num_verts_of_face(const SMikkTSpaceContext *context, const int face_num)
 {
 	MikkUserData *userdata = (MikkUserData*)context->m_pUserData;
-	BL::MeshTessFace f = userdata->mesh.tessfaces[face_num];
-	int4 vi = get_int4(f.vertices_raw());
-
-	return (vi[3] == 0)? 3: 4;
+	return userdata->mesh_export->nverts[face_num];
 }
 
 static void mikk_get_position(const SMikkTSpaceContext *context, float P[3], const int face_num, const int vert_num)
 {
 	MikkUserData *userdata = (MikkUserData*)context->m_pUserData;
-	BL::MeshTessFace f = userdata->mesh.tessfaces[face_num];
-	int4 vi = get_int4(f.vertices_raw());
-	BL::MeshVertex v = userdata->mesh.vertices[vi[vert_num]];
-	float3 vP = get_float3(v.co());
+	int4 vi = userdata->mesh_export->faces[face_num];
+	float3 vP = userdata->mesh_export->verts[vi[vert_num]];
 
 	P[0] = vP.x;
 	P[1] = vP.y;
@@ -78,24 +168,8 @@ static void mikk_get_position(const SMikkTSpaceContext *context, float P[3], con
 static void mikk_get_texture_coordinate(const SMikkTSpaceContext *context, float uv[2], const int face_num, const int vert_num)
 {
 	MikkUserData *userdata = (MikkUserData*)context->m_pUserData;
-	BL::MeshTextureFace tf = userdata->layer.data[face_num];
-	float3 tfuv;
-	
-	switch (vert_num) {
-		case 0:
-			tfuv = get_float3(tf.uv1());
-			break;
-		case 1:
-			tfuv = get_float3(tf.uv2());
-			break;
-		case 2:
-			tfuv = get_float3(tf.uv3());
-			break;
-		default:
-			tfuv = get_float3(tf.uv4());
-			break;
-	}
-	
+	float3 tfuv = userdata->layer->data[face_num*4 + vert_num];
+
 	uv[0] = tfuv.x;
 	uv[1] = tfuv.y;
 }
@@ -103,16 +177,15 @@ static void mikk_get_texture_coordinate(const SMikkTSpaceContext *context, float
 static void mikk_get_normal(const SMikkTSpaceContext *context, float N[3], const int face_num, const int vert_num)
 {
 	MikkUserData *userdata = (MikkUserData*)context->m_pUserData;
-	BL::MeshTessFace f = userdata->mesh.tessfaces[face_num];
+	const BlenderMeshExport *mesh_export = userdata->mesh_export;
 	float3 vN;
 
-	if(f.use_smooth()) {
-		int4 vi = get_int4(f.vertices_raw());
-		BL::MeshVertex v = userdata->mesh.vertices[vi[vert_num]];
-		vN = get_float3(v.normal());
+	if(mesh_export->face_smooth[face_num]) {
+		int4 vi = mesh_export->faces[face_num];
+		vN = mesh_export->vert_normals[vi[vert_num]];
 	}
 	else {
-		vN = get_float3(f.normal());
+		vN = mesh_export->face_normals[face_num];
 	}
 
 	N[0] = vN.x;
@@ -127,10 +200,14 @@ static void mikk_set_tangent_space(const SMikkTSpaceContext *context, const floa
 	userdata->tangent[face*4 + vert] = make_float4(T[0], T[1], T[2], sign);
 }
 
-static void mikk_compute_tangents(BL::Mesh b_mesh, BL::MeshTextureFaceLayer b_layer, Mesh *mesh, vector<int>& nverts, bool need_sign, bool active_render)
+static void mikk_compute_tangents(const BlenderMeshExport& mesh_export, const BlenderMeshExport::Layer& layer, Mesh *mesh)
 {
+	const vector<int>& nverts = mesh_export.nverts;
+	bool need_sign = layer.need_tangent_sign;
+	bool active_render = layer.active_render;
+
 	/* setup userdata */
-	MikkUserData userdata(b_mesh, b_layer, nverts.size());
+	MikkUserData userdata(&mesh_export, &layer, nverts.size());
 
 	/* setup interface */
 	SMikkTSpaceInterface sm_interface;
@@ -153,7 +230,7 @@ static void mikk_compute_tangents(BL::Mesh b_mesh, BL::MeshTextureFaceLayer b_la
 
 	/* create tangent attributes */
 	Attribute *attr;
-	ustring name = ustring((string(b_layer.name().c_str()) + ".tangent").c_str());
+	ustring name = ustring((layer.name + ".tangent").c_str());
 
 	if(active_render)
 		attr = mesh->attributes.add(ATTR_STD_UV_TANGENT, name);
@@ -167,7 +244,7 @@ static void mikk_compute_tangents(BL::Mesh b_mesh, BL::MeshTextureFaceLayer b_la
 
 	if(need_sign) {
 		Attribute *attr_sign;
-		ustring name_sign = ustring((string(b_layer.name().c_str()) + ".tangent_sign").c_str());
+		ustring name_sign = ustring((layer.name + ".tangent_sign").c_str());
 
 		if(active_render)
 			attr_sign = mesh->attributes.add(ATTR_STD_UV_TANGENT_SIGN, name_sign);
@@ -240,73 +317,201 @@ static void create_mesh_volume_attributes(Scene *scene, BL::Object b_ob, Mesh *m
 		create_mesh_volume_attribute(b_ob, mesh, scene->image_manager, ATTR_STD_VOLUME_VELOCITY);
 }
 
-/* Create Mesh */
+/* Export Mesh */
 
-static void create_mesh(Scene *scene, Mesh *mesh, BL::Mesh b_mesh, const vector<uint>& used_shaders)
+static void export_mesh(Scene *scene, BlenderMeshExport& mesh_export, BL::Mesh b_mesh)
 {
-	/* count vertices and faces */
+	Mesh *mesh = mesh_export.mesh;
+	const vector<uint>& used_shaders = mesh_export.used_shaders;
+
+	/* vertex coordinates and normals */
 	int numverts = b_mesh.vertices.length();
 	int numfaces = b_mesh.tessfaces.length();
-	int numtris = 0;
-	bool use_loop_normals = b_mesh.use_auto_smooth();
 
 	BL::Mesh::vertices_iterator v;
 	BL::Mesh::tessfaces_iterator f;
 
+	mesh_export.verts.reserve(numverts);
+	mesh_export.vert_normals.reserve(numverts);
+
+	for(b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v) {
+		mesh_export.verts.push_back(get_float3(v->co()));
+		mesh_export.vert_normals.push_back(get_float3(v->normal()));
+	}
+
+	/* generated coordinates from undeformed coordinates */
+	if(mesh->need_attribute(scene, ATTR_STD_GENERATED)) {
+		float3 loc, size;
+		mesh_texture_space(b_mesh, loc, size);
+
+		mesh_export.generated.reserve(numverts);
+
+		for(b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v)
+			mesh_export.generated.push_back(get_float3(v->undeformed_co())*size - loc);
+	}
+
+	/* faces */
+	mesh_export.use_loop_normals = b_mesh.use_auto_smooth();
+
+	mesh_export.faces.reserve(numfaces);
+	mesh_export.nverts.reserve(numfaces);
+	mesh_export.face_shader.reserve(numfaces);
+	mesh_export.face_smooth.reserve(numfaces);
+	mesh_export.face_normals.reserve(numfaces);
+
 	for(b_mesh.tessfaces.begin(f); f != b_mesh.tessfaces.end(); ++f) {
 		int4 vi = get_int4(f->vertices_raw());
-		numtris += (vi[3] == 0)? 1: 2;
+		int n = (vi[3] == 0)? 3: 4;
+		int mi = clamp(f->material_index(), 0, used_shaders.size()-1);
+
+		mesh_export.faces.push_back(vi);
+		mesh_export.nverts.push_back(n);
+		mesh_export.face_shader.push_back(used_shaders[mi]);
+		mesh_export.face_smooth.push_back(f->use_smooth());
+		mesh_export.face_normals.push_back(get_float3(f->normal()));
+
+		if(mesh_export.use_loop_normals) {
+			BL::Array<float, 12> loop_normals = f->split_normals();
+
+			for(int i = 0; i < 4; i++)
+				mesh_export.loop_normals.push_back(make_float3(loop_normals[i * 3], loop_normals[i * 3 + 1], loop_normals[i * 3 + 2]));
+		}
+	}
+
+	/* vertex color layers */
+	{
+		BL::Mesh::tessface_vertex_colors_iterator l;
+
+		for(b_mesh.tessface_vertex_colors.begin(l); l != b_mesh.tessface_vertex_colors.end(); ++l) {
+			if(!mesh->need_attribute(scene, ustring(l->name().c_str())))
+				continue;
+
+			mesh_export.vertex_colors.push_back(BlenderMeshExport::Layer());
+			BlenderMeshExport::Layer& layer = mesh_export.vertex_colors.back();
+
+			layer.name = l->name();
+			layer.need_data = true;
+			layer.data.reserve(numfaces*4);
+
+			BL::MeshColorLayer::data_iterator c;
+			size_t i = 0;
+
+			for(l->data.begin(c); c != l->data.end(); ++c, ++i) {
+				layer.data.push_back(get_float3(c->color1()));
+				layer.data.push_back(get_float3(c->color2()));
+				layer.data.push_back(get_float3(c->color3()));
+				layer.data.push_back((mesh_export.nverts[i] == 4)? get_float3(c->color4()): make_float3(0.0f, 0.0f, 0.0f));
+			}
+		}
 	}
 
+	/* uv map layers, also needed for tangents */
+	{
+		BL::Mesh::tessface_uv_textures_iterator l;
+
+		for(b_mesh.tessface_uv_textures.begin(l); l != b_mesh.tessface_uv_textures.end(); ++l) {
+			BlenderMeshExport::Layer layer;
+
+			layer.name = l->name();
+			layer.active_render = l->active_render();
+
+			AttributeStandard std = (layer.active_render)? ATTR_STD_UV: ATTR_STD_NONE;
+			layer.need_data = mesh->need_attribute(scene, ustring(layer.name)) || mesh->need_attribute(scene, std);
+
+			std = (layer.active_render)? ATTR_STD_UV_TANGENT: ATTR_STD_NONE;
+			layer.need_tangent = mesh->need_attribute(scene, ustring(layer.name + ".tangent")) ||
+			                     (layer.active_render && mesh->need_attribute(scene, std));
+
+			if(layer.need_tangent) {
+				std = (layer.active_render)? ATTR_STD_UV_TANGENT_SIGN: ATTR_STD_NONE;
+				layer.need_tangent_sign = mesh->need_attribute(scene, ustring(layer.name + ".tangent_sign")) ||
+				                          mesh->need_attribute(scene, std);
+			}
+
+			if(!(layer.need_data || layer.need_tangent))
+				continue;
+
+			BL::MeshTextureFaceLayer::data_iterator t;
+
+			layer.data.reserve(numfaces*4);
+
+			for(l->data.begin(t); t != l->data.end(); ++t) {
+				layer.data.push_back(get_float3(t->uv1()));
+				layer.data.push_back(get_float3(t->uv2()));
+				layer.data.push_back(get_float3(t->uv3()));
+				layer.data.push_back(get_float3(t->uv4()));
+			}
+
+			mesh_export.uv_layers.push_back(layer);
+		}
+	}
+
+	/* for volume objects, create a matrix to transform from object space to
+	 * mesh texture space. this does not work with deformations but that can
+	 * probably only be done well with a volume grid mapping of coordinates */
+	if(mesh->need_attribute(scene, ATTR_STD_GENERATED_TRANSFORM)) {
+		float3 loc, size;
+		mesh_texture_space(b_mesh, loc, size);
+
+		mesh_export.need_generated_transform = true;
+		mesh_export.generated_transform = transform_translate(-loc)*transform_scale(size);
+	}
+}
+
+/* Create Mesh */
+
+static void create_mesh(BlenderMeshExport *mesh_export)
+{
+	Mesh *mesh = mesh_export->mesh;
+	const vector<int4>& faces = mesh_export->faces;
+	const vector<int>& nverts = mesh_export->nverts;
+
+	/* count vertices and faces */
+	int numverts = mesh_export->verts.size();
+	int numfaces = faces.size();
+	int numtris = 0;
+
+	for(int fi = 0; fi < numfaces; fi++)
+		numtris += (nverts[fi] == 3)? 1: 2;
+
 	/* reserve memory */
 	mesh->reserve(numverts, numtris, 0, 0);
 
 	/* create vertex coordinates and normals */
-	int i = 0;
-	for(b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v, ++i)
-		mesh->verts[i] = get_float3(v->co());
+	if(numverts)
+		memcpy(&mesh->verts[0], &mesh_export->verts[0], sizeof(float3)*numverts);
 
 	Attribute *attr_N = mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
 	float3 *N = attr_N->data_float3();
 
-	for(b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v, ++N)
-		*N = get_float3(v->normal());
-	N = attr_N->data_float3();
+	for(int i = 0; i < numverts; i++)
+		N[i] = mesh_export->vert_normals[i];
 
 	/* create generated coordinates from undeformed coordinates */
-	if(mesh->need_attribute(scene, ATTR_STD_GENERATED)) {
+	if(mesh_export->generated.size()) {
 		Attribute *attr = mesh->attributes.add(ATTR_STD_GENERATED);
-
-		float3 loc, size;
-		mesh_texture_space(b_mesh, loc, size);
-
 		float3 *generated = attr->data_float3();
-		size_t i = 0;
 
-		for(b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v)
-			generated[i++] = get_float3(v->undeformed_co())*size - loc;
+		for(int i = 0; i < numverts; i++)
+			generated[i] = mesh_export->generated[i];
 	}
 
 	/* create faces */
-	vector<int> nverts(numfaces);
-	int fi = 0, ti = 0;
+	int ti = 0;
 
-	for(b_mesh.tessfaces.begin(f); f != b_mesh.tessfaces.end(); ++f, ++fi) {
-		int4 vi = get_int4(f->vertices_raw());
-		int n = (vi[3] == 0)? 3: 4;
-		int mi = clamp(f->material_index(), 0, used_shaders.size()-1);
-		int shader = used_shaders[mi];
-		bool smooth = f->use_smooth();
+	for(int fi = 0; fi < numfaces; fi++) {
+		int4 vi = faces[fi];
+		int n = nverts[fi];
+		int shader = mesh_export->face_shader[fi];
+		bool smooth = mesh_export->face_smooth[fi];
 
 		/* split vertices if normal is different
 		 *
 		 * note all vertex attributes must have been set here so we can split
 		 * and copy attributes in split_vertex without remapping later */
-		if(use_loop_normals) {
-			BL::Array<float, 12> loop_normals = f->split_normals();
-
+		if(mesh_export->use_loop_normals) {
 			for(int i = 0; i < n; i++) {
-				float3 loop_N = make_float3(loop_normals[i * 3], loop_normals[i * 3 + 1], loop_normals[i * 3 + 2]);
+				float3 loop_N = mesh_export->loop_normals[fi*4 + i];
 
 				if(N[vi[i]] != loop_N) {
 					int new_vi = mesh->split_vertex(vi[i]);
@@ -333,104 +538,73 @@ static void create_mesh(Scene *scene, Mesh *mesh, BL::Mesh b_mesh, const vector<
 		}
 		else
 			mesh->set_triangle(ti++, vi[0], vi[1], vi[2], shader, smooth);
-
-		nverts[fi] = n;
 	}
 
 	/* create vertex color attributes */
-	{
-		BL::Mesh::tessface_vertex_colors_iterator l;
-
-		for(b_mesh.tessface_vertex_colors.begin(l); l != b_mesh.tessface_vertex_colors.end(); ++l) {
-			if(!mesh->need_attribute(scene, ustring(l->name().c_str())))
-				continue;
-
-			Attribute *attr = mesh->attributes.add(
-				ustring(l->name().c_str()), TypeDesc::TypeColor, ATTR_ELEMENT_CORNER);
-
-			BL::MeshColorLayer::data_iterator c;
-			float3 *fdata = attr->data_float3();
-			size_t i = 0;
-
-			for(l->data.begin(c); c != l->data.end(); ++c, ++i) {
-				fdata[0] = color_srgb_to_scene_linear(get_float3(c->color1()));
-				fdata[1] = color_srgb_to_scene_linear(get_float3(c->color2()));
-				fdata[2] = color_srgb_to_scene_linear(get_float3(c->color3()));
-
-				if(nverts[i] == 4) {
-					fdata[3] = fdata[0];
-					fdata[4] = fdata[2];
-					fdata[5] = color_srgb_to_scene_linear(get_float3(c->color4()));
-					fdata += 6;
-				}
-				else
-					fdata += 3;
+	foreach(const BlenderMeshExport::Layer& layer, mesh_export->vertex_colors) {
+		Attribute *attr = mesh->attributes.add(
+			ustring(layer.name), TypeDesc::TypeColor, ATTR_ELEMENT_CORNER);
+
+		const float3 *c = (layer.data.size())? &layer.data[0]: NULL;
+		float3 *fdata = attr->data_float3();
+
+		for(int i = 0; i < numfaces; i++, c += 4) {
+			fdata[0] = color_srgb_to_scene_linear(c[0]);
+			fdata[1] = color_srgb_to_scene_linear(c[1]);
+			fdata[2] = color_srgb_to_scene_linear(c[2]);
+
+			if(nverts[i] == 4) {
+				fdata[3] = fdata[0];
+				fdata[4] = fdata[2];
+				fdata[5] = color_srgb_to_scene_linear(c[3]);
+				fdata += 6;
 			}
+			else
+				fdata += 3;
 		}
 	}
 
 	/* create uv map attributes */
-	{
-		BL::Mesh::tessface_uv_textures_iterator l;
-
-		for(b_mesh.tessface_uv_textures.begin(l); l != b_mesh.tessface_uv_textures.end(); ++l) {
-			bool active_render = l->active_render();
-			AttributeStandard std = (active_render)? ATTR_STD_UV: ATTR_STD_NONE;
-			ustring name = ustring(l->name().c_str());
-
-			/* UV map */
-			if(mesh->need_attribute(scene, name) || mesh->need_attribute(scene, std)) {
-				Attribute *attr;
-
-				if(active_render)
-					attr = mesh->attributes.add(std, name);
-				else
-					attr = mesh->attributes.add(name, TypeDesc::TypePoint, ATTR_ELEMENT_CORNER);
-
-				BL::MeshTextureFaceLayer::data_iterator t;
-				float3 *fdata = attr->data_float3();
-				size_t i = 0;
-
-				for(l->data.begin(t); t != l->data.end(); ++t, ++i) {
-					fdata[0] =  get_float3(t->uv1());
-					fdata[1] =  get_float3(t->uv2());
-					fdata[2] =  get_float3(t->uv3());
-					fdata += 3;
-
-					if(nverts[i] == 4) {
-						fdata[0] =  get_float3(t->uv1());
-						fdata[1] =  get_float3(t->uv3());
-						fdata[2] =  get_float3(t->uv4());
-						fdata += 3;
-					}
-				}
-			}
+	foreach(const BlenderMeshExport::Layer& layer, mesh_export->uv_layers) {
+		/* UV map */
+		if(layer.need_data) {
+			Attribute *attr;
+			ustring name = ustring(layer.name);
+
+			if(layer.active_render)
+				attr = mesh->attributes.add(ATTR_STD_UV, name);
+			else
+				attr = mesh->attributes.add(name, TypeDesc::TypePoint, ATTR_ELEMENT_CORNER);
 
-			/* UV tangent */
-			std = (active_render)? ATTR_STD_UV_TANGENT: ATTR_STD_NONE;
-			name = ustring((string(l->name().c_str()) + ".tangent").c_str());
+			const float3 *uv = (layer.data.size())? &layer.data[0]: NULL;
+			float3 *fdata = attr->data_float3();
 
-			if(mesh->need_attribute(scene, name) || (active_render && mesh->need_attribute(scene, std))) {
-				std = (active_render)? ATTR_STD_UV_TANGENT_SIGN: ATTR_STD_NONE;
-				name = ustring((string(l->name().c_str()) + ".tangent_sign").c_str());
-				bool need_sign = (mesh->need_attribute(scene, name) || mesh->need_attribute(scene, std));
+			for(int i = 0; i < numfaces; i++, uv += 4) {
+				fdata[0] = uv[0];
+				fdata[1] = uv[1];
+				fdata[2] = uv[2];
+				fdata += 3;
 
-				mikk_compute_tangents(b_mesh, *l, mesh, nverts, need_sign, active_render);
+				if(nverts[i] == 4) {
+					fdata[0] = uv[0];
+					fdata[1] = uv[2];
+					fdata[2] = uv[3];
+					fdata += 3;
+				}
 			}
 		}
+
+		/* UV tangent */
+		if(layer.need_tangent)
+			mikk_compute_tangents(*mesh_export, layer, mesh);
 	}
 
-	/* for volume objects, create a matrix to transform from object space to
-	 * mesh texture space. this does not work with deformations but that can
-	 * probably only be done well with a volume grid mapping of coordinates */
-	if(mesh->need_attribute(scene, ATTR_STD_GENERATED_TRANSFORM)) {
+	/* texture space transform for volumes */
+	if(mesh_export->need_generated_transform) {
 		Attribute *attr = mesh->attributes.add(ATTR_STD_GENERATED_TRANSFORM);
 		Transform *tfm = attr->data_transform();
 
-		float3 loc, size;
-		mesh_texture_space(b_mesh, loc, size);
-
-		*tfm = transform_translate(-loc)*transform_scale(size);
+		*tfm = mesh_export->generated_transform;
 	}
 }
 
@@ -478,6 +652,30 @@ static void create_subd_mesh(Scene *scene, Mesh *mesh, BL::Mesh b_mesh, PointerR
 
 /* Sync */
 
+static bool object_has_hair(BL::Object b_ob)
+{
+	BL::Object::particle_systems_iterator b_psys;
+
+	for(b_ob.particle_systems.begin(b_psys); b_psys != b_ob.particle_systems.end(); ++b_psys) {
+		BL::ParticleSettings b_part = b_psys->settings();
+
+		if(b_part.render_type() == BL::ParticleSettings::render_type_PATH && b_part.type() == BL::ParticleSettings::type_HAIR)
+			return true;
+	}
+
+	return false;
+}
+
+static bool mesh_triangles_changed(const vector<Mesh::Triangle>& oldtriangle, const vector<Mesh::Triangle>& triangle)
+{
+	if(oldtriangle.size() != triangle.size())
+		return true;
+	else if(oldtriangle.size())
+		return (memcmp(&oldtriangle[0], &triangle[0], sizeof(Mesh::Triangle)*oldtriangle.size()) != 0);
+
+	return false;
+}
+
 Mesh *BlenderSync::sync_mesh(BL::Object b_ob, bool object_updated, bool hide_tris)
 {
 	/* test if we can instance or if the object is modified */
@@ -535,64 +733,113 @@ Mesh *BlenderSync::sync_mesh(BL::Object b_ob, bool object_updated, bool hide_tri
 
 	/* create derived mesh */
 	PointerRNA cmesh = RNA_pointer_get(&b_ob_data.ptr, "cycles");
+	bool use_subdivision = (cmesh.data && experimental && RNA_boolean_get(&cmesh, "use_subdivision"));
 
-	vector<Mesh::Triangle> oldtriangle = mesh->triangles;
-	
-	/* compares curve_keys rather than strands in order to handle quick hair
-	 * adjustsments in dynamic BVH - other methods could probably do this better*/
-	vector<float4> oldcurve_keys = mesh->curve_keys;
+	/* displacement method */
+	Mesh::DisplacementMethod displacement_method = mesh->displacement_method;
+
+	if(cmesh.data) {
+		const int method = RNA_enum_get(&cmesh, "displacement_method");
+
+		if(method == 0 || !experimental)
+			displacement_method = Mesh::DISPLACE_BUMP;
+		else if(method == 1)
+			displacement_method = Mesh::DISPLACE_TRUE;
+		else
+			displacement_method = Mesh::DISPLACE_BOTH;
+	}
+
+	/* used shaders determine which attributes are needed */
+	bool force_update = (object_updated && mesh->transform_applied) || mesh->displacement_method != displacement_method;
 
-	mesh->clear();
 	mesh->used_shaders = used_shaders;
-	mesh->name = ustring(b_ob_data.name().c_str());
+	mesh->displacement_method = displacement_method;
+
+	BL::Mesh b_mesh(PointerRNA_NULL);
 
 	if(render_layer.use_surfaces || render_layer.use_hair) {
 		if(preview)
 			b_ob.update_from_editmode();
 
 		bool need_undeformed = mesh->need_attribute(scene, ATTR_STD_GENERATED);
-		BL::Mesh b_mesh = object_to_mesh(b_data, b_ob, b_scene, true, !preview, need_undeformed);
+		b_mesh = object_to_mesh(b_data, b_ob, b_scene, true, !preview, need_undeformed);
+	}
 
-		if(b_mesh) {
-			if(render_layer.use_surfaces && !hide_tris) {
-				if(cmesh.data && experimental && RNA_boolean_get(&cmesh, "use_subdivision"))
-					create_subd_mesh(scene, mesh, b_mesh, &cmesh, used_shaders);
-				else
-					create_mesh(scene, mesh, b_mesh, used_shaders);
+	/* plain meshes are exported from RNA here and converted in a task, or not
+	 * at all if they did not change since the last sync. subdivision, hair
+	 * and smoke need RNA access during conversion and are done directly */
+	bool use_task = b_mesh && render_layer.use_surfaces && !hide_tris && !use_subdivision &&
+	                !(render_layer.use_hair && object_has_hair(b_ob)) && !object_smoke_domain_find(b_ob);
 
-				create_mesh_volume_attributes(scene, b_ob, mesh);
-			}
+	if(use_task) {
+		BlenderMeshExport *mesh_export = new BlenderMeshExport(mesh, used_shaders);
 
-			if(render_layer.use_hair)
-				sync_curves(mesh, b_mesh, b_ob, false);
+		export_mesh(scene, *mesh_export, b_mesh);
 
-			/* free derived mesh */
-			b_data.meshes.remove(b_mesh);
+		/* free derived mesh */
+		b_data.meshes.remove(b_mesh);
+
+		uint64_t hash = mesh_export->hash();
+
+		if(hash == mesh->source_hash && mesh->curve_keys.empty() && !force_update) {
+			/* unchanged, keep mesh and BVH as they are */
+			delete mesh_export;
+			return mesh;
 		}
-	}
 
-	/* displacement method */
-	if(cmesh.data) {
-		const int method = RNA_enum_get(&cmesh, "displacement_method");
+		mesh_export->old_triangles.swap(mesh->triangles);
+		mesh_export->had_curves = !mesh->curve_keys.empty();
 
-		if(method == 0 || !experimental)
-			mesh->displacement_method = Mesh::DISPLACE_BUMP;
-		else if(method == 1)
-			mesh->displacement_method = Mesh::DISPLACE_TRUE;
-		else
-			mesh->displacement_method = Mesh::DISPLACE_BOTH;
+		mesh->clear();
+		mesh->used_shaders = used_shaders;
+		mesh->name = ustring(b_ob_data.name().c_str());
+		mesh->source_hash = hash;
+
+		/* tagged for update in sync_mesh_finish once converted, but objects
+		 * test this flag already while syncing */
+		mesh->need_update = true;
+
+		mesh_exports.push_back(mesh_export);
+		mesh_pool.push(function_bind(create_mesh, mesh_export));
+
+		return mesh;
 	}
 
-	/* tag update */
-	bool rebuild = false;
+	vector<Mesh::Triangle> oldtriangle = mesh->triangles;
+	
+	/* compares curve_keys rather than strands in order to handle quick hair
+	 * adjustsments in dynamic BVH - other methods could probably do this better*/
+	vector<float4> oldcurve_keys = mesh->curve_keys;
 
-	if(oldtriangle.size() != mesh->triangles.size())
-		rebuild = true;
-	else if(oldtriangle.size()) {
-		if(memcmp(&oldtriangle[0], &mesh->triangles[0], sizeof(Mesh::Triangle)*oldtriangle.size()) != 0)
-			rebuild = true;
+	mesh->clear();
+	mesh->used_shaders = used_shaders;
+	mesh->name = ustring(b_ob_data.name().c_str());
+
+	if(b_mesh) {
+		if(render_layer.use_surfaces && !hide_tris) {
+			if(use_subdivision) {
+				create_subd_mesh(scene, mesh, b_mesh, &cmesh, used_shaders);
+			}
+			else {
+				BlenderMeshExport mesh_export(mesh, used_shaders);
+
+				export_mesh(scene, mesh_export, b_mesh);
+				create_mesh(&mesh_export);
+			}
+
+			create_mesh_volume_attributes(scene, b_ob, mesh);
+		}
+
+		if(render_layer.use_hair)
+			sync_curves(mesh, b_mesh, b_ob, false);
+
+		/* free derived mesh */
+		b_data.meshes.remove(b_mesh);
 	}
 
+	/* tag update */
+	bool rebuild = mesh_triangles_changed(oldtriangle, mesh->triangles);
+
 	if(oldcurve_keys.size() != mesh->curve_keys.size())
 		rebuild = true;
 	else if(oldcurve_keys.size()) {
@@ -605,6 +852,23 @@ Mesh *BlenderSync::sync_mesh(BL::Object b_ob, bool object_updated, bool hide_tri
 	return mesh;
 }
 
+void BlenderSync::sync_mesh_finish()
+{
+	/* wait for mesh conversion tasks, and tag meshes for update */
+	mesh_pool.wait_work();
+
+	foreach(BlenderMeshExport *mesh_export, mesh_exports) {
+		Mesh *mesh = mesh_export->mesh;
+		bool rebuild = mesh_export->had_curves || mesh_triangles_changed(mesh_export->old_triangles, mesh->triangles);
+
+		mesh->tag_update(scene, rebuild);
+
+		delete mesh_export;
+	}
+
+	mesh_exports.clear();
+}
+
 void BlenderSync::sync_mesh_motion(BL::Object b_ob, Object *object, float motion_time)
 {
 	/* ensure we only sync instanced meshes once */
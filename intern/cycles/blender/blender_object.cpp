@@ -521,6 +521,9 @@ void BlenderSync::sync_objects(BL::SpaceView3D b_v3d, float motion_time)
 		}
 	}
 
+	/* meshes are converted in parallel while objects are synced */
+	sync_mesh_finish();
+
 	progress.set_sync_status("");
 
 	if(!cancel && !motion) {
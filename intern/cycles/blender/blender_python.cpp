@@ -21,6 +21,7 @@
 #include "blender_sync.h"
 #include "blender_session.h"
 
+#include "util_debug.h"
 #include "util_foreach.h"
 #include "util_md5.h"
 #include "util_opengl.h"
@@ -49,11 +50,13 @@ void python_thread_state_restore(void **python_thread_state)
 static PyObject *init_func(PyObject *self, PyObject *args)
 {
 	const char *path, *user_path;
+	int debug = 0;
 
-	if(!PyArg_ParseTuple(args, "ss", &path, &user_path))
+	if(!PyArg_ParseTuple(args, "ss|i", &path, &user_path, &debug))
 		return NULL;
 	
 	path_init(path, user_path);
+	debug_set_verbose(debug != 0);
 
 	Py_RETURN_NONE;
 }
@@ -83,7 +83,7 @@ void BlenderSession::create()
 void BlenderSession::create_session()
 {
 	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
-	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_data, b_scene, background);
 
 	/* reset status/progress */
 	last_status = "";
@@ -135,7 +135,7 @@ void BlenderSession::reset_session(BL::BlendData b_data_, BL::Scene b_scene_)
 	b_scene = b_scene_;
 
 	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
-	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_data, b_scene, background);
 
 	width = render_resolution_x(b_render);
 	height = render_resolution_y(b_render);
@@ -338,7 +338,7 @@ void BlenderSession::render()
 	session->update_render_tile_cb = function_bind(&BlenderSession::update_render_tile, this, _1);
 
 	/* get buffer parameters */
-	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_data, b_scene, background);
 	BufferParams buffer_params = BlenderSync::get_buffer_params(b_render, b_scene, b_v3d, b_rv3d, scene->camera, width, height);
 
 	/* render each layer */
@@ -384,6 +384,20 @@ void BlenderSession::render()
 		/* free result without merging */
 		end_render_result(b_engine, b_rr, true, false);
 
+		if(session_params.adaptive_threshold > 0.0f && !session_params.progressive)
+			Pass::add(PASS_ADAPTIVE_AUX, passes);
+
+		if(session_params.denoise) {
+			/* variance and feature passes used by the denoiser */
+			Pass::add(PASS_ADAPTIVE_AUX, passes);
+
+			if(session_params.device.advanced_shading) {
+				Pass::add(PASS_NORMAL, passes);
+				Pass::add(PASS_DIFFUSE_COLOR, passes);
+				Pass::add(PASS_DEPTH, passes);
+			}
+		}
+
 		buffer_params.passes = passes;
 		scene->film->pass_alpha_threshold = b_iter->pass_alpha_threshold();
 		scene->film->tag_passes_update(scene, passes);
@@ -394,6 +408,10 @@ void BlenderSession::render()
 		sync->sync_camera(b_render, b_engine.camera_override(), width, height);
 		sync->sync_data(b_v3d, b_engine.camera_override(), &python_thread_state, b_rlay_name.c_str());
 
+		/* tiles in the checkpoint are stored per render layer and frame */
+		if(session->checkpoint)
+			session->checkpoint->set_layer(b_rlay_name, b_scene.frame_current());
+
 		/* update number of samples per layer */
 		int samples = sync->get_layer_samples();
 		bool bound_samples = sync->get_layer_bound_samples();
@@ -483,7 +501,7 @@ void BlenderSession::synchronize()
 
 	/* on session/scene parameter changes, we recreate session entirely */
 	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
-	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_data, b_scene, background);
 
 	if(session->params.modified(session_params) ||
 	   scene->params.modified(scene_params))
@@ -575,7 +593,7 @@ bool BlenderSession::draw(int w, int h)
 
 		/* reset if requested */
 		if(reset) {
-			SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+			SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_data, b_scene, background);
 			BufferParams buffer_params = BlenderSync::get_buffer_params(b_render, b_scene, b_v3d, b_rv3d, scene->camera, width, height);
 
 			session->reset(buffer_params, session_params.samples);
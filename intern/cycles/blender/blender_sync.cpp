@@ -176,6 +176,13 @@ void BlenderSync::sync_integrator()
 	integrator->volume_max_steps = get_int(cscene, "volume_max_steps");
 	integrator->volume_step_size = get_float(cscene, "volume_step_size");
 
+	bool use_volume_majorant = get_boolean(cscene, "use_volume_majorant");
+
+	if(integrator->use_volume_majorant != use_volume_majorant) {
+		scene->mesh_manager->tag_update(scene);
+		integrator->use_volume_majorant = use_volume_majorant;
+	}
+
 	integrator->no_caustics = get_boolean(cscene, "no_caustics");
 	integrator->filter_glossy = get_float(cscene, "blur_glossy");
 
@@ -201,6 +208,13 @@ void BlenderSync::sync_integrator()
 	integrator->sample_all_lights_direct = get_boolean(cscene, "sample_all_lights_direct");
 	integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
 
+	bool use_light_tree = get_boolean(cscene, "use_light_tree");
+
+	if(integrator->use_light_tree != use_light_tree) {
+		scene->light_manager->tag_update(scene);
+		integrator->use_light_tree = use_light_tree;
+	}
+
 	int diffuse_samples = get_int(cscene, "diffuse_samples");
 	int glossy_samples = get_int(cscene, "glossy_samples");
 	int transmission_samples = get_int(cscene, "transmission_samples");
@@ -374,6 +388,11 @@ SceneParams BlenderSync::get_scene_params(BL::Scene b_scene, bool background)
 	else
 		params.persistent_data = false;
 
+	params.bvh_refit_threshold = get_float(cscene, "bvh_refit_threshold");
+
+	params.use_texture_cache = RNA_boolean_get(&cscene, "use_texture_cache");
+	params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+
 	return params;
 }
 
@@ -385,7 +404,7 @@ bool BlenderSync::get_session_pause(BL::Scene b_scene, bool background)
 	return (background)? false: get_boolean(cscene, "preview_pause");
 }
 
-SessionParams BlenderSync::get_session_params(BL::RenderEngine b_engine, BL::UserPreferences b_userpref, BL::Scene b_scene, bool background)
+SessionParams BlenderSync::get_session_params(BL::RenderEngine b_engine, BL::UserPreferences b_userpref, BL::BlendData b_data, BL::Scene b_scene, bool background)
 {
 	SessionParams params;
 	PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
@@ -491,6 +510,18 @@ SessionParams BlenderSync::get_session_params(BL::RenderEngine b_engine, BL::Use
 
 	params.progressive_refine = get_boolean(cscene, "use_progressive_refine");
 
+	if(get_boolean(cscene, "use_adaptive_sampling"))
+		params.adaptive_threshold = get_float(cscene, "adaptive_threshold");
+	else
+		params.adaptive_threshold = 0.0f;
+
+	params.use_packet_tracing = get_boolean(cscene, "debug_use_packet_tracing");
+
+	params.denoise = background && get_boolean(cscene, "use_denoising");
+	params.denoising.radius = get_int(cscene, "denoising_radius");
+	params.denoising.strength = get_float(cscene, "denoising_strength");
+	params.denoising.feature_strength = get_float(cscene, "denoising_feature_strength");
+
 	if(background) {
 		if(params.progressive_refine)
 			params.progressive = true;
@@ -502,6 +533,20 @@ SessionParams BlenderSync::get_session_params(BL::RenderEngine b_engine, BL::Use
 	else
 		params.progressive = true;
 
+	/* with save buffers, tiles must match the render parts for writing to
+	 * tiled EXR files, so they can't be split */
+	params.split_tiles = background && !b_scene.render().use_save_buffers();
+
+	/* checkpoints for resuming final renders */
+	if(background) {
+		string checkpoint_path = get_string(cscene, "checkpoint_path");
+
+		if(checkpoint_path != "")
+			params.checkpoint_path = blender_absolute_path(b_data, b_scene, checkpoint_path);
+
+		params.checkpoint_interval = get_float(cscene, "checkpoint_interval");
+	}
+
 	/* shading system - scene level needs full refresh */
 	const bool shadingsystem = RNA_boolean_get(&cscene, "shading_system");
 
@@ -59,6 +59,7 @@ struct BVHStackEntry
 BVH::BVH(const BVHParams& params_, const vector<Object*>& objects_)
 : params(params_), objects(objects_)
 {
+	build_sah_cost = 0.0f;
 }
 
 BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
@@ -172,8 +173,11 @@ void BVH::build(Progress& progress)
 	if(params.use_cache) {
 		progress.set_substatus("Looking in BVH cache");
 
-		if(cache_read(key))
+		if(cache_read(key)) {
+			if(!params.top_level)
+				build_sah_cost = sah_cost();
 			return;
+		}
 	}
 
 	/* build nodes */
@@ -222,6 +226,9 @@ void BVH::build(Progress& progress)
 
 	if(progress.get_cancel()) return;
 
+	if(!params.top_level)
+		build_sah_cost = sah_cost();
+
 	/* cache write */
 	if(params.use_cache) {
 		progress.set_substatus("Writing BVH cache");
@@ -713,6 +720,55 @@ void RegularBVH::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility
 	}
 }
 
+/* Quality */
+
+static BoundBox regular_bvh_child_bounds(const int4 *data, int child)
+{
+	/* child bounds are stored as (c0 min, c1 min, c0 max, c1 max) per axis */
+	const int lo = (child == 0)? 0: 1;
+	const int hi = lo + 2;
+
+	return BoundBox(
+		make_float3(__int_as_float(data[0][lo]), __int_as_float(data[1][lo]), __int_as_float(data[2][lo])),
+		make_float3(__int_as_float(data[0][hi]), __int_as_float(data[1][hi]), __int_as_float(data[2][hi])));
+}
+
+float RegularBVH::sah_cost()
+{
+	assert(!params.top_level);
+
+	if(pack.nodes.size() == 0)
+		return 0.0f;
+
+	BoundBox bbox = merge(regular_bvh_child_bounds(&pack.nodes[0], 0),
+	                      regular_bvh_child_bounds(&pack.nodes[0], 1));
+	float area = bbox.safe_area();
+
+	if(area == 0.0f)
+		return 0.0f;
+
+	/* same cost as computed by the builder, with areas relative to the root */
+	return sah_node_cost(0, (pack.is_leaf[0])? true: false, area)/area;
+}
+
+float RegularBVH::sah_node_cost(int idx, bool leaf, float area)
+{
+	const int4 *data = &pack.nodes[idx*BVH_NODE_SIZE];
+
+	int c0 = data[3].x;
+	int c1 = data[3].y;
+
+	if(leaf)
+		return area*params.primitive_cost(c1 - c0);
+
+	float area0 = regular_bvh_child_bounds(data, 0).safe_area();
+	float area1 = regular_bvh_child_bounds(data, 1).safe_area();
+
+	return area*params.node_cost(2) +
+	       sah_node_cost((c0 < 0)? -c0-1: c0, (c0 < 0), area0) +
+	       sah_node_cost((c1 < 0)? -c1-1: c1, (c1 < 0), area1);
+}
+
 /* QBVH */
 
 QBVH::QBVH(const BVHParams& params_, const vector<Object*>& objects_)
@@ -856,5 +912,10 @@ void QBVH::refit_nodes()
 	assert(0); /* todo */
 }
 
+float QBVH::sah_cost()
+{
+	return pack.SAH;
+}
+
 CCL_NAMESPACE_END
 
@@ -88,12 +88,19 @@ public:
 	vector<Object*> objects;
 	string cache_filename;
 
+	/* SAH cost of the packed nodes right after building, to compare against
+	 * after refitting, when deformation may have degraded the quality */
+	float build_sah_cost;
+
 	static BVH *create(const BVHParams& params, const vector<Object*>& objects);
 	virtual ~BVH() {}
 
 	void build(Progress& progress);
 	void refit(Progress& progress);
 
+	/* SAH cost of the packed nodes as they are now */
+	virtual float sah_cost() = 0;
+
 	void clear_cache_except();
 
 protected:
@@ -135,6 +142,10 @@ protected:
 	/* refit */
 	void refit_nodes();
 	void refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility);
+
+	/* quality */
+	float sah_cost();
+	float sah_node_cost(int idx, bool leaf, float area);
 };
 
 /* QBVH
@@ -154,6 +165,9 @@ protected:
 
 	/* refit */
 	void refit_nodes();
+
+	/* quality */
+	float sah_cost();
 };
 
 CCL_NAMESPACE_END
@@ -154,7 +154,11 @@ Device *Device::create(DeviceInfo& info, Stats &stats, bool background)
 #endif
 #ifdef WITH_NETWORK
 		case DEVICE_NETWORK:
-			device = device_network_create(info, stats, "127.0.0.1");
+			/* id is the server address, as host or host:port */
+			if(info.id != "" && info.id != "NETWORK")
+				device = device_network_create(info, stats, info.id.c_str());
+			else
+				device = device_network_create(info, stats, "127.0.0.1");
 			break;
 #endif
 #ifdef WITH_OPENCL
@@ -116,6 +116,13 @@ public:
 	/* open shading language, only for CPU device */
 	virtual void *osl_memory() { return NULL; }
 
+	/* image texture cache, only for CPU device */
+	virtual void *texture_cache_memory() { return NULL; }
+
+	/* ray tracing benchmark, traces one camera ray per pixel and returns
+	 * the number of rays traced, only for CPU device */
+	virtual int bvh_benchmark(int width, int height, bool use_packets, bool occlusion) { return 0; }
+
 	/* load/compile kernels, must be called before adding tasks */ 
 	virtual bool load_kernels(bool experimental) { return true; }
 
@@ -130,8 +137,8 @@ public:
 		const DeviceDrawParams &draw_params);
 
 #ifdef WITH_NETWORK
-	/* networking */
-	void server_run();
+	/* networking, port 0 uses the default server port */
+	void server_run(int port = 0);
 #endif
 
 	/* multi device */
@@ -24,6 +24,8 @@
 #include "kernel_compat_cpu.h"
 #include "kernel_types.h"
 #include "kernel_globals.h"
+#include "kernel_texture_cache.h"
+#include "kernel_texture_cache_globals.h"
 
 #include "osl_shader.h"
 #include "osl_globals.h"
@@ -49,6 +51,11 @@ public:
 #ifdef WITH_OSL
 	OSLGlobals osl_globals;
 #endif
+
+	TextureCacheGlobals texture_cache_globals;
+
+	/* threads add their ray count to the device stats */
+	thread_mutex stats_mutex;
 	
 	CPUDevice(DeviceInfo& info, Stats &stats, bool background)
 	: Device(info, stats, background)
@@ -57,11 +64,16 @@ public:
 		kernel_globals.osl = &osl_globals;
 #endif
 
+		kernel_globals.texture_cache = NULL;
+		kernel_globals.texture_cache_tdata = NULL;
+		kernel_globals.num_rays = 0;
+
 		/* do now to avoid thread issues */
 		system_cpu_support_sse2();
 		system_cpu_support_sse3();
 		system_cpu_support_sse41();
 		system_cpu_support_avx();
+		system_cpu_support_avx2();
 	}
 
 	~CPUDevice()
@@ -105,7 +117,17 @@ public:
 
 	void tex_alloc(const char *name, device_memory& mem, InterpolationType interpolation, bool periodic)
 	{
-		kernel_tex_copy(&kernel_globals, name, mem.data_pointer, mem.data_width, mem.data_height, mem.data_depth, interpolation);
+		/* images may use compact storage, which we read directly */
+		ImageDataType type;
+
+		if(mem.data_type == TYPE_HALF)
+			type = (mem.data_elements == 1)? IMAGE_DATA_TYPE_HALF: IMAGE_DATA_TYPE_HALF4;
+		else if(mem.data_type == TYPE_UCHAR)
+			type = (mem.data_elements == 1)? IMAGE_DATA_TYPE_BYTE: IMAGE_DATA_TYPE_BYTE4;
+		else
+			type = (mem.data_elements == 1)? IMAGE_DATA_TYPE_FLOAT: IMAGE_DATA_TYPE_FLOAT4;
+
+		kernel_tex_copy(&kernel_globals, name, mem.data_pointer, mem.data_width, mem.data_height, mem.data_depth, interpolation, type);
 		mem.device_pointer = mem.data_pointer;
 
 		stats.mem_alloc(mem.memory_size());
@@ -127,6 +149,19 @@ public:
 #endif
 	}
 
+	void *texture_cache_memory()
+	{
+		return &texture_cache_globals;
+	}
+
+	int bvh_benchmark(int width, int height, bool use_packets, bool occlusion)
+	{
+		/* copy, so traced rays are not counted in the render statistics */
+		KernelGlobals kg = kernel_globals;
+
+		return kernel_cpu_bvh_trace_camera_rays(&kg, 0, 0, width, height, use_packets, occlusion);
+	}
+
 	void thread_run(DeviceTask *task)
 	{
 		if(task->type == DeviceTask::PATH_TRACE)
@@ -159,6 +194,54 @@ public:
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
 
+		TextureCache::thread_init(&kg, &texture_cache_globals);
+
+		void(*path_trace_kernel)(KernelGlobals*, float*, unsigned int*, int, int, int, int, int);
+		void(*path_trace_packet_kernel)(KernelGlobals*, float*, unsigned int*, int, int, int, int, int, int, int);
+
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+		if(system_cpu_support_avx2()) {
+			path_trace_kernel = kernel_cpu_avx2_path_trace;
+			path_trace_packet_kernel = kernel_cpu_avx2_path_trace_packet;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
+		if(system_cpu_support_avx()) {
+			path_trace_kernel = kernel_cpu_avx_path_trace;
+			path_trace_packet_kernel = kernel_cpu_avx_path_trace_packet;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
+		if(system_cpu_support_sse41()) {
+			path_trace_kernel = kernel_cpu_sse41_path_trace;
+			path_trace_packet_kernel = kernel_cpu_sse41_path_trace_packet;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE3
+		if(system_cpu_support_sse3()) {
+			path_trace_kernel = kernel_cpu_sse3_path_trace;
+			path_trace_packet_kernel = kernel_cpu_sse3_path_trace_packet;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE2
+		if(system_cpu_support_sse2()) {
+			path_trace_kernel = kernel_cpu_sse2_path_trace;
+			path_trace_packet_kernel = kernel_cpu_sse2_path_trace_packet;
+		}
+		else
+#endif
+		{
+			path_trace_kernel = kernel_cpu_path_trace;
+			path_trace_packet_kernel = kernel_cpu_path_trace_packet;
+		}
+
+		/* camera rays of 2x2 pixel blocks are traced as packets */
+		int step = (task.use_packet_tracing)? 2: 1;
+
 		RenderTile tile;
 		
 		while(task.acquire_tile(this, tile)) {
@@ -167,111 +250,82 @@ public:
 			int start_sample = tile.start_sample;
 			int end_sample = tile.start_sample + tile.num_samples;
 
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
-			if(system_cpu_support_avx()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.canceled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
-
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_avx_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
-					}
+			/* adaptive sampling, tile is split into blocks that stop
+			 * sampling once all their pixels have converged */
+			bool adaptive = task.adaptive_threshold > 0.0f &&
+			                (kg.__data.film.pass_flag & PASS_ADAPTIVE_AUX) &&
+			                start_sample == 0 &&
+			                tile.num_samples >= ADAPTIVE_MIN_SAMPLES + ADAPTIVE_CHECK_STEP;
+			int blocks_w = (tile.w + ADAPTIVE_BLOCK_SIZE - 1)/ADAPTIVE_BLOCK_SIZE;
+			int blocks_h = (tile.h + ADAPTIVE_BLOCK_SIZE - 1)/ADAPTIVE_BLOCK_SIZE;
+			vector<bool> block_active(blocks_w*blocks_h, true);
+			int num_active = blocks_w*blocks_h;
+
+			tile.sample = start_sample;
+
+			for(int sample = start_sample; sample < end_sample; sample++) {
+				if (task.get_cancel() || task_pool.canceled()) {
+					if(task.need_finish_queue == false)
+						break;
+				}
 
-					tile.sample = sample + 1;
+				for(int y = tile.y; y < tile.y + tile.h; y += step) {
+					for(int x = tile.x; x < tile.x + tile.w; x += step) {
+						/* packet blocks never straddle adaptive blocks */
+						if(adaptive) {
+							int block_x = (x - tile.x)/ADAPTIVE_BLOCK_SIZE;
+							int block_y = (y - tile.y)/ADAPTIVE_BLOCK_SIZE;
 
-					task.update_progress(tile);
-				}
-			}
-			else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41			
-			if(system_cpu_support_sse41()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.canceled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
+							if(!block_active[block_x + block_y*blocks_w])
+								continue;
+						}
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_sse41_path_trace(&kg, render_buffer, rng_state,
+						if(step == 1) {
+							path_trace_kernel(&kg, render_buffer, rng_state,
 								sample, x, y, tile.offset, tile.stride);
 						}
-					}
-
-					tile.sample = sample + 1;
-
-					task.update_progress(tile);
-				}
-			}
-			else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE3
-			if(system_cpu_support_sse3()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.canceled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
+						else {
+							int w = min(step, tile.x + tile.w - x);
+							int h = min(step, tile.y + tile.h - y);
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_sse3_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
+							path_trace_packet_kernel(&kg, render_buffer, rng_state,
+								sample, x, y, w, h, tile.offset, tile.stride);
 						}
 					}
+				}
 
-					tile.sample = sample + 1;
+				tile.sample = sample + 1;
 
-					task.update_progress(tile);
+				if(adaptive &&
+				   tile.sample >= ADAPTIVE_MIN_SAMPLES &&
+				   tile.sample % ADAPTIVE_CHECK_STEP == 0)
+				{
+					num_active = thread_adaptive_update_blocks(kg, task, tile, block_active, blocks_w, blocks_h);
 				}
-			}
-			else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE2
-			if(system_cpu_support_sse2()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.canceled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_sse2_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
-					}
+				task.update_progress(tile);
 
-					tile.sample = sample + 1;
+				/* every block converged, skip the remaining samples but count
+				 * them as done, passes are scaled to the full count below */
+				if(adaptive && num_active == 0) {
+					tile.sample = end_sample;
 
-					task.update_progress(tile);
+					if(task.update_progress_sample) {
+						for(int i = sample + 1; i < end_sample; i++)
+							task.update_progress_sample();
+					}
+
+					break;
 				}
 			}
-			else
-#endif
-			{
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.canceled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
+			/* converged pixels have fewer samples than the rest of the tile */
+			if(adaptive) {
+				for(int y = tile.y; y < tile.y + tile.h; y++) {
+					for(int x = tile.x; x < tile.x + tile.w; x++) {
+						kernel_cpu_adaptive_scale_passes(&kg, render_buffer,
+							tile.sample, x, y, tile.offset, tile.stride);
 					}
-
-					tile.sample = sample + 1;
-
-					task.update_progress(tile);
 				}
 			}
 
@@ -283,9 +337,58 @@ public:
 			}
 		}
 
+		{
+			thread_scoped_lock lock(stats_mutex);
+			stats.num_rays += kg.num_rays;
+		}
+
 #ifdef WITH_OSL
 		OSLShader::thread_free(&kg);
 #endif
+
+		TextureCache::thread_free(&kg);
+	}
+
+	int thread_adaptive_update_blocks(KernelGlobals& kg, DeviceTask& task, RenderTile& tile,
+		vector<bool>& block_active, int blocks_w, int blocks_h)
+	{
+		float *render_buffer = (float*)tile.buffer;
+		int num_active = 0;
+
+		for(int block_y = 0; block_y < blocks_h; block_y++) {
+			for(int block_x = 0; block_x < blocks_w; block_x++) {
+				int block = block_x + block_y*blocks_w;
+
+				if(!block_active[block])
+					continue;
+
+				/* block converged if the noise of every pixel is under the threshold */
+				int x0 = tile.x + block_x*ADAPTIVE_BLOCK_SIZE;
+				int y0 = tile.y + block_y*ADAPTIVE_BLOCK_SIZE;
+				int x1 = min(x0 + ADAPTIVE_BLOCK_SIZE, tile.x + tile.w);
+				int y1 = min(y0 + ADAPTIVE_BLOCK_SIZE, tile.y + tile.h);
+				bool converged = true;
+
+				for(int y = y0; y < y1 && converged; y++) {
+					for(int x = x0; x < x1; x++) {
+						float error = kernel_cpu_adaptive_pixel_error(&kg, render_buffer,
+							x, y, tile.offset, tile.stride);
+
+						if(error > task.adaptive_threshold) {
+							converged = false;
+							break;
+						}
+					}
+				}
+
+				if(converged)
+					block_active[block] = false;
+				else
+					num_active++;
+			}
+		}
+
+		return num_active;
 	}
 
 	void thread_film_convert(DeviceTask& task)
@@ -293,6 +396,15 @@ public:
 		float sample_scale = 1.0f/(task.sample + 1);
 
 		if(task.rgba_half) {
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+			if(system_cpu_support_avx2()) {
+				for(int y = task.y; y < task.y + task.h; y++)
+					for(int x = task.x; x < task.x + task.w; x++)
+						kernel_cpu_avx2_convert_to_half_float(&kernel_globals, (uchar4*)task.rgba_half, (float*)task.buffer,
+							sample_scale, x, y, task.offset, task.stride);
+			}
+			else
+#endif
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 			if(system_cpu_support_avx()) {
 				for(int y = task.y; y < task.y + task.h; y++)
@@ -337,6 +449,15 @@ public:
 			}
 		}
 		else {
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+			if(system_cpu_support_avx2()) {
+				for(int y = task.y; y < task.y + task.h; y++)
+					for(int x = task.x; x < task.x + task.w; x++)
+						kernel_cpu_avx2_convert_to_byte(&kernel_globals, (uchar4*)task.rgba_byte, (float*)task.buffer,
+							sample_scale, x, y, task.offset, task.stride);
+			}
+			else
+#endif
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 			if(system_cpu_support_avx()) {
 				for(int y = task.y; y < task.y + task.h; y++)
@@ -390,6 +511,19 @@ public:
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
 
+		TextureCache::thread_init(&kg, &texture_cache_globals);
+
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+		if(system_cpu_support_avx2()) {
+			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++) {
+				kernel_cpu_avx2_shader(&kg, (uint4*)task.shader_input, (float4*)task.shader_output, task.shader_eval_type, x);
+
+				if(task_pool.canceled())
+					break;
+			}
+		}
+		else
+#endif
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 		if(system_cpu_support_avx()) {
 			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++) {
@@ -446,6 +580,8 @@ public:
 #ifdef WITH_OSL
 		OSLShader::thread_free(&kg);
 #endif
+
+		TextureCache::thread_free(&kg);
 	}
 
 	void task_add(DeviceTask& task)
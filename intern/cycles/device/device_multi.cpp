@@ -48,14 +48,21 @@ public:
 	: Device(info, stats, background_), unique_ptr(1)
 	{
 		Device *device;
+		bool have_network = false;
 
 		foreach(DeviceInfo& subinfo, info.multi_devices) {
 			device = Device::create(subinfo, stats, background);
 			devices.push_back(SubDevice(device));
+
+			if(subinfo.type == DEVICE_NETWORK)
+				have_network = true;
 		}
 
 #ifdef WITH_NETWORK
-		/* try to add network devices */
+		/* try to add network devices, unless servers were specified */
+		if(have_network)
+			return;
+
 		ServerDiscovery discovery(true);
 		time_sleep(1.0);
 
@@ -50,15 +50,28 @@ public:
 
 	thread_mutex rpc_lock;
 
+	/* calls are written asynchronously, and buffers the server already has
+	 * are sent by content hash only */
+	RPCSendQueue *send_queue;
+	NetworkCache cache;
+
 	NetworkDevice(DeviceInfo& info, Stats &stats, const char *address)
-	: Device(info, stats, true), socket(io_service)
+	: Device(info, stats, true), socket(io_service), send_queue(NULL)
 	{
-		error_func = NetworkError();
+		/* address with optional port, as host:port */
+		string host = address;
 		stringstream portstr;
-		portstr << SERVER_PORT;
+		size_t colon = host.rfind(':');
+
+		if(colon != string::npos && host.find(':') == colon) {
+			portstr << host.substr(colon + 1);
+			host = host.substr(0, colon);
+		}
+		else
+			portstr << SERVER_PORT;
 
 		tcp::resolver resolver(io_service);
-		tcp::resolver::query query(address, portstr.str());
+		tcp::resolver::query query(host, portstr.str());
 		tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
 		tcp::resolver::iterator end;
 
@@ -73,12 +86,35 @@ public:
 			error_func.network_error(error.message());
 
 		mem_counter = 0;
+
+		if(error_func.have_error())
+			return;
+
+		/* get index of data the server has cached from previous renders */
+		RPCReceive rcv(socket, &error_func);
+
+		if(rcv.name == "cache_index") {
+			vector<string> hashes;
+			vector<uint64_t> sizes;
+
+			rcv.read(hashes);
+			rcv.read(sizes);
+
+			cache.set_index(hashes, sizes);
+		}
+
+		send_queue = new RPCSendQueue(io_service, socket, &error_func);
 	}
 
 	~NetworkDevice()
 	{
-		RPCSend snd(socket, &error_func, "stop");
-		snd.write();
+		if(send_queue) {
+			RPCSend snd(socket, &error_func, "stop", send_queue);
+			snd.write();
+
+			/* waits for all queued calls to be sent */
+			delete send_queue;
+		}
 	}
 
 	void mem_alloc(device_memory& mem, MemoryType type)
@@ -87,7 +123,7 @@ public:
 
 		mem.device_pointer = ++mem_counter;
 
-		RPCSend snd(socket, &error_func, "mem_alloc");
+		RPCSend snd(socket, &error_func, "mem_alloc", send_queue);
 
 		snd.add(mem);
 		snd.add(type);
@@ -98,11 +134,11 @@ public:
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		RPCSend snd(socket, &error_func, "mem_copy_to");
+		RPCSend snd(socket, &error_func, "mem_copy_to", send_queue);
 
 		snd.add(mem);
+		snd.add_buffer((void*)mem.data_pointer, mem.memory_size(), &cache);
 		snd.write();
-		snd.write_buffer((void*)mem.data_pointer, mem.memory_size());
 	}
 
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
@@ -111,7 +147,7 @@ public:
 
 		size_t data_size = mem.memory_size();
 
-		RPCSend snd(socket, &error_func, "mem_copy_from");
+		RPCSend snd(socket, &error_func, "mem_copy_from", send_queue);
 
 		snd.add(mem);
 		snd.add(y);
@@ -128,7 +164,7 @@ public:
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		RPCSend snd(socket, &error_func, "mem_zero");
+		RPCSend snd(socket, &error_func, "mem_zero", send_queue);
 
 		snd.add(mem);
 		snd.write();
@@ -139,7 +175,7 @@ public:
 		if(mem.device_pointer) {
 			thread_scoped_lock lock(rpc_lock);
 
-			RPCSend snd(socket, &error_func, "mem_free");
+			RPCSend snd(socket, &error_func, "mem_free", send_queue);
 
 			snd.add(mem);
 			snd.write();
@@ -152,14 +188,14 @@ public:
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		RPCSend snd(socket, &error_func, "const_copy_to");
+		RPCSend snd(socket, &error_func, "const_copy_to", send_queue);
 
 		string name_string(name);
 
 		snd.add(name_string);
 		snd.add(size);
+		snd.add_buffer(host, size);
 		snd.write();
-		snd.write_buffer(host, size);
 	}
 
 	void tex_alloc(const char *name, device_memory& mem, InterpolationType interpolation, bool periodic)
@@ -168,7 +204,7 @@ public:
 
 		mem.device_pointer = ++mem_counter;
 
-		RPCSend snd(socket, &error_func, "tex_alloc");
+		RPCSend snd(socket, &error_func, "tex_alloc", send_queue);
 
 		string name_string(name);
 
@@ -176,8 +212,8 @@ public:
 		snd.add(mem);
 		snd.add(interpolation);
 		snd.add(periodic);
+		snd.add_buffer((void*)mem.data_pointer, mem.memory_size(), &cache);
 		snd.write();
-		snd.write_buffer((void*)mem.data_pointer, mem.memory_size());
 	}
 
 	void tex_free(device_memory& mem)
@@ -185,7 +221,7 @@ public:
 		if(mem.device_pointer) {
 			thread_scoped_lock lock(rpc_lock);
 
-			RPCSend snd(socket, &error_func, "tex_free");
+			RPCSend snd(socket, &error_func, "tex_free", send_queue);
 
 			snd.add(mem);
 			snd.write();
@@ -201,7 +237,7 @@ public:
 
 		thread_scoped_lock lock(rpc_lock);
 
-		RPCSend snd(socket, &error_func, "load_kernels");
+		RPCSend snd(socket, &error_func, "load_kernels", send_queue);
 		snd.add(experimental);
 		snd.write();
 
@@ -218,7 +254,7 @@ public:
 
 		the_task = task;
 
-		RPCSend snd(socket, &error_func, "task_add");
+		RPCSend snd(socket, &error_func, "task_add", send_queue);
 		snd.add(task);
 		snd.write();
 	}
@@ -227,7 +263,7 @@ public:
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		RPCSend snd(socket, &error_func, "task_wait");
+		RPCSend snd(socket, &error_func, "task_wait", send_queue);
 		snd.write();
 
 		lock.unlock();
@@ -252,14 +288,14 @@ public:
 					the_tiles.push_back(tile);
 
 					lock.lock();
-					RPCSend snd(socket, &error_func, "acquire_tile");
+					RPCSend snd(socket, &error_func, "acquire_tile", send_queue);
 					snd.add(tile);
 					snd.write();
 					lock.unlock();
 				}
 				else {
 					lock.lock();
-					RPCSend snd(socket, &error_func, "acquire_tile_none");
+					RPCSend snd(socket, &error_func, "acquire_tile_none", send_queue);
 					snd.write();
 					lock.unlock();
 				}
@@ -279,7 +315,7 @@ public:
 				the_task.release_tile(tile);
 
 				lock.lock();
-				RPCSend snd(socket, &error_func, "release_tile");
+				RPCSend snd(socket, &error_func, "release_tile", send_queue);
 				snd.write();
 				lock.unlock();
 			}
@@ -295,7 +331,7 @@ public:
 	void task_cancel()
 	{
 		thread_scoped_lock lock(rpc_lock);
-		RPCSend snd(socket, &error_func, "task_cancel");
+		RPCSend snd(socket, &error_func, "task_cancel", send_queue);
 		snd.write();
 	}
 
@@ -332,14 +368,25 @@ public:
 
 	bool have_error() { return error_func.have_error(); }
 
-	DeviceServer(Device *device_, tcp::socket& socket_)
-	: device(device_), socket(socket_), stop(false), blocked_waiting(false)
+	DeviceServer(Device *device_, tcp::socket& socket_, NetworkCache& cache_)
+	: device(device_), socket(socket_), cache(cache_), stop(false), blocked_waiting(false)
 	{
-		error_func = NetworkError();
 	}
 
 	void listen()
 	{
+		/* let the client know which data it doesn't need to send again */
+		{
+			vector<string> hashes;
+			vector<uint64_t> sizes;
+			cache.get_index(hashes, sizes);
+
+			RPCSend snd(socket, &error_func, "cache_index");
+			snd.add(hashes);
+			snd.add(sizes);
+			snd.write();
+		}
+
 		/* receive remote function calls */
 		for(;;) {
 			listen_step();
@@ -353,7 +400,7 @@ protected:
 	void listen_step()
 	{
 		thread_scoped_lock lock(rpc_lock);
-		RPCReceive rcv(socket, &error_func);
+		RPCReceive rcv(socket, &error_func, &cache);
 
 		if(rcv.name == "stop")
 			stop = true;
@@ -511,8 +558,8 @@ protected:
 			size_t data_size = mem.memory_size();
 
 			RPCSend snd(socket, &error_func, "mem_copy_from");
+			snd.add_buffer((uint8_t*)mem.data_pointer, data_size);
 			snd.write();
-			snd.write_buffer((uint8_t*)mem.data_pointer, data_size);
 			lock.unlock();
 		}
 		else if(rcv.name == "mem_zero") {
@@ -778,6 +825,9 @@ protected:
 	Device *device;
 	tcp::socket& socket;
 
+	/* data received from clients, kept across connections */
+	NetworkCache& cache;
+
 	/* mapping of remote to local pointer */
 	PtrMap ptr_map;
 	PtrMap ptr_imap;
@@ -800,24 +850,34 @@ private:
 
 };
 
-void Device::server_run()
+void Device::server_run(int port)
 {
+	if(port == 0)
+		port = SERVER_PORT;
+
 	try {
 		/* starts thread that responds to discovery requests */
 		ServerDiscovery discovery;
+		NetworkCache cache;
+
+		/* keep listening while serving a client, so a client that reconnects
+		 * right after disconnecting is queued instead of refused */
+		boost::asio::io_service io_service;
+		tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), port));
+
+		/* flushed, for tools that start servers and wait for them */
+		printf("Listening on port %d\n", port);
+		fflush(stdout);
 
 		for(;;) {
 			/* accept connection */
-			boost::asio::io_service io_service;
-			tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), SERVER_PORT));
-
 			tcp::socket socket(io_service);
 			acceptor.accept(socket);
 
 			string remote_address = socket.remote_endpoint().address().to_string();
 			printf("Connected to remote client at: %s\n", remote_address.c_str());
 
-			DeviceServer server(this, socket);
+			DeviceServer server(this, socket, cache);
 			server.listen();
 
 			printf("Disconnected.\n");
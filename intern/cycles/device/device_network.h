@@ -26,6 +26,7 @@
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/thread.hpp>
 
@@ -33,12 +34,23 @@
 #include <sstream>
 #include <deque>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef WITH_LZO
+#include "minilzo.h"
+#endif
+
 #include "buffers.h"
 
 #include "util_foreach.h"
+#include "util_function.h"
 #include "util_list.h"
 #include "util_map.h"
+#include "util_md5.h"
 #include "util_string.h"
+#include "util_thread.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -55,6 +67,22 @@ static const int DISCOVER_PORT = 5121;
 static const string DISCOVER_REQUEST_MSG = "REQUEST_RENDER_SERVER_IP";
 static const string DISCOVER_REPLY_MSG = "REPLY_RENDER_SERVER_IP";
 
+/* frame identifier, changes with incompatible protocol versions */
+static const uint32_t RPC_MAGIC = 0x43594333;
+
+/* buffers smaller than these are not worth compressing or caching */
+static const size_t NETWORK_COMPRESS_MIN_SIZE = 1024;
+static const size_t NETWORK_CACHE_MIN_SIZE = 16384;
+
+/* maximum size of data cached on the server, and of frames queued for
+ * sending on the client */
+static const size_t NETWORK_CACHE_SIZE = (size_t)1024*1024*1024;
+static const size_t NETWORK_QUEUE_SIZE = (size_t)256*1024*1024;
+
+/* largest frame parts accepted, sizes in received headers are not trusted */
+static const uint32_t NETWORK_ARCHIVE_MAX_SIZE = 64*1024*1024;
+static const uint64_t NETWORK_BUFFER_MAX_SIZE = (uint64_t)4*1024*1024*1024;
+
 #if 0
 typedef boost::archive::text_oarchive o_archive;
 typedef boost::archive::text_iarchive i_archive;
@@ -84,31 +112,318 @@ public:
 
 	~NetworkError() {}
 
+	/* also called from the send queue thread */
 	void network_error(const string& message) {
+		thread_scoped_lock lock(mutex);
 		error = message;
 		error_count += 1;
 	}
 
 	bool have_error() {
-		return true ? error_count > 0 : false;
+		thread_scoped_lock lock(mutex);
+		return error_count > 0;
 	}
 
 private:
 	string error;
 	int error_count;
+	thread_mutex mutex;
 };
 
 
+/* Network data cache
+ *
+ * Data buffers received by the server are kept by content, so that data
+ * which did not change does not have to be sent again, when the scene is
+ * updated or a new render is started. The server keeps the cache across
+ * connections and sends its index to new clients. Clients keep a copy of the
+ * index without the data, and apply the same insertions and evictions in the
+ * same order, so they know which buffers the server has without asking.
+ *
+ * The server uses cached data in place of what the client would have sent,
+ * so entries are identified by MD5 hash together with the size, a fast hash
+ * could silently render with the wrong data on a collision. */
+
+static const size_t NETWORK_HASH_SIZE = 32;
+
+static string network_buffer_hash(const void *buffer, size_t size)
+{
+	MD5Hash md5;
+	const uint8_t *data = (const uint8_t*)buffer;
+
+	/* appended in parts, sizes are int */
+	for(size_t offset = 0; offset < size;) {
+		size_t part = size - offset;
+
+		if(part > (size_t)1024*1024*1024)
+			part = (size_t)1024*1024*1024;
+
+		md5.append(data + offset, (int)part);
+		offset += part;
+	}
+
+	return md5.get_hex();
+}
+
+class NetworkCache {
+public:
+	NetworkCache(size_t max_size_ = NETWORK_CACHE_SIZE)
+	: max_size(max_size_), total_size(0)
+	{
+	}
+
+	/* find entry and mark it as recently used */
+	bool find(const string& hash, size_t size)
+	{
+		map<Key, EntryList::iterator>::iterator it = index.find(Key(hash, size));
+
+		if(it == index.end())
+			return false;
+
+		entries.splice(entries.end(), entries, it->second);
+		return true;
+	}
+
+	const vector<uint8_t>& data(const string& hash, size_t size)
+	{
+		return index[Key(hash, size)]->data;
+	}
+
+	/* insert entry, with data on the server and only the size on the client */
+	void insert(const string& hash, size_t size, const void *data = NULL)
+	{
+		if(find(hash, size) || size > max_size)
+			return;
+
+		entries.push_back(Entry());
+
+		Entry& entry = entries.back();
+		entry.hash = hash;
+		entry.size = size;
+
+		if(data)
+			entry.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+		index[Key(hash, size)] = --entries.end();
+		total_size += size;
+
+		/* evict least recently used */
+		while(total_size > max_size) {
+			Entry& old = entries.front();
+
+			total_size -= old.size;
+			index.erase(Key(old.hash, old.size));
+			entries.pop_front();
+		}
+	}
+
+	/* index in order from least to most recently used */
+	void get_index(vector<string>& hashes, vector<uint64_t>& sizes)
+	{
+		foreach(Entry& entry, entries) {
+			hashes.push_back(entry.hash);
+			sizes.push_back(entry.size);
+		}
+	}
+
+	void set_index(const vector<string>& hashes, const vector<uint64_t>& sizes)
+	{
+		for(size_t i = 0; i < hashes.size() && i < sizes.size(); i++)
+			insert(hashes[i], sizes[i]);
+	}
+
+protected:
+	typedef std::pair<string, size_t> Key;
+
+	struct Entry {
+		string hash;
+		size_t size;
+		vector<uint8_t> data;
+	};
+
+	typedef list<Entry> EntryList;
+
+	EntryList entries;
+	map<Key, EntryList::iterator> index;
+	size_t max_size;
+	size_t total_size;
+};
+
+/* Frame header
+ *
+ * Each call is sent as one frame: this fixed size header, the archive with
+ * the call name and arguments, and optionally the contents of a data buffer,
+ * stored as is, LZO compressed, or as a reference into the server cache. */
+
+enum RPCBufferType {
+	RPC_BUFFER_NONE = 0,
+	RPC_BUFFER_RAW,
+	RPC_BUFFER_LZO,
+	RPC_BUFFER_CACHED
+};
+
+struct RPCHeader {
+	uint32_t magic;
+	uint32_t archive_size;
+	uint32_t buffer_type;
+	uint32_t pad;
+	uint64_t buffer_size;		/* uncompressed size of the buffer */
+	uint64_t buffer_data_size;	/* size of the buffer data in this frame */
+	char buffer_hash[NETWORK_HASH_SIZE];	/* MD5 hex digest for caching, or zeros */
+};
+
+#ifdef WITH_LZO
+static void rpc_compress_init_once()
+{
+	lzo_init();
+}
+#endif
+
+/* called from the client and server threads, and the send queue */
+static void rpc_compress_init()
+{
+#ifdef WITH_LZO
+	static boost::once_flag initialized = BOOST_ONCE_INIT;
+
+	boost::call_once(initialized, rpc_compress_init_once);
+#endif
+}
+
+/* Send queue
+ *
+ * Frames are written to the socket by a separate thread, so that calls that
+ * don't wait for a reply, like memory copies and adding tasks, return
+ * immediately and are pipelined with the work done by the server.
+ *
+ * Asio socket objects must not be used from two threads at once, and the
+ * calling thread keeps reading replies from its socket, so the writer thread
+ * writes through its own socket object on a duplicate of the connection. */
+
+static tcp::socket::native_handle_type rpc_socket_duplicate(tcp::socket& socket)
+{
+#ifdef _WIN32
+	WSAPROTOCOL_INFO info;
+
+	if(WSADuplicateSocket(socket.native_handle(), GetCurrentProcessId(), &info) != 0)
+		return INVALID_SOCKET;
+
+	return WSASocket(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, &info, 0, WSA_FLAG_OVERLAPPED);
+#else
+	return dup(socket.native_handle());
+#endif
+}
+
+class RPCSendQueue {
+public:
+	RPCSendQueue(boost::asio::io_service& io_service, tcp::socket& socket, NetworkError *e)
+	: write_socket(io_service), error_func(e), queued_size(0), writing(false), stop(false)
+	{
+		boost::system::error_code error;
+		write_socket.assign(socket.local_endpoint().protocol(), rpc_socket_duplicate(socket), error);
+
+		if(error.value())
+			error_func->network_error(error.message());
+
+		writer = new thread(function_bind(&RPCSendQueue::run, this));
+	}
+
+	~RPCSendQueue()
+	{
+		flush();
+
+		{
+			thread_scoped_lock lock(mutex);
+			stop = true;
+			cond.notify_all();
+		}
+
+		writer->join();
+		delete writer;
+	}
+
+	/* takes over the contents of frame */
+	void push(vector<char>& frame)
+	{
+		thread_scoped_lock lock(mutex);
+
+		/* limit memory usage when producing faster than the network */
+		while(queued_size > NETWORK_QUEUE_SIZE && !frames.empty())
+			cond.wait(lock);
+
+		queued_size += frame.size();
+		frames.push_back(vector<char>());
+		frames.back().swap(frame);
+
+		cond.notify_all();
+	}
+
+	/* wait until all frames are written */
+	void flush()
+	{
+		thread_scoped_lock lock(mutex);
+
+		while(!frames.empty() || writing)
+			cond.wait(lock);
+	}
+
+protected:
+	void run()
+	{
+		thread_scoped_lock lock(mutex);
+
+		for(;;) {
+			while(frames.empty() && !stop)
+				cond.wait(lock);
+
+			if(frames.empty())
+				break;
+
+			vector<char> frame;
+			frame.swap(frames.front());
+			frames.pop_front();
+			writing = true;
+
+			lock.unlock();
+
+			boost::system::error_code error;
+			boost::asio::write(write_socket, boost::asio::buffer(frame), boost::asio::transfer_all(), error);
+
+			if(error.value())
+				error_func->network_error(error.message());
+
+			lock.lock();
+
+			queued_size -= frame.size();
+			writing = false;
+			cond.notify_all();
+		}
+	}
+
+	tcp::socket write_socket;
+	NetworkError *error_func;
+
+	thread *writer;
+	thread_mutex mutex;
+	thread_condition_variable cond;
+	std::deque<vector<char> > frames;
+	size_t queued_size;
+	bool writing;
+	bool stop;
+};
+
 /* Remote procedure call Send */
 
 class RPCSend {
 public:
-	RPCSend(tcp::socket& socket_, NetworkError* e, const string& name_ = "")
-	: name(name_), socket(socket_), archive(archive_stream), sent(false)
+	RPCSend(tcp::socket& socket_, NetworkError* e, const string& name_ = "", RPCSendQueue *queue_ = NULL)
+	: name(name_), socket(socket_), queue(queue_), archive(archive_stream), sent(false)
 	{
 		archive & name_;
 		error_func = e;
-		fprintf(stderr, "rpc send %s\n", name.c_str());
+
+		memset(&header, 0, sizeof(header));
+		header.magic = RPC_MAGIC;
+		header.buffer_type = RPC_BUFFER_NONE;
 	}
 
 	~RPCSend()
@@ -145,53 +460,92 @@ public:
 		archive & tile.buffer & tile.rng_state;
 	}
 
-	void write()
+	/* attach a data buffer to the frame, compressed if that makes it smaller,
+	 * and only as a reference if the server has the same data cached */
+	void add_buffer(const void *buffer, size_t size, NetworkCache *cache = NULL)
 	{
-		boost::system::error_code error;
+		header.buffer_size = size;
+		header.buffer_type = RPC_BUFFER_RAW;
 
-		/* get string from stream */
-		string archive_str = archive_stream.str();
+		if(size == 0)
+			return;
 
-		/* first send fixed size header with size of following data */
-		ostringstream header_stream;
-		header_stream << setw(8) << hex << archive_str.size();
-		string header_str = header_stream.str();
+		if(cache && size >= NETWORK_CACHE_MIN_SIZE) {
+			string hash = network_buffer_hash(buffer, size);
+			memcpy(header.buffer_hash, hash.data(), NETWORK_HASH_SIZE);
 
-		boost::asio::write(socket,
-			boost::asio::buffer(header_str),
-			boost::asio::transfer_all(), error);
+			if(cache->find(hash, size)) {
+				header.buffer_type = RPC_BUFFER_CACHED;
+				return;
+			}
 
-		if(error.value())
-			error_func->network_error(error.message());
+			cache->insert(hash, size);
+		}
 
-		/* then send actual data */
-		boost::asio::write(socket,
-			boost::asio::buffer(archive_str),
-			boost::asio::transfer_all(), error);
-		
-		if(error.value())
-			error_func->network_error(error.message());
+#ifdef WITH_LZO
+		if(size >= NETWORK_COMPRESS_MIN_SIZE) {
+			lzo_uint compressed_size = 0;
+			vector<lzo_align_t> work((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1)/sizeof(lzo_align_t));
 
-		sent = true;
+			rpc_compress_init();
+			buffer_data.resize(size + size/16 + 64 + 3);
+
+			int r = lzo1x_1_compress((const unsigned char*)buffer, (lzo_uint)size,
+				(unsigned char*)&buffer_data[0], &compressed_size, &work[0]);
+
+			if(r == LZO_E_OK && compressed_size < size) {
+				buffer_data.resize(compressed_size);
+				header.buffer_type = RPC_BUFFER_LZO;
+				return;
+			}
+		}
+#endif
+
+		buffer_data.assign((const char*)buffer, (const char*)buffer + size);
 	}
 
-	void write_buffer(void *buffer, size_t size)
+	void write()
 	{
-		boost::system::error_code error;
+		/* get string from stream */
+		string archive_str = archive_stream.str();
 
-		boost::asio::write(socket,
-			boost::asio::buffer(buffer, size),
-			boost::asio::transfer_all(), error);
-		
-		if(error.value())
-			error_func->network_error(error.message());
+		header.archive_size = archive_str.size();
+		header.buffer_data_size = buffer_data.size();
+
+		/* assemble frame */
+		vector<char> frame(sizeof(RPCHeader) + archive_str.size() + buffer_data.size());
+
+		memcpy(&frame[0], &header, sizeof(RPCHeader));
+		if(archive_str.size())
+			memcpy(&frame[sizeof(RPCHeader)], archive_str.data(), archive_str.size());
+		if(buffer_data.size())
+			memcpy(&frame[sizeof(RPCHeader) + archive_str.size()], &buffer_data[0], buffer_data.size());
+
+		if(queue) {
+			queue->push(frame);
+		}
+		else {
+			boost::system::error_code error;
+
+			boost::asio::write(socket,
+				boost::asio::buffer(frame),
+				boost::asio::transfer_all(), error);
+
+			if(error.value())
+				error_func->network_error(error.message());
+		}
+
+		sent = true;
 	}
 
 protected:
 	string name;
 	tcp::socket& socket;
+	RPCSendQueue *queue;
 	ostringstream archive_stream;
 	o_archive archive;
+	RPCHeader header;
+	vector<char> buffer_data;
 	bool sent;
 	NetworkError *error_func;
 };
@@ -200,53 +554,52 @@ protected:
 
 class RPCReceive {
 public:
-	RPCReceive(tcp::socket& socket_, NetworkError* e )
-	: socket(socket_), archive_stream(NULL), archive(NULL)
+	RPCReceive(tcp::socket& socket_, NetworkError* e, NetworkCache *cache_ = NULL)
+	: socket(socket_), cache(cache_), archive_stream(NULL), archive(NULL)
 	{
 		error_func = e;
-		/* read head with fixed size */
-		vector<char> header(8);
+		memset(&header, 0, sizeof(header));
+
+		/* read header with fixed size */
 		boost::system::error_code error;
-		size_t len = boost::asio::read(socket, boost::asio::buffer(header), error);
+		size_t len = boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)), error);
 
-		if(error.value()){
+		if(error.value()) {
 			error_func->network_error(error.message());
 		}
 
 		/* verify if we got something */
-		if(len == header.size()) {
-			/* decode header */
-			string header_str(&header[0], header.size());
-			istringstream header_stream(header_str);
-
-			size_t data_size;
-
-			if((header_stream >> hex >> data_size)) {
-
-				vector<char> data(data_size);
-				size_t len = boost::asio::read(socket, boost::asio::buffer(data), error);
-
-				if(error.value())
-					error_func->network_error(error.message());
+		if(len == sizeof(header) && header.magic == RPC_MAGIC &&
+		   (header.archive_size > NETWORK_ARCHIVE_MAX_SIZE || header.buffer_size > NETWORK_BUFFER_MAX_SIZE ||
+		    header.buffer_data_size > header.buffer_size))
+		{
+			/* don't allocate whatever size the other side claims */
+			error_func->network_error("Network receive error: invalid frame size");
+		}
+		else if(len == sizeof(header) && header.magic == RPC_MAGIC) {
+			vector<char> data(header.archive_size);
+			buffer_data.resize(header.buffer_data_size);
 
+			if(data.size())
+				boost::asio::read(socket, boost::asio::buffer(data), error);
+			if(!error.value() && buffer_data.size())
+				boost::asio::read(socket, boost::asio::buffer(buffer_data), error);
 
-				if(len == data_size) {
-					archive_str = (data.size())? string(&data[0], data.size()): string("");
+			if(!error.value()) {
+				archive_str = (data.size())? string(&data[0], data.size()): string("");
 
-					archive_stream = new istringstream(archive_str);
-					archive = new i_archive(*archive_stream);
+				archive_stream = new istringstream(archive_str);
+				archive = new i_archive(*archive_stream);
 
-					*archive & name;
-					fprintf(stderr, "rpc receive %s\n", name.c_str());
-				}
-				else {
-					error_func->network_error("Network receive error: data size doesn't match header");
-				}
+				*archive & name;
 			}
 			else {
-				error_func->network_error("Network receive error: can't decode data size from header");
+				error_func->network_error(error.message());
 			}
 		}
+		else if(len == sizeof(header)) {
+			error_func->network_error("Network receive error: invalid frame header");
+		}
 		else {
 			error_func->network_error("Network receive error: invalid header size");
 		}
@@ -271,17 +624,57 @@ public:
 		*archive & data;
 	}
 
+	/* read the data buffer of the frame, decompressing or looking it up in the
+	 * cache, and keeping it in the cache for later frames */
 	void read_buffer(void *buffer, size_t size)
 	{
-		boost::system::error_code error;
-		size_t len = boost::asio::read(socket, boost::asio::buffer(buffer, size), error);
+		if(header.buffer_size != size) {
+			error_func->network_error("Network receive error: buffer size doesn't match expected size");
+			return;
+		}
 
-		if(error.value()){
-			error_func->network_error(error.message());
+		if(size == 0)
+			return;
+
+		string hash = (header.buffer_hash[0])? string(header.buffer_hash, NETWORK_HASH_SIZE): string("");
+
+		if(header.buffer_type == RPC_BUFFER_CACHED) {
+			if(!cache || hash == "" || !cache->find(hash, size)) {
+				error_func->network_error("Network receive error: buffer not found in cache");
+				return;
+			}
+
+			memcpy(buffer, &cache->data(hash, size)[0], size);
+			return;
+		}
+		else if(header.buffer_type == RPC_BUFFER_LZO) {
+#ifdef WITH_LZO
+			lzo_uint decompressed_size = size;
+
+			rpc_compress_init();
+
+			int r = lzo1x_decompress_safe((const unsigned char*)&buffer_data[0], (lzo_uint)buffer_data.size(),
+				(unsigned char*)buffer, &decompressed_size, NULL);
+
+			if(r != LZO_E_OK || decompressed_size != size) {
+				error_func->network_error("Network receive error: failed to decompress buffer");
+				return;
+			}
+#else
+			error_func->network_error("Network receive error: compressed buffers not supported");
+			return;
+#endif
+		}
+		else if(header.buffer_type == RPC_BUFFER_RAW && buffer_data.size() == size) {
+			memcpy(buffer, &buffer_data[0], size);
+		}
+		else {
+			error_func->network_error("Network receive error: invalid buffer");
+			return;
 		}
 
-		if(len != size)
-			cout << "Network receive error: buffer size doesn't match expected size\n";
+		if(cache && hash != "")
+			cache->insert(hash, size, buffer);
 	}
 
 	void read(DeviceTask& task)
@@ -312,6 +705,9 @@ public:
 
 protected:
 	tcp::socket& socket;
+	NetworkCache *cache;
+	RPCHeader header;
+	vector<char> buffer_data;
 	string archive_str;
 	istringstream *archive_stream;
 	i_archive *archive;
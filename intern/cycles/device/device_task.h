@@ -65,6 +65,8 @@ public:
 
 	bool need_finish_queue;
 	bool integrator_branched;
+	float adaptive_threshold;
+	bool use_packet_tracing;
 protected:
 	double last_update_time;
 };
@@ -42,3 +42,7 @@
 #include "geom_primitive.h"
 #include "geom_bvh.h"
 
+#ifdef __KERNEL_CPU__
+#include "geom_bvh_packet.h"
+#endif
+
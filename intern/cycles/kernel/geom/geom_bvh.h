@@ -135,6 +135,11 @@ bool scene_intersect(KernelGlobals *kg, const Ray *ray, const uint visibility, I
 bool scene_intersect(KernelGlobals *kg, const Ray *ray, const uint visibility, Intersection *isect)
 #endif
 {
+#ifdef __RAY_STATS__
+	/* ray count for performance statistics */
+	kg->num_rays++;
+#endif
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #ifdef __HAIR__
@@ -179,6 +184,11 @@ ccl_device_noinline
 #endif
 uint scene_intersect_subsurface(KernelGlobals *kg, const Ray *ray, Intersection *isect, int subsurface_object, uint *lcg_state, int max_hits)
 {
+#ifdef __RAY_STATS__
+	/* ray count for performance statistics */
+	kg->num_rays++;
+#endif
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #ifdef __HAIR__
@@ -224,6 +234,11 @@ ccl_device_noinline
 #endif
 uint scene_intersect_shadow_all(KernelGlobals *kg, const Ray *ray, Intersection *isect, uint max_hits, uint *num_hits)
 {
+#ifdef __RAY_STATS__
+	/* ray count for performance statistics */
+	kg->num_rays++;
+#endif
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #ifdef __HAIR__
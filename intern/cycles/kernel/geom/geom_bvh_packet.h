@@ -0,0 +1,406 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+/* BVH Packet Traversal
+ *
+ * On the CPU, coherent rays such as camera rays of neighbouring pixels can be
+ * traced together. A packet of up to 4 rays is kept in SSE registers and
+ * traverses the BVH as a whole: the child boxes of a node are tested for all
+ * rays at once, and a child is visited if any of the rays intersects it.
+ * With AVX the packet is duplicated into 8 wide registers so both children
+ * are tested in a single pass, using fused multiply-add with AVX2.
+ * Triangles are then intersected per ray with the regular function, so hits
+ * are exactly the same as with single ray traversal. Instances are entered
+ * with all rays of the packet, transformed into object space together.
+ *
+ * Only scenes with static triangles are supported, for motion blur and hair,
+ * and for incoherent rays, single ray traversal should be used. */
+
+CCL_NAMESPACE_BEGIN
+
+#define BVH_PACKET_SIZE 4
+
+ccl_device_inline bool bvh_packet_supported(KernelGlobals *kg)
+{
+	return !(kernel_data.bvh.have_motion || kernel_data.bvh.have_curves);
+}
+
+ccl_device_inline bool bvh_packet_coherent(const Ray *rays, int num_rays, uint active)
+{
+	/* packets only pay off when the rays visit mostly the same nodes, which
+	 * we estimate from the ray directions being close to each other */
+	const Ray *first = NULL;
+
+	for(int i = 0; i < num_rays; i++) {
+		if(!(active & (1 << i)))
+			continue;
+
+		if(!first)
+			first = &rays[i];
+		else if(dot(first->D, rays[i].D) < 0.95f)
+			return false;
+	}
+
+	return true;
+}
+
+#ifdef __KERNEL_SSE2__
+
+/* rays in structure of arrays layout, set up again when entering or leaving
+ * an instance */
+ccl_device_inline void bvh_packet_rays_soa(const float3 P[BVH_PACKET_SIZE], const float3 idir[BVH_PACKET_SIZE],
+	__m128 Psplat[3], __m128 idirsplat[3])
+{
+	Psplat[0] = _mm_set_ps(P[3].x, P[2].x, P[1].x, P[0].x);
+	Psplat[1] = _mm_set_ps(P[3].y, P[2].y, P[1].y, P[0].y);
+	Psplat[2] = _mm_set_ps(P[3].z, P[2].z, P[1].z, P[0].z);
+
+	idirsplat[0] = _mm_set_ps(idir[3].x, idir[2].x, idir[1].x, idir[0].x);
+	idirsplat[1] = _mm_set_ps(idir[3].y, idir[2].y, idir[1].y, idir[0].y);
+	idirsplat[2] = _mm_set_ps(idir[3].z, idir[2].z, idir[1].z, idir[0].z);
+}
+
+ccl_device_inline int bvh_packet_node_intersect(const __m128 P[3], const __m128 idir[3], const __m128 tfar,
+	float lox, float hix, float loy, float hiy, float loz, float hiz, __m128 *tnear)
+{
+	const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(lox), P[0]), idir[0]);
+	const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(hix), P[0]), idir[0]);
+	const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(loy), P[1]), idir[1]);
+	const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(hiy), P[1]), idir[1]);
+	const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(loz), P[2]), idir[2]);
+	const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set_ps1(hiz), P[2]), idir[2]);
+
+	const __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+	                               _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+	const __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+	                               _mm_min_ps(_mm_max_ps(t0z, t1z), tfar));
+
+	*tnear = tmin;
+
+	/* bit per ray */
+	return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+}
+
+#endif
+
+#ifdef __KERNEL_AVX__
+
+/* the same rays in both halves, to test both children at once */
+ccl_device_inline void bvh_packet_rays_avx(const __m128 Psplat[3], const __m128 idirsplat[3],
+	__m256 P8[3], __m256 idir8[3], __m256 Pidir8[3])
+{
+	for(int i = 0; i < 3; i++) {
+		P8[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(Psplat[i]), Psplat[i], 1);
+		idir8[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(idirsplat[i]), idirsplat[i], 1);
+		Pidir8[i] = _mm256_mul_ps(P8[i], idir8[i]);
+	}
+}
+
+/* distance to a slab plane, (lo - P)*idir */
+ccl_device_inline __m256 bvh_packet_slab_avx(const __m256 lo, const __m256 P, const __m256 idir, const __m256 Pidir)
+{
+#ifdef __KERNEL_AVX2__
+	/* as lo*idir - P*idir, with P*idir computed once per packet */
+	return _mm256_fmsub_ps(lo, idir, Pidir);
+#else
+	return _mm256_mul_ps(_mm256_sub_ps(lo, P), idir);
+#endif
+}
+
+/* Test 4 rays against both child nodes at once, the lower half of the
+ * registers is for the first child and the upper half for the second. Returns
+ * a bit per ray for the first child in bits 0-3, and the second in bits 4-7. */
+
+ccl_device_inline int bvh_packet_node_intersect_avx(const __m256 P[3], const __m256 idir[3], const __m256 Pidir[3],
+	const __m256 tfar, const float4 node0, const float4 node1, const float4 node2, __m128 *tnear0, __m128 *tnear1)
+{
+	const __m256 lox = _mm256_setr_ps(node0.x, node0.x, node0.x, node0.x, node0.y, node0.y, node0.y, node0.y);
+	const __m256 hix = _mm256_setr_ps(node0.z, node0.z, node0.z, node0.z, node0.w, node0.w, node0.w, node0.w);
+	const __m256 loy = _mm256_setr_ps(node1.x, node1.x, node1.x, node1.x, node1.y, node1.y, node1.y, node1.y);
+	const __m256 hiy = _mm256_setr_ps(node1.z, node1.z, node1.z, node1.z, node1.w, node1.w, node1.w, node1.w);
+	const __m256 loz = _mm256_setr_ps(node2.x, node2.x, node2.x, node2.x, node2.y, node2.y, node2.y, node2.y);
+	const __m256 hiz = _mm256_setr_ps(node2.z, node2.z, node2.z, node2.z, node2.w, node2.w, node2.w, node2.w);
+
+	const __m256 t0x = bvh_packet_slab_avx(lox, P[0], idir[0], Pidir[0]);
+	const __m256 t1x = bvh_packet_slab_avx(hix, P[0], idir[0], Pidir[0]);
+	const __m256 t0y = bvh_packet_slab_avx(loy, P[1], idir[1], Pidir[1]);
+	const __m256 t1y = bvh_packet_slab_avx(hiy, P[1], idir[1], Pidir[1]);
+	const __m256 t0z = bvh_packet_slab_avx(loz, P[2], idir[2], Pidir[2]);
+	const __m256 t1z = bvh_packet_slab_avx(hiz, P[2], idir[2], Pidir[2]);
+
+	const __m256 tmin = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)),
+	                                  _mm256_max_ps(_mm256_min_ps(t0z, t1z), _mm256_setzero_ps()));
+	const __m256 tmax = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)),
+	                                  _mm256_min_ps(_mm256_max_ps(t0z, t1z), tfar));
+
+	*tnear0 = _mm256_castps256_ps128(tmin);
+	*tnear1 = _mm256_extractf128_ps(tmin, 1);
+
+	/* bit per ray and child */
+	return _mm256_movemask_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ));
+}
+
+#endif
+
+/* Intersect up to BVH_PACKET_SIZE rays, only rays with their bit set in
+ * active are traced. Returns a bitmask of the rays that hit something. */
+
+ccl_device uint bvh_intersect_packet(KernelGlobals *kg, const Ray *rays, Intersection *isects,
+	const uint visibility, int num_rays, uint active)
+{
+#ifdef __KERNEL_SSE2__
+	union { __m128 m128; float v[BVH_PACKET_SIZE]; } tfar;
+	float3 P[BVH_PACKET_SIZE], dir[BVH_PACKET_SIZE], idir[BVH_PACKET_SIZE];
+	uint hits = 0;
+
+	kernel_assert(num_rays <= BVH_PACKET_SIZE);
+
+	for(int i = 0; i < BVH_PACKET_SIZE; i++) {
+		if(i < num_rays && (active & (1 << i))) {
+			P[i] = rays[i].P;
+			dir[i] = bvh_clamp_direction(rays[i].D);
+			idir[i] = bvh_inverse_direction(dir[i]);
+			tfar.v[i] = rays[i].t;
+
+			isects[i].t = rays[i].t;
+			isects[i].object = OBJECT_NONE;
+			isects[i].prim = PRIM_NONE;
+			isects[i].u = 0.0f;
+			isects[i].v = 0.0f;
+		}
+		else {
+			/* inactive rays get a negative distance so they never hit a node */
+			P[i] = make_float3(0.0f, 0.0f, 0.0f);
+			dir[i] = make_float3(0.0f, 0.0f, 1.0f);
+			idir[i] = make_float3(1.0f, 1.0f, 1.0f);
+			tfar.v[i] = -1.0f;
+			active &= ~(1 << i);
+		}
+	}
+
+	if(!active)
+		return 0;
+
+#ifdef __RAY_STATS__
+	/* ray count for performance statistics */
+	for(int i = 0; i < BVH_PACKET_SIZE; i++)
+		kg->num_rays += (active >> i) & 1;
+#endif
+
+	/* rays in structure of arrays layout */
+	__m128 Psplat[3], idirsplat[3];
+
+	bvh_packet_rays_soa(P, idir, Psplat, idirsplat);
+
+#ifdef __KERNEL_AVX__
+	__m256 P8[3], idir8[3], Pidir8[3];
+
+	bvh_packet_rays_avx(Psplat, idirsplat, P8, idir8, Pidir8);
+#endif
+
+	/* traversal stack */
+	int traversalStack[BVH_STACK_SIZE];
+	traversalStack[0] = ENTRYPOINT_SENTINEL;
+
+	int stackPtr = 0;
+	int nodeAddr = kernel_data.bvh.root;
+	int object = OBJECT_NONE;
+
+	/* traversal loop */
+	do {
+		do {
+			/* traverse internal nodes */
+			while(nodeAddr >= 0 && nodeAddr != ENTRYPOINT_SENTINEL) {
+				const float4 *node = (float4*)kg->__bvh_nodes.data + nodeAddr*BVH_NODE_SIZE;
+				const float4 node0 = node[0], node1 = node[1], node2 = node[2], cnodes = node[3];
+
+				/* intersect all rays against both child nodes */
+				__m128 tnear0, tnear1;
+#ifdef __KERNEL_AVX__
+				const __m256 tfar8 = _mm256_insertf128_ps(_mm256_castps128_ps256(tfar.m128), tfar.m128, 1);
+				int hit = bvh_packet_node_intersect_avx(P8, idir8, Pidir8, tfar8, node0, node1, node2, &tnear0, &tnear1);
+				int hit0 = hit & 0xF;
+				int hit1 = hit >> 4;
+#else
+				int hit0 = bvh_packet_node_intersect(Psplat, idirsplat, tfar.m128,
+					node0.x, node0.z, node1.x, node1.z, node2.x, node2.z, &tnear0);
+				int hit1 = bvh_packet_node_intersect(Psplat, idirsplat, tfar.m128,
+					node0.y, node0.w, node1.y, node1.w, node2.y, node2.w, &tnear1);
+#endif
+
+#ifdef __VISIBILITY_FLAG__
+				bool traverseChild0 = hit0 && (__float_as_uint(cnodes.z) & visibility);
+				bool traverseChild1 = hit1 && (__float_as_uint(cnodes.w) & visibility);
+#else
+				bool traverseChild0 = (hit0 != 0);
+				bool traverseChild1 = (hit1 != 0);
+#endif
+
+				nodeAddr = __float_as_int(cnodes.x);
+				int nodeAddrChild1 = __float_as_int(cnodes.y);
+
+				if(traverseChild0 && traverseChild1) {
+					/* both children were intersected, visit the one closer to the
+					 * majority of rays first and push the other */
+					int closer1 = _mm_movemask_ps(_mm_cmplt_ps(tnear1, tnear0)) & hit0 & hit1;
+					int num_both = 0, num_closer1 = 0;
+
+					for(int i = 0; i < BVH_PACKET_SIZE; i++) {
+						num_both += ((hit0 & hit1) >> i) & 1;
+						num_closer1 += (closer1 >> i) & 1;
+					}
+
+					if(2*num_closer1 > num_both) {
+						int tmp = nodeAddr;
+						nodeAddr = nodeAddrChild1;
+						nodeAddrChild1 = tmp;
+					}
+
+					++stackPtr;
+					traversalStack[stackPtr] = nodeAddrChild1;
+				}
+				else {
+					/* one child was intersected */
+					if(traverseChild1) {
+						nodeAddr = nodeAddrChild1;
+					}
+					else if(!traverseChild0) {
+						/* neither child was intersected */
+						nodeAddr = traversalStack[stackPtr];
+						--stackPtr;
+					}
+				}
+			}
+
+			/* if node is leaf, fetch triangle list */
+			if(nodeAddr < 0) {
+				float4 leaf = kernel_tex_fetch(__bvh_nodes, (-nodeAddr-1)*BVH_NODE_SIZE+(BVH_NODE_SIZE-1));
+				int primAddr = __float_as_int(leaf.x);
+
+#ifdef __INSTANCING__
+				if(primAddr >= 0) {
+#endif
+					int primAddr2 = __float_as_int(leaf.y);
+
+					/* pop */
+					nodeAddr = traversalStack[stackPtr];
+					--stackPtr;
+
+					/* primitive intersection, per ray */
+					for(; primAddr < primAddr2; primAddr++) {
+						uint type = kernel_tex_fetch(__prim_type, primAddr);
+
+						if((type & PRIMITIVE_ALL) != PRIMITIVE_TRIANGLE)
+							continue;
+
+						for(int i = 0; i < BVH_PACKET_SIZE; i++) {
+							if(!(active & (1 << i)))
+								continue;
+
+							if(triangle_intersect(kg, &isects[i], P[i], dir[i], visibility, object, primAddr)) {
+								hits |= (1 << i);
+
+								if(visibility == PATH_RAY_SHADOW_OPAQUE) {
+									/* shadow ray early termination */
+									active &= ~(1 << i);
+									tfar.v[i] = -1.0f;
+								}
+								else
+									tfar.v[i] = isects[i].t;
+							}
+						}
+
+						if(!active)
+							return hits;
+					}
+#ifdef __INSTANCING__
+				}
+				else {
+					/* instance push, all rays enter the object together */
+					object = kernel_tex_fetch(__prim_object, -primAddr-1);
+
+					for(int i = 0; i < BVH_PACKET_SIZE; i++) {
+						if(!(active & (1 << i)))
+							continue;
+
+						bvh_instance_push(kg, object, &rays[i], &P[i], &dir[i], &idir[i], &isects[i].t);
+						tfar.v[i] = isects[i].t;
+					}
+
+					bvh_packet_rays_soa(P, idir, Psplat, idirsplat);
+#ifdef __KERNEL_AVX__
+					bvh_packet_rays_avx(Psplat, idirsplat, P8, idir8, Pidir8);
+#endif
+
+					++stackPtr;
+					traversalStack[stackPtr] = ENTRYPOINT_SENTINEL;
+
+					nodeAddr = kernel_tex_fetch(__object_node, object);
+				}
+#endif
+			}
+		} while(nodeAddr != ENTRYPOINT_SENTINEL);
+
+#ifdef __INSTANCING__
+		if(stackPtr >= 0) {
+			kernel_assert(object != OBJECT_NONE);
+
+			/* instance pop */
+			for(int i = 0; i < BVH_PACKET_SIZE; i++) {
+				if(!(active & (1 << i)))
+					continue;
+
+				bvh_instance_pop(kg, object, &rays[i], &P[i], &dir[i], &idir[i], &isects[i].t);
+				tfar.v[i] = isects[i].t;
+			}
+
+			bvh_packet_rays_soa(P, idir, Psplat, idirsplat);
+#ifdef __KERNEL_AVX__
+			bvh_packet_rays_avx(Psplat, idirsplat, P8, idir8, Pidir8);
+#endif
+
+			object = OBJECT_NONE;
+			nodeAddr = traversalStack[stackPtr];
+			--stackPtr;
+		}
+#endif
+	} while(nodeAddr != ENTRYPOINT_SENTINEL);
+
+	return hits;
+#else
+	/* no SSE, trace rays one by one */
+	uint hits = 0;
+
+	for(int i = 0; i < num_rays; i++) {
+		if(!(active & (1 << i)))
+			continue;
+
+#ifdef __HAIR__
+		bool hit = scene_intersect(kg, &rays[i], visibility, &isects[i], NULL, 0.0f, 0.0f);
+#else
+		bool hit = scene_intersect(kg, &rays[i], visibility, &isects[i]);
+#endif
+
+		if(hit)
+			hits |= (1 << i);
+	}
+
+	return hits;
+#endif
+}
+
+CCL_NAMESPACE_END
+
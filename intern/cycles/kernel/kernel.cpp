@@ -37,7 +37,7 @@ void kernel_const_copy(KernelGlobals *kg, const char *name, void *host, size_t s
 		assert(0);
 }
 
-void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t width, size_t height, size_t depth, InterpolationType interpolation)
+void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t width, size_t height, size_t depth, InterpolationType interpolation, ImageDataType type)
 {
 	if(0) {
 	}
@@ -51,7 +51,7 @@ void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t
 #include "kernel_textures.h"
 
 	else if(strstr(name, "__tex_image_float")) {
-		texture_image_float4 *tex = NULL;
+		texture_image *tex = NULL;
 		int id = atoi(name + strlen("__tex_image_float_"));
 		int array_index = id;
 
@@ -60,7 +60,8 @@ void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t
 		}
 
 		if(tex) {
-			tex->data = (float4*)mem;
+			tex->data = (void*)mem;
+			tex->type = type;
 			tex->width = width;
 			tex->height = height;
 			tex->depth = depth;
@@ -68,7 +69,7 @@ void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t
 		}
 	}
 	else if(strstr(name, "__tex_image")) {
-		texture_image_uchar4 *tex = NULL;
+		texture_image *tex = NULL;
 		int id = atoi(name + strlen("__tex_image_"));
 		int array_index = id - MAX_FLOAT_IMAGES;
 
@@ -77,7 +78,8 @@ void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t
 		}
 
 		if(tex) {
-			tex->data = (uchar4*)mem;
+			tex->data = (void*)mem;
+			tex->type = type;
 			tex->width = width;
 			tex->height = height;
 			tex->depth = depth;
@@ -110,6 +112,11 @@ void kernel_cpu_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_s
 		kernel_path_trace(kg, buffer, rng_state, sample, x, y, offset, stride);
 }
 
+void kernel_cpu_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state, int sample, int x, int y, int w, int h, int offset, int stride)
+{
+	kernel_path_trace_packet(kg, buffer, rng_state, sample, x, y, w, h, offset, stride);
+}
+
 /* Film */
 
 void kernel_cpu_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer, float sample_scale, int x, int y, int offset, int stride)
@@ -122,6 +129,66 @@ void kernel_cpu_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *bu
 	kernel_film_convert_to_half_float(kg, rgba, buffer, sample_scale, x, y, offset, stride);
 }
 
+/* Adaptive Sampling */
+
+float kernel_cpu_adaptive_pixel_error(KernelGlobals *kg, float *buffer, int x, int y, int offset, int stride)
+{
+	return kernel_film_adaptive_pixel_error(kg, buffer, x, y, offset, stride);
+}
+
+void kernel_cpu_adaptive_scale_passes(KernelGlobals *kg, float *buffer, int num_samples, int x, int y, int offset, int stride)
+{
+	kernel_film_adaptive_scale_passes(kg, buffer, num_samples, x, y, offset, stride);
+}
+
+/* BVH Benchmark */
+
+int kernel_cpu_bvh_trace_camera_rays(KernelGlobals *kg, int x, int y, int w, int h, bool use_packets, bool occlusion)
+{
+	uint visibility = (occlusion)? PATH_RAY_SHADOW_OPAQUE: PATH_RAY_CAMERA | kernel_data.integrator.layer_flag;
+	int num_rays = 0;
+
+	/* 2x2 pixel blocks, matching packet tracing of the path tracer */
+	for(int by = y; by < y + h; by += 2) {
+		for(int bx = x; bx < x + w; bx += 2) {
+			int bw = min(2, x + w - bx);
+			int bh = min(2, y + h - by);
+			int num = bw*bh;
+
+			Ray ray[BVH_PACKET_SIZE];
+			Intersection isect[BVH_PACKET_SIZE];
+			uint active = 0;
+
+			for(int i = 0; i < num; i++) {
+				camera_sample(kg, bx + i%bw, by + i/bw, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, &ray[i]);
+
+				if(ray[i].t != 0.0f)
+					active |= (1 << i);
+			}
+
+			if(use_packets) {
+				bvh_intersect_packet(kg, ray, isect, visibility, num, active);
+			}
+			else {
+				for(int i = 0; i < num; i++) {
+					if(!(active & (1 << i)))
+						continue;
+#ifdef __HAIR__
+					scene_intersect(kg, &ray[i], visibility, &isect[i], NULL, 0.0f, 0.0f);
+#else
+					scene_intersect(kg, &ray[i], visibility, &isect[i]);
+#endif
+				}
+			}
+
+			for(int i = 0; i < num; i++)
+				num_rays += (active >> i) & 1;
+		}
+	}
+
+	return num_rays;
+}
+
 /* Shader Evaluation */
 
 void kernel_cpu_shader(KernelGlobals *kg, uint4 *input, float4 *output, int type, int i)
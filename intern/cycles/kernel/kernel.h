@@ -32,10 +32,12 @@ void *kernel_osl_memory(KernelGlobals *kg);
 bool kernel_osl_use(KernelGlobals *kg);
 
 void kernel_const_copy(KernelGlobals *kg, const char *name, void *host, size_t size);
-void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t width, size_t height, size_t depth, InterpolationType interpolation=INTERPOLATION_LINEAR);
+void kernel_tex_copy(KernelGlobals *kg, const char *name, device_ptr mem, size_t width, size_t height, size_t depth, InterpolationType interpolation=INTERPOLATION_LINEAR, ImageDataType type=IMAGE_DATA_TYPE_FLOAT4);
 
 void kernel_cpu_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
 	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
 void kernel_cpu_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
 	float sample_scale, int x, int y, int offset, int stride);
 void kernel_cpu_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
@@ -43,9 +45,22 @@ void kernel_cpu_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *bu
 void kernel_cpu_shader(KernelGlobals *kg, uint4 *input, float4 *output,
 	int type, int i);
 
+/* adaptive sampling runs only once every few samples, no optimized variants */
+float kernel_cpu_adaptive_pixel_error(KernelGlobals *kg, float *buffer,
+	int x, int y, int offset, int stride);
+void kernel_cpu_adaptive_scale_passes(KernelGlobals *kg, float *buffer,
+	int num_samples, int x, int y, int offset, int stride);
+
+/* traces pixel center camera rays without shading, for measuring ray
+ * throughput of single ray and packet traversal, returns number of rays */
+int kernel_cpu_bvh_trace_camera_rays(KernelGlobals *kg, int x, int y, int w, int h,
+	bool use_packets, bool occlusion);
+
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE2
 void kernel_cpu_sse2_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
 	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_sse2_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
 void kernel_cpu_sse2_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
 	float sample_scale, int x, int y, int offset, int stride);
 void kernel_cpu_sse2_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
@@ -57,6 +72,8 @@ void kernel_cpu_sse2_shader(KernelGlobals *kg, uint4 *input, float4 *output,
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE3
 void kernel_cpu_sse3_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
 	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_sse3_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
 void kernel_cpu_sse3_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
 	float sample_scale, int x, int y, int offset, int stride);
 void kernel_cpu_sse3_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
@@ -68,6 +85,8 @@ void kernel_cpu_sse3_shader(KernelGlobals *kg, uint4 *input, float4 *output,
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
 void kernel_cpu_sse41_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
 	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_sse41_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
 void kernel_cpu_sse41_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
 	float sample_scale, int x, int y, int offset, int stride);
 void kernel_cpu_sse41_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
@@ -79,6 +98,8 @@ void kernel_cpu_sse41_shader(KernelGlobals *kg, uint4 *input, float4 *output,
 #ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 void kernel_cpu_avx_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
 	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_avx_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
 void kernel_cpu_avx_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
 	float sample_scale, int x, int y, int offset, int stride);
 void kernel_cpu_avx_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
@@ -87,6 +108,19 @@ void kernel_cpu_avx_shader(KernelGlobals *kg, uint4 *input, float4 *output,
 	int type, int i);
 #endif
 
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+void kernel_cpu_avx2_path_trace(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int offset, int stride);
+void kernel_cpu_avx2_path_trace_packet(KernelGlobals *kg, float *buffer, unsigned int *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride);
+void kernel_cpu_avx2_convert_to_byte(KernelGlobals *kg, uchar4 *rgba, float *buffer,
+	float sample_scale, int x, int y, int offset, int stride);
+void kernel_cpu_avx2_convert_to_half_float(KernelGlobals *kg, uchar4 *rgba, float *buffer,
+	float sample_scale, int x, int y, int offset, int stride);
+void kernel_cpu_avx2_shader(KernelGlobals *kg, uint4 *input, float4 *output,
+	int type, int i);
+#endif
+
 CCL_NAMESPACE_END
 
 #endif /* __KERNEL_H__ */
@@ -61,7 +61,10 @@ template<typename T> struct texture  {
 	int width;
 };
 
-template<typename T> struct texture_image  {
+/* Image textures can be stored with different data types and number of
+ * channels to save memory, they are converted to float4 on lookup. */
+
+struct texture_image  {
 	ccl_always_inline float4 read(float4 r)
 	{
 		return r;
@@ -73,6 +76,29 @@ template<typename T> struct texture_image  {
 		return make_float4(r.x*f, r.y*f, r.z*f, r.w*f);
 	}
 
+	ccl_always_inline float4 read(half4 r)
+	{
+		return half4_to_float4(r);
+	}
+
+	/* single channel images are read as grayscale */
+	ccl_always_inline float4 read(float r)
+	{
+		return make_float4(r, r, r, 1.0f);
+	}
+
+	ccl_always_inline float4 read(uchar r)
+	{
+		float f = r*(1.0f/255.0f);
+		return make_float4(f, f, f, 1.0f);
+	}
+
+	ccl_always_inline float4 read(half r)
+	{
+		float f = half_to_float(r);
+		return make_float4(f, f, f, 1.0f);
+	}
+
 	ccl_always_inline int wrap_periodic(int x, int width)
 	{
 		x %= width;
@@ -93,11 +119,8 @@ template<typename T> struct texture_image  {
 		return x - (float)i;
 	}
 
-	ccl_always_inline float4 interp(float x, float y, bool periodic = true)
+	template<typename T> ccl_always_inline float4 interp_data(const T *data, float x, float y, bool periodic)
 	{
-		if(!data)
-			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
-
 		int ix, iy, nix, niy;
 
 		if(interpolation == INTERPOLATION_CLOSEST) {
@@ -142,11 +165,8 @@ template<typename T> struct texture_image  {
 		}
 	}
 
-	ccl_always_inline float4 interp_3d(float x, float y, float z, bool periodic = false)
+	template<typename T> ccl_always_inline float4 interp_3d_data(const T *data, float x, float y, float z, bool periodic)
 	{
-		if(!data)
-			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
-
 		int ix, iy, iz, nix, niy, niz;
 
 		if(interpolation == INTERPOLATION_CLOSEST) {
@@ -207,7 +227,38 @@ template<typename T> struct texture_image  {
 		}
 	}
 
-	T *data;
+	ccl_always_inline float4 interp(float x, float y, bool periodic = true)
+	{
+		if(!data)
+			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		switch(type) {
+			case IMAGE_DATA_TYPE_BYTE4: return interp_data((const uchar4*)data, x, y, periodic);
+			case IMAGE_DATA_TYPE_HALF4: return interp_data((const half4*)data, x, y, periodic);
+			case IMAGE_DATA_TYPE_FLOAT: return interp_data((const float*)data, x, y, periodic);
+			case IMAGE_DATA_TYPE_BYTE: return interp_data((const uchar*)data, x, y, periodic);
+			case IMAGE_DATA_TYPE_HALF: return interp_data((const half*)data, x, y, periodic);
+			default: return interp_data((const float4*)data, x, y, periodic);
+		}
+	}
+
+	ccl_always_inline float4 interp_3d(float x, float y, float z, bool periodic = false)
+	{
+		if(!data)
+			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		switch(type) {
+			case IMAGE_DATA_TYPE_BYTE4: return interp_3d_data((const uchar4*)data, x, y, z, periodic);
+			case IMAGE_DATA_TYPE_HALF4: return interp_3d_data((const half4*)data, x, y, z, periodic);
+			case IMAGE_DATA_TYPE_FLOAT: return interp_3d_data((const float*)data, x, y, z, periodic);
+			case IMAGE_DATA_TYPE_BYTE: return interp_3d_data((const uchar*)data, x, y, z, periodic);
+			case IMAGE_DATA_TYPE_HALF: return interp_3d_data((const half*)data, x, y, z, periodic);
+			default: return interp_3d_data((const float4*)data, x, y, z, periodic);
+		}
+	}
+
+	void *data;
+	ImageDataType type;
 	int interpolation;
 	int width, height, depth;
 };
@@ -219,8 +270,6 @@ typedef texture<uint> texture_uint;
 typedef texture<int> texture_int;
 typedef texture<uint4> texture_uint4;
 typedef texture<uchar4> texture_uchar4;
-typedef texture_image<float4> texture_image_float4;
-typedef texture_image<uchar4> texture_image_uchar4;
 
 /* Macros to handle different memory storage on different devices */
 
@@ -172,7 +172,16 @@ ccl_device_noinline float3 indirect_primitive_emission(KernelGlobals *kg, Shader
 #endif
 		/* multiple importance sampling, get triangle light pdf,
 		 * and compute weight with respect to BSDF pdf */
-		float pdf = triangle_light_pdf(kg, sd->Ng, sd->I, t);
+		float pdf;
+
+		if(kernel_data.integrator.use_light_tree) {
+			/* tree probability depends on the point the ray came from */
+			float3 P = sd->P + sd->I*t;
+			pdf = light_tree_triangle_pdf(kg, sd->object, sd->prim, P, sd->Ng, sd->I, t);
+		}
+		else
+			pdf = triangle_light_pdf(kg, sd->Ng, sd->I, t);
+
 		float mis_weight = power_heuristic(bsdf_pdf, pdf);
 
 		return L*mis_weight;
@@ -186,7 +195,8 @@ ccl_device_noinline float3 indirect_primitive_emission(KernelGlobals *kg, Shader
 ccl_device_noinline bool indirect_lamp_emission(KernelGlobals *kg, PathState *state, Ray *ray, float randt, float3 *emission)
 {
 	LightSample ls;
-	int lamp = lamp_light_eval_sample(kg, randt);
+	float eval_fac;
+	int lamp = lamp_light_eval_sample(kg, randt, ray->P, &eval_fac);
 
 	if(lamp == LAMP_NONE)
 		return false;
@@ -194,6 +204,8 @@ ccl_device_noinline bool indirect_lamp_emission(KernelGlobals *kg, PathState *st
 	if(!lamp_light_eval(kg, lamp, ray->P, ray->D, ray->t, &ls))
 		return false;
 
+	ls.eval_fac *= eval_fac;
+
 #ifdef __PASSES__
 	/* use visibility flag to skip lights */
 	if(ls.shader & SHADER_EXCLUDE_ANY) {
@@ -86,5 +86,67 @@ ccl_device void kernel_film_convert_to_half_float(KernelGlobals *kg,
 	float4_store_half(out, rgba_in, sample_scale);
 }
 
+/* Adaptive Sampling */
+
+ccl_device float kernel_film_adaptive_pixel_error(KernelGlobals *kg,
+	ccl_global float *buffer, int x, int y, int offset, int stride)
+{
+	/* buffer offset */
+	int index = offset + x + y*stride;
+
+	buffer += index*kernel_data.film.pass_stride;
+
+	float4 L = *((ccl_global float4*)buffer);
+	float4 L2 = *((ccl_global float4*)(buffer + kernel_data.film.pass_adaptive_aux));
+	float n = L2.w;
+
+	if(n < 2.0f)
+		return FLT_MAX;
+
+	/* variance of the mean from the first and second moment */
+	float inv_n = 1.0f/n;
+	float3 mean = make_float3(L.x, L.y, L.z)*inv_n;
+	float3 variance = make_float3(L2.x, L2.y, L2.z)*inv_n - mean*mean;
+	float3 error = max(variance, make_float3(0.0f, 0.0f, 0.0f))*(1.0f/(n - 1.0f));
+
+	error = make_float3(sqrtf(error.x), sqrtf(error.y), sqrtf(error.z));
+
+	/* relative to the square root of intensity, so that bright areas are
+	 * allowed more absolute noise, as it is perceived less there */
+	return average(error)/(1e-3f + sqrtf(max(average(mean), 0.0f)));
+}
+
+ccl_device void kernel_film_adaptive_scale_passes(KernelGlobals *kg,
+	ccl_global float *buffer, int num_samples, int x, int y, int offset, int stride)
+{
+	/* buffer offset */
+	int index = offset + x + y*stride;
+	int pass_stride = kernel_data.film.pass_stride;
+
+	buffer += index*pass_stride;
+
+	/* pixels that stopped sampling early are scaled up as if they had
+	 * taken all samples, so the film can divide by the tile sample count */
+	float n = buffer[kernel_data.film.pass_adaptive_aux + 3];
+
+	if(n <= 0.0f || n >= (float)num_samples)
+		return;
+
+	float scale = (float)num_samples/n;
+	int flag = kernel_data.film.pass_flag;
+
+	for(int i = 0; i < pass_stride; i++) {
+		/* depth and id passes are written once and not accumulated */
+		if((flag & PASS_DEPTH) && i == kernel_data.film.pass_depth)
+			continue;
+		if((flag & PASS_OBJECT_ID) && i == kernel_data.film.pass_object_id)
+			continue;
+		if((flag & PASS_MATERIAL_ID) && i == kernel_data.film.pass_material_id)
+			continue;
+
+		buffer[i] *= scale;
+	}
+}
+
 CCL_NAMESPACE_END
 
@@ -16,6 +16,8 @@
 
 /* Constant Globals */
 
+#include "kernel_texture_cache.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* On the CPU, we pass along the struct KernelGlobals to nearly everywhere in
@@ -31,12 +33,15 @@ struct OSLThreadData;
 struct OSLShadingSystem;
 #endif
 
+struct TextureCacheGlobals;
+struct TextureCacheThreadData;
+
 #define MAX_BYTE_IMAGES   1024
 #define MAX_FLOAT_IMAGES  1024
 
 typedef struct KernelGlobals {
-	texture_image_uchar4 texture_byte_images[MAX_BYTE_IMAGES];
-	texture_image_float4 texture_float_images[MAX_FLOAT_IMAGES];
+	texture_image texture_byte_images[MAX_BYTE_IMAGES];
+	texture_image texture_float_images[MAX_FLOAT_IMAGES];
 
 #define KERNEL_TEX(type, ttype, name) ttype name;
 #define KERNEL_IMAGE_TEX(type, ttype, name)
@@ -52,6 +57,14 @@ typedef struct KernelGlobals {
 	OSLThreadData *osl_tdata;
 #endif
 
+	/* image texture cache, NULL when all images are loaded into memory */
+	TextureCacheGlobals *texture_cache;
+	TextureCacheThreadData *texture_cache_tdata;
+
+	/* number of rays traced, for performance statistics, only counted
+	 * when built with WITH_CYCLES_RAY_STATS */
+	uint64_t num_rays;
+
 } KernelGlobals;
 
 #endif
@@ -513,12 +513,206 @@ ccl_device int light_distribution_sample(KernelGlobals *kg, float randt)
 	return clamp(first-1, 0, kernel_data.integrator.num_distribution-1);
 }
 
+/* Light Tree
+ *
+ * Instead of picking from the distribution proportional to area only, the
+ * triangles and the point, spot and area lamps are picked by descending a
+ * tree, choosing a child by an estimate of its contribution at the shading
+ * point from its energy, distance and orientation bounds. Distant and
+ * background lamps are still picked from the distribution. */
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, int node, float3 P)
+{
+	float4 data0 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 0);
+	float4 data1 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1);
+	float4 data2 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 2);
+	float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+
+	float energy = data0.w;
+
+	if(energy == 0.0f)
+		return 0.0f;
+
+	float3 bmin = float4_to_float3(data0);
+	float3 bmax = float4_to_float3(data1);
+	float3 axis = float4_to_float3(data2);
+	float theta_o = data2.w;
+	float theta_e = data3.x;
+	bool two_sided = (__float_as_int(data3.y) != 0);
+
+	/* distance to the bounds, clamped to the bounds radius to avoid
+	 * overestimating nearby nodes */
+	float3 V = P - 0.5f*(bmin + bmax);
+	float radius2 = 0.25f*len_squared(bmax - bmin);
+	float dist2 = len_squared(V);
+
+	if(dist2 <= radius2) {
+		/* inside the bounds, light may arrive from any direction */
+		return (radius2 > 0.0f)? energy/radius2: energy;
+	}
+
+	/* smallest angle between the emission cone and the direction to P,
+	 * widened by the angle subtended by the bounds */
+	float dist = sqrtf(dist2);
+	float cos_theta = dot(axis, V)/dist;
+
+	if(two_sided)
+		cos_theta = fabsf(cos_theta);
+
+	float theta = safe_acosf(cos_theta);
+	float theta_u = safe_asinf(sqrtf(radius2)/dist);
+	float theta_i = fmaxf(theta - theta_o - theta_u, 0.0f);
+
+	if(theta_i >= theta_e)
+		return 0.0f;
+
+	return energy*cosf(theta_i)/dist2;
+}
+
+/* descend from root to a leaf node, returns -1 if no emitter in the tree
+ * can contribute at P */
+
+ccl_device int light_tree_sample(KernelGlobals *kg, int root, float randt, float3 P, float *pdf)
+{
+	int node = root;
+
+	*pdf = 1.0f;
+
+	for(;;) {
+		float4 data1 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1);
+		int child = __float_as_int(data1.w);
+
+		if(child < 0)
+			return node;
+
+		/* pick child proportional to importance and rescale random number */
+		int left = node + 1;
+		int right = child;
+		float importance_left = light_tree_node_importance(kg, left, P);
+		float importance_right = light_tree_node_importance(kg, right, P);
+		float importance = importance_left + importance_right;
+
+		if(importance == 0.0f) {
+			*pdf = 0.0f;
+			return -1;
+		}
+
+		float prob_left = importance_left/importance;
+
+		if(randt < prob_left) {
+			randt = randt/prob_left;
+			node = left;
+			*pdf *= prob_left;
+		}
+		else {
+			randt = (randt - prob_left)/(1.0f - prob_left);
+			node = right;
+			*pdf *= 1.0f - prob_left;
+		}
+
+		randt = min(randt, 1.0f - FLT_EPSILON);
+	}
+}
+
+ccl_device float light_tree_pdf(KernelGlobals *kg, int node, float3 P)
+{
+	/* walk up from the leaf, multiplying the probabilities of the choices
+	 * made when descending the tree */
+	float pdf = 1.0f;
+	int parent = __float_as_int(kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3).z);
+
+	while(parent != -1) {
+		int left = parent + 1;
+		int right = __float_as_int(kernel_tex_fetch(__light_tree_nodes, parent*LIGHT_TREE_NODE_SIZE + 1).w);
+		float importance_left = light_tree_node_importance(kg, left, P);
+		float importance_right = light_tree_node_importance(kg, right, P);
+		float importance = importance_left + importance_right;
+
+		if(importance == 0.0f)
+			return 0.0f;
+
+		pdf *= ((node == left)? importance_left: importance_right)/importance;
+
+		node = parent;
+		parent = __float_as_int(kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3).z);
+	}
+
+	return pdf;
+}
+
+ccl_device float light_tree_triangle_pdf(KernelGlobals *kg, int object, int prim,
+	float3 P, const float3 Ng, const float3 I, float t)
+{
+	/* find leaf node of the triangle, through a per object offset into a
+	 * table indexed by triangle */
+	uint offset = kernel_tex_fetch(__light_tree_leaves, object*2 + 0);
+
+	if(offset == 0)
+		return 0.0f;
+
+	uint tri_offset = kernel_tex_fetch(__light_tree_leaves, object*2 + 1);
+	uint leaf = kernel_tex_fetch(__light_tree_leaves, offset + prim - tri_offset);
+
+	if(leaf == ~0u)
+		return 0.0f;
+
+	float cos_pi = fabsf(dot(Ng, I));
+
+	if(cos_pi == 0.0f)
+		return 0.0f;
+
+	/* leaves store the triangle area next to the parent index */
+	float area = kernel_tex_fetch(__light_tree_nodes, leaf*LIGHT_TREE_NODE_SIZE + 3).w;
+	float pdf = kernel_data.integrator.light_tree_pdf_triangles*light_tree_pdf(kg, leaf, P)/area;
+
+	return t*t*pdf/cos_pi;
+}
+
+ccl_device int light_tree_distribution_sample(KernelGlobals *kg, float randt, float3 P, int *leaf, float *pdf)
+{
+	/* pick triangles, positional lamps, or other lamps with the same
+	 * probabilities as the distribution, and then an emitter in the tree */
+	float pdf_triangles = kernel_data.integrator.light_tree_pdf_triangles;
+	float pdf_lamps = kernel_data.integrator.light_tree_pdf_lamps;
+
+	if(randt < pdf_triangles + pdf_lamps) {
+		bool triangle = (randt < pdf_triangles);
+		int root = (triangle)? 0: kernel_data.integrator.light_tree_lamp_root;
+		float group_pdf = (triangle)? pdf_triangles: pdf_lamps;
+		float group_randt = (triangle)? randt: randt - pdf_triangles;
+
+		*leaf = light_tree_sample(kg, root, group_randt/group_pdf, P, pdf);
+		*pdf *= group_pdf;
+
+		if(*leaf == -1)
+			return -1;
+
+		return ~__float_as_int(kernel_tex_fetch(__light_tree_nodes, (*leaf)*LIGHT_TREE_NODE_SIZE + 1).w);
+	}
+
+	*leaf = -1;
+	*pdf = kernel_data.integrator.pdf_lights;
+	return light_distribution_sample(kg, randt);
+}
+
 /* Generic Light */
 
 ccl_device void light_sample(KernelGlobals *kg, float randt, float randu, float randv, float time, float3 P, LightSample *ls)
 {
 	/* sample index */
-	int index = light_distribution_sample(kg, randt);
+	int index, leaf;
+	float tree_pdf = 1.0f;
+
+	if(kernel_data.integrator.use_light_tree) {
+		index = light_tree_distribution_sample(kg, randt, P, &leaf, &tree_pdf);
+
+		if(tree_pdf == 0.0f) {
+			ls->pdf = 0.0f;
+			return;
+		}
+	}
+	else
+		index = light_distribution_sample(kg, randt);
 
 	/* fetch light data */
 	float4 l = kernel_tex_fetch(__light_distribution, index);
@@ -532,12 +726,25 @@ ccl_device void light_sample(KernelGlobals *kg, float randt, float randu, float
 
 		/* compute incoming direction, distance and pdf */
 		ls->D = normalize_len(ls->P - P, &ls->t);
-		ls->pdf = triangle_light_pdf(kg, ls->Ng, -ls->D, ls->t);
 		ls->shader |= shader_flag;
+
+		if(kernel_data.integrator.use_light_tree) {
+			/* leaves store the triangle area next to the parent index */
+			float area = kernel_tex_fetch(__light_tree_nodes, leaf*LIGHT_TREE_NODE_SIZE + 3).w;
+			float cos_pi = fabsf(dot(ls->Ng, ls->D));
+
+			ls->pdf = (cos_pi > 0.0f)? ls->t*ls->t*tree_pdf/(area*cos_pi): 0.0f;
+		}
+		else
+			ls->pdf = triangle_light_pdf(kg, ls->Ng, -ls->D, ls->t);
 	}
 	else {
 		int lamp = -prim-1;
 		lamp_light_sample(kg, lamp, randu, randv, P, ls);
+
+		/* replace distribution by tree probability */
+		if(kernel_data.integrator.use_light_tree)
+			ls->eval_fac *= kernel_data.integrator.pdf_lights/tree_pdf;
 	}
 }
 
@@ -552,10 +759,27 @@ ccl_device void light_select(KernelGlobals *kg, int index, float randu, float ra
 	lamp_light_sample(kg, index, randu, randv, P, ls);
 }
 
-ccl_device int lamp_light_eval_sample(KernelGlobals *kg, float randt)
+ccl_device int lamp_light_eval_sample(KernelGlobals *kg, float randt, float3 P, float *eval_fac)
 {
 	/* sample index */
-	int index = light_distribution_sample(kg, randt);
+	int index;
+
+	*eval_fac = 1.0f;
+
+	if(kernel_data.integrator.use_light_tree) {
+		/* replace distribution by tree probability */
+		int leaf;
+		float tree_pdf;
+
+		index = light_tree_distribution_sample(kg, randt, P, &leaf, &tree_pdf);
+
+		if(tree_pdf == 0.0f)
+			return LAMP_NONE;
+
+		*eval_fac = kernel_data.integrator.pdf_lights/tree_pdf;
+	}
+	else
+		index = light_distribution_sample(kg, randt);
 
 	/* fetch light data */
 	float4 l = kernel_tex_fetch(__light_distribution, index);
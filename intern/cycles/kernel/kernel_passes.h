@@ -34,6 +34,18 @@ ccl_device_inline void kernel_write_pass_float4(ccl_global float *buffer, int sa
 	*buf = (sample == 0)? value: *buf + value;
 }
 
+ccl_device_inline void kernel_write_adaptive_pass(KernelGlobals *kg, ccl_global float *buffer, int sample, float4 L)
+{
+#ifdef __PASSES__
+	/* second moment of the combined pass for adaptive sampling convergence
+	 * tests, with the number of samples taken by this pixel in w */
+	if(kernel_data.film.pass_flag & PASS_ADAPTIVE_AUX) {
+		float4 L2 = make_float4(L.x*L.x, L.y*L.y, L.z*L.z, 1.0f);
+		kernel_write_pass_float4(buffer + kernel_data.film.pass_adaptive_aux, sample, L2);
+	}
+#endif
+}
+
 ccl_device_inline void kernel_write_data_passes(KernelGlobals *kg, ccl_global float *buffer, PathRadiance *L,
 	ShaderData *sd, int sample, PathState *state, float3 throughput)
 {
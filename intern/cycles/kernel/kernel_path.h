@@ -572,7 +572,11 @@ ccl_device_inline bool kernel_path_integrate_lighting(KernelGlobals *kg, RNG *rn
 
 #endif
 
-ccl_device float4 kernel_path_integrate(KernelGlobals *kg, RNG *rng, int sample, Ray ray, ccl_global float *buffer)
+/* first_isect is optional, when the camera ray was already intersected with
+ * the scene (packet tracing), its result is used for the first bounce */
+
+ccl_device float4 kernel_path_integrate(KernelGlobals *kg, RNG *rng, int sample, Ray ray,
+	ccl_global float *buffer, const Intersection *first_isect)
 {
 	/* initialize */
 	PathRadiance L;
@@ -604,11 +608,22 @@ ccl_device float4 kernel_path_integrate(KernelGlobals *kg, RNG *rng, int sample,
 			extmax = kernel_data.curve.maximum_width;
 			lcg_state = lcg_state_init(rng, &state, 0x51633e2d);
 		}
+#endif
 
-		bool hit = scene_intersect(kg, &ray, visibility, &isect, &lcg_state, difl, extmax);
+		bool hit;
+
+		if(first_isect) {
+			isect = *first_isect;
+			hit = (isect.prim != PRIM_NONE);
+			first_isect = NULL;
+		}
+		else {
+#ifdef __HAIR__
+			hit = scene_intersect(kg, &ray, visibility, &isect, &lcg_state, difl, extmax);
 #else
-		bool hit = scene_intersect(kg, &ray, visibility, &isect);
+			hit = scene_intersect(kg, &ray, visibility, &isect);
 #endif
+		}
 
 #ifdef __LAMP_MIS__
 		if(kernel_data.integrator.use_lamp_mis && !(state.flag & PATH_RAY_CAMERA)) {
@@ -1081,7 +1096,9 @@ ccl_device float4 kernel_branched_path_integrate(KernelGlobals *kg, RNG *rng, in
 			/* decoupled ray marching only supported on CPU */
 			bool heterogeneous = volume_stack_is_heterogeneous(kg, state.volume_stack);
 
-			/* cache steps along volume for repeated sampling */
+			/* cache steps along volume for repeated sampling. this ray marches
+			 * the whole segment and does not use the majorant grid, which only
+			 * speeds up the distance sampling in kernel_volume_integrate */
 			VolumeSegment volume_segment;
 			ShaderData volume_sd;
 
@@ -1409,12 +1426,13 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	float4 L;
 
 	if(ray.t != 0.0f)
-		L = kernel_path_integrate(kg, &rng, sample, ray, buffer);
+		L = kernel_path_integrate(kg, &rng, sample, ray, buffer, NULL);
 	else
 		L = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
 	/* accumulate result in output buffer */
 	kernel_write_pass_float4(buffer, sample, L);
+	kernel_write_adaptive_pass(kg, buffer, sample, L);
 
 	path_rng_end(kg, rng_state, rng);
 }
@@ -1447,10 +1465,87 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 
 	/* accumulate result in output buffer */
 	kernel_write_pass_float4(buffer, sample, L);
+	kernel_write_adaptive_pass(kg, buffer, sample, L);
 
 	path_rng_end(kg, rng_state, rng);
 }
 #endif
 
+#ifdef __KERNEL_CPU__
+
+/* Trace camera rays of a block of up to 2x2 pixels as a packet. The first
+ * intersection of coherent rays is found with packet traversal, after which
+ * each path continues on its own, so shadow rays and later bounces are still
+ * traced one ray at a time. Falls back to tracing pixels one by one when the
+ * scene or rays are not suited for packets. */
+
+ccl_device void kernel_path_trace_packet(KernelGlobals *kg,
+	ccl_global float *buffer, ccl_global uint *rng_state,
+	int sample, int x, int y, int w, int h, int offset, int stride)
+{
+	int num_rays = w*h;
+
+	kernel_assert(num_rays <= BVH_PACKET_SIZE);
+
+#ifdef __BRANCHED_PATH__
+	if(kernel_data.integrator.branched) {
+		for(int i = 0; i < num_rays; i++)
+			kernel_branched_path_trace(kg, buffer, rng_state, sample, x + i%w, y + i/w, offset, stride);
+		return;
+	}
+#endif
+
+	if(!bvh_packet_supported(kg)) {
+		for(int i = 0; i < num_rays; i++)
+			kernel_path_trace(kg, buffer, rng_state, sample, x + i%w, y + i/w, offset, stride);
+		return;
+	}
+
+	int pass_stride = kernel_data.film.pass_stride;
+
+	/* initialize random numbers and rays */
+	RNG rng[BVH_PACKET_SIZE];
+	Ray ray[BVH_PACKET_SIZE];
+	Intersection isect[BVH_PACKET_SIZE];
+	uint active = 0;
+
+	for(int i = 0; i < num_rays; i++) {
+		int index = offset + (x + i%w) + (y + i/w)*stride;
+
+		kernel_path_trace_setup(kg, rng_state + index, sample, x + i%w, y + i/w, &rng[i], &ray[i]);
+
+		if(ray[i].t != 0.0f)
+			active |= (1 << i);
+	}
+
+	/* intersect camera rays */
+	bool use_packet = bvh_packet_coherent(ray, num_rays, active);
+
+	if(use_packet) {
+		uint visibility = PATH_RAY_CAMERA | kernel_data.integrator.layer_flag;
+		bvh_intersect_packet(kg, ray, isect, visibility, num_rays, active);
+	}
+
+	/* integrate */
+	for(int i = 0; i < num_rays; i++) {
+		int index = offset + (x + i%w) + (y + i/w)*stride;
+		ccl_global float *pixel_buffer = buffer + index*pass_stride;
+		float4 L;
+
+		if(active & (1 << i))
+			L = kernel_path_integrate(kg, &rng[i], sample, ray[i], pixel_buffer, (use_packet)? &isect[i]: NULL);
+		else
+			L = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		/* accumulate result in output buffer */
+		kernel_write_pass_float4(pixel_buffer, sample, L);
+		kernel_write_adaptive_pass(kg, pixel_buffer, sample, L);
+
+		path_rng_end(kg, rng_state + index, rng[i]);
+	}
+}
+
+#endif
+
 CCL_NAMESPACE_END
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#include "kernel_compat_cpu.h"
+#include "kernel_types.h"
+#include "kernel_globals.h"
+#include "kernel_texture_cache.h"
+#include "kernel_texture_cache_globals.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Threads */
+
+void TextureCache::thread_init(KernelGlobals *kg, TextureCacheGlobals *texture_cache_globals)
+{
+	/* no texture cache used? */
+	if(!texture_cache_globals->ts) {
+		kg->texture_cache = NULL;
+		kg->texture_cache_tdata = NULL;
+		return;
+	}
+
+	TextureCacheThreadData *tdata = new TextureCacheThreadData();
+	tdata->thread_info = texture_cache_globals->ts->get_perthread_info();
+
+	kg->texture_cache = texture_cache_globals;
+	kg->texture_cache_tdata = tdata;
+}
+
+void TextureCache::thread_free(KernelGlobals *kg)
+{
+	if(!kg->texture_cache)
+		return;
+
+	delete kg->texture_cache_tdata;
+
+	kg->texture_cache = NULL;
+	kg->texture_cache_tdata = NULL;
+}
+
+/* Lookup */
+
+bool TextureCache::lookup(KernelGlobals *kg, int id, float s, float t,
+                          float dsdx, float dtdx, float dsdy, float dtdy, float4 *result)
+{
+	TextureCacheGlobals *tcg = kg->texture_cache;
+
+	if(id < 0 || id >= (int)tcg->handles.size() || !tcg->handles[id])
+		return false;
+
+	TextureOpt options;
+	options.nchannels = 4;
+	options.fill = 1.0f;
+	options.swrap = TextureOpt::WrapPeriodic;
+	options.twrap = TextureOpt::WrapPeriodic;
+
+	switch(tcg->interpolation[id]) {
+		case INTERPOLATION_CLOSEST:
+			options.interpmode = TextureOpt::InterpClosest;
+			options.mipmode = TextureOpt::MipModeNoMIP;
+			break;
+		case INTERPOLATION_CUBIC:
+			options.interpmode = TextureOpt::InterpBicubic;
+			break;
+		case INTERPOLATION_SMART:
+			options.interpmode = TextureOpt::InterpSmartBicubic;
+			break;
+		default:
+			options.interpmode = TextureOpt::InterpBilinear;
+			break;
+	}
+
+	/* image rows are stored bottom to top in our texture space, while the
+	 * texture system has t pointing down */
+	float *r = (float*)result;
+	bool status = tcg->ts->texture(tcg->handles[id], kg->texture_cache_tdata->thread_info,
+	                               options, s, 1.0f - t, dsdx, -dtdx, dsdy, -dtdy, r);
+
+	if(!status) {
+		/* same pink as for images that failed to load */
+		r[0] = 1.0f;
+		r[1] = 0.0f;
+		r[2] = 1.0f;
+		r[3] = 1.0f;
+	}
+
+	return true;
+}
+
+CCL_NAMESPACE_END
+
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __KERNEL_TEXTURE_CACHE_H__
+#define __KERNEL_TEXTURE_CACHE_H__
+
+#ifdef __KERNEL_CPU__
+
+/* Texture Cache
+ *
+ * On the CPU, image textures from files can be read through an OpenImageIO
+ * TextureSystem instead of being loaded fully into memory. Tiles and mip
+ * levels are then loaded on demand at lookup time, with the mip level chosen
+ * from the texture coordinate differentials, and the total memory used is
+ * limited by the cache size. The TextureSystem and per slot handles are set
+ * up externally by ImageManager before rendering starts.
+ *
+ * Before/after a thread starts rendering, thread_init/thread_free must be
+ * called, which will store the per thread texture system state in the
+ * thread's kernel globals. */
+
+#include "kernel_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+struct KernelGlobals;
+struct TextureCacheGlobals;
+
+class TextureCache {
+public:
+	/* per thread data */
+	static void thread_init(KernelGlobals *kg, TextureCacheGlobals *texture_cache_globals);
+	static void thread_free(KernelGlobals *kg);
+
+	/* lookup, returns false if the image in this slot is not in the cache */
+	static bool lookup(KernelGlobals *kg, int id, float s, float t,
+	                   float dsdx, float dtdx, float dsdy, float dtdy, float4 *result);
+};
+
+CCL_NAMESPACE_END
+
+#endif
+
+#endif /* __KERNEL_TEXTURE_CACHE_H__ */
+
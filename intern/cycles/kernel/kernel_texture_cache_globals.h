@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __KERNEL_TEXTURE_CACHE_GLOBALS_H__
+#define __KERNEL_TEXTURE_CACHE_GLOBALS_H__
+
+#include <OpenImageIO/texture.h>
+
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+OIIO_NAMESPACE_USING
+
+struct TextureCacheGlobals {
+	TextureCacheGlobals()
+	{
+		ts = NULL;
+	}
+
+	/* texture system, NULL if the texture cache is not used */
+	TextureSystem *ts;
+
+	/* per image slot, NULL for images that are fully loaded into memory */
+	vector<TextureSystem::TextureHandle*> handles;
+	vector<InterpolationType> interpolation;
+};
+
+/* thread specific data */
+struct TextureCacheThreadData {
+	TextureSystem::Perthread *thread_info;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __KERNEL_TEXTURE_CACHE_GLOBALS_H__ */
+
@@ -50,11 +50,17 @@ KERNEL_TEX(uint4, texture_uint4, __attributes_map)
 KERNEL_TEX(float, texture_float, __attributes_float)
 KERNEL_TEX(float4, texture_float4, __attributes_float3)
 
+/* volumes */
+KERNEL_TEX(float4, texture_float4, __volume_majorant_info)
+KERNEL_TEX(float, texture_float, __volume_majorant_grid)
+
 /* lights */
 KERNEL_TEX(float4, texture_float4, __light_distribution)
 KERNEL_TEX(float4, texture_float4, __light_data)
 KERNEL_TEX(float2, texture_float2, __light_background_marginal_cdf)
 KERNEL_TEX(float2, texture_float2, __light_background_conditional_cdf)
+KERNEL_TEX(float4, texture_float4, __light_tree_nodes)
+KERNEL_TEX(uint, texture_uint, __light_tree_leaves)
 
 /* particles */
 KERNEL_TEX(float4, texture_float4, __particles)
@@ -30,6 +30,8 @@ CCL_NAMESPACE_BEGIN
 #define OBJECT_SIZE 		11
 #define OBJECT_VECTOR_SIZE	6
 #define LIGHT_SIZE			4
+#define LIGHT_TREE_NODE_SIZE	4
+#define VOLUME_MAJORANT_SIZE	5
 #define FILTER_TABLE_SIZE	256
 #define RAMP_TABLE_SIZE		256
 #define PARTICLE_SIZE 		5
@@ -53,6 +55,10 @@ CCL_NAMESPACE_BEGIN
 
 #define VOLUME_STACK_SIZE		16
 
+#define ADAPTIVE_BLOCK_SIZE		8
+#define ADAPTIVE_MIN_SAMPLES	16
+#define ADAPTIVE_CHECK_STEP		8
+
 /* device capabilities */
 #ifdef __KERNEL_CPU__
 #define __KERNEL_SHADING__
@@ -65,6 +71,9 @@ CCL_NAMESPACE_BEGIN
 #define __CMJ__
 #define __VOLUME__
 #define __SHADOW_RECORD_ALL__
+#ifdef WITH_CYCLES_RAY_STATS
+#define __RAY_STATS__
+#endif
 #endif
 
 #ifdef __KERNEL_CUDA__
@@ -281,7 +290,8 @@ typedef enum PassType {
 	PASS_MIST = 2097152,
 	PASS_SUBSURFACE_DIRECT = 4194304,
 	PASS_SUBSURFACE_INDIRECT = 8388608,
-	PASS_SUBSURFACE_COLOR = 16777216
+	PASS_SUBSURFACE_COLOR = 16777216,
+	PASS_ADAPTIVE_AUX = 33554432
 } PassType;
 
 #define PASS_ALL (~0)
@@ -786,7 +796,7 @@ typedef struct KernelFilm {
 	int pass_shadow;
 	float pass_shadow_scale;
 	int filter_table_offset;
-	int pass_pad2;
+	int pass_adaptive_aux;
 
 	int pass_mist;
 	float mist_start;
@@ -818,6 +828,12 @@ typedef struct KernelIntegrator {
 	float inv_pdf_lights;
 	int pdf_background_res;
 
+	/* light tree */
+	int use_light_tree;
+	int light_tree_lamp_root;
+	float light_tree_pdf_triangles;
+	float light_tree_pdf_lamps;
+
 	/* bounces */
 	int min_bounce;
 	int max_bounce;
@@ -870,6 +886,8 @@ typedef struct KernelIntegrator {
 	int volume_max_steps;
 	float volume_step_size;
 	int volume_samples;
+	int use_volume_majorant;
+	int pad1, pad2, pad3;
 } KernelIntegrator;
 
 typedef struct KernelBVH {
@@ -104,6 +104,24 @@ ccl_device float kernel_volume_channel_get(float3 value, int channel)
 	return (channel == 0)? value.x: ((channel == 1)? value.y: value.z);
 }
 
+/* russian roulette for majorant tracking. once the throughput falls below
+ * tp_rr the path survives with probability proportional to the throughput,
+ * and is scaled back up to tp_rr so the estimate stays unbiased. returns
+ * false when the path is terminated */
+ccl_device bool kernel_volume_tracking_roulette(PathState *state, float3 *tp, float tp_rr)
+{
+	float tp_max = max(max(tp->x, tp->y), tp->z);
+
+	if(tp_max >= tp_rr)
+		return true;
+
+	if(lcg_step_float(&state->rng_congruential)*tp_rr >= tp_max)
+		return false;
+
+	*tp *= tp_rr/tp_max;
+	return true;
+}
+
 ccl_device bool volume_stack_is_heterogeneous(KernelGlobals *kg, VolumeStack *stack)
 {
 	for(int i = 0; stack[i].shader != SHADER_NONE; i++) {
@@ -116,6 +134,189 @@ ccl_device bool volume_stack_is_heterogeneous(KernelGlobals *kg, VolumeStack *st
 	return false;
 }
 
+/* Volume Majorant Grid
+ *
+ * For a single object volume with a majorant grid, the extinction is bounded
+ * per grid cell by scale*density + bias, with the maximum density in the cell
+ * computed on the host. The ray is split into segments of constant majorant,
+ * through which delta and ratio tracking take tentative collisions, without
+ * evaluating the shader in cells that are empty. Outside the grid bounds the
+ * maximum over the whole grid is used.
+ *
+ * Decoupled ray marching (branched path on the CPU) still records every step
+ * along the ray and does not use the grid. */
+
+typedef struct VolumeMajorantIterator {
+	/* ray in grid cell coordinates */
+	float3 P, D;
+	int res[3];
+	int offset;
+
+	/* distances to the grid bounds, and the end of the ray */
+	float t, t_in, t_out, t_end;
+
+	/* 3D DDA state */
+	int cell[3];
+	int step[3];
+	float t_next[3];
+	float t_delta[3];
+
+	/* extinction bound */
+	float scale, bias;
+	float sigma_outside;
+} VolumeMajorantIterator;
+
+ccl_device bool kernel_volume_majorant_init(KernelGlobals *kg, VolumeStack *stack, Ray *ray, VolumeMajorantIterator *it)
+{
+	if(!kernel_data.integrator.use_volume_majorant)
+		return false;
+
+	/* only for a single object, as the grid bounds that object's shaders */
+	if(stack[0].shader == SHADER_NONE || stack[1].shader != SHADER_NONE)
+		return false;
+
+	int object = stack[0].object;
+
+	if(object == OBJECT_NONE)
+		return false;
+	if(kernel_tex_fetch(__object_flag, object) & SD_OBJECT_MOTION)
+		return false;
+
+	int offset = object*VOLUME_MAJORANT_SIZE;
+	float4 info = kernel_tex_fetch(__volume_majorant_info, offset + 3);
+
+	it->offset = __float_as_int(info.w);
+
+	if(it->offset == -1)
+		return false;
+
+	it->res[0] = __float_as_int(info.x);
+	it->res[1] = __float_as_int(info.y);
+	it->res[2] = __float_as_int(info.z);
+
+	float4 bound = kernel_tex_fetch(__volume_majorant_info, offset + 4);
+
+	it->scale = bound.x;
+	it->bias = bound.y;
+	it->sigma_outside = bound.x*bound.z + bound.y;
+
+	/* transform ray into grid */
+	Transform tfm;
+
+	tfm.x = kernel_tex_fetch(__volume_majorant_info, offset + 0);
+	tfm.y = kernel_tex_fetch(__volume_majorant_info, offset + 1);
+	tfm.z = kernel_tex_fetch(__volume_majorant_info, offset + 2);
+	tfm.w = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	it->P = transform_point(&tfm, ray->P);
+	it->D = transform_direction(&tfm, ray->D);
+	it->t = 0.0f;
+	it->t_end = ray->t;
+
+	/* intersect with grid bounds */
+	float P[3] = {it->P.x, it->P.y, it->P.z};
+	float D[3] = {it->D.x, it->D.y, it->D.z};
+	float t_in = 0.0f, t_out = ray->t;
+
+	for(int i = 0; i < 3; i++) {
+		if(D[i] != 0.0f) {
+			float inv_D = 1.0f/D[i];
+			float t0 = -P[i]*inv_D;
+			float t1 = ((float)it->res[i] - P[i])*inv_D;
+
+			t_in = max(t_in, min(t0, t1));
+			t_out = min(t_out, max(t0, t1));
+		}
+		else if(P[i] < 0.0f || P[i] > (float)it->res[i])
+			t_out = -1.0f;
+	}
+
+	if(t_in >= t_out) {
+		/* ray does not pass through the grid */
+		it->t_in = ray->t;
+		it->t_out = ray->t;
+		return true;
+	}
+
+	it->t_in = t_in;
+	it->t_out = t_out;
+
+	/* set up stepping from the cell where the ray enters */
+	for(int i = 0; i < 3; i++) {
+		float p = P[i] + D[i]*t_in;
+
+		it->cell[i] = clamp((int)floorf(p), 0, it->res[i] - 1);
+
+		if(D[i] > 0.0f) {
+			it->step[i] = 1;
+			it->t_next[i] = ((float)(it->cell[i] + 1) - P[i])/D[i];
+			it->t_delta[i] = 1.0f/D[i];
+		}
+		else if(D[i] < 0.0f) {
+			it->step[i] = -1;
+			it->t_next[i] = ((float)it->cell[i] - P[i])/D[i];
+			it->t_delta[i] = -1.0f/D[i];
+		}
+		else {
+			it->step[i] = 0;
+			it->t_next[i] = FLT_MAX;
+			it->t_delta[i] = FLT_MAX;
+		}
+	}
+
+	return true;
+}
+
+/* get the next segment [t0, t1] of the ray with constant majorant, returns
+ * false at the end of the ray */
+ccl_device bool kernel_volume_majorant_next(KernelGlobals *kg, VolumeMajorantIterator *it, float *t0, float *t1, float *sigma_maj)
+{
+	if(it->t >= it->t_end)
+		return false;
+
+	*t0 = it->t;
+
+	if(it->t >= it->t_in && it->t < it->t_out) {
+		/* stop stepping when leaving the grid earlier due to precision */
+		if(it->cell[0] < 0 || it->cell[0] >= it->res[0] ||
+		   it->cell[1] < 0 || it->cell[1] >= it->res[1] ||
+		   it->cell[2] < 0 || it->cell[2] >= it->res[2])
+		{
+			it->t_out = it->t;
+		}
+	}
+
+	if(it->t < it->t_in) {
+		/* before the grid */
+		*t1 = it->t_in;
+		*sigma_maj = it->sigma_outside;
+	}
+	else if(it->t < it->t_out) {
+		/* inside the grid, step to the next cell */
+		int index = it->offset + it->cell[0] + it->res[0]*(it->cell[1] + it->res[1]*it->cell[2]);
+		float density = kernel_tex_fetch(__volume_majorant_grid, index);
+
+		int axis = (it->t_next[0] < it->t_next[1])?
+			((it->t_next[0] < it->t_next[2])? 0: 2):
+			((it->t_next[1] < it->t_next[2])? 1: 2);
+
+		*t1 = min(max(it->t_next[axis], it->t), it->t_out);
+		*sigma_maj = it->scale*density + it->bias;
+
+		it->cell[axis] += it->step[axis];
+		it->t_next[axis] += it->t_delta[axis];
+	}
+	else {
+		/* after the grid */
+		*t1 = it->t_end;
+		*sigma_maj = it->sigma_outside;
+	}
+
+	it->t = *t1;
+
+	return true;
+}
+
 /* Volume Shadows
  *
  * These functions are used to attenuate shadow rays to lights. Both absorption
@@ -179,6 +380,62 @@ ccl_device void kernel_volume_shadow_heterogeneous(KernelGlobals *kg, PathState
 	*throughput = tp;
 }
 
+/* heterogeneous volume with majorant grid: ratio tracking, taking tentative
+ * collisions at the majorant rate and attenuating by the fraction of real
+ * extinction at each of them. unbiased, and no shader evaluations in empty
+ * space. when running out of steps, the rest of the ray is ray marched as
+ * without a majorant grid, instead of skipping it */
+ccl_device void kernel_volume_shadow_majorant(KernelGlobals *kg, PathState *state, Ray *ray, ShaderData *sd, float3 *throughput, VolumeMajorantIterator *it)
+{
+	float3 tp = *throughput;
+	const float tp_rr = 0.1f*max(max(tp.x, tp.y), tp.z);
+	int max_steps = kernel_data.integrator.volume_max_steps;
+	int steps = 0;
+	float t0, t1, sigma_maj;
+
+	while(kernel_volume_majorant_next(kg, it, &t0, &t1, &sigma_maj)) {
+		/* skip empty space */
+		if(sigma_maj <= 0.0f)
+			continue;
+
+		float inv_sigma_maj = 1.0f/sigma_maj;
+		float t = t0;
+
+		for(;;) {
+			/* tentative collision, restarting at segment boundaries is fine
+			 * because the exponential distribution is memoryless */
+			t -= logf(1.0f - lcg_step_float(&state->rng_congruential))*inv_sigma_maj;
+
+			if(t >= t1)
+				break;
+
+			float3 sigma_t;
+
+			if(volume_shader_extinction_sample(kg, sd, state, ray->P + ray->D*t, &sigma_t)) {
+				tp *= max(make_float3(1.0f, 1.0f, 1.0f) - sigma_t*inv_sigma_maj, make_float3(0.0f, 0.0f, 0.0f));
+
+				/* stop if light is blocked, randomly when mostly blocked */
+				if(!kernel_volume_tracking_roulette(state, &tp, tp_rr)) {
+					*throughput = make_float3(0.0f, 0.0f, 0.0f);
+					return;
+				}
+			}
+
+			if(++steps >= max_steps) {
+				Ray rest_ray = *ray;
+				rest_ray.P = ray->P + ray->D*t;
+				rest_ray.t = ray->t - t;
+
+				kernel_volume_shadow_heterogeneous(kg, state, &rest_ray, sd, &tp);
+				*throughput = tp;
+				return;
+			}
+		}
+	}
+
+	*throughput = tp;
+}
+
 /* get the volume attenuation over line segment defined by ray, with the
  * assumption that there are no surfaces blocking light between the endpoints */
 ccl_device_noinline void kernel_volume_shadow(KernelGlobals *kg, PathState *state, Ray *ray, float3 *throughput)
@@ -186,8 +443,14 @@ ccl_device_noinline void kernel_volume_shadow(KernelGlobals *kg, PathState *stat
 	ShaderData sd;
 	shader_setup_from_volume(kg, &sd, ray, state->bounce, state->transparent_bounce);
 
-	if(volume_stack_is_heterogeneous(kg, state->volume_stack))
-		kernel_volume_shadow_heterogeneous(kg, state, ray, &sd, throughput);
+	if(volume_stack_is_heterogeneous(kg, state->volume_stack)) {
+		VolumeMajorantIterator it;
+
+		if(kernel_volume_majorant_init(kg, state->volume_stack, ray, &it))
+			kernel_volume_shadow_majorant(kg, state, ray, &sd, throughput, &it);
+		else
+			kernel_volume_shadow_heterogeneous(kg, state, ray, &sd, throughput);
+	}
 	else
 		kernel_volume_shadow_homogeneous(kg, state, ray, &sd, throughput);
 }
@@ -414,7 +677,7 @@ ccl_device VolumeIntegrateResult kernel_volume_integrate_heterogeneous(KernelGlo
 	PathState *state, Ray *ray, ShaderData *sd, PathRadiance *L, float3 *throughput, RNG *rng)
 {
 	float3 tp = *throughput;
-	const float tp_eps = 1e-10f; /* todo: this is likely not the right value */
+	const float tp_eps = 1e-10f;
 
 	/* prepare for stepping */
 	int max_steps = kernel_data.integrator.volume_max_steps;
@@ -545,6 +808,103 @@ ccl_device VolumeIntegrateResult kernel_volume_integrate_heterogeneous(KernelGlo
 	return VOLUME_PATH_ATTENUATED;
 }
 
+/* heterogeneous volume with majorant grid: delta tracking with tentative
+ * collisions at the majorant rate. at each collision we either scatter or
+ * continue through a null collision, picked proportional to the scattering
+ * and null coefficients weighted by throughput, with absorption applied to
+ * the throughput. emission is picked up at every collision. this is unbiased
+ * and does not need to evaluate the shader in empty space. when running out
+ * of steps, the rest of the ray is ray marched as without a majorant grid,
+ * instead of skipping it */
+ccl_device VolumeIntegrateResult kernel_volume_integrate_majorant(KernelGlobals *kg,
+	PathState *state, Ray *ray, ShaderData *sd, PathRadiance *L, float3 *throughput,
+	RNG *rng, VolumeMajorantIterator *it)
+{
+	float3 tp = *throughput;
+	const float tp_rr = 0.1f*max(max(tp.x, tp.y), tp.z);
+	int max_steps = kernel_data.integrator.volume_max_steps;
+	int steps = 0;
+	float t0, t1, sigma_maj;
+
+	/* first distance uses the path random numbers for stratification */
+	float xi = path_state_rng_1D(kg, rng, state, PRNG_SCATTER_DISTANCE);
+	sd->randb_closure = path_state_rng_1D(kg, rng, state, PRNG_PHASE);
+
+	while(kernel_volume_majorant_next(kg, it, &t0, &t1, &sigma_maj)) {
+		/* skip empty space */
+		if(sigma_maj <= 0.0f)
+			continue;
+
+		float inv_sigma_maj = 1.0f/sigma_maj;
+		float t = t0;
+
+		for(;;) {
+			t -= logf(1.0f - xi)*inv_sigma_maj;
+			xi = lcg_step_float(&state->rng_congruential);
+
+			if(t >= t1)
+				break;
+
+			float3 P = ray->P + ray->D*t;
+			VolumeShaderCoefficients coeff;
+
+			if(volume_shader_sample(kg, sd, state, P, &coeff)) {
+				int closure_flag = sd->flag;
+
+				/* emission, with the collision density as pdf */
+				if(closure_flag & SD_EMISSION)
+					path_radiance_accum_emission(L, tp, coeff.emission*inv_sigma_maj, state->bounce);
+
+				if(closure_flag & (SD_ABSORPTION|SD_SCATTER)) {
+					float3 sigma_t = coeff.sigma_a + coeff.sigma_s;
+					float3 sigma_n = max(make_float3(sigma_maj, sigma_maj, sigma_maj) - sigma_t, make_float3(0.0f, 0.0f, 0.0f));
+
+					float p_scatter = average(tp*coeff.sigma_s);
+					float p_null = average(tp*sigma_n);
+
+					if(p_scatter + p_null <= 0.0f) {
+						/* fully absorbed */
+						*throughput = make_float3(0.0f, 0.0f, 0.0f);
+						return VOLUME_PATH_ATTENUATED;
+					}
+
+					p_scatter /= p_scatter + p_null;
+
+					if(lcg_step_float(&state->rng_congruential) < p_scatter) {
+						/* real collision, scatter at this point */
+						*throughput = tp * coeff.sigma_s * (inv_sigma_maj/p_scatter);
+						sd->P = P;
+
+						return VOLUME_PATH_SCATTERED;
+					}
+
+					/* null collision */
+					tp *= sigma_n * (inv_sigma_maj/(1.0f - p_scatter));
+
+					/* stop if light is blocked, randomly when mostly blocked */
+					if(!kernel_volume_tracking_roulette(state, &tp, tp_rr)) {
+						*throughput = make_float3(0.0f, 0.0f, 0.0f);
+						return VOLUME_PATH_ATTENUATED;
+					}
+				}
+			}
+
+			if(++steps >= max_steps) {
+				Ray rest_ray = *ray;
+				rest_ray.P = P;
+				rest_ray.t = ray->t - t;
+
+				*throughput = tp;
+				return kernel_volume_integrate_heterogeneous(kg, state, &rest_ray, sd, L, throughput, rng);
+			}
+		}
+	}
+
+	*throughput = tp;
+
+	return VOLUME_PATH_ATTENUATED;
+}
+
 /* Decoupled Volume Sampling
  *
  * VolumeSegment is list of coefficients and transmittance stored at all steps
@@ -839,8 +1199,14 @@ ccl_device_noinline VolumeIntegrateResult kernel_volume_integrate(KernelGlobals
 #else
 	shader_setup_from_volume(kg, sd, ray, state->bounce, state->transparent_bounce);
 
-	if(heterogeneous)
+	if(heterogeneous) {
+		VolumeMajorantIterator it;
+
+		if(kernel_volume_majorant_init(kg, state->volume_stack, ray, &it))
+			return kernel_volume_integrate_majorant(kg, state, ray, sd, L, throughput, &tmp_rng, &it);
+
 		return kernel_volume_integrate_heterogeneous(kg, state, ray, sd, L, throughput, &tmp_rng);
+	}
 	else
 		return kernel_volume_integrate_homogeneous(kg, state, ray, sd, L, throughput, &tmp_rng);
 #endif
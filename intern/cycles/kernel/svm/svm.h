@@ -164,8 +164,11 @@ CCL_NAMESPACE_END
 #include "svm_mapping.h"
 #include "svm_normal.h"
 #include "svm_wave.h"
+#include "svm_math_util.h"
 #include "svm_math.h"
+#include "svm_color_util.h"
 #include "svm_mix.h"
+#include "svm_ramp_util.h"
 #include "svm_ramp.h"
 #include "svm_sepcomb_rgb.h"
 #include "svm_sepcomb_hsv.h"
@@ -48,7 +48,7 @@ ccl_device_inline float svm_image_texture_frac(float x, int *ix)
 	return x - (float)i;
 }
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, differential ds, differential dt, uint srgb, uint use_alpha)
 {
 	/* first slots are used by float textures, which are not supported here */
 	if(id < TEX_NUM_FLOAT_IMAGES)
@@ -130,16 +130,19 @@ ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y,
 
 #else
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, differential ds, differential dt, uint srgb, uint use_alpha)
 {
 #ifdef __KERNEL_CPU__
 #ifdef __KERNEL_SSE2__
 	__m128 r_m128;
 	float4 &r = (float4 &)r_m128;
-	r = kernel_tex_image_interp(id, x, y);
 #else
-	float4 r = kernel_tex_image_interp(id, x, y);
+	float4 r;
 #endif
+
+	/* images read through the texture cache, differentials select the mip level */
+	if(!(kg->texture_cache && TextureCache::lookup(kg, id, x, y, ds.dx, dt.dx, ds.dy, dt.dy, &r)))
+		r = kernel_tex_image_interp(id, x, y);
 #else
 	float4 r;
 
@@ -308,7 +311,29 @@ ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *sta
 
 	float3 co = stack_load_float3(stack, co_offset);
 	uint use_alpha = stack_valid(alpha_offset);
-	float4 f = svm_image_texture(kg, id, co.x, co.y, srgb, use_alpha);
+	differential ds = differential_zero();
+	differential dt = differential_zero();
+
+#ifdef __KERNEL_CPU__
+	/* texture coordinate differentials, available when the coordinate is an
+	 * unmapped UV attribute, only needed for the texture cache */
+	if(kg->texture_cache && node.w != ATTR_STD_NONE) {
+		AttributeElement elem;
+		int offset = find_attribute(kg, sd, node.w, &elem);
+
+		if(offset != ATTR_STD_NOT_FOUND) {
+			float3 dx, dy;
+			primitive_attribute_float3(kg, sd, elem, offset, &dx, &dy);
+
+			ds.dx = dx.x;
+			ds.dy = dy.x;
+			dt.dx = dx.y;
+			dt.dy = dy.y;
+		}
+	}
+#endif
+
+	float4 f = svm_image_texture(kg, id, co.x, co.y, ds, dt, srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -392,11 +417,11 @@ ccl_device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float
 	uint use_alpha = stack_valid(alpha_offset);
 
 	if(weight.x > 0.0f)
-		f += weight.x*svm_image_texture(kg, id, co.y, co.z, srgb, use_alpha);
+		f += weight.x*svm_image_texture(kg, id, co.y, co.z, differential_zero(), differential_zero(), srgb, use_alpha);
 	if(weight.y > 0.0f)
-		f += weight.y*svm_image_texture(kg, id, co.x, co.z, srgb, use_alpha);
+		f += weight.y*svm_image_texture(kg, id, co.x, co.z, differential_zero(), differential_zero(), srgb, use_alpha);
 	if(weight.z > 0.0f)
-		f += weight.z*svm_image_texture(kg, id, co.y, co.x, srgb, use_alpha);
+		f += weight.z*svm_image_texture(kg, id, co.y, co.x, differential_zero(), differential_zero(), srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -424,7 +449,7 @@ ccl_device void svm_node_tex_environment(KernelGlobals *kg, ShaderData *sd, floa
 		uv = direction_to_mirrorball(co);
 
 	uint use_alpha = stack_valid(alpha_offset);
-	float4 f = svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+	float4 f = svm_image_texture(kg, id, uv.x, uv.y, differential_zero(), differential_zero(), srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
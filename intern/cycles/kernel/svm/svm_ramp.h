@@ -21,12 +21,8 @@ CCL_NAMESPACE_BEGIN
 
 ccl_device float4 rgb_ramp_lookup(KernelGlobals *kg, int offset, float f, bool interpolate)
 {
-	f = clamp(f, 0.0f, 1.0f)*(RAMP_TABLE_SIZE-1);
-
-	/* clamp int as well in case of NaN */
-	int i = clamp(float_to_int(f), 0, RAMP_TABLE_SIZE-1);
-	float t = f - (float)i;
-
+	float t;
+	int i = rgb_ramp_table_index(f, &t);
 	float4 a = fetch_node_float(kg, offset+i);
 
 	if(interpolate && t > 0.0f)
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __SVM_RAMP_UTIL_H__
+#define __SVM_RAMP_UTIL_H__
+
+CCL_NAMESPACE_BEGIN
+
+/* Ramp table lookup, shared with the shader graph for constant folding on the
+ * host. The kernel reads the table from the SVM nodes, see rgb_ramp_lookup. */
+
+ccl_device_inline int rgb_ramp_table_index(float f, float *t)
+{
+	f = clamp(f, 0.0f, 1.0f)*(RAMP_TABLE_SIZE-1);
+
+	/* clamp int as well in case of NaN */
+	int i = clamp(float_to_int(f), 0, RAMP_TABLE_SIZE-1);
+	*t = f - (float)i;
+
+	return i;
+}
+
+ccl_device_inline float4 rgb_ramp_lookup_table(const float4 *ramp, float f, bool interpolate)
+{
+	float t;
+	int i = rgb_ramp_table_index(f, &t);
+	float4 a = ramp[i];
+
+	if(interpolate && t > 0.0f)
+		a = (1.0f - t)*a + t*ramp[i+1];
+
+	return a;
+}
+
+CCL_NAMESPACE_END
+
+#endif /* __SVM_RAMP_UTIL_H__ */
+
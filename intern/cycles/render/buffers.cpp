@@ -72,6 +72,20 @@ int BufferParams::get_passes_size()
 	return align_up(size, 4);
 }
 
+int BufferParams::get_pass_offset(PassType type)
+{
+	int offset = 0;
+
+	foreach(Pass& pass, passes) {
+		if(pass.type == type)
+			return offset;
+
+		offset += pass.components;
+	}
+
+	return -1;
+}
+
 /* Render Buffer Task */
 
 RenderTile::RenderTile()
@@ -93,6 +107,8 @@ RenderTile::RenderTile()
 	rng_state = 0;
 
 	buffers = NULL;
+
+	start_time = 0.0;
 }
 
 /* Render Buffers */
@@ -156,6 +172,36 @@ bool RenderBuffers::copy_from_device()
 	return true;
 }
 
+bool RenderBuffers::copy_to_device()
+{
+	if(!buffer.device_pointer)
+		return false;
+
+	device->mem_copy_to(buffer);
+
+	return true;
+}
+
+bool RenderBuffers::copy_rng_state_from_device()
+{
+	if(!rng_state.device_pointer)
+		return false;
+
+	device->mem_copy_from(rng_state, 0, params.width, params.height, sizeof(uint));
+
+	return true;
+}
+
+bool RenderBuffers::copy_rng_state_to_device()
+{
+	if(!rng_state.device_pointer)
+		return false;
+
+	device->mem_copy_to(rng_state);
+
+	return true;
+}
+
 bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels)
 {
 	int pass_offset = 0;
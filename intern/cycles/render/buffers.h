@@ -59,6 +59,7 @@ public:
 	bool modified(const BufferParams& params);
 	void add_pass(PassType type);
 	int get_passes_size();
+	int get_pass_offset(PassType type);
 };
 
 /* Render Buffers */
@@ -79,6 +80,9 @@ public:
 	void reset(Device *device, BufferParams& params);
 
 	bool copy_from_device();
+	bool copy_to_device();
+	bool copy_rng_state_from_device();
+	bool copy_rng_state_to_device();
 	bool get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels);
 
 protected:
@@ -144,6 +148,9 @@ public:
 
 	RenderBuffers *buffers;
 
+	/* time the tile was handed out, for tile timing statistics */
+	double start_time;
+
 	RenderTile();
 };
 
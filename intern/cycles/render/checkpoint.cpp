@@ -0,0 +1,491 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "buffers.h"
+#include "checkpoint.h"
+#include "scene.h"
+
+#include "util_foreach.h"
+#include "util_md5.h"
+#include "util_path.h"
+#include "util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* File layout: header, then a record for each tile with the layer name, scene
+ * fingerprint, dimensions, sample count and frame followed by the render
+ * buffer and random number state. Finished tiles are appended, and a later
+ * record for a tile replaces the earlier ones. Data is stored in native byte
+ * order, checkpoints are meant to be resumed on the same kind of machine. */
+
+static const char CHECKPOINT_MAGIC[8] = {'C', 'Y', 'C', 'L', 'C', 'K', 'P', 'T'};
+static const uint CHECKPOINT_VERSION = 3;
+
+static bool checkpoint_write(FILE *f, const void *data, size_t size)
+{
+	return (size == 0 || fwrite(data, size, 1, f) == 1);
+}
+
+static bool checkpoint_read(FILE *f, void *data, size_t size)
+{
+	return (size == 0 || fread(data, size, 1, f) == 1);
+}
+
+/* checkpoints of large renders exceed 2GB */
+static bool checkpoint_seek(FILE *f, int64_t offset, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(f, offset, origin) == 0;
+#else
+	return fseeko(f, (off_t)offset, origin) == 0;
+#endif
+}
+
+static int64_t checkpoint_tell(FILE *f)
+{
+#ifdef _WIN32
+	return _ftelli64(f);
+#else
+	return (int64_t)ftello(f);
+#endif
+}
+
+static bool checkpoint_write_string(FILE *f, const string& str)
+{
+	uint size = str.size();
+
+	return checkpoint_write(f, &size, sizeof(size)) &&
+	       checkpoint_write(f, str.data(), size);
+}
+
+static bool checkpoint_read_string(FILE *f, string& str)
+{
+	uint size;
+
+	if(!checkpoint_read(f, &size, sizeof(size)) || size >= 4096)
+		return false;
+
+	vector<char> data(size + 1, '\0');
+
+	if(!checkpoint_read(f, &data[0], size))
+		return false;
+
+	str = &data[0];
+	return true;
+}
+
+static bool checkpoint_write_header(FILE *f)
+{
+	return checkpoint_write(f, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) &&
+	       checkpoint_write(f, &CHECKPOINT_VERSION, sizeof(CHECKPOINT_VERSION));
+}
+
+template<typename T> static void checkpoint_hash(MD5Hash& md5, device_vector<T>& vec)
+{
+	size_t size = vec.memory_size();
+	uint8_t *data = (uint8_t*)vec.data_pointer;
+
+	md5.append((uint8_t*)&size, sizeof(size));
+
+	/* append takes an int size */
+	while(data && size > 0) {
+		int chunk = (size > (size_t)(1 << 30))? (1 << 30): (int)size;
+		md5.append(data, chunk);
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+Checkpoint::Checkpoint(const string& filepath_, double interval_)
+: filepath(filepath_), interval(interval_)
+{
+	frame = 0;
+	file = NULL;
+	file_error = false;
+	modified = false;
+	last_write_time = time_dt();
+}
+
+Checkpoint::~Checkpoint()
+{
+	if(file)
+		fclose(file);
+}
+
+string Checkpoint::tile_key(const string& layer, int x, int y, int w, int h)
+{
+	return layer + string_printf("\n%d %d %d %d", x, y, w, h);
+}
+
+bool Checkpoint::read_tile(FILE *f, int64_t file_size, Tile& tile)
+{
+	int header[7];
+
+	if(!checkpoint_read_string(f, tile.layer) ||
+	   !checkpoint_read_string(f, tile.fingerprint) ||
+	   !checkpoint_read(f, header, sizeof(header)))
+		return false;
+
+	if(header[2] <= 0 || header[3] <= 0 || header[4] <= 0 || header[5] <= 0)
+		return false;
+
+	tile.x = header[0];
+	tile.y = header[1];
+	tile.w = header[2];
+	tile.h = header[3];
+	tile.pass_stride = header[4];
+	tile.num_samples = header[5];
+	tile.frame = header[6];
+	tile.offset = checkpoint_tell(f);
+
+	/* skip the data, a record cut off by stopping the render while it was
+	 * written ends the file */
+	int64_t num_pixels = (int64_t)tile.w*tile.h;
+	int64_t size = num_pixels*tile.pass_stride*sizeof(float) + num_pixels*sizeof(uint);
+
+	if(tile.offset < 0 || tile.offset + size > file_size)
+		return false;
+
+	return checkpoint_seek(f, tile.offset + size, SEEK_SET);
+}
+
+bool Checkpoint::write_tile(FILE *f, Tile& tile, const float *buffer, const uint *rng_state)
+{
+	int header[7] = {tile.x, tile.y, tile.w, tile.h, tile.pass_stride, tile.num_samples, tile.frame};
+	size_t num_pixels = (size_t)tile.w*tile.h;
+
+	if(!checkpoint_write_string(f, tile.layer) ||
+	   !checkpoint_write_string(f, tile.fingerprint) ||
+	   !checkpoint_write(f, header, sizeof(header)))
+		return false;
+
+	tile.offset = checkpoint_tell(f);
+
+	return tile.offset >= 0 &&
+	       checkpoint_write(f, buffer, sizeof(float)*num_pixels*tile.pass_stride) &&
+	       checkpoint_write(f, rng_state, sizeof(uint)*num_pixels);
+}
+
+bool Checkpoint::compact_file(FILE *f)
+{
+	/* write only the last record of each tile to a temporary file first, so
+	 * stopping the render while writing never leaves a broken checkpoint */
+	string tmp_filepath = filepath + ".tmp";
+	FILE *tmp = path_fopen(tmp_filepath, "wb");
+
+	if(!tmp)
+		return false;
+
+	vector<float> buffer;
+	vector<uint> rng_state;
+	bool ok = checkpoint_write_header(tmp);
+
+	for(TileMap::iterator it = tiles.begin(); ok && it != tiles.end(); it++) {
+		Tile& tile = it->second;
+		size_t num_pixels = (size_t)tile.w*tile.h;
+
+		buffer.resize(num_pixels*tile.pass_stride);
+		rng_state.resize(num_pixels);
+
+		ok = checkpoint_seek(f, tile.offset, SEEK_SET) &&
+		     checkpoint_read(f, &buffer[0], sizeof(float)*buffer.size()) &&
+		     checkpoint_read(f, &rng_state[0], sizeof(uint)*rng_state.size()) &&
+		     write_tile(tmp, tile, &buffer[0], &rng_state[0]);
+	}
+
+	if(fclose(tmp) != 0)
+		ok = false;
+
+	return ok && path_rename(tmp_filepath, filepath);
+}
+
+bool Checkpoint::read()
+{
+	thread_scoped_lock lock(mutex);
+
+	if(file) {
+		fclose(file);
+		file = NULL;
+	}
+
+	tiles.clear();
+	file_error = false;
+
+	if(!path_exists(filepath))
+		return false;
+
+	FILE *f = path_fopen(filepath, "rb");
+
+	if(!f) {
+		fprintf(stderr, "Failed to open checkpoint %s for reading.\n", filepath.c_str());
+		return false;
+	}
+
+	int64_t file_size = -1;
+
+	if(checkpoint_seek(f, 0, SEEK_END)) {
+		file_size = checkpoint_tell(f);
+		checkpoint_seek(f, 0, SEEK_SET);
+	}
+
+	char magic[8];
+	uint version;
+	bool ok = file_size >= 0 &&
+	          checkpoint_read(f, magic, sizeof(magic)) &&
+	          memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0 &&
+	          checkpoint_read(f, &version, sizeof(version)) &&
+	          version == CHECKPOINT_VERSION;
+
+	if(!ok) {
+		fclose(f);
+		fprintf(stderr, "Invalid checkpoint %s, rendering from the start.\n", filepath.c_str());
+		return false;
+	}
+
+	/* index the tiles, keeping only the position of their data */
+	int64_t end = checkpoint_tell(f);
+	size_t num_records = 0;
+
+	while(end < file_size) {
+		Tile tile;
+
+		if(!read_tile(f, file_size, tile))
+			break;
+
+		tiles[tile_key(tile.layer, tile.x, tile.y, tile.w, tile.h)] = tile;
+		num_records++;
+		end = checkpoint_tell(f);
+	}
+
+	/* drop replaced records and a record that was cut off, so the file does
+	 * not keep growing when resuming repeatedly */
+	if(end != file_size || num_records != tiles.size()) {
+		if(!compact_file(f)) {
+			fprintf(stderr, "Failed to write checkpoint %s, rendering from the start.\n", filepath.c_str());
+			tiles.clear();
+		}
+	}
+
+	fclose(f);
+
+	return open_file();
+}
+
+bool Checkpoint::open_file()
+{
+	/* the mutex must be locked by the caller */
+	if(file)
+		return true;
+	if(file_error)
+		return false;
+
+	if(tiles.empty()) {
+		path_create_directories(filepath);
+		file = path_fopen(filepath, "w+b");
+
+		if(file && !checkpoint_write_header(file)) {
+			fclose(file);
+			file = NULL;
+		}
+	}
+	else
+		file = path_fopen(filepath, "r+b");
+
+	if(!file) {
+		fprintf(stderr, "Failed to open checkpoint %s for writing.\n", filepath.c_str());
+		file_error = true;
+		tiles.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool Checkpoint::write()
+{
+	thread_scoped_lock lock(mutex);
+
+	modified = false;
+	last_write_time = time_dt();
+
+	return file && fflush(file) == 0;
+}
+
+void Checkpoint::update()
+{
+	thread_scoped_lock lock(mutex);
+
+	if(file && modified && time_dt() - last_write_time >= interval) {
+		modified = false;
+		last_write_time = time_dt();
+
+		fflush(file);
+	}
+}
+
+void Checkpoint::set_layer(const string& layer_, int frame_)
+{
+	thread_scoped_lock lock(mutex);
+
+	layer = layer_;
+	frame = frame_;
+}
+
+void Checkpoint::set_scene(Scene *scene)
+{
+	/* everything that affects the render result ends up in the kernel data
+	 * and device arrays, including the seed and resolution. image contents
+	 * are not included, image sequences are covered by the frame number */
+	DeviceScene& dscene = scene->dscene;
+	KernelData data = dscene.data;
+	MD5Hash md5;
+
+	/* tiles can be extended with more samples, except with correlated multi
+	 * jitter where the pattern depends on the total number of samples */
+	if(data.integrator.sampling_pattern != SAMPLING_PATTERN_CMJ)
+		data.integrator.aa_samples = 0;
+
+	md5.append((uint8_t*)&data, sizeof(data));
+
+	checkpoint_hash(md5, dscene.tri_verts);
+	checkpoint_hash(md5, dscene.tri_vindex);
+	checkpoint_hash(md5, dscene.curves);
+	checkpoint_hash(md5, dscene.curve_keys);
+	checkpoint_hash(md5, dscene.objects);
+	checkpoint_hash(md5, dscene.objects_vector);
+	checkpoint_hash(md5, dscene.attributes_map);
+	checkpoint_hash(md5, dscene.attributes_float);
+	checkpoint_hash(md5, dscene.attributes_float3);
+	checkpoint_hash(md5, dscene.light_data);
+	checkpoint_hash(md5, dscene.particles);
+	checkpoint_hash(md5, dscene.svm_nodes);
+	checkpoint_hash(md5, dscene.shader_flag);
+	checkpoint_hash(md5, dscene.object_flag);
+
+	string hex = md5.get_hex();
+
+	thread_scoped_lock lock(mutex);
+
+	fingerprint = hex;
+}
+
+void Checkpoint::add_tile(RenderBuffers *buffers, int num_samples)
+{
+	if(num_samples <= 0)
+		return;
+
+	BufferParams& params = buffers->params;
+
+	if(!buffers->copy_from_device() || !buffers->copy_rng_state_from_device())
+		return;
+
+	Tile tile;
+
+	tile.layer = layer;
+	tile.x = params.full_x;
+	tile.y = params.full_y;
+	tile.w = params.width;
+	tile.h = params.height;
+	tile.pass_stride = params.get_passes_size();
+	tile.num_samples = num_samples;
+	tile.offset = 0;
+
+	thread_scoped_lock lock(mutex);
+
+	tile.frame = frame;
+	tile.fingerprint = fingerprint;
+
+	/* a tile restored without rendering more samples is in the file already */
+	string key = tile_key(tile.layer, tile.x, tile.y, tile.w, tile.h);
+	TileMap::iterator it = tiles.find(key);
+
+	if(it != tiles.end() && it->second.frame == tile.frame &&
+	   it->second.fingerprint == tile.fingerprint &&
+	   it->second.pass_stride == tile.pass_stride &&
+	   it->second.num_samples == tile.num_samples)
+		return;
+
+	if(!open_file())
+		return;
+
+	/* only this tile is written while locked, a record cut off by a failed
+	 * write is dropped when the file is read again */
+	if(!checkpoint_seek(file, 0, SEEK_END) ||
+	   !write_tile(file, tile, (float*)buffers->buffer.data_pointer, (uint*)buffers->rng_state.data_pointer))
+	{
+		fprintf(stderr, "Failed to write checkpoint %s.\n", filepath.c_str());
+		fclose(file);
+		file = NULL;
+		file_error = true;
+		return;
+	}
+
+	tiles[key] = tile;
+	modified = true;
+}
+
+int Checkpoint::restore_tile(RenderBuffers *buffers, int max_samples)
+{
+	BufferParams& params = buffers->params;
+	int pass_stride = params.get_passes_size();
+	size_t num_pixels = (size_t)params.width*params.height;
+
+	thread_scoped_lock lock(mutex);
+
+	TileMap::iterator it = tiles.find(tile_key(layer, params.full_x, params.full_y, params.width, params.height));
+
+	if(it == tiles.end() || !file)
+		return 0;
+
+	/* frame, scene and passes must match, and the image can't be rendered
+	 * with fewer samples than it already has */
+	const Tile& tile = it->second;
+
+	if(tile.frame != frame || tile.fingerprint != fingerprint || fingerprint.empty() ||
+	   tile.pass_stride != pass_stride || tile.num_samples > max_samples)
+		return 0;
+
+	/* the random number state is only replaced once both were read */
+	float *buffer = (float*)buffers->buffer.data_pointer;
+	vector<uint> rng_state(num_pixels);
+
+	if(!checkpoint_seek(file, tile.offset, SEEK_SET) ||
+	   !checkpoint_read(file, buffer, sizeof(float)*num_pixels*pass_stride) ||
+	   !checkpoint_read(file, &rng_state[0], sizeof(uint)*num_pixels))
+	{
+		fprintf(stderr, "Failed to read checkpoint %s.\n", filepath.c_str());
+		memset(buffer, 0, sizeof(float)*num_pixels*pass_stride);
+		tiles.erase(it);
+		return 0;
+	}
+
+	memcpy((uint*)buffers->rng_state.data_pointer, &rng_state[0], sizeof(uint)*num_pixels);
+
+	int num_samples = tile.num_samples;
+
+	lock.unlock();
+
+	buffers->copy_to_device();
+	buffers->copy_rng_state_to_device();
+
+	return num_samples;
+}
+
+CCL_NAMESPACE_END
+
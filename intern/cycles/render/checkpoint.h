@@ -0,0 +1,105 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdio.h>
+
+#include "util_map.h"
+#include "util_string.h"
+#include "util_thread.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class RenderBuffers;
+class Scene;
+
+/* Render Checkpoint
+ *
+ * Appends the accumulated render buffers and random number state of finished
+ * tiles to a file. A render started with the same file restores these tiles
+ * and only renders the samples that are missing, so a render that was stopped,
+ * or is extended with more samples, continues from where it was. Tiles are
+ * identified by render layer and position, and are only restored for the same
+ * frame and a scene with the same fingerprint, so an animation or an edited
+ * scene renders anew. Only the position of tiles in the file is kept in
+ * memory. */
+
+class Checkpoint {
+public:
+	Checkpoint(const string& filepath, double interval);
+	~Checkpoint();
+
+	/* index tiles in the file of a previous render, if it exists */
+	bool read();
+	/* flush tiles added so far to disk */
+	bool write();
+	/* flush if tiles were added and the interval has passed */
+	void update();
+
+	/* render layer and frame of the tiles that follow */
+	void set_layer(const string& layer, int frame);
+	/* fingerprint of the scene data as synced to the device, to be called
+	 * after each device update */
+	void set_scene(Scene *scene);
+
+	/* store tile buffers containing num_samples samples */
+	void add_tile(RenderBuffers *buffers, int num_samples);
+	/* restore tile buffers rendered before with at most max_samples,
+	 * returns the number of samples they contain or 0 if not found */
+	int restore_tile(RenderBuffers *buffers, int max_samples);
+
+protected:
+	struct Tile {
+		string layer;
+		int x, y, w, h;
+		int pass_stride;
+		int num_samples;
+		int frame;
+		string fingerprint;
+		/* position of the render buffer and random number state */
+		int64_t offset;
+	};
+
+	typedef map<string, Tile> TileMap;
+
+	string tile_key(const string& layer, int x, int y, int w, int h);
+	bool read_tile(FILE *f, int64_t file_size, Tile& tile);
+	bool write_tile(FILE *f, Tile& tile, const float *buffer, const uint *rng_state);
+	bool compact_file(FILE *f);
+	bool open_file();
+
+	string filepath;
+	double interval;
+	string layer;
+	int frame;
+	string fingerprint;
+
+	TileMap tiles;
+	FILE *file;
+	bool file_error;
+	bool modified;
+	double last_write_time;
+	thread_mutex mutex;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __CHECKPOINT_H__ */
+
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#include <math.h>
+
+#include "buffers.h"
+#include "denoising.h"
+
+#include "util_foreach.h"
+#include "util_function.h"
+#include "util_math.h"
+#include "util_progress.h"
+#include "util_task.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* rows of a buffer filtered by one task */
+#define DENOISE_BAND_HEIGHT 16
+
+/* falloff of the feature weights, scaled by the feature strength */
+#define DENOISE_NORMAL_SIGMA 0.35f
+#define DENOISE_ALBEDO_SIGMA 0.2f
+#define DENOISE_DEPTH_SIGMA 0.05f
+
+/* planes of the gathered region, stored separately so that the filter can
+ * process four neighbouring pixels at once */
+enum {
+	DENOISE_PLANE_R,
+	DENOISE_PLANE_G,
+	DENOISE_PLANE_B,
+	DENOISE_PLANE_VARIANCE,
+	DENOISE_PLANE_NORMAL_X,
+	DENOISE_PLANE_NORMAL_Y,
+	DENOISE_PLANE_NORMAL_Z,
+	DENOISE_PLANE_ALBEDO_R,
+	DENOISE_PLANE_ALBEDO_G,
+	DENOISE_PLANE_ALBEDO_B,
+	DENOISE_PLANE_DEPTH,
+	DENOISE_PLANE_VALID,
+	DENOISE_NUM_PLANES
+};
+
+#ifdef __KERNEL_SSE2__
+
+/* exp(x) for x <= 0, computed as 2^(x*log2(e)) from the integer part put
+ * into the exponent bits and a polynomial for the fraction */
+static inline __m128 denoise_exp_neg_sse(__m128 x)
+{
+	x = _mm_max_ps(x, _mm_set1_ps(-80.0f));
+
+	__m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+	__m128 ti = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+	/* truncation rounds towards zero, floor needs one less for fractions */
+	ti = _mm_sub_ps(ti, _mm_and_ps(_mm_cmpgt_ps(ti, t), _mm_set1_ps(1.0f)));
+
+	__m128 f = _mm_sub_ps(t, ti);
+	__m128 p = _mm_set1_ps(1.3333558e-3f);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.6181291e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.5504109e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.4022651e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.9314718e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+	__m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(ti), _mm_set1_epi32(127)), 23);
+
+	return _mm_mul_ps(p, _mm_castsi128_ps(e));
+}
+
+static inline float denoise_reduce_add_sse(__m128 a)
+{
+	__m128 b = _mm_add_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+	b = _mm_add_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(b);
+}
+
+#endif
+
+Denoiser::Denoiser(const DenoiseParams& params_)
+: params(params_)
+{
+	sample = 0;
+	progress = NULL;
+}
+
+void Denoiser::run(const vector<RenderBuffers*>& buffers_, int sample_, Progress& progress_)
+{
+	sample = sample_;
+	progress = &progress_;
+
+	if(sample < 2)
+		return;
+
+	/* variance is estimated from the adaptive aux pass, without it there is
+	 * nothing to tell noise from detail */
+	buffers.clear();
+
+	foreach(RenderBuffers *rbuffers, buffers_) {
+		if(rbuffers == NULL)
+			continue;
+		if(rbuffers->params.get_pass_offset(PASS_ADAPTIVE_AUX) == -1)
+			continue;
+
+		rbuffers->copy_from_device();
+		buffers.push_back(rbuffers);
+	}
+
+	/* filter into separate output, neighbouring bands must see the input */
+	TaskPool pool;
+
+	output.resize(buffers.size());
+
+	for(size_t i = 0; i < buffers.size(); i++) {
+		BufferParams& bparams = buffers[i]->params;
+
+		output[i].resize(bparams.width*bparams.height*3);
+
+		for(int y = 0; y < bparams.height; y += DENOISE_BAND_HEIGHT) {
+			int y1 = min(y + DENOISE_BAND_HEIGHT, bparams.height);
+			pool.push(function_bind(&Denoiser::filter_band, this, (int)i, y, y1));
+		}
+	}
+
+	pool.wait_work();
+
+	/* write back into the combined pass */
+	if(!progress->get_cancel()) {
+		for(size_t i = 0; i < buffers.size(); i++) {
+			BufferParams& bparams = buffers[i]->params;
+			int pass_stride = bparams.get_passes_size();
+			int size = bparams.width*bparams.height;
+			float *combined = (float*)buffers[i]->buffer.data_pointer + bparams.get_pass_offset(PASS_COMBINED);
+			float *out = &output[i][0];
+
+			for(int j = 0; j < size; j++, combined += pass_stride, out += 3) {
+				combined[0] = out[0]*sample;
+				combined[1] = out[1]*sample;
+				combined[2] = out[2]*sample;
+			}
+
+			buffers[i]->copy_to_device();
+		}
+	}
+
+	buffers.clear();
+	output.clear();
+}
+
+void Denoiser::gather(RenderBuffers *rbuffers, float *planes, int x0, int y0, int w, int h, int stride)
+{
+	BufferParams& bparams = rbuffers->params;
+
+	/* intersect region with buffer */
+	int gx0 = max(x0, bparams.full_x);
+	int gy0 = max(y0, bparams.full_y);
+	int gx1 = min(x0 + w, bparams.full_x + bparams.width);
+	int gy1 = min(y0 + h, bparams.full_y + bparams.height);
+
+	if(gx0 >= gx1 || gy0 >= gy1)
+		return;
+
+	int pass_stride = bparams.get_passes_size();
+	int combined = bparams.get_pass_offset(PASS_COMBINED);
+	int aux = bparams.get_pass_offset(PASS_ADAPTIVE_AUX);
+	int normal = bparams.get_pass_offset(PASS_NORMAL);
+	int albedo = bparams.get_pass_offset(PASS_DIFFUSE_COLOR);
+	int depth = bparams.get_pass_offset(PASS_DEPTH);
+
+	float *data = (float*)rbuffers->buffer.data_pointer;
+	float scale = 1.0f/sample;
+	float variance_scale = 1.0f/(sample - 1);
+	int plane_size = stride*h;
+
+	for(int y = gy0; y < gy1; y++) {
+		for(int x = gx0; x < gx1; x++) {
+			float *in = data + ((x - bparams.full_x) + (y - bparams.full_y)*bparams.width)*pass_stride;
+			float *out = planes + (x - x0) + (y - y0)*stride;
+
+			/* variance of the mean from the first and second moment */
+			float3 mean = make_float3(in[combined], in[combined+1], in[combined+2])*scale;
+			float3 moment = make_float3(in[aux], in[aux+1], in[aux+2])*scale;
+			float3 variance = max(moment - mean*mean, make_float3(0.0f, 0.0f, 0.0f))*variance_scale;
+
+			out[DENOISE_PLANE_R*plane_size] = mean.x;
+			out[DENOISE_PLANE_G*plane_size] = mean.y;
+			out[DENOISE_PLANE_B*plane_size] = mean.z;
+			out[DENOISE_PLANE_VARIANCE*plane_size] = average(variance);
+
+			if(normal != -1) {
+				out[DENOISE_PLANE_NORMAL_X*plane_size] = in[normal]*scale;
+				out[DENOISE_PLANE_NORMAL_Y*plane_size] = in[normal+1]*scale;
+				out[DENOISE_PLANE_NORMAL_Z*plane_size] = in[normal+2]*scale;
+			}
+
+			if(albedo != -1) {
+				out[DENOISE_PLANE_ALBEDO_R*plane_size] = in[albedo]*scale;
+				out[DENOISE_PLANE_ALBEDO_G*plane_size] = in[albedo+1]*scale;
+				out[DENOISE_PLANE_ALBEDO_B*plane_size] = in[albedo+2]*scale;
+			}
+
+			/* depth is written once, zero for the background */
+			if(depth != -1)
+				out[DENOISE_PLANE_DEPTH*plane_size] = in[depth];
+
+			out[DENOISE_PLANE_VALID*plane_size] = 1.0f;
+		}
+	}
+}
+
+void Denoiser::filter_band(int index, int y0, int y1)
+{
+	if(progress->get_cancel())
+		return;
+
+	BufferParams& bparams = buffers[index]->params;
+	int r = params.radius;
+
+	/* gather band with overlap from all buffers, padded on the right so that
+	 * four pixels can be read at the end of each window row */
+	int region_x = bparams.full_x - r;
+	int region_y = bparams.full_y + y0 - r;
+	int region_w = bparams.width + 2*r;
+	int region_h = (y1 - y0) + 2*r;
+	int stride = align_up(region_w + 3, 4);
+	int plane_size = stride*region_h;
+
+	vector<float> region(DENOISE_NUM_PLANES*plane_size, 0.0f);
+	float *planes = &region[0];
+
+	foreach(RenderBuffers *rbuffers, buffers)
+		gather(rbuffers, planes, region_x, region_y, region_w, region_h, stride);
+
+	const float *color_r = planes + DENOISE_PLANE_R*plane_size;
+	const float *color_g = planes + DENOISE_PLANE_G*plane_size;
+	const float *color_b = planes + DENOISE_PLANE_B*plane_size;
+	const float *variance = planes + DENOISE_PLANE_VARIANCE*plane_size;
+	const float *normal_x = planes + DENOISE_PLANE_NORMAL_X*plane_size;
+	const float *normal_y = planes + DENOISE_PLANE_NORMAL_Y*plane_size;
+	const float *normal_z = planes + DENOISE_PLANE_NORMAL_Z*plane_size;
+	const float *albedo_r = planes + DENOISE_PLANE_ALBEDO_R*plane_size;
+	const float *albedo_g = planes + DENOISE_PLANE_ALBEDO_G*plane_size;
+	const float *albedo_b = planes + DENOISE_PLANE_ALBEDO_B*plane_size;
+	const float *depth = planes + DENOISE_PLANE_DEPTH*plane_size;
+	const float *valid = planes + DENOISE_PLANE_VALID*plane_size;
+
+	float k2 = params.strength*params.strength;
+	float fs2 = params.feature_strength*params.feature_strength;
+	float inv_normal = 1.0f/(DENOISE_NORMAL_SIGMA*DENOISE_NORMAL_SIGMA*fs2);
+	float inv_albedo = 1.0f/(DENOISE_ALBEDO_SIGMA*DENOISE_ALBEDO_SIGMA*fs2);
+	float inv_depth = 1.0f/(DENOISE_DEPTH_SIGMA*DENOISE_DEPTH_SIGMA*fs2);
+
+	float *out = &output[index][y0*bparams.width*3];
+
+	for(int y = 0; y < y1 - y0; y++) {
+		for(int x = 0; x < bparams.width; x++, out += 3) {
+			int p = (x + r) + (y + r)*stride;
+
+#ifdef __KERNEL_SSE2__
+			const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 third = _mm_set1_ps(1.0f/3.0f);
+			const __m128 p_r = _mm_set1_ps(color_r[p]);
+			const __m128 p_g = _mm_set1_ps(color_g[p]);
+			const __m128 p_b = _mm_set1_ps(color_b[p]);
+			const __m128 p_var = _mm_set1_ps(variance[p]);
+			const __m128 p_nx = _mm_set1_ps(normal_x[p]);
+			const __m128 p_ny = _mm_set1_ps(normal_y[p]);
+			const __m128 p_nz = _mm_set1_ps(normal_z[p]);
+			const __m128 p_ar = _mm_set1_ps(albedo_r[p]);
+			const __m128 p_ag = _mm_set1_ps(albedo_g[p]);
+			const __m128 p_ab = _mm_set1_ps(albedo_b[p]);
+			const __m128 p_depth = _mm_set1_ps(depth[p]);
+			const __m128 k2_sse = _mm_set1_ps(k2);
+			const __m128 inv_normal_sse = _mm_set1_ps(inv_normal);
+			const __m128 inv_albedo_sse = _mm_set1_ps(inv_albedo);
+			const __m128 inv_depth_sse = _mm_set1_ps(inv_depth);
+
+			__m128 sum_w = zero, sum_r = zero, sum_g = zero, sum_b = zero;
+
+			for(int dy = -r; dy <= r; dy++) {
+				for(int dx = -r; dx <= r; dx += 4) {
+					int q = p + dx + dy*stride;
+
+					/* mask out lanes past the end of the window */
+					__m128 mask = _mm_cmplt_ps(lane, _mm_set1_ps((float)(r - dx + 1)));
+					__m128 q_valid = _mm_and_ps(_mm_loadu_ps(valid + q), mask);
+
+					/* color distance minus the expected difference from noise */
+					__m128 q_r = _mm_loadu_ps(color_r + q);
+					__m128 q_g = _mm_loadu_ps(color_g + q);
+					__m128 q_b = _mm_loadu_ps(color_b + q);
+					__m128 q_var = _mm_loadu_ps(variance + q);
+					__m128 d_r = _mm_sub_ps(q_r, p_r);
+					__m128 d_g = _mm_sub_ps(q_g, p_g);
+					__m128 d_b = _mm_sub_ps(q_b, p_b);
+					__m128 dist = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d_r, d_r), _mm_mul_ps(d_g, d_g)), _mm_mul_ps(d_b, d_b)), third);
+					__m128 noise = _mm_add_ps(p_var, _mm_min_ps(p_var, q_var));
+					__m128 denom = _mm_add_ps(_mm_mul_ps(k2_sse, _mm_add_ps(p_var, q_var)), _mm_set1_ps(1e-10f));
+					__m128 d = _mm_max_ps(_mm_div_ps(_mm_sub_ps(dist, noise), denom), zero);
+
+					/* feature distances */
+					__m128 d_nx = _mm_sub_ps(_mm_loadu_ps(normal_x + q), p_nx);
+					__m128 d_ny = _mm_sub_ps(_mm_loadu_ps(normal_y + q), p_ny);
+					__m128 d_nz = _mm_sub_ps(_mm_loadu_ps(normal_z + q), p_nz);
+					__m128 d_n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d_nx, d_nx), _mm_mul_ps(d_ny, d_ny)), _mm_mul_ps(d_nz, d_nz));
+					d = _mm_add_ps(d, _mm_mul_ps(d_n, inv_normal_sse));
+
+					__m128 d_ar = _mm_sub_ps(_mm_loadu_ps(albedo_r + q), p_ar);
+					__m128 d_ag = _mm_sub_ps(_mm_loadu_ps(albedo_g + q), p_ag);
+					__m128 d_ab = _mm_sub_ps(_mm_loadu_ps(albedo_b + q), p_ab);
+					__m128 d_a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d_ar, d_ar), _mm_mul_ps(d_ag, d_ag)), _mm_mul_ps(d_ab, d_ab));
+					d = _mm_add_ps(d, _mm_mul_ps(d_a, inv_albedo_sse));
+
+					__m128 q_depth = _mm_loadu_ps(depth + q);
+					__m128 depth_max = _mm_max_ps(_mm_max_ps(p_depth, q_depth), _mm_set1_ps(1e-4f));
+					__m128 d_depth = _mm_div_ps(_mm_sub_ps(q_depth, p_depth), depth_max);
+					d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(d_depth, d_depth), inv_depth_sse));
+
+					__m128 w = _mm_mul_ps(denoise_exp_neg_sse(_mm_sub_ps(zero, d)), q_valid);
+
+					sum_w = _mm_add_ps(sum_w, w);
+					sum_r = _mm_add_ps(sum_r, _mm_mul_ps(w, q_r));
+					sum_g = _mm_add_ps(sum_g, _mm_mul_ps(w, q_g));
+					sum_b = _mm_add_ps(sum_b, _mm_mul_ps(w, q_b));
+				}
+			}
+
+			/* center pixel always has weight one, so this is never zero */
+			float inv_w = 1.0f/denoise_reduce_add_sse(sum_w);
+
+			out[0] = denoise_reduce_add_sse(sum_r)*inv_w;
+			out[1] = denoise_reduce_add_sse(sum_g)*inv_w;
+			out[2] = denoise_reduce_add_sse(sum_b)*inv_w;
+#else
+			float sum_w = 0.0f, sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
+
+			for(int dy = -r; dy <= r; dy++) {
+				for(int dx = -r; dx <= r; dx++) {
+					int q = p + dx + dy*stride;
+
+					if(valid[q] == 0.0f)
+						continue;
+
+					/* color distance minus the expected difference from noise */
+					float d_r = color_r[q] - color_r[p];
+					float d_g = color_g[q] - color_g[p];
+					float d_b = color_b[q] - color_b[p];
+					float dist = (d_r*d_r + d_g*d_g + d_b*d_b)*(1.0f/3.0f);
+					float noise = variance[p] + min(variance[p], variance[q]);
+					float denom = k2*(variance[p] + variance[q]) + 1e-10f;
+					float d = max((dist - noise)/denom, 0.0f);
+
+					/* feature distances */
+					float d_nx = normal_x[q] - normal_x[p];
+					float d_ny = normal_y[q] - normal_y[p];
+					float d_nz = normal_z[q] - normal_z[p];
+					d += (d_nx*d_nx + d_ny*d_ny + d_nz*d_nz)*inv_normal;
+
+					float d_ar = albedo_r[q] - albedo_r[p];
+					float d_ag = albedo_g[q] - albedo_g[p];
+					float d_ab = albedo_b[q] - albedo_b[p];
+					d += (d_ar*d_ar + d_ag*d_ag + d_ab*d_ab)*inv_albedo;
+
+					float depth_max = max(max(depth[p], depth[q]), 1e-4f);
+					float d_depth = (depth[q] - depth[p])/depth_max;
+					d += d_depth*d_depth*inv_depth;
+
+					float w = expf(-d);
+
+					sum_w += w;
+					sum_r += w*color_r[q];
+					sum_g += w*color_g[q];
+					sum_b += w*color_b[q];
+				}
+			}
+
+			/* center pixel always has weight one, so this is never zero */
+			float inv_w = 1.0f/sum_w;
+
+			out[0] = sum_r*inv_w;
+			out[1] = sum_g*inv_w;
+			out[2] = sum_b*inv_w;
+#endif
+		}
+	}
+}
+
+CCL_NAMESPACE_END
+
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __DENOISING_H__
+#define __DENOISING_H__
+
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class Progress;
+class RenderBuffers;
+
+/* Denoise Parameters */
+
+class DenoiseParams {
+public:
+	/* half width of the filter window in pixels */
+	int radius;
+	/* color differences tolerated, relative to the estimated pixel variance */
+	float strength;
+	/* normal, albedo and depth differences tolerated */
+	float feature_strength;
+
+	DenoiseParams()
+	{
+		radius = 8;
+		strength = 2.0f;
+		feature_strength = 1.0f;
+	}
+
+	bool modified(const DenoiseParams& params)
+	{ return !(radius == params.radius
+		&& strength == params.strength
+		&& feature_strength == params.feature_strength); }
+};
+
+/* Denoiser
+ *
+ * Feature guided filter applied to the combined pass once all tiles are
+ * rendered. Every pixel becomes a weighted average of a window around it,
+ * weighted by the color difference relative to the variance estimated from
+ * the adaptive aux pass, and by the normal, albedo (diffuse color) and depth
+ * differences when those passes are available. The image is filtered in
+ * bands of rows in parallel, reading the overlap from neighbouring tiles. */
+
+class Denoiser {
+public:
+	Denoiser(const DenoiseParams& params);
+
+	/* buffers together make up the image, empty entries are skipped */
+	void run(const vector<RenderBuffers*>& buffers, int sample, Progress& progress);
+
+protected:
+	void filter_band(int index, int y0, int y1);
+	void gather(RenderBuffers *rbuffers, float *planes, int x0, int y0, int w, int h, int stride);
+
+	DenoiseParams params;
+	vector<RenderBuffers*> buffers;
+	vector<vector<float> > output;
+	int sample;
+	Progress *progress;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __DENOISING_H__ */
+
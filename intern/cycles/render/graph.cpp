@@ -135,12 +135,37 @@ void ShaderNode::attributes(Shader *shader, AttributeRequestSet *attributes)
 	}
 }
 
+bool ShaderNode::equals_inputs(ShaderNode *other)
+{
+	if(name != other->name || bump != other->bump || inputs.size() != other->inputs.size())
+		return false;
+
+	for(size_t i = 0; i < inputs.size(); i++) {
+		ShaderInput *input = inputs[i];
+		ShaderInput *other_input = other->inputs[i];
+
+		/* linked inputs must come from the same output socket */
+		if(input->link != other_input->link)
+			return false;
+
+		if(!input->link) {
+			if(input->default_value != other_input->default_value)
+				return false;
+			if(!(input->value == other_input->value) || input->value_string != other_input->value_string)
+				return false;
+		}
+	}
+
+	return true;
+}
+
 /* Graph */
 
 ShaderGraph::ShaderGraph()
 {
 	finalized = false;
 	num_node_ids = 0;
+	optimize = true;
 	add(new OutputNode());
 }
 
@@ -166,6 +191,7 @@ OutputNode *ShaderGraph::output()
 ShaderGraph *ShaderGraph::copy()
 {
 	ShaderGraph *newgraph = new ShaderGraph();
+	newgraph->optimize = optimize;
 
 	/* copy nodes */
 	set<ShaderNode*> nodes_all;
@@ -469,6 +495,128 @@ void ShaderGraph::break_cycles(ShaderNode *node, vector<bool>& visited, vector<b
 	on_stack[node->id] = false;
 }
 
+bool ShaderGraph::constant_fold_input(ShaderInput *input)
+{
+	/* test if a constant value can be assigned to the input instead of a
+	 * link. inputs with a default value such as texture coordinates would use
+	 * that when unlinked, and the output node only uses linked inputs */
+	ShaderNode *node = input->parent;
+
+	if(input->default_value != ShaderInput::NONE || node == output())
+		return false;
+
+	if(input->type == SHADER_SOCKET_INT || input->type == SHADER_SOCKET_STRING)
+		return false;
+
+	/* closures can only be left out of mix and add closures */
+	if(input->type == SHADER_SOCKET_CLOSURE)
+		return (node->special_type == SHADER_SPECIAL_TYPE_MIX_CLOSURE || node->name == ustring("add_closure"));
+
+	return true;
+}
+
+void ShaderGraph::constant_fold(set<ShaderNode*>& done, ShaderNode *node)
+{
+	/* only fold each node once */
+	if(done.find(node) != done.end())
+		return;
+
+	done.insert(node);
+
+	/* fold nodes connected to inputs first, so constant values propagate
+	 * through the whole subgraph */
+	foreach(ShaderInput *input, node->inputs)
+		if(input->link)
+			constant_fold(done, input->link->parent);
+
+	/* then replace the links from outputs of this node */
+	foreach(ShaderOutput *output, node->outputs) {
+		/* temp. copy of the output links list.
+		 * output->links is modified when we disconnect!
+		 */
+		vector<ShaderInput*> links(output->links);
+		ShaderInput *bypass = node->constant_fold_bypass(output);
+		float3 optimized_value = make_float3(0.0f, 0.0f, 0.0f);
+
+		if(bypass && bypass->link) {
+			/* pass on the input link, this keeps inputs linked */
+			ShaderOutput *from = bypass->link;
+
+			foreach(ShaderInput *to, links) {
+				disconnect(to);
+				connect(from, to);
+			}
+
+			continue;
+		}
+		else if(bypass)
+			optimized_value = bypass->value;
+		else if(!node->constant_fold(output, &optimized_value))
+			continue;
+
+		foreach(ShaderInput *to, links) {
+			if(constant_fold_input(to)) {
+				disconnect(to);
+				to->value = optimized_value;
+			}
+		}
+	}
+}
+
+void ShaderGraph::sort_nodes(ShaderNode *node, vector<bool>& visited, vector<ShaderNode*>& sorted)
+{
+	/* depth first, so that nodes are added after all nodes they depend on */
+	visited[node->id] = true;
+
+	foreach(ShaderInput *input, node->inputs) {
+		if(input->link && !visited[input->link->parent->id])
+			sort_nodes(input->link->parent, visited, sorted);
+	}
+
+	sorted.push_back(node);
+}
+
+void ShaderGraph::deduplicate_nodes()
+{
+	/* merge nodes that compute the same outputs from the same inputs, e.g.
+	 * identical texture coordinate or math nodes. nodes are visited in
+	 * dependency order, so that the nodes feeding into a node are merged
+	 * before it is compared, and whole identical subgraphs get merged */
+	vector<bool> visited(num_node_ids, false);
+	vector<ShaderNode*> sorted;
+
+	sort_nodes(output(), visited, sorted);
+
+	map<ustring, vector<ShaderNode*> > candidates;
+
+	foreach(ShaderNode *node, sorted) {
+		vector<ShaderNode*>& same_type = candidates[node->name];
+		ShaderNode *merge = NULL;
+
+		foreach(ShaderNode *other, same_type) {
+			if(node->equals(other)) {
+				merge = other;
+				break;
+			}
+		}
+
+		if(!merge) {
+			same_type.push_back(node);
+			continue;
+		}
+
+		/* move all links over to the equal node, this node is then unused */
+		for(size_t i = 0; i < node->outputs.size(); i++) {
+			vector<ShaderInput*> links(node->outputs[i]->links);
+
+			foreach(ShaderInput *to, links) {
+				disconnect(to);
+				connect(merge->outputs[i], to);
+			}
+		}
+	}
+}
+
 void ShaderGraph::clean()
 {
 	/* remove proxy and unnecessary mix nodes */
@@ -484,6 +632,20 @@ void ShaderGraph::clean()
 	/* break cycles */
 	break_cycles(output(), visited, on_stack);
 
+	/* evaluate constant subgraphs and merge duplicate nodes. mix closures may
+	 * now have a constant factor, so remove unneeded nodes once more */
+	if(optimize) {
+		set<ShaderNode*> done;
+		constant_fold(done, output());
+		remove_unneeded_nodes();
+		deduplicate_nodes();
+	}
+
+	/* find the nodes still used after optimization, no more cycles here */
+	visited.assign(num_node_ids, false);
+	on_stack.assign(num_node_ids, false);
+	break_cycles(output(), visited, on_stack);
+
 	/* disconnect unused nodes */
 	foreach(ShaderNode *node, nodes) {
 		if(!visited[node->id]) {
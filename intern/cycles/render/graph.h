@@ -195,6 +195,19 @@ public:
 	virtual bool has_bssrdf_bump() { return false; }
 	virtual bool has_spatial_varying() { return false; }
 
+	/* constant folding: if the output socket has a value that can be computed
+	 * at compile time, store it in optimized_value and return true. closure
+	 * outputs that contribute nothing also return true. */
+	virtual bool constant_fold(ShaderOutput *socket, float3 *optimized_value) { return false; }
+	/* if the output socket is equal to one of the inputs, return that input
+	 * so its link or value can be used directly */
+	virtual ShaderInput *constant_fold_bypass(ShaderOutput *socket) { return NULL; }
+
+	/* deduplication: true if the other node is of the same type with the same
+	 * parameters and inputs, so that it produces the same outputs */
+	virtual bool equals(ShaderNode *other) { return false; }
+	bool equals_inputs(ShaderNode *other);
+
 	vector<ShaderInput*> inputs;
 	vector<ShaderOutput*> outputs;
 
@@ -235,6 +248,10 @@ public:
 	size_t num_node_ids;
 	bool finalized;
 
+	/* constant folding and deduplication when finalizing, only disabled to
+	 * measure what they save */
+	bool optimize;
+
 	ShaderGraph();
 	~ShaderGraph();
 
@@ -256,6 +273,10 @@ protected:
 	void copy_nodes(set<ShaderNode*>& nodes, map<ShaderNode*, ShaderNode*>& nnodemap);
 
 	void break_cycles(ShaderNode *node, vector<bool>& visited, vector<bool>& on_stack);
+	bool constant_fold_input(ShaderInput *input);
+	void constant_fold(set<ShaderNode*>& done, ShaderNode *node);
+	void sort_nodes(ShaderNode *node, vector<bool>& visited, vector<ShaderNode*>& sorted);
+	void deduplicate_nodes();
 	void clean();
 	void bump_from_displacement();
 	void refine_bump_nodes();
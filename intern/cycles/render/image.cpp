@@ -18,6 +18,8 @@
 #include "image.h"
 #include "scene.h"
 
+#include "kernel_texture_cache_globals.h"
+
 #include "util_foreach.h"
 #include "util_image.h"
 #include "util_path.h"
@@ -34,6 +36,9 @@ ImageManager::ImageManager()
 	need_update = true;
 	pack_images = false;
 	osl_texture_system = NULL;
+	compact_images = false;
+	use_texture_cache = false;
+	texture_cache_size = 0;
 	animation_frame = 0;
 
 	tex_num_images = TEX_NUM_IMAGES;
@@ -66,6 +71,17 @@ void ImageManager::set_extended_image_limits(void)
 	tex_image_byte_start = TEX_EXTENDED_IMAGE_BYTE_START;
 }
 
+void ImageManager::set_compact_images(bool compact_images_)
+{
+	compact_images = compact_images_;
+}
+
+void ImageManager::set_texture_cache(bool use_texture_cache_, int texture_cache_size_)
+{
+	use_texture_cache = use_texture_cache_;
+	texture_cache_size = texture_cache_size_;
+}
+
 bool ImageManager::set_animation_frame_update(int frame)
 {
 	if(frame != animation_frame) {
@@ -145,6 +161,28 @@ bool ImageManager::is_float_image(const string& filename, void *builtin_data, bo
 	return is_float;
 }
 
+bool ImageManager::builtin_float_pixels(int slot, vector<float>& pixels, int& width, int& height, int& depth, int& channels)
+{
+	/* only float slots can hold builtin voxel data */
+	if(slot < 0 || slot >= tex_image_byte_start || (size_t)slot >= float_images.size())
+		return false;
+
+	Image *img = float_images[slot];
+
+	if(!img || !img->builtin_data || !builtin_image_info_cb || !builtin_image_float_pixels_cb)
+		return false;
+
+	bool is_float;
+	builtin_image_info_cb(img->filename, img->builtin_data, is_float, width, height, depth, channels);
+
+	if(!is_float || width <= 0 || height <= 0 || depth <= 0 || channels <= 0)
+		return false;
+
+	pixels.resize((size_t)width*height*depth*channels);
+
+	return builtin_image_float_pixels_cb(img->filename, img->builtin_data, &pixels[0]);
+}
+
 static bool image_equals(ImageManager::Image *image, const string& filename, void *builtin_data, InterpolationType interpolation)
 {
 	return image->filename == filename &&
@@ -292,105 +330,60 @@ void ImageManager::remove_image(const string& filename, void *builtin_data, Inte
 	}
 }
 
-bool ImageManager::file_load_image(Image *img, device_vector<uchar4>& tex_img)
+ImageDataType ImageManager::get_image_data_type(Image *img, bool is_float)
 {
-	if(img->filename == "")
-		return false;
+	ImageDataType type = (is_float)? IMAGE_DATA_TYPE_FLOAT4: IMAGE_DATA_TYPE_BYTE4;
 
-	ImageInput *in = NULL;
-	int width, height, depth, components;
+	if(!compact_images || img->filename == "")
+		return type;
+
+	int components = 0;
+	bool is_half = false;
 
 	if(!img->builtin_data) {
-		/* load image from file through OIIO */
-		in = ImageInput::create(img->filename);
+		ImageInput *in = ImageInput::create(img->filename);
 
 		if(!in)
-			return false;
+			return type;
 
 		ImageSpec spec;
 
-		if(!in->open(img->filename, spec)) {
-			delete in;
-			return false;
-		}
+		if(in->open(img->filename, spec)) {
+			components = spec.nchannels;
 
-		width = spec.width;
-		height = spec.height;
-		depth = spec.depth;
-		components = spec.nchannels;
-	}
-	else {
-		/* load image using builtin images callbacks */
-		if(!builtin_image_info_cb || !builtin_image_pixels_cb)
-			return false;
+			/* half float files are stored as is, other float and 16 bit
+			 * formats are kept at full precision */
+			is_half = (spec.format.basetype == TypeDesc::HALF);
 
-		bool is_float;
-		builtin_image_info_cb(img->filename, img->builtin_data, is_float, width, height, depth, components);
-	}
+			for(size_t channel = 0; channel < spec.channelformats.size(); channel++)
+				if(spec.channelformats[channel].basetype != TypeDesc::HALF)
+					is_half = false;
 
-	/* we only handle certain number of components */
-	if(!(components >= 1 && components <= 4)) {
-		if(in) {
 			in->close();
-			delete in;
 		}
 
-		return false;
-	}
-
-	/* read RGBA pixels */
-	uchar *pixels = (uchar*)tex_img.resize(width, height, depth);
-
-	if(in) {
-		if(depth <= 1) {
-			int scanlinesize = width*components*sizeof(uchar);
-
-			in->read_image(TypeDesc::UINT8,
-				(uchar*)pixels + (height-1)*scanlinesize,
-				AutoStride,
-				-scanlinesize,
-				AutoStride);
-		}
-		else {
-			in->read_image(TypeDesc::UINT8, (uchar*)pixels);
-		}
-
-		in->close();
 		delete in;
 	}
-	else {
-		builtin_image_pixels_cb(img->filename, img->builtin_data, pixels);
+	else if(builtin_image_info_cb) {
+		int width, height, depth;
+		bool builtin_is_float;
+		builtin_image_info_cb(img->filename, img->builtin_data, builtin_is_float, width, height, depth, components);
 	}
 
-	if(components == 2) {
-		for(int i = width*height*depth-1; i >= 0; i--) {
-			pixels[i*4+3] = pixels[i*2+1];
-			pixels[i*4+2] = pixels[i*2+0];
-			pixels[i*4+1] = pixels[i*2+0];
-			pixels[i*4+0] = pixels[i*2+0];
-		}
-	}
-	else if(components == 3) {
-		for(int i = width*height*depth-1; i >= 0; i--) {
-			pixels[i*4+3] = 255;
-			pixels[i*4+2] = pixels[i*3+2];
-			pixels[i*4+1] = pixels[i*3+1];
-			pixels[i*4+0] = pixels[i*3+0];
-		}
-	}
-	else if(components == 1) {
-		for(int i = width*height*depth-1; i >= 0; i--) {
-			pixels[i*4+3] = 255;
-			pixels[i*4+2] = pixels[i];
-			pixels[i*4+1] = pixels[i];
-			pixels[i*4+0] = pixels[i];
-		}
+	if(is_float) {
+		if(is_half)
+			return (components == 1)? IMAGE_DATA_TYPE_HALF: IMAGE_DATA_TYPE_HALF4;
+		else if(components == 1)
+			return IMAGE_DATA_TYPE_FLOAT;
 	}
+	else if(components == 1)
+		return IMAGE_DATA_TYPE_BYTE;
 
-	return true;
+	return type;
 }
 
-bool ImageManager::file_load_float_image(Image *img, device_vector<float4>& tex_img)
+template<TypeDesc::BASETYPE FileFormat, typename StorageType, typename DeviceType>
+bool ImageManager::file_load_image(Image *img, device_vector<DeviceType>& tex_img)
 {
 	if(img->filename == "")
 		return false;
@@ -412,51 +405,83 @@ bool ImageManager::file_load_float_image(Image *img, device_vector<float4>& tex_
 			return false;
 		}
 
-		/* we only handle certain number of components */
 		width = spec.width;
 		height = spec.height;
 		depth = spec.depth;
 		components = spec.nchannels;
 	}
 	else {
-		/* load image using builtin images callbacks */
-		if(!builtin_image_info_cb || !builtin_image_float_pixels_cb)
+		/* load image using builtin images callbacks, these only provide
+		 * byte and float pixels */
+		if(!builtin_image_info_cb)
+			return false;
+		if(FileFormat == TypeDesc::UINT8 && !builtin_image_pixels_cb)
+			return false;
+		if(FileFormat == TypeDesc::FLOAT && !builtin_image_float_pixels_cb)
+			return false;
+		if(FileFormat != TypeDesc::UINT8 && FileFormat != TypeDesc::FLOAT)
 			return false;
 
 		bool is_float;
 		builtin_image_info_cb(img->filename, img->builtin_data, is_float, width, height, depth, components);
 	}
 
-	if(!(components >= 1 && components <= 4)) {
+	/* number of channels stored per pixel, either RGBA or a single channel */
+	const int storage_components = sizeof(DeviceType)/sizeof(StorageType);
+
+	/* we only handle certain number of components */
+	if(!(components >= 1 && components <= storage_components)) {
 		if(in) {
 			in->close();
 			delete in;
 		}
+
 		return false;
 	}
 
-	/* read RGBA pixels */
-	float *pixels = (float*)tex_img.resize(width, height, depth);
+	/* read pixels */
+	StorageType *pixels = (StorageType*)tex_img.resize(width, height, depth);
 
 	if(in) {
 		if(depth <= 1) {
-			int scanlinesize = width*components*sizeof(float);
+			int scanlinesize = width*components*sizeof(StorageType);
 
-			in->read_image(TypeDesc::FLOAT,
+			in->read_image(FileFormat,
 				(uchar*)pixels + (height-1)*scanlinesize,
 				AutoStride,
 				-scanlinesize,
 				AutoStride);
 		}
 		else {
-			in->read_image(TypeDesc::FLOAT, (uchar*)pixels);
+			in->read_image(FileFormat, (uchar*)pixels);
 		}
 
 		in->close();
 		delete in;
 	}
+	else if(FileFormat == TypeDesc::FLOAT) {
+		builtin_image_float_pixels_cb(img->filename, img->builtin_data, (float*)pixels);
+	}
+	else {
+		builtin_image_pixels_cb(img->filename, img->builtin_data, (uchar*)pixels);
+	}
+
+	if(storage_components == 1)
+		return true;
+
+	/* expand to RGBA */
+	StorageType one;
+
+	if(FileFormat == TypeDesc::UINT8) {
+		one = (StorageType)255;
+	}
+	else if(FileFormat == TypeDesc::HALF) {
+		half h[4];
+		float4_store_half(h, make_float4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f);
+		one = (StorageType)h[0];
+	}
 	else {
-		builtin_image_float_pixels_cb(img->filename, img->builtin_data, pixels);
+		one = (StorageType)1.0f;
 	}
 
 	if(components == 2) {
@@ -469,7 +494,7 @@ bool ImageManager::file_load_float_image(Image *img, device_vector<float4>& tex_
 	}
 	else if(components == 3) {
 		for(int i = width*height*depth-1; i >= 0; i--) {
-			pixels[i*4+3] = 1.0f;
+			pixels[i*4+3] = one;
 			pixels[i*4+2] = pixels[i*3+2];
 			pixels[i*4+1] = pixels[i*3+1];
 			pixels[i*4+0] = pixels[i*3+0];
@@ -477,7 +502,7 @@ bool ImageManager::file_load_float_image(Image *img, device_vector<float4>& tex_
 	}
 	else if(components == 1) {
 		for(int i = width*height*depth-1; i >= 0; i--) {
-			pixels[i*4+3] = 1.0f;
+			pixels[i*4+3] = one;
 			pixels[i*4+2] = pixels[i];
 			pixels[i*4+1] = pixels[i];
 			pixels[i*4+0] = pixels[i];
@@ -487,6 +512,32 @@ bool ImageManager::file_load_float_image(Image *img, device_vector<float4>& tex_
 	return true;
 }
 
+TextureCacheGlobals *ImageManager::texture_cache_globals(Device *device)
+{
+	/* OSL already reads images through its own texture system */
+	if(!use_texture_cache || osl_texture_system)
+		return NULL;
+
+	/* NULL for devices without texture cache support */
+	return (TextureCacheGlobals*)device->texture_cache_memory();
+}
+
+void ImageManager::texture_cache_add_image(TextureCacheGlobals *tcg, int slot)
+{
+	Image *img;
+
+	if(slot >= tex_image_byte_start)
+		img = images[slot - tex_image_byte_start];
+	else
+		img = float_images[slot];
+
+	/* tiles and mip levels are only read from the file on lookup */
+	tcg->handles[slot] = tcg->ts->get_texture_handle(ustring(img->filename));
+	tcg->interpolation[slot] = img->interpolation;
+
+	img->need_load = false;
+}
+
 void ImageManager::device_load_image(Device *device, DeviceScene *dscene, int slot, Progress *progress)
 {
 	if(progress->get_cancel())
@@ -507,72 +558,106 @@ void ImageManager::device_load_image(Device *device, DeviceScene *dscene, int sl
 	if(osl_texture_system && !img->builtin_data)
 		return;
 
-	if(is_float) {
-		string filename = path_filename(float_images[slot]->filename);
-		progress->set_status("Updating Images", "Loading " + filename);
+	string filename = path_filename(img->filename);
+	progress->set_status("Updating Images", "Loading " + filename);
 
-		device_vector<float4>& tex_img = dscene->tex_float_image[slot];
+	/* free previous pixels, the storage type may have changed */
+	device_free_image_pixels(device, dscene, slot);
 
-		if(tex_img.device_pointer) {
-			thread_scoped_lock device_lock(device_mutex);
-			device->tex_free(tex_img);
+	ImageDataType type = get_image_data_type(img, is_float);
+	device_memory *tex_img = NULL;
+	string name;
+
+	if(is_float) {
+		if(type == IMAGE_DATA_TYPE_HALF4 && file_load_image<TypeDesc::HALF, half>(img, dscene->tex_half_image[slot])) {
+			tex_img = &dscene->tex_half_image[slot];
+		}
+		else if(type == IMAGE_DATA_TYPE_HALF && file_load_image<TypeDesc::HALF, half>(img, dscene->tex_half1_image[slot])) {
+			tex_img = &dscene->tex_half1_image[slot];
 		}
+		else if(type == IMAGE_DATA_TYPE_FLOAT && file_load_image<TypeDesc::FLOAT, float>(img, dscene->tex_float1_image[slot])) {
+			tex_img = &dscene->tex_float1_image[slot];
+		}
+		else {
+			device_vector<float4>& tex_float_img = dscene->tex_float_image[slot];
 
-		if(!file_load_float_image(img, tex_img)) {
-			/* on failure to load, we set a 1x1 pixels pink image */
-			float *pixels = (float*)tex_img.resize(1, 1);
+			if(!file_load_image<TypeDesc::FLOAT, float>(img, tex_float_img)) {
+				/* on failure to load, we set a 1x1 pixels pink image */
+				float *pixels = (float*)tex_float_img.resize(1, 1);
 
-			pixels[0] = TEX_IMAGE_MISSING_R;
-			pixels[1] = TEX_IMAGE_MISSING_G;
-			pixels[2] = TEX_IMAGE_MISSING_B;
-			pixels[3] = TEX_IMAGE_MISSING_A;
-		}
+				pixels[0] = TEX_IMAGE_MISSING_R;
+				pixels[1] = TEX_IMAGE_MISSING_G;
+				pixels[2] = TEX_IMAGE_MISSING_B;
+				pixels[3] = TEX_IMAGE_MISSING_A;
+			}
 
-		string name;
+			tex_img = &tex_float_img;
+		}
 
 		if(slot >= 10) name = string_printf("__tex_image_float_0%d", slot);
 		else name = string_printf("__tex_image_float_00%d", slot);
-
-		if(!pack_images) {
-			thread_scoped_lock device_lock(device_mutex);
-			device->tex_alloc(name.c_str(), tex_img, img->interpolation, true);
-		}
 	}
 	else {
-		string filename = path_filename(images[slot - tex_image_byte_start]->filename);
-		progress->set_status("Updating Images", "Loading " + filename);
+		int byte_slot = slot - tex_image_byte_start;
 
-		device_vector<uchar4>& tex_img = dscene->tex_image[slot - tex_image_byte_start];
-
-		if(tex_img.device_pointer) {
-			thread_scoped_lock device_lock(device_mutex);
-			device->tex_free(tex_img);
+		if(type == IMAGE_DATA_TYPE_BYTE && file_load_image<TypeDesc::UINT8, uchar>(img, dscene->tex_byte1_image[byte_slot])) {
+			tex_img = &dscene->tex_byte1_image[byte_slot];
 		}
+		else {
+			device_vector<uchar4>& tex_byte_img = dscene->tex_image[byte_slot];
 
-		if(!file_load_image(img, tex_img)) {
-			/* on failure to load, we set a 1x1 pixels pink image */
-			uchar *pixels = (uchar*)tex_img.resize(1, 1);
+			if(!file_load_image<TypeDesc::UINT8, uchar>(img, tex_byte_img)) {
+				/* on failure to load, we set a 1x1 pixels pink image */
+				uchar *pixels = (uchar*)tex_byte_img.resize(1, 1);
 
-			pixels[0] = (TEX_IMAGE_MISSING_R * 255);
-			pixels[1] = (TEX_IMAGE_MISSING_G * 255);
-			pixels[2] = (TEX_IMAGE_MISSING_B * 255);
-			pixels[3] = (TEX_IMAGE_MISSING_A * 255);
-		}
+				pixels[0] = (TEX_IMAGE_MISSING_R * 255);
+				pixels[1] = (TEX_IMAGE_MISSING_G * 255);
+				pixels[2] = (TEX_IMAGE_MISSING_B * 255);
+				pixels[3] = (TEX_IMAGE_MISSING_A * 255);
+			}
 
-		string name;
+			tex_img = &tex_byte_img;
+		}
 
 		if(slot >= 10) name = string_printf("__tex_image_0%d", slot);
 		else name = string_printf("__tex_image_00%d", slot);
+	}
 
-		if(!pack_images) {
-			thread_scoped_lock device_lock(device_mutex);
-			device->tex_alloc(name.c_str(), tex_img, img->interpolation, true);
-		}
+	if(!pack_images) {
+		thread_scoped_lock device_lock(device_mutex);
+		device->tex_alloc(name.c_str(), *tex_img, img->interpolation, true);
 	}
 
 	img->need_load = false;
 }
 
+template<typename T>
+void ImageManager::device_free_image_vector(Device *device, device_vector<T>& tex_img)
+{
+	if(tex_img.device_pointer) {
+		thread_scoped_lock device_lock(device_mutex);
+		device->tex_free(tex_img);
+	}
+
+	tex_img.clear();
+}
+
+void ImageManager::device_free_image_pixels(Device *device, DeviceScene *dscene, int slot)
+{
+	if(slot >= tex_image_byte_start) {
+		int byte_slot = slot - tex_image_byte_start;
+
+		device_free_image_vector(device, dscene->tex_image[byte_slot]);
+		device_free_image_vector(device, dscene->tex_byte1_image[byte_slot]);
+	}
+	else {
+		device_free_image_vector(device, dscene->tex_float_image[slot]);
+		device_free_image_vector(device, dscene->tex_half_image[slot]);
+		device_free_image_vector(device, dscene->tex_half1_image[slot]);
+		device_free_image_vector(device, dscene->tex_float1_image[slot]);
+	}
+}
+
 void ImageManager::device_free_image(Device *device, DeviceScene *dscene, int slot)
 {
 	Image *img;
@@ -588,34 +673,37 @@ void ImageManager::device_free_image(Device *device, DeviceScene *dscene, int sl
 	}
 
 	if(img) {
+		TextureCacheGlobals *tcg = texture_cache_globals(device);
+
 		if(osl_texture_system && !img->builtin_data) {
 #ifdef WITH_OSL
 			ustring filename(images[slot]->filename);
 			((OSL::TextureSystem*)osl_texture_system)->invalidate(filename);
 #endif
 		}
-		else if(is_float) {
-			device_vector<float4>& tex_img = dscene->tex_float_image[slot];
+		else if(tcg && tcg->ts && !img->builtin_data) {
+			tcg->ts->invalidate(ustring(img->filename));
 
-			if(tex_img.device_pointer) {
-				thread_scoped_lock device_lock(device_mutex);
-				device->tex_free(tex_img);
-			}
+			if(slot < (int)tcg->handles.size())
+				tcg->handles[slot] = NULL;
 
-			tex_img.clear();
+			if(is_float) {
+				delete float_images[slot];
+				float_images[slot] = NULL;
+			}
+			else {
+				delete images[slot - tex_image_byte_start];
+				images[slot - tex_image_byte_start] = NULL;
+			}
+		}
+		else if(is_float) {
+			device_free_image_pixels(device, dscene, slot);
 
 			delete float_images[slot];
 			float_images[slot] = NULL;
 		}
 		else {
-			device_vector<uchar4>& tex_img = dscene->tex_image[slot - tex_image_byte_start];
-
-			if(tex_img.device_pointer) {
-				thread_scoped_lock device_lock(device_mutex);
-				device->tex_free(tex_img);
-			}
-
-			tex_img.clear();
+			device_free_image_pixels(device, dscene, slot);
 
 			delete images[slot - tex_image_byte_start];
 			images[slot - tex_image_byte_start] = NULL;
@@ -629,6 +717,22 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 		return;
 
 	TaskPool pool;
+	TextureCacheGlobals *tcg = texture_cache_globals(device);
+
+	if(tcg) {
+		if(!tcg->ts) {
+			tcg->ts = TextureSystem::create(false);
+
+			tcg->ts->attribute("automip",  1);
+			tcg->ts->attribute("autotile", 64);
+			tcg->ts->attribute("gray_to_rgb", 1);
+		}
+
+		tcg->ts->attribute("max_memory_MB", (float)texture_cache_size);
+
+		tcg->handles.resize(tex_image_byte_start + images.size(), NULL);
+		tcg->interpolation.resize(tex_image_byte_start + images.size(), INTERPOLATION_LINEAR);
+	}
 
 	for(size_t slot = 0; slot < images.size(); slot++) {
 		if(!images[slot])
@@ -638,7 +742,9 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 			device_free_image(device, dscene, slot + tex_image_byte_start);
 		}
 		else if(images[slot]->need_load) {
-			if(!osl_texture_system || images[slot]->builtin_data) 
+			if(tcg && !images[slot]->builtin_data)
+				texture_cache_add_image(tcg, slot + tex_image_byte_start);
+			else if(!osl_texture_system || images[slot]->builtin_data) 
 				pool.push(function_bind(&ImageManager::device_load_image, this, device, dscene, slot + tex_image_byte_start, &progress));
 		}
 	}
@@ -651,7 +757,9 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 			device_free_image(device, dscene, slot);
 		}
 		else if(float_images[slot]->need_load) {
-			if(!osl_texture_system || float_images[slot]->builtin_data) 
+			if(tcg && !float_images[slot]->builtin_data)
+				texture_cache_add_image(tcg, slot);
+			else if(!osl_texture_system || float_images[slot]->builtin_data) 
 				pool.push(function_bind(&ImageManager::device_load_image, this, device, dscene, slot, &progress));
 		}
 	}
@@ -730,6 +838,16 @@ void ImageManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->tex_image_packed.clear();
 	dscene->tex_image_packed_info.clear();
 
+	TextureCacheGlobals *tcg = texture_cache_globals(device);
+
+	if(tcg && tcg->ts) {
+		TextureSystem::destroy(tcg->ts);
+		tcg->ts = NULL;
+
+		tcg->handles.clear();
+		tcg->interpolation.clear();
+	}
+
 	images.clear();
 	float_images.clear();
 }
@@ -19,6 +19,7 @@
 
 #include "device_memory.h"
 
+#include "util_image.h"
 #include "util_string.h"
 #include "util_thread.h"
 #include "util_vector.h"
@@ -44,6 +45,8 @@ class Device;
 class DeviceScene;
 class Progress;
 
+struct TextureCacheGlobals;
+
 class ImageManager {
 public:
 	ImageManager();
@@ -54,12 +57,18 @@ public:
 	void remove_image(const string& filename, void *builtin_data, InterpolationType interpolation);
 	bool is_float_image(const string& filename, void *builtin_data, bool& is_linear);
 
+	/* read pixels of a builtin float image on the host, for processing of
+	 * voxel data outside of the kernel */
+	bool builtin_float_pixels(int slot, vector<float>& pixels, int& width, int& height, int& depth, int& channels);
+
 	void device_update(Device *device, DeviceScene *dscene, Progress& progress);
 	void device_free(Device *device, DeviceScene *dscene);
 
 	void set_osl_texture_system(void *texture_system);
 	void set_pack_images(bool pack_images_);
 	void set_extended_image_limits(void);
+	void set_compact_images(bool compact_images_);
+	void set_texture_cache(bool use_texture_cache_, int texture_cache_size_);
 	bool set_animation_frame_update(int frame);
 
 	bool need_update;
@@ -90,12 +99,24 @@ private:
 	vector<Image*> float_images;
 	void *osl_texture_system;
 	bool pack_images;
+	bool compact_images;
+	bool use_texture_cache;
+	int texture_cache_size;
+
+	ImageDataType get_image_data_type(Image *img, bool is_float);
 
-	bool file_load_image(Image *img, device_vector<uchar4>& tex_img);
-	bool file_load_float_image(Image *img, device_vector<float4>& tex_img);
+	template<TypeDesc::BASETYPE FileFormat, typename StorageType, typename DeviceType>
+	bool file_load_image(Image *img, device_vector<DeviceType>& tex_img);
+
+	TextureCacheGlobals *texture_cache_globals(Device *device);
+	void texture_cache_add_image(TextureCacheGlobals *tcg, int slot);
 
 	void device_load_image(Device *device, DeviceScene *dscene, int slot, Progress *progess);
 	void device_free_image(Device *device, DeviceScene *dscene, int slot);
+	void device_free_image_pixels(Device *device, DeviceScene *dscene, int slot);
+
+	template<typename T>
+	void device_free_image_vector(Device *device, device_vector<T>& tex_img);
 
 	void device_pack_images(Device *device, DeviceScene *dscene, Progress& progess);
 };
@@ -61,6 +61,8 @@ Integrator::Integrator()
 	mesh_light_samples = 1;
 	subsurface_samples = 1;
 	volume_samples = 1;
+	use_light_tree = false;
+	use_volume_majorant = false;
 	method = PATH;
 
 	sampling_pattern = SAMPLING_PATTERN_SOBOL;
@@ -201,7 +203,9 @@ bool Integrator::modified(const Integrator& integrator)
 		motion_blur == integrator.motion_blur &&
 		sampling_pattern == integrator.sampling_pattern &&
 		sample_all_lights_direct == integrator.sample_all_lights_direct &&
-		sample_all_lights_indirect == integrator.sample_all_lights_indirect);
+		sample_all_lights_indirect == integrator.sample_all_lights_indirect &&
+		use_light_tree == integrator.use_light_tree &&
+		use_volume_majorant == integrator.use_volume_majorant);
 }
 
 void Integrator::tag_update(Scene *scene)
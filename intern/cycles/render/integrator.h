@@ -44,6 +44,7 @@ public:
 	int volume_homogeneous_sampling;
 	int volume_max_steps;
 	float volume_step_size;
+	bool use_volume_majorant;
 
 	bool no_caustics;
 	float filter_glossy;
@@ -65,6 +66,7 @@ public:
 	int volume_samples;
 	bool sample_all_lights_direct;
 	bool sample_all_lights_indirect;
+	bool use_light_tree;
 
 	enum Method {
 		BRANCHED_PATH = 0,
@@ -19,6 +19,7 @@
 #include "integrator.h"
 #include "film.h"
 #include "light.h"
+#include "light_tree.h"
 #include "mesh.h"
 #include "object.h"
 #include "scene.h"
@@ -191,6 +192,19 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 	float4 *distribution = dscene->light_distribution.resize(num_distribution + 1);
 	float totarea = 0.0f;
 
+	/* light tree emitters, with for triangles the leaves table entry */
+	bool use_light_tree = scene->integrator->use_light_tree;
+	vector<LightTreeEmitter> triangle_emitters;
+	vector<LightTreeEmitter> lamp_emitters;
+	vector<uint> leaves;
+	vector<size_t> triangle_leaves;
+
+	if(use_light_tree) {
+		leaves.resize(scene->objects.size()*2, 0);
+		triangle_emitters.reserve(num_triangles);
+		triangle_leaves.reserve(num_triangles);
+	}
+
 	/* triangles */
 	size_t offset = 0;
 	int j = 0;
@@ -206,8 +220,10 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 		}
 
 		/* skip motion blurred deforming meshes, not supported yet */
-		if(mesh->has_motion_blur())
+		if(mesh->has_motion_blur()) {
+			j++;
 			continue;
+		}
 
 		/* skip if we have no emission shaders */
 		foreach(uint sindex, mesh->used_shaders) {
@@ -242,6 +258,14 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 				use_light_visibility = true;
 			}
 
+			size_t leaves_offset = leaves.size();
+
+			if(use_light_tree) {
+				leaves[j*2 + 0] = leaves_offset;
+				leaves[j*2 + 1] = mesh->tri_offset;
+				leaves.resize(leaves_offset + mesh->triangles.size(), ~0u);
+			}
+
 			for(size_t i = 0; i < mesh->triangles.size(); i++) {
 				Shader *shader = scene->shaders[mesh->shader[i]];
 
@@ -263,7 +287,27 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 						p3 = transform_point(&tfm, p3);
 					}
 
-					totarea += triangle_area(p1, p2, p3);
+					float area = triangle_area(p1, p2, p3);
+
+					if(use_light_tree) {
+						/* triangles emit from both sides */
+						float3 N = cross(p2 - p1, p3 - p1);
+						N = (len(N) > 0.0f)? normalize(N): make_float3(0.0f, 0.0f, 1.0f);
+
+						LightTreeEmitter emitter;
+						emitter.bounds = BoundBox(p1);
+						emitter.bounds.grow(p2);
+						emitter.bounds.grow(p3);
+						emitter.cone = LightTreeCone(N, 0.0f, M_PI_2_F, true);
+						emitter.energy = area*shader->emission_estimate;
+						emitter.area = area;
+						emitter.distribution_index = offset - 1;
+
+						triangle_emitters.push_back(emitter);
+						triangle_leaves.push_back(leaves_offset + i);
+					}
+
+					totarea += area;
 				}
 			}
 		}
@@ -275,23 +319,64 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 
 	float trianglearea = totarea;
 
-	/* point lights */
+	/* point lights, with lamps that have a position first so that the light
+	 * tree can replace that part of the distribution */
 	float lightarea = (totarea > 0.0f)? totarea/scene->lights.size(): 1.0f;
 	bool use_lamp_mis = false;
 
-	for(int i = 0; i < scene->lights.size(); i++, offset++) {
-		Light *light = scene->lights[i];
+	for(int pass = 0; pass < 2; pass++) {
+		for(int i = 0; i < scene->lights.size(); i++) {
+			Light *light = scene->lights[i];
+			bool positional = (light->type == LIGHT_POINT || light->type == LIGHT_SPOT || light->type == LIGHT_AREA);
+
+			if(positional != (pass == 0))
+				continue;
 
-		distribution[offset].x = totarea;
-		distribution[offset].y = __int_as_float(~(int)i);
-		distribution[offset].z = 1.0f;
-		distribution[offset].w = light->size;
-		totarea += lightarea;
+			if(use_light_tree && positional) {
+				LightTreeEmitter emitter;
+				float3 dir = (len(light->dir) > 0.0f)? normalize(light->dir): make_float3(0.0f, 0.0f, 1.0f);
 
-		if(light->size > 0.0f && light->use_mis)
-			use_lamp_mis = true;
-		if(light->type == LIGHT_BACKGROUND)
-			num_background_lights++;
+				if(light->type == LIGHT_AREA) {
+					float3 axisu = light->axisu*(light->sizeu*light->size*0.5f);
+					float3 axisv = light->axisv*(light->sizev*light->size*0.5f);
+
+					emitter.bounds = BoundBox(light->co - axisu - axisv);
+					emitter.bounds.grow(light->co - axisu + axisv);
+					emitter.bounds.grow(light->co + axisu - axisv);
+					emitter.bounds.grow(light->co + axisu + axisv);
+					emitter.cone = LightTreeCone(dir, 0.0f, M_PI_2_F, false);
+				}
+				else {
+					emitter.bounds = BoundBox(light->co);
+					emitter.bounds.grow(light->co, light->size);
+
+					if(light->type == LIGHT_SPOT)
+						emitter.cone = LightTreeCone(dir, 0.0f, min(light->spot_angle*0.5f, M_PI_F), false);
+					else
+						emitter.cone = LightTreeCone(dir, M_PI_F, M_PI_2_F, false);
+				}
+
+				/* lamp strength is already a total power, comparable to
+				 * strength times area for mesh emitters */
+				emitter.energy = scene->shaders[light->shader]->emission_estimate;
+				emitter.area = 0.0f;
+				emitter.distribution_index = offset;
+
+				lamp_emitters.push_back(emitter);
+			}
+
+			distribution[offset].x = totarea;
+			distribution[offset].y = __int_as_float(~(int)i);
+			distribution[offset].z = 1.0f;
+			distribution[offset].w = light->size;
+			totarea += lightarea;
+			offset++;
+
+			if(light->size > 0.0f && light->use_mis)
+				use_lamp_mis = true;
+			if(light->type == LIGHT_BACKGROUND)
+				num_background_lights++;
+		}
 	}
 
 	/* normalize cumulative distribution functions */
@@ -341,6 +426,38 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 
 		kintegrator->use_lamp_mis = use_lamp_mis;
 
+		/* light tree */
+		kintegrator->use_light_tree = use_light_tree;
+
+		if(use_light_tree) {
+			LightTree triangle_tree(triangle_emitters);
+			LightTree lamp_tree(lamp_emitters);
+			size_t num_nodes = triangle_tree.num_nodes() + lamp_tree.num_nodes();
+			float4 *nodes = dscene->light_tree_nodes.resize(((num_nodes)? num_nodes: 1)*LIGHT_TREE_NODE_SIZE);
+			vector<int> leaf_nodes;
+
+			triangle_tree.pack(nodes, 0, leaf_nodes);
+			for(size_t i = 0; i < triangle_leaves.size(); i++)
+				leaves[triangle_leaves[i]] = leaf_nodes[i];
+
+			lamp_tree.pack(nodes, triangle_tree.num_nodes(), leaf_nodes);
+
+			/* pick groups with the same probability as the distribution */
+			size_t num_lamp_emitters = lamp_emitters.size();
+
+			kintegrator->light_tree_lamp_root = triangle_tree.num_nodes();
+			kintegrator->light_tree_pdf_triangles = distribution[num_triangles].x;
+			kintegrator->light_tree_pdf_lamps = distribution[num_triangles + num_lamp_emitters].x - distribution[num_triangles].x;
+
+			if(leaves.size() == 0)
+				leaves.push_back(0);
+
+			dscene->light_tree_leaves.copy(&leaves[0], leaves.size());
+
+			device->tex_alloc("__light_tree_nodes", dscene->light_tree_nodes);
+			device->tex_alloc("__light_tree_leaves", dscene->light_tree_leaves);
+		}
+
 		/* bit of an ugly hack to compensate for emitting triangles influencing
 		 * amount of samples we get for this pass */
 		kfilm->pass_shadow_scale = 1.0f;
@@ -363,6 +480,7 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 		kintegrator->pdf_lights = 0.0f;
 		kintegrator->inv_pdf_lights = 0.0f;
 		kintegrator->use_lamp_mis = false;
+		kintegrator->use_light_tree = false;
 		kfilm->pass_shadow_scale = 1.0f;
 	}
 }
@@ -633,11 +751,15 @@ void LightManager::device_free(Device *device, DeviceScene *dscene)
 	device->tex_free(dscene->light_data);
 	device->tex_free(dscene->light_background_marginal_cdf);
 	device->tex_free(dscene->light_background_conditional_cdf);
+	device->tex_free(dscene->light_tree_nodes);
+	device->tex_free(dscene->light_tree_leaves);
 
 	dscene->light_distribution.clear();
 	dscene->light_data.clear();
 	dscene->light_background_marginal_cdf.clear();
 	dscene->light_background_conditional_cdf.clear();
+	dscene->light_tree_nodes.clear();
+	dscene->light_tree_leaves.clear();
 }
 
 void LightManager::tag_update(Scene *scene)
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#include "kernel_types.h"
+
+#include "light_tree.h"
+
+#include "util_algorithm.h"
+#include "util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Cone */
+
+LightTreeCone::LightTreeCone()
+: axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f), two_sided(false)
+{
+}
+
+LightTreeCone::LightTreeCone(const float3& axis_, float theta_o_, float theta_e_, bool two_sided_)
+: axis(axis_), theta_o(theta_o_), theta_e(theta_e_), two_sided(two_sided_)
+{
+}
+
+LightTreeCone LightTreeCone::merge(const LightTreeCone& cone_a, const LightTreeCone& cone_b)
+{
+	LightTreeCone a = cone_a, b = cone_b;
+
+	if(b.theta_o > a.theta_o)
+		swap(a, b);
+
+	/* two sided emitters radiate to both sides, so their axis may be
+	 * flipped to get a tighter cone */
+	if(dot(a.axis, b.axis) < 0.0f) {
+		if(b.two_sided)
+			b.axis = -b.axis;
+		else if(a.two_sided)
+			a.axis = -a.axis;
+	}
+
+	float theta_e = max(a.theta_e, b.theta_e);
+	bool two_sided = a.two_sided || b.two_sided;
+	float theta_d = safe_acosf(dot(a.axis, b.axis));
+
+	/* b is contained in a */
+	if(min(theta_d + b.theta_o, M_PI_F) <= a.theta_o)
+		return LightTreeCone(a.axis, a.theta_o, theta_e, two_sided);
+
+	/* otherwise find the smallest cone containing both */
+	float theta_o = (a.theta_o + theta_d + b.theta_o)*0.5f;
+	float3 rotation_axis = cross(a.axis, b.axis);
+
+	if(theta_o >= M_PI_F || len(rotation_axis) < 1e-6f)
+		return LightTreeCone(a.axis, M_PI_F, theta_e, two_sided);
+
+	float3 axis = rotate_around_axis(a.axis, normalize(rotation_axis), theta_o - a.theta_o);
+
+	return LightTreeCone(normalize(axis), theta_o, theta_e, two_sided);
+}
+
+/* Tree */
+
+LightTree::LightTree(const vector<LightTreeEmitter>& emitters_)
+: emitters(emitters_)
+{
+	if(emitters.size() == 0)
+		return;
+
+	vector<int> indices(emitters.size());
+
+	for(size_t i = 0; i < emitters.size(); i++)
+		indices[i] = i;
+
+	nodes.reserve(emitters.size()*2 - 1);
+	build(indices, 0, indices.size(), -1);
+}
+
+struct LightTreeCentroidCompare {
+	const vector<LightTreeEmitter> *emitters;
+	int dim;
+
+	bool operator()(int a, int b) const
+	{
+		const BoundBox& ba = (*emitters)[a].bounds;
+		const BoundBox& bb = (*emitters)[b].bounds;
+		float ca = (ba.min[dim] + ba.max[dim]);
+		float cb = (bb.min[dim] + bb.max[dim]);
+
+		return (ca < cb);
+	}
+};
+
+int LightTree::build(vector<int>& indices, int start, int end, int parent)
+{
+	int index = nodes.size();
+	nodes.push_back(Node());
+
+	/* bounds, orientation and energy of all emitters below this node */
+	BoundBox bounds = BoundBox::empty;
+	BoundBox centroid_bounds = BoundBox::empty;
+	LightTreeCone cone = emitters[indices[start]].cone;
+	float energy = 0.0f;
+
+	for(int i = start; i < end; i++) {
+		const LightTreeEmitter& emitter = emitters[indices[i]];
+
+		bounds.grow(emitter.bounds);
+		centroid_bounds.grow(emitter.bounds.center());
+		energy += emitter.energy;
+
+		if(i != start)
+			cone = LightTreeCone::merge(cone, emitter.cone);
+	}
+
+	int right_child = -1;
+	int emitter = -1;
+
+	if(end - start == 1) {
+		emitter = indices[start];
+	}
+	else {
+		/* split at the median along the largest axis of the centroids, this
+		 * always divides the emitters in two, also for coincident centroids */
+		float3 size = centroid_bounds.size();
+		LightTreeCentroidCompare compare;
+
+		compare.emitters = &emitters;
+		compare.dim = (size.x > size.y)? ((size.x > size.z)? 0: 2): ((size.y > size.z)? 1: 2);
+
+		int middle = (start + end)/2;
+		std::nth_element(indices.begin() + start, indices.begin() + middle, indices.begin() + end, compare);
+
+		build(indices, start, middle, index);
+		right_child = build(indices, middle, end, index);
+	}
+
+	Node& node = nodes[index];
+	node.bounds = bounds;
+	node.cone = cone;
+	node.energy = energy;
+	node.parent = parent;
+	node.right_child = right_child;
+	node.emitter = emitter;
+
+	return index;
+}
+
+void LightTree::pack(float4 *data, int offset, vector<int>& leaf_nodes) const
+{
+	leaf_nodes.resize(emitters.size());
+
+	for(size_t i = 0; i < nodes.size(); i++) {
+		const Node& node = nodes[i];
+		int child;
+		float area = 0.0f;
+
+		if(node.emitter != -1) {
+			child = ~emitters[node.emitter].distribution_index;
+			area = emitters[node.emitter].area;
+			leaf_nodes[node.emitter] = offset + i;
+		}
+		else
+			child = offset + node.right_child;
+
+		int parent = (node.parent == -1)? -1: offset + node.parent;
+		float4 *d = data + (offset + i)*LIGHT_TREE_NODE_SIZE;
+
+		d[0] = make_float4(node.bounds.min.x, node.bounds.min.y, node.bounds.min.z, node.energy);
+		d[1] = make_float4(node.bounds.max.x, node.bounds.max.y, node.bounds.max.z, __int_as_float(child));
+		d[2] = make_float4(node.cone.axis.x, node.cone.axis.y, node.cone.axis.z, node.cone.theta_o);
+		d[3] = make_float4(node.cone.theta_e, __int_as_float(node.cone.two_sided), __int_as_float(parent), area);
+	}
+}
+
+CCL_NAMESPACE_END
+
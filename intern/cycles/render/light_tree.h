@@ -0,0 +1,96 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "util_boundbox.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree Cone
+ *
+ * Bounds the directions into which a set of emitters radiates: all normals
+ * lie within theta_o of the axis, and each emitter emits light up to
+ * theta_e away from its normal. */
+
+class LightTreeCone {
+public:
+	float3 axis;
+	float theta_o;
+	float theta_e;
+	bool two_sided;
+
+	LightTreeCone();
+	LightTreeCone(const float3& axis, float theta_o, float theta_e, bool two_sided);
+
+	static LightTreeCone merge(const LightTreeCone& a, const LightTreeCone& b);
+};
+
+/* Light Tree Emitter
+ *
+ * A triangle or lamp that can be picked from the tree, referring to its
+ * entry in the light distribution. Energy is the area times the emission
+ * strength where known, area is kept for the triangle sampling pdf. */
+
+class LightTreeEmitter {
+public:
+	BoundBox bounds;
+	LightTreeCone cone;
+	float energy;
+	float area;
+	int distribution_index;
+};
+
+/* Light Tree
+ *
+ * Binary tree over emitters, used by the kernel to pick an emitter with a
+ * probability that takes into account distance and orientation relative to
+ * the shading point. Nodes are stored depth first, so the left child of a
+ * node directly follows it. */
+
+class LightTree {
+public:
+	LightTree(const vector<LightTreeEmitter>& emitters);
+
+	size_t num_nodes() const { return nodes.size(); }
+
+	/* pack into kernel layout, with node indices starting at offset, and
+	 * store for each emitter the index of its leaf node */
+	void pack(float4 *data, int offset, vector<int>& leaf_nodes) const;
+
+protected:
+	struct Node {
+		BoundBox bounds;
+		LightTreeCone cone;
+		float energy;
+		int parent;
+		int right_child;
+		int emitter;
+	};
+
+	vector<LightTreeEmitter> emitters;
+	vector<Node> nodes;
+
+	int build(vector<int>& indices, int start, int end, int parent);
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
+
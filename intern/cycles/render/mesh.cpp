@@ -74,6 +74,11 @@ Mesh::Mesh()
 {
 	need_update = true;
 	need_update_rebuild = false;
+	topology_stable = false;
+	source_hash = 0;
+	volume_majorant_resolution = make_int3(0, 0, 0);
+	volume_majorant_max = 0.0f;
+
 	transform_applied = false;
 	transform_negative_scaled = false;
 	transform_normal = transform_identity();
@@ -132,6 +137,12 @@ void Mesh::clear()
 	transform_applied = false;
 	transform_negative_scaled = false;
 	transform_normal = transform_identity();
+
+	source_hash = 0;
+
+	volume_majorant.clear();
+	volume_majorant_resolution = make_int3(0, 0, 0);
+	volume_majorant_max = 0.0f;
 }
 
 int Mesh::split_vertex(int vertex)
@@ -509,12 +520,22 @@ void Mesh::compute_bvh(SceneParams *params, Progress *progress, int n, int total
 		vector<Object*> objects;
 		objects.push_back(&object);
 
-		if(bvh && !need_update_rebuild) {
+		bool rebuild = (!bvh || need_update_rebuild);
+
+		if(!rebuild) {
 			progress->set_status(msg, "Refitting BVH");
 			bvh->objects = objects;
 			bvh->refit(*progress);
+
+			/* deformation can make the refit BVH much slower to traverse
+			 * than a new one, rebuild once the SAH cost grew too much */
+			float threshold = params->bvh_refit_threshold;
+
+			if(threshold > 0.0f && bvh->sah_cost() > bvh->build_sah_cost*threshold)
+				rebuild = true;
 		}
-		else {
+
+		if(rebuild) {
 			progress->set_status(msg, "Building BVH");
 
 			BVHParams bparams;
@@ -538,9 +559,12 @@ void Mesh::tag_update(Scene *scene, bool rebuild)
 
 	if(rebuild) {
 		need_update_rebuild = true;
+		topology_stable = false;
 		scene->light_manager->need_update = true;
 	}
 	else {
+		topology_stable = true;
+
 		foreach(uint sindex, used_shaders)
 			if(scene->shaders[sindex]->has_surface_emission)
 				scene->light_manager->need_update = true;
@@ -1072,6 +1096,10 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 		if(progress.get_cancel()) return;
 	}
 
+	/* update volume majorants, before need_update is reset by the bvh build */
+	device_update_volume_majorants(device, dscene, scene, progress);
+	if(progress.get_cancel()) return;
+
 	/* update bvh */
 	size_t i = 0, num_bvh = 0;
 
@@ -1128,6 +1156,8 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	device->tex_free(dscene->attributes_map);
 	device->tex_free(dscene->attributes_float);
 	device->tex_free(dscene->attributes_float3);
+	device->tex_free(dscene->volume_majorant_info);
+	device->tex_free(dscene->volume_majorant_grid);
 
 	dscene->bvh_nodes.clear();
 	dscene->object_node.clear();
@@ -1145,6 +1175,8 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->attributes_map.clear();
 	dscene->attributes_float.clear();
 	dscene->attributes_float3.clear();
+	dscene->volume_majorant_info.clear();
+	dscene->volume_majorant_grid.clear();
 
 #ifdef WITH_OSL
 	OSLGlobals *og = (OSLGlobals*)device->osl_memory();
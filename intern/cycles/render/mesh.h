@@ -33,6 +33,7 @@ CCL_NAMESPACE_BEGIN
 class BVH;
 class Device;
 class DeviceScene;
+class ImageManager;
 class Mesh;
 class Progress;
 class Scene;
@@ -96,6 +97,20 @@ public:
 	bool need_update;
 	bool need_update_rebuild;
 
+	/* updated with unchanged topology, as for deformation in an animation,
+	 * such meshes keep their own BVH so it can be refit in later frames */
+	bool topology_stable;
+
+	/* hash of the data the mesh was last created from, so exporters can skip
+	 * converting and rebuilding unchanged meshes, reset by clear() */
+	uint64_t source_hash;
+
+	/* coarse grid with the maximum of the density voxels in each cell, for
+	 * tracking through volumes, see mesh_volume.cpp */
+	vector<float> volume_majorant;
+	int3 volume_majorant_resolution;
+	float volume_majorant_max;
+
 	/* BVH */
 	BVH *bvh;
 	size_t tri_offset;
@@ -124,6 +139,7 @@ public:
 	void pack_verts(float4 *tri_verts, float4 *tri_vindex, size_t vert_offset);
 	void pack_curves(Scene *scene, float4 *curve_key_co, float4 *curve_data, size_t curvekey_offset);
 	void compute_bvh(SceneParams *params, Progress *progress, int n, int total);
+	void compute_volume_majorant(ImageManager *image_manager);
 
 	bool need_attribute(Scene *scene, AttributeStandard std);
 	bool need_attribute(Scene *scene, ustring name);
@@ -155,6 +171,7 @@ public:
 	void device_update_mesh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_update_attributes(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
+	void device_update_volume_majorants(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_free(Device *device, DeviceScene *dscene);
 
 	void tag_update(Scene *scene);
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2011-2013 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License
+ */
+
+#include "device.h"
+
+#include "attribute.h"
+#include "image.h"
+#include "integrator.h"
+#include "mesh.h"
+#include "object.h"
+#include "scene.h"
+#include "shader.h"
+
+#include "util_foreach.h"
+#include "util_map.h"
+#include "util_progress.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Volume Majorant Grid
+ *
+ * Coarse grid over the density voxels of a mesh, storing the maximum density
+ * in each cell. Together with the extinction bound of the volume shaders this
+ * gives the kernel a majorant for delta and ratio tracking, and lets it skip
+ * cells that are empty. Voxels are interpolated linearly, so each voxel
+ * contributes to the cells overlapping the half voxel around it as well. */
+
+#define VOLUME_MAJORANT_CELL_VOXELS 8
+#define VOLUME_MAJORANT_MAX_RESOLUTION 64
+
+/* voxels are stored as floats, but the kernel interpolates and transforms
+ * them in single precision too, scale the majorant up a little to stay above
+ * values after rounding */
+#define VOLUME_MAJORANT_MARGIN 1.01f
+
+static void volume_majorant_cell_range(int voxels, int cells, vector<int>& lo, vector<int>& hi)
+{
+	lo.resize(voxels);
+	hi.resize(voxels);
+
+	for(int i = 0; i < voxels; i++) {
+		/* a voxel affects lookups between the centers of its neighbours,
+		 * with some margin for precision of the ray stepping */
+		float t0 = ((float)i - 0.5f)/(float)voxels - 1e-4f;
+		float t1 = ((float)i + 1.5f)/(float)voxels + 1e-4f;
+
+		lo[i] = clamp((int)floorf(t0*cells), 0, cells - 1);
+		hi[i] = clamp((int)floorf(t1*cells), 0, cells - 1);
+	}
+}
+
+void Mesh::compute_volume_majorant(ImageManager *image_manager)
+{
+	volume_majorant.clear();
+	volume_majorant_resolution = make_int3(0, 0, 0);
+	volume_majorant_max = 0.0f;
+
+	Attribute *attr = attributes.find(ATTR_STD_VOLUME_DENSITY);
+
+	if(!attr || attr->element != ATTR_ELEMENT_VOXEL || !attr->data_voxel())
+		return;
+
+	vector<float> pixels;
+	int width, height, depth, channels;
+
+	if(!image_manager->builtin_float_pixels(attr->data_voxel()->slot, pixels, width, height, depth, channels))
+		return;
+
+	/* density lookups average RGB, single channels are used directly */
+	if(!(channels == 1 || channels == 3 || channels == 4))
+		return;
+
+	int rx = min((width + VOLUME_MAJORANT_CELL_VOXELS - 1)/VOLUME_MAJORANT_CELL_VOXELS, VOLUME_MAJORANT_MAX_RESOLUTION);
+	int ry = min((height + VOLUME_MAJORANT_CELL_VOXELS - 1)/VOLUME_MAJORANT_CELL_VOXELS, VOLUME_MAJORANT_MAX_RESOLUTION);
+	int rz = min((depth + VOLUME_MAJORANT_CELL_VOXELS - 1)/VOLUME_MAJORANT_CELL_VOXELS, VOLUME_MAJORANT_MAX_RESOLUTION);
+
+	vector<int> x_lo, x_hi, y_lo, y_hi, z_lo, z_hi;
+
+	volume_majorant_cell_range(width, rx, x_lo, x_hi);
+	volume_majorant_cell_range(height, ry, y_lo, y_hi);
+	volume_majorant_cell_range(depth, rz, z_lo, z_hi);
+
+	volume_majorant.resize((size_t)rx*ry*rz, 0.0f);
+	volume_majorant_resolution = make_int3(rx, ry, rz);
+
+	const float *voxel = &pixels[0];
+
+	for(int z = 0; z < depth; z++) {
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++, voxel += channels) {
+				float density = (channels == 1)? voxel[0]: (voxel[0] + voxel[1] + voxel[2])*(1.0f/3.0f);
+
+				if(!(density > 0.0f))
+					continue;
+
+				volume_majorant_max = max(volume_majorant_max, density);
+
+				for(int k = z_lo[z]; k <= z_hi[z]; k++) {
+					for(int j = y_lo[y]; j <= y_hi[y]; j++) {
+						float *cell = &volume_majorant[((size_t)k*ry + j)*rx];
+
+						for(int i = x_lo[x]; i <= x_hi[x]; i++)
+							cell[i] = max(cell[i], density);
+					}
+				}
+			}
+		}
+	}
+}
+
+void MeshManager::device_update_volume_majorants(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+{
+	KernelIntegrator *kintegrator = &dscene->data.integrator;
+	kintegrator->use_volume_majorant = false;
+
+	if(!scene->integrator->use_volume_majorant || scene->objects.size() == 0)
+		return;
+
+	/* build grids of changed meshes */
+	foreach(Mesh *mesh, scene->meshes) {
+		if(mesh->need_update || mesh->volume_majorant.empty()) {
+			bool has_volume = false;
+
+			foreach(uint sindex, mesh->used_shaders)
+				if(scene->shaders[sindex]->has_volume)
+					has_volume = true;
+
+			if(has_volume) {
+				progress.set_status("Updating Mesh", "Computing volume majorants");
+				mesh->compute_volume_majorant(scene->image_manager);
+			}
+			else if(!mesh->volume_majorant.empty()) {
+				mesh->volume_majorant.clear();
+				mesh->volume_majorant_resolution = make_int3(0, 0, 0);
+			}
+
+			if(progress.get_cancel()) return;
+		}
+	}
+
+	/* pack grids, shared between instances */
+	map<Mesh*, int> grid_offset;
+	size_t grid_size = 0;
+
+	foreach(Mesh *mesh, scene->meshes) {
+		if(mesh->volume_majorant.size() && grid_offset.find(mesh) == grid_offset.end()) {
+			grid_offset[mesh] = grid_size;
+			grid_size += mesh->volume_majorant.size();
+		}
+	}
+
+	if(grid_size == 0)
+		return;
+
+	float *grid = dscene->volume_majorant_grid.resize(grid_size);
+
+	for(map<Mesh*, int>::iterator it = grid_offset.begin(); it != grid_offset.end(); it++)
+		memcpy(grid + it->second, &it->first->volume_majorant[0], sizeof(float)*it->first->volume_majorant.size());
+
+	/* per object transform into the grid and extinction bound */
+	float4 *info = dscene->volume_majorant_info.resize(scene->objects.size()*VOLUME_MAJORANT_SIZE);
+	bool have_majorant = false;
+	size_t i = 0;
+
+	foreach(Object *object, scene->objects) {
+		Mesh *mesh = object->mesh;
+		float4 *data = info + i*VOLUME_MAJORANT_SIZE;
+		int offset = -1;
+
+		/* all volume shaders of the mesh must have a bound */
+		bool has_bound = false;
+		float bound_scale = 0.0f, bound_offset = 0.0f;
+
+		if(mesh->volume_majorant.size()) {
+			has_bound = true;
+
+			foreach(uint sindex, mesh->used_shaders) {
+				Shader *shader = scene->shaders[sindex];
+
+				if(!shader->has_volume)
+					continue;
+
+				if(!shader->has_volume_bound)
+					has_bound = false;
+
+				bound_scale = max(bound_scale, shader->volume_bound_scale);
+				bound_offset = max(bound_offset, shader->volume_bound_offset);
+			}
+		}
+
+		Transform tfm = transform_identity();
+
+		if(has_bound) {
+			int3 res = mesh->volume_majorant_resolution;
+			Attribute *attr = mesh->attributes.find(ATTR_STD_GENERATED_TRANSFORM);
+			Transform ntfm = (attr)? *attr->data_transform(): transform_identity();
+
+			/* from world space to normalized voxel coordinates as used by
+			 * the density lookup, then to cell coordinates */
+			tfm = transform_scale((float)res.x, (float)res.y, (float)res.z) * ntfm * transform_inverse(object->tfm);
+			offset = grid_offset[mesh];
+			have_majorant = true;
+		}
+
+		data[0] = tfm.x;
+		data[1] = tfm.y;
+		data[2] = tfm.z;
+		data[3] = make_float4(__int_as_float(mesh->volume_majorant_resolution.x),
+		                      __int_as_float(mesh->volume_majorant_resolution.y),
+		                      __int_as_float(mesh->volume_majorant_resolution.z),
+		                      __int_as_float(offset));
+		data[4] = make_float4(bound_scale*VOLUME_MAJORANT_MARGIN,
+		                      bound_offset*VOLUME_MAJORANT_MARGIN,
+		                      mesh->volume_majorant_max,
+		                      0.0f);
+
+		i++;
+	}
+
+	device->tex_alloc("__volume_majorant_info", dscene->volume_majorant_info);
+	device->tex_alloc("__volume_majorant_grid", dscene->volume_majorant_grid);
+
+	kintegrator->use_volume_majorant = have_majorant;
+}
+
+CCL_NAMESPACE_END
+
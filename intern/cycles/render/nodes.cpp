@@ -20,6 +20,11 @@
 #include "osl.h"
 #include "sky_model.h"
 
+#include "svm_color_util.h"
+#include "svm_math_util.h"
+#include "svm_ramp_util.h"
+
+#include "util_color.h"
 #include "util_foreach.h"
 #include "util_transform.h"
 
@@ -263,13 +268,38 @@ void ImageTextureNode::compile(SVMCompiler& compiler)
 		}
 
 		if(projection == "Flat") {
+			/* UV attribute to compute differentials from, for mip level
+			 * selection when images are read through the texture cache */
+			uint uv_attr = ATTR_STD_NONE;
+			ShaderOutput *vector_link = vector_in->link;
+
+			if(vector_link && tex_mapping.skip()) {
+				ShaderNode *parent = vector_link->parent;
+
+				if(parent->name == "texture_coordinate" && vector_link == parent->output("UV")) {
+					if(!((TextureCoordinateNode*)parent)->from_dupli)
+						uv_attr = compiler.attribute(ATTR_STD_UV);
+				}
+				else if(parent->name == "uvmap") {
+					UVMapNode *uvmap = (UVMapNode*)parent;
+
+					if(!uvmap->from_dupli) {
+						if(uvmap->attribute != "")
+							uv_attr = compiler.attribute(uvmap->attribute);
+						else
+							uv_attr = compiler.attribute(ATTR_STD_UV);
+					}
+				}
+			}
+
 			compiler.add_node(NODE_TEX_IMAGE,
 				slot,
 				compiler.encode_uchar4(
 					vector_offset,
 					color_out->stack_offset,
 					alpha_out->stack_offset,
-					srgb));
+					srgb),
+				uv_attr);
 		}
 		else {
 			compiler.add_node(NODE_TEX_IMAGE_BOX,
@@ -1360,6 +1390,36 @@ ConvertNode::ConvertNode(ShaderSocketType from_, ShaderSocketType to_, bool auto
 		assert(0);
 }
 
+bool ConvertNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *in = inputs[0];
+
+	if(in->link)
+		return false;
+	if(from == SHADER_SOCKET_INT || from == SHADER_SOCKET_STRING || to == SHADER_SOCKET_INT)
+		return false;
+
+	/* same conversions as svm_node_convert */
+	float3 value = in->value;
+
+	if(from == SHADER_SOCKET_FLOAT)
+		*optimized_value = make_float3(value.x, value.x, value.x);
+	else if(to == SHADER_SOCKET_FLOAT && from == SHADER_SOCKET_COLOR)
+		*optimized_value = make_float3(linear_rgb_to_gray(value), 0.0f, 0.0f);
+	else if(to == SHADER_SOCKET_FLOAT)
+		*optimized_value = make_float3((value.x + value.y + value.z)*(1.0f/3.0f), 0.0f, 0.0f);
+	else
+		*optimized_value = value;
+
+	return true;
+}
+
+bool ConvertNode::equals(ShaderNode *other)
+{
+	ConvertNode *convert = (ConvertNode*)other;
+	return equals_inputs(other) && from == convert->from && to == convert->to;
+}
+
 void ConvertNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *in = inputs[0];
@@ -1857,6 +1917,16 @@ EmissionNode::EmissionNode()
 	add_output("Emission", SHADER_SOCKET_CLOSURE);
 }
 
+bool EmissionNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *color_in = input("Color");
+	ShaderInput *strength_in = input("Strength");
+
+	/* no emission at all */
+	return ((!color_in->link && is_zero(color_in->value)) ||
+	        (!strength_in->link && strength_in->value.x == 0.0f));
+}
+
 void EmissionNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *color_in = input("Color");
@@ -1893,6 +1963,16 @@ BackgroundNode::BackgroundNode()
 	add_output("Background", SHADER_SOCKET_CLOSURE);
 }
 
+bool BackgroundNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *color_in = input("Color");
+	ShaderInput *strength_in = input("Strength");
+
+	/* no emission at all */
+	return ((!color_in->link && is_zero(color_in->value)) ||
+	        (!strength_in->link && strength_in->value.x == 0.0f));
+}
+
 void BackgroundNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *color_in = input("Color");
@@ -2222,6 +2302,11 @@ void TextureCoordinateNode::attributes(Shader *shader, AttributeRequestSet *attr
 	ShaderNode::attributes(shader, attributes);
 }
 
+bool TextureCoordinateNode::equals(ShaderNode *other)
+{
+	return equals_inputs(other) && from_dupli == ((TextureCoordinateNode*)other)->from_dupli;
+}
+
 void TextureCoordinateNode::compile(SVMCompiler& compiler)
 {
 	ShaderOutput *out;
@@ -2357,6 +2442,12 @@ void UVMapNode::attributes(Shader *shader, AttributeRequestSet *attributes)
 	ShaderNode::attributes(shader, attributes);
 }
 
+bool UVMapNode::equals(ShaderNode *other)
+{
+	UVMapNode *uvmap = (UVMapNode*)other;
+	return equals_inputs(other) && attribute == uvmap->attribute && from_dupli == uvmap->from_dupli;
+}
+
 void UVMapNode::compile(SVMCompiler& compiler)
 {
 	ShaderOutput *out = output("UV");
@@ -2768,6 +2859,12 @@ ValueNode::ValueNode()
 	add_output("Value", SHADER_SOCKET_FLOAT);
 }
 
+bool ValueNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	*optimized_value = make_float3(value, 0.0f, 0.0f);
+	return true;
+}
+
 void ValueNode::compile(SVMCompiler& compiler)
 {
 	ShaderOutput *val_out = output("Value");
@@ -2792,6 +2889,12 @@ ColorNode::ColorNode()
 	add_output("Color", SHADER_SOCKET_COLOR);
 }
 
+bool ColorNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	*optimized_value = value;
+	return true;
+}
+
 void ColorNode::compile(SVMCompiler& compiler)
 {
 	ShaderOutput *color_out = output("Color");
@@ -2957,6 +3060,49 @@ static ShaderEnum mix_type_init()
 
 ShaderEnum MixNode::type_enum = mix_type_init();
 
+bool MixNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *fac_in = input("Fac");
+	ShaderInput *color1_in = input("Color1");
+	ShaderInput *color2_in = input("Color2");
+
+	if(fac_in->link || color1_in->link || color2_in->link)
+		return false;
+
+	float3 result = svm_mix((NodeMix)type_enum[type], fac_in->value.x, color1_in->value, color2_in->value);
+
+	if(use_clamp)
+		result = svm_mix_clamp(result);
+
+	*optimized_value = result;
+	return true;
+}
+
+ShaderInput *MixNode::constant_fold_bypass(ShaderOutput *socket)
+{
+	ShaderInput *fac_in = input("Fac");
+
+	if(fac_in->link || use_clamp)
+		return NULL;
+
+	/* these blend types give exactly the first color for factor 0 */
+	NodeMix mix_type = (NodeMix)type_enum[type];
+	bool lerp = (mix_type == NODE_MIX_BLEND || mix_type == NODE_MIX_ADD || mix_type == NODE_MIX_MUL);
+
+	if(lerp && fac_in->value.x <= 0.0f)
+		return input("Color1");
+	else if(mix_type == NODE_MIX_BLEND && fac_in->value.x >= 1.0f)
+		return input("Color2");
+
+	return NULL;
+}
+
+bool MixNode::equals(ShaderNode *other)
+{
+	MixNode *mix = (MixNode*)other;
+	return equals_inputs(other) && type == mix->type && use_clamp == mix->use_clamp;
+}
+
 void MixNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *fac_in = input("Fac");
@@ -3245,6 +3391,11 @@ void AttributeNode::attributes(Shader *shader, AttributeRequestSet *attributes)
 	ShaderNode::attributes(shader, attributes);
 }
 
+bool AttributeNode::equals(ShaderNode *other)
+{
+	return equals_inputs(other) && attribute == ((AttributeNode*)other)->attribute;
+}
+
 void AttributeNode::compile(SVMCompiler& compiler)
 {
 	ShaderOutput *color_out = output("Color");
@@ -3548,6 +3699,29 @@ static ShaderEnum math_type_init()
 
 ShaderEnum MathNode::type_enum = math_type_init();
 
+bool MathNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *value1_in = input("Value1");
+	ShaderInput *value2_in = input("Value2");
+
+	if(value1_in->link || value2_in->link)
+		return false;
+
+	float value = svm_math((NodeMath)type_enum[type], value1_in->value.x, value2_in->value.x);
+
+	if(use_clamp)
+		value = clamp(value, 0.0f, 1.0f);
+
+	*optimized_value = make_float3(value, 0.0f, 0.0f);
+	return true;
+}
+
+bool MathNode::equals(ShaderNode *other)
+{
+	MathNode *math = (MathNode*)other;
+	return equals_inputs(other) && type == math->type && use_clamp == math->use_clamp;
+}
+
 void MathNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *value1_in = input("Value1");
@@ -3603,6 +3777,32 @@ static ShaderEnum vector_math_type_init()
 
 ShaderEnum VectorMathNode::type_enum = vector_math_type_init();
 
+bool VectorMathNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *vector1_in = input("Vector1");
+	ShaderInput *vector2_in = input("Vector2");
+
+	if(vector1_in->link || vector2_in->link)
+		return false;
+
+	float value;
+	float3 vector;
+
+	svm_vector_math(&value, &vector, (NodeVectorMath)type_enum[type], vector1_in->value, vector2_in->value);
+
+	if(socket == output("Value"))
+		*optimized_value = make_float3(value, 0.0f, 0.0f);
+	else
+		*optimized_value = vector;
+
+	return true;
+}
+
+bool VectorMathNode::equals(ShaderNode *other)
+{
+	return equals_inputs(other) && type == ((VectorMathNode*)other)->type;
+}
+
 void VectorMathNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *vector1_in = input("Vector1");
@@ -3749,6 +3949,36 @@ RGBCurvesNode::RGBCurvesNode()
 	add_output("Color", SHADER_SOCKET_COLOR);
 }
 
+bool RGBCurvesNode::constant_fold(ShaderOutput *socket, float3 *optimized_value)
+{
+	ShaderInput *fac_in = input("Fac");
+	ShaderInput *color_in = input("Color");
+
+	if(fac_in->link || color_in->link)
+		return false;
+
+	float fac = fac_in->value.x;
+	float3 color = color_in->value;
+	/* same lookups as svm_node_rgb_curves */
+	float3 curved = make_float3(rgb_ramp_lookup_table(curves, color.x, true).x,
+	                            rgb_ramp_lookup_table(curves, color.y, true).y,
+	                            rgb_ramp_lookup_table(curves, color.z, true).z);
+
+	*optimized_value = (1.0f - fac)*color + fac*curved;
+	return true;
+}
+
+ShaderInput *RGBCurvesNode::constant_fold_bypass(ShaderOutput *socket)
+{
+	ShaderInput *fac_in = input("Fac");
+
+	/* curves have no effect */
+	if(!fac_in->link && fac_in->value.x == 0.0f)
+		return input("Color");
+
+	return NULL;
+}
+
 void RGBCurvesNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *fac_in = input("Fac");
@@ -193,6 +193,9 @@ public:
 	ConvertNode(ShaderSocketType from, ShaderSocketType to, bool autoconvert = false);
 	SHADER_NODE_BASE_CLASS(ConvertNode)
 
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
+	bool equals(ShaderNode *other);
+
 	ShaderSocketType from, to;
 };
 
@@ -289,6 +292,7 @@ public:
 class EmissionNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(EmissionNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
 
 	bool has_surface_emission() { return true; }
 	bool has_spatial_varying() { return true; }
@@ -299,6 +303,7 @@ public:
 class BackgroundNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(BackgroundNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
 };
 
 class HoldoutNode : public ShaderNode {
@@ -346,6 +351,7 @@ public:
 	SHADER_NODE_CLASS(GeometryNode)
 	void attributes(Shader *shader, AttributeRequestSet *attributes);
 	bool has_spatial_varying() { return true; }
+	bool equals(ShaderNode *other) { return equals_inputs(other); }
 };
 
 class TextureCoordinateNode : public ShaderNode {
@@ -353,6 +359,7 @@ public:
 	SHADER_NODE_CLASS(TextureCoordinateNode)
 	void attributes(Shader *shader, AttributeRequestSet *attributes);
 	bool has_spatial_varying() { return true; }
+	bool equals(ShaderNode *other);
 	
 	bool from_dupli;
 };
@@ -362,6 +369,7 @@ public:
 	SHADER_NODE_CLASS(UVMapNode)
 	void attributes(Shader *shader, AttributeRequestSet *attributes);
 	bool has_spatial_varying() { return true; }
+	bool equals(ShaderNode *other);
 
 	ustring attribute;
 	bool from_dupli;
@@ -400,6 +408,7 @@ public:
 class ValueNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(ValueNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
 
 	float value;
 };
@@ -407,6 +416,7 @@ public:
 class ColorNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(ColorNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
 
 	float3 value;
 };
@@ -434,6 +444,9 @@ public:
 class MixNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(MixNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
+	ShaderInput *constant_fold_bypass(ShaderOutput *socket);
+	bool equals(ShaderNode *other);
 
 	bool use_clamp;
 
@@ -444,6 +457,7 @@ public:
 class CombineRGBNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(CombineRGBNode)
+	bool equals(ShaderNode *other) { return equals_inputs(other); }
 };
 
 class CombineHSVNode : public ShaderNode {
@@ -464,6 +478,7 @@ public:
 class SeparateRGBNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(SeparateRGBNode)
+	bool equals(ShaderNode *other) { return equals_inputs(other); }
 };
 
 class SeparateHSVNode : public ShaderNode {
@@ -481,6 +496,7 @@ public:
 	SHADER_NODE_CLASS(AttributeNode)
 	void attributes(Shader *shader, AttributeRequestSet *attributes);
 	bool has_spatial_varying() { return true; }
+	bool equals(ShaderNode *other);
 
 	ustring attribute;
 };
@@ -526,6 +542,8 @@ public:
 class MathNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(MathNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
+	bool equals(ShaderNode *other);
 
 	bool use_clamp;
 
@@ -543,6 +561,8 @@ public:
 class VectorMathNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(VectorMathNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
+	bool equals(ShaderNode *other);
 
 	ustring type;
 	static ShaderEnum type_enum;
@@ -571,6 +591,8 @@ public:
 class RGBCurvesNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(RGBCurvesNode)
+	bool constant_fold(ShaderOutput *socket, float3 *optimized_value);
+	ShaderInput *constant_fold_bypass(ShaderOutput *socket);
 	float4 curves[RAMP_TABLE_SIZE];
 };
 
@@ -424,9 +424,14 @@ void ObjectManager::apply_static_transforms(DeviceScene *dscene, Scene *scene, u
 
 	if(progress.get_cancel()) return;
 
-	/* apply transforms for objects with single user meshes */
+	/* apply transforms for objects with single user meshes, except for
+	 * deforming meshes when data persists across frames, to refit their BVH */
+	bool allow_refit = scene->params.persistent_data;
+
 	foreach(Object *object, scene->objects) {
-		if(mesh_users[object->mesh] == 1) {
+		bool refit = allow_refit && object->mesh->topology_stable;
+
+		if(mesh_users[object->mesh] == 1 && !refit) {
 			if(!(motion_blur && object->use_motion)) {
 				if(!object->mesh->transform_applied) {
 					object->apply_transform();
@@ -61,8 +61,13 @@ Scene::Scene(const SceneParams& params_, const DeviceInfo& device_info_)
 	else
 		shader_manager = ShaderManager::create(this, SceneParams::SVM);
 
-	if (device_info_.type == DEVICE_CPU)
+	/* compact image storage is only supported by the CPU kernel */
+	if (device_info_.type == DEVICE_CPU) {
 		image_manager->set_extended_image_limits();
+		image_manager->set_compact_images(true);
+	}
+
+	image_manager->set_texture_cache(params.use_texture_cache, params.texture_cache_size);
 }
 
 Scene::~Scene()
@@ -83,11 +83,17 @@ public:
 	device_vector<float> attributes_float;
 	device_vector<float4> attributes_float3;
 
+	/* volumes */
+	device_vector<float4> volume_majorant_info;
+	device_vector<float> volume_majorant_grid;
+
 	/* lights */
 	device_vector<float4> light_distribution;
 	device_vector<float4> light_data;
 	device_vector<float2> light_background_marginal_cdf;
 	device_vector<float2> light_background_conditional_cdf;
+	device_vector<float4> light_tree_nodes;
+	device_vector<uint> light_tree_leaves;
 
 	/* particles */
 	device_vector<float4> particles;
@@ -107,6 +113,12 @@ public:
 	device_vector<uchar4> tex_image[TEX_EXTENDED_NUM_IMAGES];
 	device_vector<float4> tex_float_image[TEX_EXTENDED_NUM_FLOAT_IMAGES];
 
+	/* compact images, CPU only */
+	device_vector<uchar> tex_byte1_image[TEX_EXTENDED_NUM_IMAGES];
+	device_vector<half4> tex_half_image[TEX_EXTENDED_NUM_FLOAT_IMAGES];
+	device_vector<half> tex_half1_image[TEX_EXTENDED_NUM_FLOAT_IMAGES];
+	device_vector<float> tex_float1_image[TEX_EXTENDED_NUM_FLOAT_IMAGES];
+
 	/* opencl images */
 	device_vector<uchar4> tex_image_packed;
 	device_vector<uint4> tex_image_packed_info;
@@ -124,6 +136,9 @@ public:
 	bool use_bvh_spatial_split;
 	bool use_qbvh;
 	bool persistent_data;
+	float bvh_refit_threshold;
+	bool use_texture_cache;
+	int texture_cache_size;
 
 	SceneParams()
 	{
@@ -137,6 +152,9 @@ public:
 		use_qbvh = false;
 #endif
 		persistent_data = false;
+		bvh_refit_threshold = 1.5f;
+		use_texture_cache = false;
+		texture_cache_size = 1024;
 	}
 
 	bool modified(const SceneParams& params)
@@ -145,7 +163,10 @@ public:
 		&& use_bvh_cache == params.use_bvh_cache
 		&& use_bvh_spatial_split == params.use_bvh_spatial_split
 		&& use_qbvh == params.use_qbvh
-		&& persistent_data == params.persistent_data); }
+		&& persistent_data == params.persistent_data
+		&& bvh_refit_threshold == params.bvh_refit_threshold
+		&& use_texture_cache == params.use_texture_cache
+		&& texture_cache_size == params.texture_cache_size); }
 };
 
 /* Scene */
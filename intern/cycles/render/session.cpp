@@ -24,6 +24,7 @@
 #include "scene.h"
 #include "session.h"
 
+#include "util_debug.h"
 #include "util_foreach.h"
 #include "util_function.h"
 #include "util_math.h"
@@ -50,6 +51,15 @@ Session::Session(const SessionParams& params_)
 
 	device = Device::create(params.device, stats, params.background);
 
+	/* split tiles near the end of a render for threads that ran out of
+	 * work, as many workers as CPU threads or GPU devices */
+	if(params.split_tiles && !params.progressive_refine) {
+		int num_workers = (params.device.type == DEVICE_CPU)?
+			TaskScheduler::num_threads(): max((int)params.device.multi_devices.size(), 1);
+
+		tile_manager.set_split_tiles(num_workers);
+	}
+
 	if(params.background && params.output_path.empty()) {
 		buffers = NULL;
 		display = NULL;
@@ -57,8 +67,22 @@ Session::Session(const SessionParams& params_)
 	else {
 		buffers = new RenderBuffers(device);
 		display = new DisplayBuffer(device, params.display_buffer_linear);
+
+		/* denoising works on the tile buffers of a background render */
+		params.denoise = false;
 	}
 
+	/* checkpoints store tile buffers of a background render, with progressive
+	 * refine all tiles have partial samples until the end so it's not used */
+	if(params.background && params.output_path.empty() && !params.progressive_refine &&
+	   !params.checkpoint_path.empty())
+	{
+		checkpoint = new Checkpoint(params.checkpoint_path, params.checkpoint_interval);
+		checkpoint->read();
+	}
+	else
+		checkpoint = NULL;
+
 	session_thread = NULL;
 	scene = NULL;
 
@@ -114,6 +138,7 @@ Session::~Session()
 
 	delete buffers;
 	delete display;
+	delete checkpoint;
 	delete scene;
 	delete device;
 
@@ -358,8 +383,12 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	Tile tile;
 	int device_num = device->device_number(tile_device);
 
-	if(!tile_manager.next_tile(tile, device_num))
+	if(!tile_manager.next_tile(tile, device_num)) {
+		if(tile_timing.idle_time == 0.0)
+			tile_timing.idle_time = time_dt();
+
 		return false;
+	}
 	
 	/* fill render tile */
 	rtile.x = tile_manager.state.buffer.full_x + tile.x;
@@ -369,6 +398,7 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	rtile.start_sample = tile_manager.state.sample;
 	rtile.num_samples = tile_manager.state.num_samples;
 	rtile.resolution = tile_manager.state.resolution_divider;
+	rtile.start_time = time_dt();
 
 	tile_lock.unlock();
 
@@ -396,12 +426,16 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	buffer_params.get_offset_stride(rtile.offset, rtile.stride);
 
 	RenderBuffers *tilebuffers;
+	int end_sample = rtile.start_sample + rtile.num_samples;
+	int restored_samples = 0;
 
-	/* allocate buffers */
-	if(params.progressive_refine) {
+	/* allocate buffers, kept until the end for progressive refine and
+	 * denoising which reads neighbouring tiles */
+	if(params.progressive_refine || params.denoise) {
 		tile_lock.lock();
 
-		if(tile_buffers.size() == 0)
+		/* tiles split during rendering are added at the end */
+		if(tile_buffers.size() < (size_t)tile_manager.state.num_tiles)
 			tile_buffers.resize(tile_manager.state.num_tiles, NULL);
 
 		tilebuffers = tile_buffers[tile.index];
@@ -410,6 +444,9 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 			tile_buffers[tile.index] = tilebuffers;
 
 			tilebuffers->reset(tile_device, buffer_params);
+
+			if(checkpoint)
+				restored_samples = checkpoint->restore_tile(tilebuffers, end_sample);
 		}
 
 		tile_lock.unlock();
@@ -418,12 +455,25 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 		tilebuffers = new RenderBuffers(tile_device);
 
 		tilebuffers->reset(tile_device, buffer_params);
+
+		if(checkpoint)
+			restored_samples = checkpoint->restore_tile(tilebuffers, end_sample);
 	}
 
 	rtile.buffer = tilebuffers->buffer.device_pointer;
 	rtile.rng_state = tilebuffers->rng_state.device_pointer;
 	rtile.buffers = tilebuffers;
 
+	/* continue after the samples restored from the checkpoint, a tile that
+	 * is already finished is passed on with no samples left to render */
+	if(restored_samples > rtile.start_sample) {
+		rtile.start_sample = restored_samples;
+		rtile.num_samples = end_sample - restored_samples;
+		rtile.sample = restored_samples;
+
+		progress.add_samples(restored_samples);
+	}
+
 	/* this will tag tile as IN PROGRESS in blender-side render pipeline,
 	 * which is needed to highlight currently rendering tile before first
 	 * sample was processed for it
@@ -450,13 +500,40 @@ void Session::update_tile_sample(RenderTile& rtile)
 
 void Session::release_tile(RenderTile& rtile)
 {
+	/* done outside the tile lock, so other threads can continue while the
+	 * tile is appended to the checkpoint */
+	if(checkpoint) {
+		checkpoint->add_tile(rtile.buffers, rtile.sample);
+		checkpoint->update();
+	}
+
 	thread_scoped_lock tile_lock(tile_mutex);
 
+	double end_time = time_dt();
+	double tile_time = end_time - rtile.start_time;
+
+	tile_timing.num_tiles++;
+	tile_timing.total_time += tile_time;
+	tile_timing.max_time = max(tile_timing.max_time, tile_time);
+	tile_timing.end_time = end_time;
+
 	if(write_render_tile_cb) {
-		if(params.progressive_refine == false) {
+		if(params.denoise && !progress.get_cancel()) {
+			/* tile is written after denoising the whole image */
+			if(params.progressive_refine == false)
+				update_render_tile_cb(rtile);
+		}
+		else if(params.progressive_refine == false) {
 			/* todo: optimize this by making it thread safe and removing lock */
 			write_render_tile_cb(rtile);
 
+			if(params.denoise) {
+				/* canceled, write partial tile now and skip it later */
+				foreach(RenderBuffers *&buffers, tile_buffers)
+					if(buffers == rtile.buffers)
+						buffers = NULL;
+			}
+
 			delete rtile.buffers;
 		}
 	}
@@ -622,6 +699,14 @@ void Session::run()
 			run_gpu();
 		else
 			run_cpu();
+
+		/* flush the last tiles, also when canceled so the render can be
+		 * resumed later */
+		if(checkpoint)
+			checkpoint->write();
+
+		if(params.background && debug_verbose())
+			print_tile_timing();
 	}
 
 	/* progress update */
@@ -631,6 +716,23 @@ void Session::run()
 		progress.set_update();
 }
 
+void Session::print_tile_timing()
+{
+	if(tile_timing.num_tiles == 0)
+		return;
+
+	/* time between the first thread running out of tiles and the last tile
+	 * finishing, during which part of the threads were idle */
+	double tail_time = 0.0;
+
+	if(tile_timing.idle_time > 0.0 && tile_timing.end_time > tile_timing.idle_time)
+		tail_time = tile_timing.end_time - tile_timing.idle_time;
+
+	printf("Cycles tiles: %d tiles rendered, %.3fs average, %.3fs longest, %.3fs tail with idle threads.\n",
+	       tile_timing.num_tiles, tile_timing.total_time/tile_timing.num_tiles,
+	       tile_timing.max_time, tail_time);
+}
+
 bool Session::draw(BufferParams& buffer_params, DeviceDrawParams &draw_params)
 {
 	if(device_use_gl)
@@ -651,6 +753,12 @@ void Session::reset_(BufferParams& buffer_params, int samples)
 
 	tile_manager.reset(buffer_params, samples);
 
+	tile_timing.num_tiles = 0;
+	tile_timing.total_time = 0.0;
+	tile_timing.max_time = 0.0;
+	tile_timing.idle_time = 0.0;
+	tile_timing.end_time = 0.0;
+
 	start_time = time_dt();
 	preview_time = 0.0;
 	paused_time = 0.0;
@@ -666,7 +774,7 @@ void Session::reset(BufferParams& buffer_params, int samples)
 	else
 		reset_cpu(buffer_params, samples);
 
-	if(params.progressive_refine) {
+	if(params.progressive_refine || params.denoise) {
 		thread_scoped_lock buffers_lock(buffers_mutex);
 
 		foreach(RenderBuffers *buffers, tile_buffers)
@@ -749,6 +857,10 @@ void Session::update_scene()
 	if(scene->need_update()) {
 		progress.set_status("Updating Scene");
 		scene->device_update(device, progress);
+
+		/* checkpoint tiles are only restored for the same scene */
+		if(checkpoint)
+			checkpoint->set_scene(scene);
 	}
 }
 
@@ -837,6 +949,9 @@ void Session::path_trace()
 	task.update_progress_sample = function_bind(&Session::update_progress_sample, this);
 	task.need_finish_queue = params.progressive_refine;
 	task.integrator_branched = scene->integrator->method == Integrator::BRANCHED_PATH;
+	/* adaptive sampling needs all samples of a tile to be rendered at once */
+	task.adaptive_threshold = (params.progressive)? 0.0f: params.adaptive_threshold;
+	task.use_packet_tracing = params.use_packet_tracing;
 
 	device->task_add(task);
 }
@@ -867,9 +982,23 @@ void Session::tonemap(int sample)
 	display_outdated = false;
 }
 
+void Session::denoise(int sample)
+{
+	/* filtering reads neighbouring tiles, so this waits for the whole image */
+	progress.set_status("Denoising");
+
+	Denoiser denoiser(params.denoising);
+	denoiser.run(tile_buffers, sample, progress);
+}
+
 bool Session::update_progressive_refine(bool cancel)
 {
 	int sample = tile_manager.state.sample + 1;
+
+	/* without progressive refine, tiles render all samples at once */
+	if(params.denoise && !params.progressive_refine)
+		sample = tile_manager.num_samples;
+
 	bool write = sample == tile_manager.num_samples || cancel;
 
 	double current_time = time_dt();
@@ -880,8 +1009,14 @@ bool Session::update_progressive_refine(bool cancel)
 			return false;
 	}
 
-	if(params.progressive_refine) {
+	if(params.progressive_refine || (params.denoise && write)) {
+		if(params.denoise && write && !progress.get_cancel())
+			denoise(sample);
+
 		foreach(RenderBuffers *buffers, tile_buffers) {
+			if(buffers == NULL)
+				continue;
+
 			RenderTile rtile;
 			rtile.buffers = buffers;
 			rtile.sample = sample;
@@ -18,6 +18,8 @@
 #define __SESSION_H__
 
 #include "buffers.h"
+#include "checkpoint.h"
+#include "denoising.h"
 #include "device.h"
 #include "tile.h"
 
@@ -52,9 +54,20 @@ public:
 	TileOrder tile_order;
 	int start_resolution;
 	int threads;
+	float adaptive_threshold;
+	bool use_packet_tracing;
+	bool split_tiles;
+
+	bool denoise;
+	DenoiseParams denoising;
 
 	bool display_buffer_linear;
 
+	/* file to periodically store finished tiles in and resume from, for
+	 * background renders */
+	string checkpoint_path;
+	double checkpoint_interval;
+
 	double cancel_timeout;
 	double reset_timeout;
 	double text_timeout;
@@ -73,9 +86,17 @@ public:
 		tile_size = make_int2(64, 64);
 		start_resolution = INT_MAX;
 		threads = 0;
+		adaptive_threshold = 0.0f;
+		use_packet_tracing = false;
+		split_tiles = false;
+
+		denoise = false;
 
 		display_buffer_linear = false;
 
+		checkpoint_path = "";
+		checkpoint_interval = 300.0;
+
 		cancel_timeout = 0.1;
 		reset_timeout = 0.1;
 		text_timeout = 1.0;
@@ -96,7 +117,14 @@ public:
 		&& tile_size == params.tile_size
 		&& start_resolution == params.start_resolution
 		&& threads == params.threads
+		&& adaptive_threshold == params.adaptive_threshold
+		&& use_packet_tracing == params.use_packet_tracing
+		&& split_tiles == params.split_tiles
+		&& denoise == params.denoise
+		&& !denoising.modified(params.denoising)
 		&& display_buffer_linear == params.display_buffer_linear
+		&& checkpoint_path == params.checkpoint_path
+		&& checkpoint_interval == params.checkpoint_interval
 		&& cancel_timeout == params.cancel_timeout
 		&& reset_timeout == params.reset_timeout
 		&& text_timeout == params.text_timeout
@@ -120,6 +148,7 @@ public:
 	SessionParams params;
 	TileManager tile_manager;
 	Stats stats;
+	Checkpoint *checkpoint;
 
 	boost::function<void(RenderTile&)> write_render_tile_cb;
 	boost::function<void(RenderTile&)> update_render_tile_cb;
@@ -152,6 +181,7 @@ protected:
 
 	void tonemap(int sample);
 	void path_trace();
+	void denoise(int sample);
 	void reset_(BufferParams& params, int samples);
 
 	void run_cpu();
@@ -168,6 +198,18 @@ protected:
 
 	void update_progress_sample();
 
+	/* tile timing, to measure how long threads idle at the end of a render */
+	struct TileTiming {
+		int num_tiles;
+		double total_time;
+		double max_time;
+		/* first time a thread found no tile left, and last tile finished */
+		double idle_time;
+		double end_time;
+	} tile_timing;
+
+	void print_tile_timing();
+
 	bool device_use_gl;
 
 	thread *session_thread;
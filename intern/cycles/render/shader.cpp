@@ -55,6 +55,13 @@ Shader::Shader()
 	has_bssrdf_bump = false;
 	has_heterogeneous_volume = false;
 
+	has_volume_bound = false;
+	volume_bound_scale = 0.0f;
+	volume_bound_offset = 0.0f;
+
+	emission_estimate = 1.0f;
+	num_svm_nodes_unoptimized = 0;
+
 	used = false;
 
 	need_update = true;
@@ -216,6 +223,397 @@ void ShaderManager::device_update_shaders_used(Scene *scene)
 		scene->shaders[light->shader]->used = true;
 }
 
+/* Volume Bounds
+ *
+ * Find an upper bound for the extinction of a volume shader, in the form
+ * scale*density + offset with density the density attribute. This is only
+ * possible for a small set of nodes, for anything else no bound is found and
+ * the kernel falls back to ray marching. Bounds are only valid for density
+ * clamped to positive values, so all scales must be positive. */
+
+/* check that a value can't be negative, needed to bound products */
+static bool shader_volume_value_nonnegative(ShaderInput *input)
+{
+	if(!input->link) {
+		if(input->type == SHADER_SOCKET_FLOAT)
+			return input->value.x >= 0.0f;
+
+		return min(min(input->value.x, input->value.y), input->value.z) >= 0.0f;
+	}
+
+	ShaderNode *node = input->link->parent;
+
+	if(node->name == ustring("attribute")) {
+		/* same assumption as the bounds, density is not negative */
+		AttributeNode *attr = (AttributeNode*)node;
+
+		return Attribute::name_standard(attr->attribute.c_str()) == ATTR_STD_VOLUME_DENSITY &&
+		       strcmp(input->link->name, "Vector") != 0;
+	}
+	else if(node->name == ustring("value")) {
+		return ((ValueNode*)node)->value >= 0.0f;
+	}
+	else if(node->name == ustring("color")) {
+		float3 value = ((ColorNode*)node)->value;
+		return min(min(value.x, value.y), value.z) >= 0.0f;
+	}
+	else if(node->name == ustring("convert") || node->name == ustring("proxy")) {
+		ConvertNode *convert = (ConvertNode*)node;
+
+		if(node->name == ustring("convert") &&
+		   (convert->from == SHADER_SOCKET_VECTOR || convert->from == SHADER_SOCKET_POINT ||
+		    convert->from == SHADER_SOCKET_NORMAL || convert->from == SHADER_SOCKET_STRING))
+			return false;
+
+		return shader_volume_value_nonnegative(node->inputs[0]);
+	}
+	else if(node->name == ustring("math")) {
+		MathNode *math = (MathNode*)node;
+		bool nonneg1, nonneg2;
+
+		if(math->use_clamp)
+			return true;
+
+		nonneg1 = shader_volume_value_nonnegative(math->input("Value1"));
+		nonneg2 = shader_volume_value_nonnegative(math->input("Value2"));
+
+		if(math->type == ustring("Add") || math->type == ustring("Multiply") || math->type == ustring("Minimum"))
+			return nonneg1 && nonneg2;
+		else if(math->type == ustring("Maximum"))
+			return nonneg1 || nonneg2;
+	}
+
+	return false;
+}
+
+static bool shader_volume_value_bound(ShaderInput *input, float *scale, float *offset)
+{
+	if(!input->link) {
+		float value = (input->type == SHADER_SOCKET_FLOAT)? input->value.x: max(max(input->value.x, input->value.y), input->value.z);
+
+		if(input->type != SHADER_SOCKET_FLOAT && min(min(input->value.x, input->value.y), input->value.z) < 0.0f)
+			return false;
+
+		*scale = 0.0f;
+		*offset = value;
+		return true;
+	}
+
+	ShaderNode *node = input->link->parent;
+
+	if(node->name == ustring("attribute")) {
+		AttributeNode *attr = (AttributeNode*)node;
+
+		if(Attribute::name_standard(attr->attribute.c_str()) != ATTR_STD_VOLUME_DENSITY)
+			return false;
+		if(strcmp(input->link->name, "Vector") == 0)
+			return false;
+
+		*scale = 1.0f;
+		*offset = 0.0f;
+		return true;
+	}
+	else if(node->name == ustring("value")) {
+		*scale = 0.0f;
+		*offset = ((ValueNode*)node)->value;
+		return true;
+	}
+	else if(node->name == ustring("color")) {
+		float3 value = ((ColorNode*)node)->value;
+
+		if(min(min(value.x, value.y), value.z) < 0.0f)
+			return false;
+
+		*scale = 0.0f;
+		*offset = max(max(value.x, value.y), value.z);
+		return true;
+	}
+	else if(node->name == ustring("convert") || node->name == ustring("proxy")) {
+		ConvertNode *convert = (ConvertNode*)node;
+
+		/* vectors have no meaningful bound, other conversions keep or average
+		 * the components, which does not increase the maximum */
+		if(node->name == ustring("convert") &&
+		   (convert->from == SHADER_SOCKET_VECTOR || convert->from == SHADER_SOCKET_POINT ||
+		    convert->from == SHADER_SOCKET_NORMAL || convert->from == SHADER_SOCKET_STRING))
+			return false;
+
+		return shader_volume_value_bound(node->inputs[0], scale, offset);
+	}
+	else if(node->name == ustring("math")) {
+		MathNode *math = (MathNode*)node;
+		float scale1, offset1, scale2, offset2;
+
+		if(!shader_volume_value_bound(math->input("Value1"), &scale1, &offset1))
+			return false;
+
+		if(math->type == ustring("Subtract")) {
+			/* only subtracting a constant keeps the bound linear */
+			ShaderInput *value2_in = math->input("Value2");
+
+			if(value2_in->link)
+				return false;
+
+			*scale = scale1;
+			*offset = offset1 - value2_in->value.x;
+			return true;
+		}
+
+		if(!shader_volume_value_bound(math->input("Value2"), &scale2, &offset2))
+			return false;
+
+		if(math->type == ustring("Add")) {
+			*scale = scale1 + scale2;
+			*offset = offset1 + offset2;
+		}
+		else if(math->type == ustring("Multiply")) {
+			/* only multiplication with a constant, and the product of upper
+			 * bounds only bounds the product when neither factor is negative,
+			 * e.g. Minimum(1, density - 10) can be negative */
+			if(scale1 != 0.0f && scale2 != 0.0f)
+				return false;
+			if(!shader_volume_value_nonnegative(math->input("Value1")) ||
+			   !shader_volume_value_nonnegative(math->input("Value2")))
+				return false;
+
+			if(scale1 == 0.0f) {
+				*scale = offset1*scale2;
+				*offset = offset1*offset2;
+			}
+			else {
+				*scale = scale1*offset2;
+				*offset = offset1*offset2;
+			}
+		}
+		else if(math->type == ustring("Maximum")) {
+			*scale = max(scale1, scale2);
+			*offset = max(offset1, offset2);
+		}
+		else if(math->type == ustring("Minimum")) {
+			*scale = scale1;
+			*offset = offset1;
+		}
+		else
+			return false;
+
+		/* clamping to 0..1 can only lower the value, except for raising
+		 * negative values to zero */
+		if(math->use_clamp)
+			*offset = max(*offset, 0.0f);
+
+		return true;
+	}
+
+	return false;
+}
+
+static bool shader_volume_closure_bound(ShaderInput *input, float *scale, float *offset)
+{
+	*scale = 0.0f;
+	*offset = 0.0f;
+
+	if(!input->link)
+		return true;
+
+	ShaderNode *node = input->link->parent;
+
+	if(node->name == ustring("volume")) {
+		VolumeNode *volume = static_cast<VolumeNode*>(node);
+		ShaderInput *color_in = node->input("Color");
+		float color_scale, color_offset, density_scale, density_offset;
+
+		if(!shader_volume_value_bound(node->input("Density"), &density_scale, &density_offset))
+			return false;
+
+		if(volume->closure == CLOSURE_VOLUME_ABSORPTION_ID) {
+			/* absorption extinction is (1 - color)*density, which needs a
+			 * lower bound on the color, only known for unlinked colors */
+			if(color_in->link)
+				return false;
+
+			float3 color = color_in->value;
+
+			color_scale = 0.0f;
+			color_offset = 1.0f - min(min(color.x, color.y), color.z);
+		}
+		else {
+			if(!shader_volume_value_bound(color_in, &color_scale, &color_offset))
+				return false;
+
+			/* color depending on density would give a quadratic bound */
+			if(color_scale != 0.0f)
+				return false;
+		}
+
+		/* density is clamped to be positive in the closure */
+		color_offset = max(color_offset, 0.0f);
+		density_offset = max(density_offset, 0.0f);
+
+		*scale = color_offset*density_scale;
+		*offset = color_offset*density_offset;
+		return true;
+	}
+	else if(node->name == ustring("emission")) {
+		float color_scale, color_offset, strength_scale, strength_offset;
+
+		/* emission does not add to extinction, but is only picked up where
+		 * the majorant is non-zero, so it must vanish along with density */
+		if(!shader_volume_value_bound(node->input("Color"), &color_scale, &color_offset))
+			return false;
+		if(!shader_volume_value_bound(node->input("Strength"), &strength_scale, &strength_offset))
+			return false;
+		if(color_scale != 0.0f || (strength_offset > 0.0f && color_offset > 0.0f))
+			return false;
+
+		return true;
+	}
+	else if(node->name == ustring("add_closure") || node->name == ustring("mix_closure")) {
+		float scale1, offset1, scale2, offset2;
+
+		if(!shader_volume_closure_bound(node->input("Closure1"), &scale1, &offset1))
+			return false;
+		if(!shader_volume_closure_bound(node->input("Closure2"), &scale2, &offset2))
+			return false;
+
+		if(node->name == ustring("add_closure")) {
+			*scale = scale1 + scale2;
+			*offset = offset1 + offset2;
+		}
+		else {
+			*scale = max(scale1, scale2);
+			*offset = max(offset1, offset2);
+		}
+
+		return true;
+	}
+	else if(node->name == ustring("proxy")) {
+		return shader_volume_closure_bound(node->inputs[0], scale, offset);
+	}
+
+	return false;
+}
+
+/* Estimate of the power emitted per area by a surface closure, strength
+ * times average color, for the emitters of the light tree. Only constant
+ * strengths are known after folding, textured colors are assumed to stay
+ * in the 0..1 range. Returns false if the emission can't be estimated. */
+
+static bool shader_emission_estimate(ShaderInput *input, float *estimate)
+{
+	*estimate = 0.0f;
+
+	if(!input->link)
+		return true;
+
+	ShaderNode *node = input->link->parent;
+
+	if(node->name == ustring("emission")) {
+		EmissionNode *emission = static_cast<EmissionNode*>(node);
+		ShaderInput *color_in = node->input("Color");
+		ShaderInput *strength_in = node->input("Strength");
+		float strength;
+
+		if(emission->total_power)
+			return false;
+
+		if(!strength_in->link)
+			strength = strength_in->value.x;
+		else if(strength_in->link->parent->name == ustring("light_falloff") &&
+		        !strength_in->link->parent->input("Strength")->link)
+			strength = strength_in->link->parent->input("Strength")->value.x;
+		else
+			return false;
+
+		float color = (color_in->link)? 1.0f: average(color_in->value);
+
+		*estimate = max(strength*color, 0.0f);
+		return true;
+	}
+	else if(node->name == ustring("add_closure") || node->name == ustring("mix_closure")) {
+		float estimate1, estimate2;
+
+		if(!shader_emission_estimate(node->input("Closure1"), &estimate1))
+			return false;
+		if(!shader_emission_estimate(node->input("Closure2"), &estimate2))
+			return false;
+
+		if(node->name == ustring("add_closure")) {
+			*estimate = estimate1 + estimate2;
+		}
+		else {
+			ShaderInput *fac_in = node->input("Fac");
+
+			if(fac_in->link) {
+				*estimate = max(estimate1, estimate2);
+			}
+			else {
+				float fac = clamp(fac_in->value.x, 0.0f, 1.0f);
+				*estimate = (1.0f - fac)*estimate1 + fac*estimate2;
+			}
+		}
+
+		return true;
+	}
+	else if(node->name == ustring("proxy")) {
+		return shader_emission_estimate(node->inputs[0], estimate);
+	}
+	else if(dynamic_cast<BsdfNode*>(node) || node->name == ustring("holdout")) {
+		/* closures that don't emit */
+		return true;
+	}
+
+	return false;
+}
+
+void ShaderManager::device_update_emission_estimates(Scene *scene)
+{
+	foreach(Shader *shader, scene->shaders) {
+		float estimate = 1.0f;
+
+		if(shader->has_surface_emission && shader->graph) {
+			ShaderInput *surface_in = shader->graph->output()->input("Surface");
+
+			if(!shader_emission_estimate(surface_in, &estimate))
+				estimate = 1.0f;
+		}
+
+		/* emitter energies in the light tree depend on it */
+		if(estimate != shader->emission_estimate)
+			scene->light_manager->need_update = true;
+
+		shader->emission_estimate = estimate;
+	}
+}
+
+void ShaderManager::device_update_volume_bounds(Scene *scene)
+{
+	foreach(Shader *shader, scene->shaders) {
+		bool has_bound = false;
+		float scale = 0.0f, offset = 0.0f;
+
+		if(shader->has_volume && shader->graph) {
+			ShaderInput *volume_in = shader->graph->output()->input("Volume");
+			has_bound = shader_volume_closure_bound(volume_in, &scale, &offset);
+
+			/* without any extinction there is nothing to track */
+			if(scale == 0.0f && offset == 0.0f)
+				has_bound = false;
+		}
+
+		/* meshes pack the bounds along with their majorant grids */
+		if(has_bound != shader->has_volume_bound ||
+		   scale != shader->volume_bound_scale ||
+		   offset != shader->volume_bound_offset)
+		{
+			scene->mesh_manager->need_update = true;
+		}
+
+		shader->has_volume_bound = has_bound;
+		shader->volume_bound_scale = (has_bound)? scale: 0.0f;
+		shader->volume_bound_offset = (has_bound)? offset: 0.0f;
+	}
+}
+
 void ShaderManager::device_update_common(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	device->tex_free(dscene->shader_flag);
@@ -271,6 +669,9 @@ void ShaderManager::device_update_common(Device *device, DeviceScene *dscene, Sc
 
 	device->tex_alloc("__shader_flag", dscene->shader_flag);
 
+	device_update_volume_bounds(scene);
+	device_update_emission_estimates(scene);
+
 	/* blackbody lookup table */
 	KernelBlackbody *kblackbody = &dscene->data.blackbody;
 	
@@ -79,6 +79,21 @@ public:
 	bool has_bssrdf_bump;
 	bool has_heterogeneous_volume;
 
+	/* upper bound of the volume extinction as a linear function of the
+	 * density attribute, scale*density + offset, used to find majorants for
+	 * tracking through heterogeneous volumes */
+	bool has_volume_bound;
+	float volume_bound_scale;
+	float volume_bound_offset;
+
+	/* emitted power per area, strength times average color when known from
+	 * the graph and 1 otherwise, used as light tree emitter energy */
+	float emission_estimate;
+
+	/* size of the SVM code without constant folding and deduplication,
+	 * measured when compiling with verbose debug output */
+	int num_svm_nodes_unoptimized;
+
 	/* requested mesh attributes */
 	AttributeRequestSet attributes;
 
@@ -139,6 +154,9 @@ public:
 protected:
 	ShaderManager();
 
+	void device_update_volume_bounds(Scene *scene);
+	void device_update_emission_estimates(Scene *scene);
+
 	typedef unordered_map<ustring, uint, ustringHash> AttributeIDMap;
 	AttributeIDMap unique_attribute_id;
 
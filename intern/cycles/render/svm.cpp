@@ -56,6 +56,7 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 
 	/* svm_nodes */
 	vector<int4> svm_nodes;
+	int num_unoptimized_nodes = 0;
 	size_t i;
 
 	for(i = 0; i < scene->shaders.size(); i++) {
@@ -75,7 +76,28 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 
 		SVMCompiler compiler(scene->shader_manager, scene->image_manager);
 		compiler.background = ((int)i == scene->default_background);
+
+		/* the graph is optimized when finalized, so measure before that
+		 * from a copy, unchanged shaders keep their earlier measurement */
+		if(debug_verbose() && !shader->graph->finalized)
+			shader->num_svm_nodes_unoptimized = compiler.compile_unoptimized_size(shader);
+
+		size_t num_svm_nodes = svm_nodes.size();
 		compiler.compile(shader, svm_nodes, i);
+
+		if(debug_verbose()) {
+			printf("Cycles SVM: shader \"%s\" compiled to %d nodes, %d without constant folding and deduplication.\n",
+			       shader->name.c_str(), (int)(svm_nodes.size() - num_svm_nodes), shader->num_svm_nodes_unoptimized);
+		}
+
+		num_unoptimized_nodes += shader->num_svm_nodes_unoptimized;
+	}
+
+	if(debug_verbose()) {
+		int num_jump_nodes = scene->shaders.size()*2;
+
+		printf("Cycles SVM: %d nodes total, %d without constant folding and deduplication.\n",
+		       (int)svm_nodes.size(), num_jump_nodes + num_unoptimized_nodes);
 	}
 
 	dscene->svm_nodes.copy((uint4*)&svm_nodes[0], svm_nodes.size());
@@ -705,5 +727,25 @@ void SVMCompiler::compile(Shader *shader, vector<int4>& global_svm_nodes, int in
 	global_svm_nodes.insert(global_svm_nodes.end(), svm_nodes.begin(), svm_nodes.end());
 }
 
+int SVMCompiler::compile_unoptimized_size(Shader *shader)
+{
+	/* compile a copy of the graph with optimization disabled, into a
+	 * temporary shader that owns the copy */
+	Shader unoptimized;
+
+	unoptimized.name = shader->name;
+	unoptimized.used = shader->used;
+	unoptimized.graph = shader->graph->copy();
+	unoptimized.graph->optimize = false;
+
+	SVMCompiler compiler(shader_manager, image_manager);
+	compiler.background = background;
+
+	vector<int4> svm_nodes(2, make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+	compiler.compile(&unoptimized, svm_nodes, 0);
+
+	return (int)svm_nodes.size() - 2;
+}
+
 CCL_NAMESPACE_END
 
@@ -54,6 +54,7 @@ class SVMCompiler {
 public:
 	SVMCompiler(ShaderManager *shader_manager, ImageManager *image_manager);
 	void compile(Shader *shader, vector<int4>& svm_nodes, int index);
+	int compile_unoptimized_size(Shader *shader);
 
 	void stack_assign(ShaderOutput *output);
 	void stack_assign(ShaderInput *input);
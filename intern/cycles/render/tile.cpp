@@ -21,6 +21,9 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* tiles are not split smaller than this, to keep the per tile overhead low */
+#define TILE_SPLIT_MIN_SIZE 16
+
 TileManager::TileManager(bool progressive_, int num_samples_, int2 tile_size_, int start_resolution_,
                          bool preserve_tile_device_, bool background_, TileOrder tile_order_, int num_devices_)
 {
@@ -29,6 +32,7 @@ TileManager::TileManager(bool progressive_, int num_samples_, int2 tile_size_, i
 	tile_order = tile_order_;
 	start_resolution = start_resolution_;
 	num_devices = num_devices_;
+	num_split_workers = 0;
 	preserve_tile_device = preserve_tile_device_;
 	background = background_;
 
@@ -230,6 +234,34 @@ list<Tile>::iterator TileManager::next_background_tile(int device, TileOrder til
 	return best;
 }
 
+void TileManager::split_tile(Tile& tile)
+{
+	int num_remaining = 0;
+
+	for(list<Tile>::iterator iter = state.tiles.begin(); iter != state.tiles.end(); iter++)
+		if(iter->rendering == false)
+			num_remaining++;
+
+	/* the split off halves are added as new tiles, which may get split
+	 * further when they are handed out in turn */
+	while(num_remaining < num_split_workers) {
+		if(tile.w >= tile.h && tile.w >= TILE_SPLIT_MIN_SIZE*2) {
+			int w = tile.w/2;
+			state.tiles.push_back(Tile(state.num_tiles++, tile.x + w, tile.y, tile.w - w, tile.h, tile.device));
+			tile.w = w;
+		}
+		else if(tile.h >= TILE_SPLIT_MIN_SIZE*2) {
+			int h = tile.h/2;
+			state.tiles.push_back(Tile(state.num_tiles++, tile.x, tile.y + h, tile.w, tile.h - h, tile.device));
+			tile.h = h;
+		}
+		else
+			break;
+
+		num_remaining++;
+	}
+}
+
 bool TileManager::next_tile(Tile& tile, int device)
 {
 	list<Tile>::iterator tile_it;
@@ -240,6 +272,10 @@ bool TileManager::next_tile(Tile& tile, int device)
 		tile_it = next_viewport_tile(device);
 
 	if(tile_it != state.tiles.end()) {
+		/* tiles are only split when any device can render any tile */
+		if(num_split_workers > 0 && background && !preserve_tile_device)
+			split_tile(*tile_it);
+
 		tile_it->rendering = true;
 		tile = *tile_it;
 		state.num_rendered_tiles++;
@@ -80,6 +80,10 @@ public:
 	bool done();
 	
 	void set_tile_order(TileOrder tile_order_) { tile_order = tile_order_; }
+
+	/* split tiles on demand near the end of a render, when fewer tiles are
+	 * left than there are threads to render them, 0 to disable */
+	void set_split_tiles(int num_workers_) { num_split_workers = num_workers_; }
 protected:
 
 	void set_tiles();
@@ -89,6 +93,7 @@ protected:
 	TileOrder tile_order;
 	int start_resolution;
 	int num_devices;
+	int num_split_workers;
 
 	/* in some cases it is important that the same tile will be returned for the same
 	 * device it was originally generated for (i.e. viewport rendering when buffer is
@@ -120,6 +125,9 @@ protected:
 
 	/* returns first unhandled tile for viewport render */
 	list<Tile>::iterator next_viewport_tile(int device);
+
+	/* split tile in halves until there are enough tiles left for all workers */
+	void split_tile(Tile& tile);
 };
 
 CCL_NAMESPACE_END
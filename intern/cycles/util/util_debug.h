@@ -19,5 +19,19 @@
 
 #include <assert.h>
 
+#include "util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Debug Output
+ *
+ * Enables printing of extra statistics, such as the effect of shader graph
+ * optimizations. Set by the host application, e.g. with --debug-cycles. */
+
+void debug_set_verbose(bool verbose);
+bool debug_verbose();
+
+CCL_NAMESPACE_END
+
 #endif /* __UTIL_DEBUG_H__ */
 
@@ -85,6 +85,49 @@ ccl_device_inline void float4_store_half(half *h, float4 f, float scale)
 #endif
 }
 
+ccl_device_inline float half_to_float(half h)
+{
+	/* shift exponent and mantissa in place and rebias the exponent with a
+	 * multiply, which also takes care of denormals */
+	union { uint i; float f; } out, magic;
+	magic.i = 0x77800000; /* 2^112 */
+
+	out.i = (uint)(h & 0x7FFF) << 13;
+	out.f *= magic.f;
+
+	/* infinity and nan */
+	if((h & 0x7C00) == 0x7C00)
+		out.i |= 0x7F800000;
+
+	out.i |= (uint)(h & 0x8000) << 16;
+
+	return out.f;
+}
+
+ccl_device_inline float4 half4_to_float4(half4 h)
+{
+#ifndef __KERNEL_SSE2__
+	return make_float4(half_to_float(h.x), half_to_float(h.y), half_to_float(h.z), half_to_float(h.w));
+#else
+	/* same as above with SSE */
+	const __m128i mm_7FFF = _mm_set1_epi32(0x7FFF);
+	const __m128i mm_8000 = _mm_set1_epi32(0x8000);
+	const __m128i mm_7BFF = _mm_set1_epi32(0x7BFF);
+	const __m128i mm_7F800000 = _mm_set1_epi32(0x7F800000);
+	const __m128 mm_magic = _mm_castsi128_ps(_mm_set1_epi32(0x77800000));
+
+	__m128i x = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)&h), _mm_setzero_si128());
+	__m128i absolute = _mm_and_si128(x, mm_7FFF);
+	__m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(absolute, 13)), mm_magic);
+	__m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(absolute, mm_7BFF), mm_7F800000);
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(x, mm_8000), 16);
+
+	float4 r;
+	_mm_store_ps(&r.x, _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(_mm_castps_si128(f), infnan), sign)));
+	return r;
+#endif
+}
+
 #endif
 
 #endif
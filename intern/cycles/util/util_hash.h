@@ -17,6 +17,8 @@
 #ifndef __UTIL_HASH_H__
 #define __UTIL_HASH_H__
 
+#include <string.h>
+
 #include "util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -59,6 +61,33 @@ static inline uint hash_string(const char *str)
 	return i;
 }
 
+/* hash of a block of memory, to detect changes in large arrays. processes
+ * 8 bytes at a time and finishes with a 64 bit avalanche mix */
+
+static inline uint64_t hash_data(const void *data, size_t size, uint64_t seed = 0)
+{
+	const uchar *p = (const uchar*)data;
+	uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+
+	for(; size >= 8; size -= 8, p += 8) {
+		uint64_t k;
+		memcpy(&k, p, sizeof(k));
+
+		k *= 0x87C37B91114253D5ULL;
+		k ^= k >> 31;
+		h = (h ^ k) * 0x9E3779B97F4A7C15ULL;
+	}
+
+	for(; size > 0; size--, p++)
+		h = (h ^ *p) * 0x100000001B3ULL;
+
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
 CCL_NAMESPACE_END
 
 #endif /* __UTIL_HASH_H__ */
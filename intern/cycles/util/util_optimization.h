@@ -23,7 +23,9 @@
 #if defined(__KERNEL_SSE2__)  || \
 	defined(__KERNEL_SSE3__)  || \
 	defined(__KERNEL_SSSE3__) || \
-	defined(__KERNEL_SSE41__)
+	defined(__KERNEL_SSE41__) || \
+	defined(__KERNEL_AVX__)   || \
+	defined(__KERNEL_AVX2__)
 	/* do nothing */
 #endif
 
@@ -45,7 +47,7 @@
 
 /* x86-64
  *
- * Compile a regular (includes SSE2), SSE3 and SSE 4.1 kernel. */
+ * Compile a regular (includes SSE2), SSE3, SSE 4.1, AVX and AVX2 kernel. */
 
 #if defined(__x86_64__) || defined(_M_X64)
 
@@ -65,12 +67,21 @@
 #define WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 #endif
 
+#ifdef WITH_KERNEL_AVX2
+#define WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+#endif
+
 /* MSVC 2008, no SSE41 (broken blendv intrinsic) and no AVX support */
 #if defined(_MSC_VER) && (_MSC_VER < 1700)
 #undef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
 #undef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
 #endif
 
+/* MSVC 2012, no AVX2 support */
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#undef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+#endif
+
 #endif
 
 /* SSE Experiment
@@ -118,6 +129,10 @@
 #include <smmintrin.h> /* SSE 4.1 */
 #endif
 
+#if defined(__KERNEL_AVX__) || defined(__KERNEL_AVX2__)
+#include <immintrin.h> /* AVX, AVX2 and FMA */
+#endif
+
 #else
 
 /* MinGW64 has conflicting declarations for these SSE headers in <windows.h>.
@@ -222,6 +222,23 @@ bool path_read_text(const string& path, string& text)
 	return true;
 }
 
+bool path_rename(const string& from, const string& to)
+{
+	try {
+#if (BOOST_FILESYSTEM_VERSION == 2)
+		/* version 2 fails when the destination exists */
+		if(boost::filesystem::exists(to_boost(to)))
+			boost::filesystem::remove(to_boost(to));
+#endif
+		boost::filesystem::rename(to_boost(from), to_boost(to));
+	}
+	catch(const boost::filesystem::filesystem_error&) {
+		return false;
+	}
+
+	return true;
+}
+
 uint64_t path_modified_time(const string& path)
 {
 	if(boost::filesystem::exists(to_boost(path)))
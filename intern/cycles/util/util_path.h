@@ -59,6 +59,9 @@ bool path_write_text(const string& path, string& text);
 bool path_read_binary(const string& path, vector<uint8_t>& binary);
 bool path_read_text(const string& path, string& text);
 
+/* replaces the destination file if it exists */
+bool path_rename(const string& from, const string& to);
+
 /* source code utility */
 string path_source_replace_includes(const string& source, const string& path);
 
@@ -149,6 +149,13 @@ public:
 		sample++;
 	}
 
+	void add_samples(int num_samples)
+	{
+		thread_scoped_lock lock(progress_mutex);
+
+		sample += num_samples;
+	}
+
 	int get_sample()
 	{
 		return sample;
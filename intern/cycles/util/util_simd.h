@@ -142,6 +142,28 @@ ccl_device_inline const __m128 blend(const __m128& mask, const __m128& a, const
 }
 #endif
 
+#ifdef __KERNEL_AVX2__
+
+/* calculate a*b+c with a single rounding, using FMA instructions */
+ccl_device_inline const __m128 fma(const __m128& a, const __m128& b, const __m128& c)
+{
+	return _mm_fmadd_ps(a, b, c);
+}
+
+/* calculate a*b-c with a single rounding */
+ccl_device_inline const __m128 fms(const __m128& a, const __m128& b, const __m128& c)
+{
+	return _mm_fmsub_ps(a, b, c);
+}
+
+/* calculate -a*b+c with a single rounding */
+ccl_device_inline const __m128 fnma(const __m128& a, const __m128& b, const __m128& c)
+{
+	return _mm_fnmadd_ps(a, b, c);
+}
+
+#else
+
 /* calculate a*b+c (replacement for fused multiply-add on SSE CPUs) */
 ccl_device_inline const __m128 fma(const __m128& a, const __m128& b, const __m128& c)
 {
@@ -160,6 +182,8 @@ ccl_device_inline const __m128 fnma(const __m128& a, const __m128& b, const __m1
 	return _mm_sub_ps(c, _mm_mul_ps(a, b));
 }
 
+#endif
+
 template<size_t N> ccl_device_inline const __m128 broadcast(const __m128& a)
 {
 	return _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(a), _MM_SHUFFLE(N, N, N, N)));
@@ -17,11 +17,13 @@
 #ifndef __UTIL_STATS_H__
 #define __UTIL_STATS_H__
 
+#include "util_types.h"
+
 CCL_NAMESPACE_BEGIN
 
 class Stats {
 public:
-	Stats() : mem_used(0), mem_peak(0) {}
+	Stats() : mem_used(0), mem_peak(0), num_rays(0) {}
 
 	void mem_alloc(size_t size) {
 		mem_used += size;
@@ -35,6 +37,9 @@ public:
 
 	size_t mem_used;
 	size_t mem_peak;
+
+	/* rays traced by the CPU device, for benchmarking */
+	uint64_t num_rays;
 };
 
 CCL_NAMESPACE_END
@@ -58,21 +58,26 @@ int system_cpu_thread_count()
 }
 
 #if !defined(_WIN32) || defined(FREE_WINDOWS)
-static void __cpuid(int data[4], int selector)
+static void __cpuidex(int data[4], int selector, int subselector)
 {
 #ifdef __x86_64__
-	asm("cpuid" : "=a" (data[0]), "=b" (data[1]), "=c" (data[2]), "=d" (data[3]) : "a"(selector));
+	asm("cpuid" : "=a" (data[0]), "=b" (data[1]), "=c" (data[2]), "=d" (data[3]) : "a"(selector), "c"(subselector));
 #else
 #ifdef __i386__
 	asm("pushl %%ebx    \n\t"
 		"cpuid          \n\t"
 		"movl %%ebx, %1 \n\t"
-		"popl %%ebx     \n\t" : "=a" (data[0]), "=r" (data[1]), "=c" (data[2]), "=d" (data[3]) : "a"(selector));
+		"popl %%ebx     \n\t" : "=a" (data[0]), "=r" (data[1]), "=c" (data[2]), "=d" (data[3]) : "a"(selector), "c"(subselector));
 #else
 	data[0] = data[1] = data[2] = data[3] = 0;
 #endif
 #endif
 }
+
+static void __cpuid(int data[4], int selector)
+{
+	__cpuidex(data, selector, 0);
+}
 #endif
 
 static void replace_string(string& haystack, const string& needle, const string& other)
@@ -114,6 +119,28 @@ int system_cpu_bits()
 	return (sizeof(void*)*8);
 }
 
+/* instruction set limit, 0 for none up to 5 for avx2 */
+static int system_cpu_instruction_set_limit = 5;
+
+bool system_cpu_limit_instruction_set(const string& name)
+{
+	const char *names[] = {"none", "sse2", "sse3", "sse41", "avx", "avx2"};
+
+	if(name == "") {
+		system_cpu_instruction_set_limit = 5;
+		return true;
+	}
+
+	for(int i = 0; i < 6; i++) {
+		if(name == names[i]) {
+			system_cpu_instruction_set_limit = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 #if defined(__x86_64__) || defined(_M_X64) || defined(i386) || defined(_M_IX86)
 
 struct CPUCapabilities {
@@ -127,6 +154,7 @@ struct CPUCapabilities {
 	bool sse42;
 	bool sse4a;
 	bool avx;
+	bool avx2;
 	bool xop;
 	bool fma3;
 	bool fma4;
@@ -181,6 +209,13 @@ static CPUCapabilities& system_cpu_capabilities()
 			}
 		}
 
+		if(num >= 7) {
+			/* structured extended feature flags, AVX2 needs the same OS
+			 * support for YMM registers as AVX */
+			__cpuidex(result, 0x00000007, 0);
+			caps.avx2 = caps.avx && (result[1] & ((int)1 << 5)) != 0;
+		}
+
 #if 0
 		if(num_ex >= 0x80000001) {
 			__cpuid(result, 0x80000001);
@@ -200,25 +235,31 @@ static CPUCapabilities& system_cpu_capabilities()
 bool system_cpu_support_sse2()
 {
 	CPUCapabilities& caps = system_cpu_capabilities();
-	return caps.sse && caps.sse2;
+	return system_cpu_instruction_set_limit >= 1 && caps.sse && caps.sse2;
 }
 
 bool system_cpu_support_sse3()
 {
 	CPUCapabilities& caps = system_cpu_capabilities();
-	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3;
+	return system_cpu_instruction_set_limit >= 2 && caps.sse && caps.sse2 && caps.sse3 && caps.ssse3;
 }
 
 bool system_cpu_support_sse41()
 {
 	CPUCapabilities& caps = system_cpu_capabilities();
-	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41;
+	return system_cpu_instruction_set_limit >= 3 && caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41;
 }
 
 bool system_cpu_support_avx()
 {
 	CPUCapabilities& caps = system_cpu_capabilities();
-	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41 && caps.avx;
+	return system_cpu_instruction_set_limit >= 4 && caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41 && caps.avx;
+}
+
+bool system_cpu_support_avx2()
+{
+	CPUCapabilities& caps = system_cpu_capabilities();
+	return system_cpu_instruction_set_limit >= 5 && caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41 && caps.avx && caps.avx2 && caps.fma3;
 }
 #else
 
@@ -242,6 +283,11 @@ bool system_cpu_support_avx()
 	return false;
 }
 
+bool system_cpu_support_avx2()
+{
+	return false;
+}
+
 #endif
 
 CCL_NAMESPACE_END
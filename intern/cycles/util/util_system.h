@@ -28,6 +28,11 @@ bool system_cpu_support_sse2();
 bool system_cpu_support_sse3();
 bool system_cpu_support_sse41();
 bool system_cpu_support_avx();
+bool system_cpu_support_avx2();
+
+/* restrict kernels to an instruction set (none, sse2, sse3, sse41, avx, avx2), to
+ * compare kernel variants on the same machine, empty string for no limit */
+bool system_cpu_limit_instruction_set(const string& name);
 
 CCL_NAMESPACE_END
 
@@ -460,6 +460,17 @@ enum InterpolationType {
 	INTERPOLATION_SMART = 3,
 };
 
+/* Storage types for image textures, other than float4 and byte4 these are
+ * only supported on the CPU */
+enum ImageDataType {
+	IMAGE_DATA_TYPE_FLOAT4 = 0,
+	IMAGE_DATA_TYPE_BYTE4 = 1,
+	IMAGE_DATA_TYPE_HALF4 = 2,
+	IMAGE_DATA_TYPE_FLOAT = 3,
+	IMAGE_DATA_TYPE_BYTE = 4,
+	IMAGE_DATA_TYPE_HALF = 5,
+};
+
 CCL_NAMESPACE_END
 
 #endif /* __UTIL_TYPES_H__ */
@@ -184,6 +184,10 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Allocate small blocks of the lock-free allocator from size class slabs with
+ * per-thread caches, call on startup before creating threads. */
+void MEM_use_slab_allocator(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
@@ -60,6 +60,11 @@ uintptr_t (*MEM_get_peak_memory)(void) = MEM_lockfree_get_peak_memory;
 const char *(*MEM_name_ptr)(void *vmemh) = MEM_lockfree_name_ptr;
 #endif
 
+void MEM_use_slab_allocator(void)
+{
+	MEM_lockfree_use_slab_allocator();
+}
+
 void MEM_use_guarded_allocator(void)
 {
 	MEM_allocN_len = MEM_guarded_allocN_len;
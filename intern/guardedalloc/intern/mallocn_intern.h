@@ -102,6 +102,7 @@ void MEM_lockfree_set_error_callback(void (*func)(const char *));
 bool MEM_lockfree_check_memory_integrity(void);
 void MEM_lockfree_set_lock_callback(void (*lock)(void), void (*unlock)(void));
 void MEM_lockfree_set_memory_debug(void);
+void MEM_lockfree_use_slab_allocator(void);
 uintptr_t MEM_lockfree_get_memory_in_use(void);
 uintptr_t MEM_lockfree_get_mapped_memory_in_use(void);
 unsigned int MEM_lockfree_get_memory_blocks_in_use(void);
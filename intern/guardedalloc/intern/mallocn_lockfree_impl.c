@@ -38,7 +38,7 @@
 /* to ensure strict conversions */
 #include "../../source/blender/blenlib/BLI_strict_flags.h"
 
-#include "atomic_ops.h"
+#include "atomic_spin.h"
 #include "mallocn_intern.h"
 
 typedef struct MemHead {
@@ -57,6 +57,56 @@ static void (*thread_unlock_callback)(void) = NULL;
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead*) vmemh) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_IS_MMAP(memhead) ((memhead)->len & (size_t) 1)
+#define MEMHEAD_IS_SLAB(memhead) ((memhead)->len & (size_t) 2)
+#define MEMHEAD_LEN_FLAGS ((size_t) 3)
+
+/* ******** Slab allocator for small blocks ******** */
+
+/* Blocks (including the MemHead) up to SLAB_BLOCK_MAX bytes are carved out of
+ * large slabs, one size class per multiple of SLAB_CLASS_STEP.
+ *
+ * Free blocks are kept in SLAB_CACHE_TOT caches, each holding a free list per size class.
+ * A thread locks one cache for a single alloc/free, see #atomic_spin_lock_any.
+ * Since caches are never held between calls, threads exiting don't need any cleanup.
+ * Free blocks move between caches in batches of about SLAB_BATCH_SIZE bytes,
+ * through a per class list of full batches.
+ *
+ * Slab memory is never given back to the system. */
+
+#define SLAB_CLASS_STEP   16
+#define SLAB_CLASS_TOT    32
+#define SLAB_BLOCK_MAX    (SLAB_CLASS_STEP * SLAB_CLASS_TOT)
+#define SLAB_CACHE_TOT    64
+#define SLAB_SIZE         (1024 * 1024)
+#define SLAB_BATCH_SIZE   (16 * 1024)
+
+#define SLAB_CLASS_INDEX(size) ((unsigned int)(((size) - 1) / SLAB_CLASS_STEP))
+#define SLAB_CLASS_SIZE(index) ((size_t)((index) + 1) * SLAB_CLASS_STEP)
+#define SLAB_BATCH_LEN(index)  ((unsigned int)(SLAB_BATCH_SIZE / SLAB_CLASS_SIZE(index)))
+
+typedef struct SlabNode {
+	struct SlabNode *next;
+	struct SlabNode *batch_next;  /* only used by the first node of a batch */
+} SlabNode;
+
+typedef struct SlabCache {
+	uint32_t lock;
+	unsigned int totfree[SLAB_CLASS_TOT];
+	int totused[SLAB_CLASS_TOT];  /* allocated minus freed using this cache (may be negative) */
+	SlabNode *free[SLAB_CLASS_TOT];
+	char _pad[64];  /* avoid false sharing with the next cache */
+} SlabCache;
+
+typedef struct SlabClass {
+	uint32_t lock;
+	SlabNode *batches;  /* full batches of free blocks, linked by 'batch_next' */
+	char *slab_cur, *slab_end;  /* unused part of the last slab */
+	size_t slab_mem;  /* memory taken from the system */
+} SlabClass;
+
+static bool slab_enabled = false;
+static SlabCache slab_caches[SLAB_CACHE_TOT];
+static SlabClass slab_classes[SLAB_CLASS_TOT];
 
 #ifdef __GNUC__
 __attribute__ ((format(printf, 1, 2)))
@@ -90,10 +140,127 @@ static void mem_unlock_thread(void)
 }
 #endif
 
+static SlabCache *slab_cache_acquire(void)
+{
+	return &slab_caches[atomic_spin_lock_any(&slab_caches[0].lock, sizeof(*slab_caches), SLAB_CACHE_TOT)];
+}
+
+/**
+ * Take a full batch of free blocks of a size class,
+ * carving a new one from the current slab when there are none.
+ */
+static SlabNode *slab_batch_pop(const unsigned int index)
+{
+	SlabClass *sclass = &slab_classes[index];
+	SlabNode *batch;
+
+	atomic_spin_lock(&sclass->lock);
+
+	batch = sclass->batches;
+	if (batch) {
+		sclass->batches = batch->batch_next;
+	}
+	else {
+		const size_t size = SLAB_CLASS_SIZE(index);
+		const unsigned int batch_len = SLAB_BATCH_LEN(index);
+		SlabNode *node;
+		unsigned int i;
+
+		if ((size_t)(sclass->slab_end - sclass->slab_cur) < size * batch_len) {
+			/* the rest of the previous slab is wasted, at most one batch */
+			char *slab = malloc(SLAB_SIZE);
+			if (slab) {
+				sclass->slab_cur = slab;
+				sclass->slab_end = slab + SLAB_SIZE;
+				sclass->slab_mem += SLAB_SIZE;
+			}
+		}
+
+		if ((size_t)(sclass->slab_end - sclass->slab_cur) >= size * batch_len) {
+			batch = node = (SlabNode *)sclass->slab_cur;
+			for (i = 1; i < batch_len; i++) {
+				node->next = (SlabNode *)((char *)node + size);
+				node = node->next;
+			}
+			node->next = NULL;
+			sclass->slab_cur += size * batch_len;
+		}
+	}
+
+	atomic_spin_unlock(&sclass->lock);
+
+	return batch;
+}
+
+static void slab_batch_push(const unsigned int index, SlabNode *batch)
+{
+	SlabClass *sclass = &slab_classes[index];
+
+	atomic_spin_lock(&sclass->lock);
+	batch->batch_next = sclass->batches;
+	sclass->batches = batch;
+	atomic_spin_unlock(&sclass->lock);
+}
+
+/* \param size: the block size including the MemHead. */
+static MemHead *slab_alloc(const size_t size)
+{
+	const unsigned int index = SLAB_CLASS_INDEX(size);
+	SlabCache *cache = slab_cache_acquire();
+	SlabNode *node = cache->free[index];
+
+	if (UNLIKELY(node == NULL)) {
+		node = slab_batch_pop(index);
+		if (UNLIKELY(node == NULL)) {
+			atomic_spin_unlock(&cache->lock);
+			return NULL;
+		}
+		cache->totfree[index] = SLAB_BATCH_LEN(index);
+	}
+
+	cache->free[index] = node->next;
+	cache->totfree[index]--;
+	cache->totused[index]++;
+
+	atomic_spin_unlock(&cache->lock);
+
+	return (MemHead *)node;
+}
+
+static void slab_free(MemHead *memh, const size_t size)
+{
+	const unsigned int index = SLAB_CLASS_INDEX(size);
+	const unsigned int batch_len = SLAB_BATCH_LEN(index);
+	SlabCache *cache = slab_cache_acquire();
+	SlabNode *node = (SlabNode *)memh;
+
+	node->next = cache->free[index];
+	cache->free[index] = node;
+	cache->totfree[index]++;
+	cache->totused[index]--;
+
+	if (UNLIKELY(cache->totfree[index] == batch_len * 2)) {
+		/* hand the most recently freed batch over to other caches */
+		SlabNode *batch = cache->free[index];
+		unsigned int i;
+
+		for (i = 1; i < batch_len; i++) {
+			node = node->next;
+		}
+		cache->free[index] = node->next;
+		node->next = NULL;
+		cache->totfree[index] -= batch_len;
+
+		slab_batch_push(index, batch);
+	}
+
+	atomic_spin_unlock(&cache->lock);
+}
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
 	if (vmemh) {
-		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) 1);
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~MEMHEAD_LEN_FLAGS;
 	}
 	else {
 		return 0;
@@ -124,7 +291,12 @@ void MEM_lockfree_freeN(void *vmemh)
 		if (UNLIKELY(malloc_debug_memset && len)) {
 			memset(memh + 1, 255, len);
 		}
-		free(memh);
+		if (MEMHEAD_IS_SLAB(memh)) {
+			slab_free(memh, len + sizeof(MemHead));
+		}
+		else {
+			free(memh);
+		}
 	}
 }
 
@@ -212,10 +384,17 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	if (slab_enabled && len + sizeof(MemHead) <= SLAB_BLOCK_MAX &&
+	    (memh = slab_alloc(len + sizeof(MemHead))))
+	{
+		memset(memh + 1, 0, len);
+		memh->len = len | (size_t) 2;
+	}
+	else if ((memh = (MemHead *)calloc(1, len + sizeof(MemHead)))) {
+		memh->len = len;
+	}
 
 	if (LIKELY(memh)) {
-		memh->len = len;
 		atomic_add_u(&totblock, 1);
 		atomic_add_z(&mem_in_use, len);
 
@@ -235,14 +414,20 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)malloc(len + sizeof(MemHead));
+	if (slab_enabled && len + sizeof(MemHead) <= SLAB_BLOCK_MAX &&
+	    (memh = slab_alloc(len + sizeof(MemHead))))
+	{
+		memh->len = len | (size_t) 2;
+	}
+	else if ((memh = (MemHead *)malloc(len + sizeof(MemHead)))) {
+		memh->len = len;
+	}
 
 	if (LIKELY(memh)) {
 		if (UNLIKELY(malloc_debug_memset && len)) {
 			memset(memh + 1, 255, len);
 		}
 
-		memh->len = len;
 		atomic_add_u(&totblock, 1);
 		atomic_add_z(&mem_in_use, len);
 
@@ -316,6 +501,35 @@ void MEM_lockfree_printmemlist_stats(void)
 	       (double)mem_in_use / (double)(1024 * 1024));
 	printf("peak memory len: %.3f MB\n",
 	       (double)peak_mem / (double)(1024 * 1024));
+
+	if (slab_enabled) {
+		size_t slab_mem_tot = 0;
+		unsigned int index, i;
+
+		printf("\nslab allocator size classes:\n");
+		printf(" block size   blocks in use   used (KB)   slabs (KB)\n");
+		for (index = 0; index < SLAB_CLASS_TOT; index++) {
+			const size_t size = SLAB_CLASS_SIZE(index);
+			const size_t slab_mem = slab_classes[index].slab_mem;
+			int totused = 0;
+
+			if (slab_mem == 0) {
+				continue;
+			}
+
+			/* not locking, only for an overview */
+			for (i = 0; i < SLAB_CACHE_TOT; i++) {
+				totused += slab_caches[i].totused[index];
+			}
+
+			printf(" %10u   %13d   %9.1f   %10.1f\n",
+			       (unsigned int)size, totused,
+			       (double)((size_t)totused * size) / 1024.0, (double)slab_mem / 1024.0);
+			slab_mem_tot += slab_mem;
+		}
+		printf("total slab memory: %.3f MB\n", (double)slab_mem_tot / (double)(1024 * 1024));
+	}
+
 	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
 
 #ifdef HAVE_MALLOC_STATS
@@ -345,6 +559,11 @@ void MEM_lockfree_set_memory_debug(void)
 	malloc_debug_memset = true;
 }
 
+void MEM_lockfree_use_slab_allocator(void)
+{
+	slab_enabled = true;
+}
+
 uintptr_t MEM_lockfree_get_memory_in_use(void)
 {
 	return mem_in_use;
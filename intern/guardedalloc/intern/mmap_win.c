@@ -78,8 +78,8 @@ static void mmap_addtail(volatile mmapListBase *listbase, void *vlink);
 static void mmap_remlink(volatile mmapListBase *listbase, void *vlink);
 static void *mmap_findlink(volatile mmapListBase *listbase, void *ptr);
 
-static int mmap_get_prot_flags(int flags);
-static int mmap_get_access_flags(int flags);
+static int mmap_get_prot_flags(int prot, int flags);
+static int mmap_get_access_flags(int prot, int flags);
 
 /* --------------------------------------------------------------------- */
 /* vars                                                                  */
@@ -97,8 +97,8 @@ void *mmap(void *UNUSED(start), size_t len, int prot, int flags, int fd, off_t o
 {
 	HANDLE fhandle = INVALID_HANDLE_VALUE;
 	HANDLE maphandle;
-	int prot_flags = mmap_get_prot_flags(prot);
-	int access_flags = mmap_get_access_flags(prot);
+	int prot_flags = mmap_get_prot_flags(prot, flags);
+	int access_flags = mmap_get_access_flags(prot, flags);
 	MemMap *mm = NULL;
 	void *ptr = NULL;
 
@@ -225,43 +225,50 @@ static void *mmap_findlink(volatile mmapListBase *listbase, void *ptr)
 	return NULL;
 }
 
-static int mmap_get_prot_flags(int flags)
+/* writable private mappings are copy on write, changes never reach the file */
+static int mmap_get_prot_flags(int prot, int flags)
 {
-	int prot = PAGE_NOACCESS;
+	int page_prot = PAGE_NOACCESS;
 
-	if ( (flags & PROT_READ) == PROT_READ) {
-		if ( (flags & PROT_WRITE) == PROT_WRITE) {
-			prot = (flags & PROT_EXEC) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+	if ( (prot & PROT_WRITE) == PROT_WRITE && (flags & MAP_PRIVATE) ) {
+		page_prot = (prot & PROT_EXEC) ? PAGE_EXECUTE_WRITECOPY : PAGE_WRITECOPY;
+	}
+	else if ( (prot & PROT_READ) == PROT_READ) {
+		if ( (prot & PROT_WRITE) == PROT_WRITE) {
+			page_prot = (prot & PROT_EXEC) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
 		}
 		else {
-			prot = (flags & PROT_EXEC) ? PAGE_EXECUTE_READ : PAGE_READONLY;
+			page_prot = (prot & PROT_EXEC) ? PAGE_EXECUTE_READ : PAGE_READONLY;
 		}
 	}
-	else if ( (flags & PROT_WRITE) == PROT_WRITE) {
-		prot = (flags & PROT_EXEC) ? PAGE_EXECUTE_READ : PAGE_WRITECOPY;
+	else if ( (prot & PROT_WRITE) == PROT_WRITE) {
+		page_prot = (prot & PROT_EXEC) ? PAGE_EXECUTE_READ : PAGE_WRITECOPY;
 	}
-	else if ( (flags & PROT_EXEC) == PROT_EXEC) {
-		prot = PAGE_EXECUTE_READ;
+	else if ( (prot & PROT_EXEC) == PROT_EXEC) {
+		page_prot = PAGE_EXECUTE_READ;
 	}
-	return prot;
+	return page_prot;
 }
 
-static int mmap_get_access_flags(int flags)
+static int mmap_get_access_flags(int prot, int flags)
 {
 	int access = 0;
 
-	if ( (flags & PROT_READ) == PROT_READ) {
-		if ( (flags & PROT_WRITE) == PROT_WRITE) {
+	if ( (prot & PROT_WRITE) == PROT_WRITE && (flags & MAP_PRIVATE) ) {
+		access = (prot & PROT_EXEC) ? (FILE_MAP_COPY | FILE_MAP_EXECUTE) : FILE_MAP_COPY;
+	}
+	else if ( (prot & PROT_READ) == PROT_READ) {
+		if ( (prot & PROT_WRITE) == PROT_WRITE) {
 			access = FILE_MAP_WRITE;
 		}
 		else {
-			access = (flags & PROT_EXEC) ? FILE_MAP_EXECUTE : FILE_MAP_READ;
+			access = (prot & PROT_EXEC) ? FILE_MAP_EXECUTE : FILE_MAP_READ;
 		}
 	}
-	else if ( (flags & PROT_WRITE) == PROT_WRITE) {
+	else if ( (prot & PROT_WRITE) == PROT_WRITE) {
 		access = FILE_MAP_COPY;
 	}
-	else if ( (flags & PROT_EXEC) == PROT_EXEC) {
+	else if ( (prot & PROT_EXEC) == PROT_EXEC) {
 		access = FILE_MAP_EXECUTE;
 	}
 	return access;
@@ -71,6 +71,13 @@ extern "C" {
 #  define BKE_MESH_OMP_LIMIT 10000
 #endif
 
+/* minimum number of elements per chunk for BLI_task_parallel_range */
+#ifdef DEBUG
+#  define BKE_MESH_TASK_CHUNK 1
+#else
+#  define BKE_MESH_TASK_CHUNK 1024
+#endif
+
 /* *** mesh.c *** */
 
 struct BMesh *BKE_mesh_to_bmesh(struct Mesh *me, struct Object *ob);
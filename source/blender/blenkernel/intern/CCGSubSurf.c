@@ -30,6 +30,7 @@
 #include "BLI_sys_types.h" // for intptr_t support
 
 #include "BLI_utildefines.h" /* for BLI_assert */
+#include "BLI_task.h"
 
 #include "BKE_ccg.h"
 #include "CCGSubSurf.h"
@@ -1430,98 +1431,161 @@ CCGError ccgSubSurf_processSync(CCGSubSurf *ss)
 #define FACE_calcIFNo(f, lvl, S, x, y, no)  _face_calcIFNo(f, lvl, S, x, y, no, subdivLevels, vertDataSize)
 #define FACE_getIENo(f, lvl, S, x)          _face_getIENo(f, lvl, S, x, subdivLevels, vertDataSize, normalDataOffset)
 
-static void ccgSubSurf__calcVertNormals(CCGSubSurf *ss,
-                                        CCGVert **effectedV, CCGEdge **effectedE, CCGFace **effectedF,
-                                        int numEffectedV, int numEffectedE, int numEffectedF)
+typedef struct CCGSubSurfCalcSubdivData {
+	CCGSubSurf *ss;
+	CCGEdge **effectedE;
+	CCGFace **effectedF;
+	int curLvl;
+} CCGSubSurfCalcSubdivData;
+
+typedef struct CCGSubSurfCalcSubdivChunk {
+	float *q, *r;
+} CCGSubSurfCalcSubdivChunk;
+
+/* minimum number of elements per chunk for BLI_task_parallel_range, ranges
+ * smaller than CCG_OMP_LIMIT are processed on the calling thread */
+static int ccg_task_min_chunk(int numEffectedF, int edgeSize, int tot)
 {
-	int i, ptrIdx;
+	return (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT) ? 1 : tot;
+}
+
+static void ccgSubSurf__calcVertNormals_faces_accumulate_func(void *userdata, int ptrIdx)
+{
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurf *ss = data->ss;
+	CCGFace *f = data->effectedF[ptrIdx];
 	int subdivLevels = ss->subdivLevels;
 	int lvl = ss->subdivLevels;
-	int edgeSize = ccg_edgesize(lvl);
 	int gridSize = ccg_gridsize(lvl);
 	int normalDataOffset = ss->normalDataOffset;
 	int vertDataSize = ss->meshIFC.vertDataSize;
+	int S, x, y;
+	float no[3];
 
-#pragma omp parallel for private(ptrIdx) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
-	for (ptrIdx = 0; ptrIdx < numEffectedF; ptrIdx++) {
-		CCGFace *f = (CCGFace *) effectedF[ptrIdx];
-		int S, x, y;
-		float no[3];
-
-		for (S = 0; S < f->numVerts; S++) {
-			for (y = 0; y < gridSize - 1; y++) {
-				for (x = 0; x < gridSize - 1; x++) {
-					NormZero(FACE_getIFNo(f, lvl, S, x, y));
-				}
+	for (S = 0; S < f->numVerts; S++) {
+		for (y = 0; y < gridSize - 1; y++) {
+			for (x = 0; x < gridSize - 1; x++) {
+				NormZero(FACE_getIFNo(f, lvl, S, x, y));
 			}
+		}
 
-			if (FACE_getEdges(f)[(S - 1 + f->numVerts) % f->numVerts]->flags & Edge_eEffected) {
-				for (x = 0; x < gridSize - 1; x++) {
-					NormZero(FACE_getIFNo(f, lvl, S, x, gridSize - 1));
-				}
-			}
-			if (FACE_getEdges(f)[S]->flags & Edge_eEffected) {
-				for (y = 0; y < gridSize - 1; y++) {
-					NormZero(FACE_getIFNo(f, lvl, S, gridSize - 1, y));
-				}
+		if (FACE_getEdges(f)[(S - 1 + f->numVerts) % f->numVerts]->flags & Edge_eEffected) {
+			for (x = 0; x < gridSize - 1; x++) {
+				NormZero(FACE_getIFNo(f, lvl, S, x, gridSize - 1));
 			}
-			if (FACE_getVerts(f)[S]->flags & Vert_eEffected) {
-				NormZero(FACE_getIFNo(f, lvl, S, gridSize - 1, gridSize - 1));
+		}
+		if (FACE_getEdges(f)[S]->flags & Edge_eEffected) {
+			for (y = 0; y < gridSize - 1; y++) {
+				NormZero(FACE_getIFNo(f, lvl, S, gridSize - 1, y));
 			}
 		}
+		if (FACE_getVerts(f)[S]->flags & Vert_eEffected) {
+			NormZero(FACE_getIFNo(f, lvl, S, gridSize - 1, gridSize - 1));
+		}
+	}
 
-		for (S = 0; S < f->numVerts; S++) {
-			int yLimit = !(FACE_getEdges(f)[(S - 1 + f->numVerts) % f->numVerts]->flags & Edge_eEffected);
-			int xLimit = !(FACE_getEdges(f)[S]->flags & Edge_eEffected);
-			int yLimitNext = xLimit;
-			int xLimitPrev = yLimit;
-			
-			for (y = 0; y < gridSize - 1; y++) {
-				for (x = 0; x < gridSize - 1; x++) {
-					int xPlusOk = (!xLimit || x < gridSize - 2);
-					int yPlusOk = (!yLimit || y < gridSize - 2);
-
-					FACE_calcIFNo(f, lvl, S, x, y, no);
-
-					NormAdd(FACE_getIFNo(f, lvl, S, x + 0, y + 0), no);
-					if (xPlusOk)
-						NormAdd(FACE_getIFNo(f, lvl, S, x + 1, y + 0), no);
-					if (yPlusOk)
-						NormAdd(FACE_getIFNo(f, lvl, S, x + 0, y + 1), no);
-					if (xPlusOk && yPlusOk) {
-						if (x < gridSize - 2 || y < gridSize - 2 || FACE_getVerts(f)[S]->flags & Vert_eEffected) {
-							NormAdd(FACE_getIFNo(f, lvl, S, x + 1, y + 1), no);
-						}
+	for (S = 0; S < f->numVerts; S++) {
+		int yLimit = !(FACE_getEdges(f)[(S - 1 + f->numVerts) % f->numVerts]->flags & Edge_eEffected);
+		int xLimit = !(FACE_getEdges(f)[S]->flags & Edge_eEffected);
+		int yLimitNext = xLimit;
+		int xLimitPrev = yLimit;
+		
+		for (y = 0; y < gridSize - 1; y++) {
+			for (x = 0; x < gridSize - 1; x++) {
+				int xPlusOk = (!xLimit || x < gridSize - 2);
+				int yPlusOk = (!yLimit || y < gridSize - 2);
+
+				FACE_calcIFNo(f, lvl, S, x, y, no);
+
+				NormAdd(FACE_getIFNo(f, lvl, S, x + 0, y + 0), no);
+				if (xPlusOk)
+					NormAdd(FACE_getIFNo(f, lvl, S, x + 1, y + 0), no);
+				if (yPlusOk)
+					NormAdd(FACE_getIFNo(f, lvl, S, x + 0, y + 1), no);
+				if (xPlusOk && yPlusOk) {
+					if (x < gridSize - 2 || y < gridSize - 2 || FACE_getVerts(f)[S]->flags & Vert_eEffected) {
+						NormAdd(FACE_getIFNo(f, lvl, S, x + 1, y + 1), no);
 					}
+				}
 
-					if (x == 0 && y == 0) {
-						int K;
+				if (x == 0 && y == 0) {
+					int K;
 
-						if (!yLimitNext || 1 < gridSize - 1)
-							NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, 1), no);
-						if (!xLimitPrev || 1 < gridSize - 1)
-							NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, 1, 0), no);
+					if (!yLimitNext || 1 < gridSize - 1)
+						NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, 1), no);
+					if (!xLimitPrev || 1 < gridSize - 1)
+						NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, 1, 0), no);
 
-						for (K = 0; K < f->numVerts; K++) {
-							if (K != S) {
-								NormAdd(FACE_getIFNo(f, lvl, K, 0, 0), no);
-							}
+					for (K = 0; K < f->numVerts; K++) {
+						if (K != S) {
+							NormAdd(FACE_getIFNo(f, lvl, K, 0, 0), no);
 						}
 					}
-					else if (y == 0) {
-						NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, x), no);
-						if (!yLimitNext || x < gridSize - 2)
-							NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, x + 1), no);
-					}
-					else if (x == 0) {
-						NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, y, 0), no);
-						if (!xLimitPrev || y < gridSize - 2)
-							NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, y + 1, 0), no);
-					}
 				}
+				else if (y == 0) {
+					NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, x), no);
+					if (!yLimitNext || x < gridSize - 2)
+						NormAdd(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, x + 1), no);
+				}
+				else if (x == 0) {
+					NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, y, 0), no);
+					if (!xLimitPrev || y < gridSize - 2)
+						NormAdd(FACE_getIFNo(f, lvl, (S - 1 + f->numVerts) % f->numVerts, y + 1, 0), no);
+				}
+			}
+		}
+	}
+}
+
+static void ccgSubSurf__calcVertNormals_faces_finalize_func(void *userdata, int ptrIdx)
+{
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurf *ss = data->ss;
+	CCGFace *f = data->effectedF[ptrIdx];
+	int subdivLevels = ss->subdivLevels;
+	int lvl = ss->subdivLevels;
+	int gridSize = ccg_gridsize(lvl);
+	int normalDataOffset = ss->normalDataOffset;
+	int vertDataSize = ss->meshIFC.vertDataSize;
+	int S, x, y;
+
+	for (S = 0; S < f->numVerts; S++) {
+		NormCopy(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, gridSize - 1),
+		         FACE_getIFNo(f, lvl, S, gridSize - 1, 0));
+	}
+
+	for (S = 0; S < f->numVerts; S++) {
+		for (y = 0; y < gridSize; y++) {
+			for (x = 0; x < gridSize; x++) {
+				float *no = FACE_getIFNo(f, lvl, S, x, y);
+				Normalize(no);
 			}
 		}
+
+		VertDataCopy((float *)((byte *)FACE_getCenterData(f) + normalDataOffset),
+		             FACE_getIFNo(f, lvl, S, 0, 0), ss);
+
+		for (x = 1; x < gridSize - 1; x++)
+			NormCopy(FACE_getIENo(f, lvl, S, x),
+			         FACE_getIFNo(f, lvl, S, x, 0));
 	}
+}
+
+static void ccgSubSurf__calcVertNormals(CCGSubSurf *ss,
+                                        CCGVert **effectedV, CCGEdge **effectedE, CCGFace **effectedF,
+                                        int numEffectedV, int numEffectedE, int numEffectedF)
+{
+	int i, ptrIdx;
+	int subdivLevels = ss->subdivLevels;
+	int lvl = ss->subdivLevels;
+	int edgeSize = ccg_edgesize(lvl);
+	int gridSize = ccg_gridsize(lvl);
+	int normalDataOffset = ss->normalDataOffset;
+	int vertDataSize = ss->meshIFC.vertDataSize;
+	CCGSubSurfCalcSubdivData data = {ss, effectedE, effectedF, lvl};
+
+	BLI_task_parallel_range(0, numEffectedF, &data, ccgSubSurf__calcVertNormals_faces_accumulate_func,
+	                        ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedF));
 	/* XXX can I reduce the number of normalisations here? */
 	for (ptrIdx = 0; ptrIdx < numEffectedV; ptrIdx++) {
 		CCGVert *v = (CCGVert *) effectedV[ptrIdx];
@@ -1576,32 +1640,8 @@ static void ccgSubSurf__calcVertNormals(CCGSubSurf *ss,
 		}
 	}
 
-#pragma omp parallel for private(ptrIdx) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
-	for (ptrIdx = 0; ptrIdx < numEffectedF; ptrIdx++) {
-		CCGFace *f = (CCGFace *) effectedF[ptrIdx];
-		int S, x, y;
-
-		for (S = 0; S < f->numVerts; S++) {
-			NormCopy(FACE_getIFNo(f, lvl, (S + 1) % f->numVerts, 0, gridSize - 1),
-			         FACE_getIFNo(f, lvl, S, gridSize - 1, 0));
-		}
-
-		for (S = 0; S < f->numVerts; S++) {
-			for (y = 0; y < gridSize; y++) {
-				for (x = 0; x < gridSize; x++) {
-					float *no = FACE_getIFNo(f, lvl, S, x, y);
-					Normalize(no);
-				}
-			}
-
-			VertDataCopy((float *)((byte *)FACE_getCenterData(f) + normalDataOffset),
-			             FACE_getIFNo(f, lvl, S, 0, 0), ss);
-
-			for (x = 1; x < gridSize - 1; x++)
-				NormCopy(FACE_getIENo(f, lvl, S, x),
-				         FACE_getIFNo(f, lvl, S, x, 0));
-		}
-	}
+	BLI_task_parallel_range(0, numEffectedF, &data, ccgSubSurf__calcVertNormals_faces_finalize_func,
+	                        ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedF));
 
 	for (ptrIdx = 0; ptrIdx < numEffectedE; ptrIdx++) {
 		CCGEdge *e = (CCGEdge *) effectedE[ptrIdx];
@@ -1635,94 +1675,271 @@ static void ccgSubSurf__calcVertNormals(CCGSubSurf *ss,
 #define FACE_getIECo(f, lvl, S, x)      _face_getIECo(f, lvl, S, x, subdivLevels, vertDataSize)
 #define FACE_getIFCo(f, lvl, S, x, y)   _face_getIFCo(f, lvl, S, x, y, subdivLevels, vertDataSize)
 
-static void ccgSubSurf__calcSubdivLevel(CCGSubSurf *ss,
-                                        CCGVert **effectedV, CCGEdge **effectedE, CCGFace **effectedF,
-                                        int numEffectedV, int numEffectedE, int numEffectedF, int curLvl)
+static void ccgSubSurf__calcSubdivLevel_interior_faces_edges_midpoints_func(void *userdata, int ptrIdx)
 {
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurf *ss = data->ss;
+	CCGFace *f = data->effectedF[ptrIdx];
 	int subdivLevels = ss->subdivLevels;
-	int edgeSize = ccg_edgesize(curLvl);
-	int gridSize = ccg_gridsize(curLvl);
+	int curLvl = data->curLvl;
 	int nextLvl = curLvl + 1;
-	int ptrIdx, cornerIdx, i;
+	int gridSize = ccg_gridsize(curLvl);
 	int vertDataSize = ss->meshIFC.vertDataSize;
-	float *q = ss->q, *r = ss->r;
+	int S, x, y;
 
-#pragma omp parallel for private(ptrIdx) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
-	for (ptrIdx = 0; ptrIdx < numEffectedF; ptrIdx++) {
-		CCGFace *f = (CCGFace *) effectedF[ptrIdx];
-		int S, x, y;
+	/* interior face midpoints
+	 * - old interior face points
+	 */
+	for (S = 0; S < f->numVerts; S++) {
+		for (y = 0; y < gridSize - 1; y++) {
+			for (x = 0; x < gridSize - 1; x++) {
+				int fx = 1 + 2 * x;
+				int fy = 1 + 2 * y;
+				const float *co0 = FACE_getIFCo(f, curLvl, S, x + 0, y + 0);
+				const float *co1 = FACE_getIFCo(f, curLvl, S, x + 1, y + 0);
+				const float *co2 = FACE_getIFCo(f, curLvl, S, x + 1, y + 1);
+				const float *co3 = FACE_getIFCo(f, curLvl, S, x + 0, y + 1);
+				float *co = FACE_getIFCo(f, nextLvl, S, fx, fy);
 
-		/* interior face midpoints
+				VertDataAvg4(co, co0, co1, co2, co3, ss);
+			}
+		}
+	}
+
+	/* interior edge midpoints
+	 * - old interior edge points
+	 * - new interior face midpoints
+	 */
+	for (S = 0; S < f->numVerts; S++) {
+		for (x = 0; x < gridSize - 1; x++) {
+			int fx = x * 2 + 1;
+			const float *co0 = FACE_getIECo(f, curLvl, S, x + 0);
+			const float *co1 = FACE_getIECo(f, curLvl, S, x + 1);
+			const float *co2 = FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx);
+			const float *co3 = FACE_getIFCo(f, nextLvl, S, fx, 1);
+			float *co  = FACE_getIECo(f, nextLvl, S, fx);
+			
+			VertDataAvg4(co, co0, co1, co2, co3, ss);
+		}
+
+		/* interior face interior edge midpoints
 		 * - old interior face points
+		 * - new interior face midpoints
 		 */
-		for (S = 0; S < f->numVerts; S++) {
+
+		/* vertical */
+		for (x = 1; x < gridSize - 1; x++) {
 			for (y = 0; y < gridSize - 1; y++) {
-				for (x = 0; x < gridSize - 1; x++) {
-					int fx = 1 + 2 * x;
-					int fy = 1 + 2 * y;
-					const float *co0 = FACE_getIFCo(f, curLvl, S, x + 0, y + 0);
-					const float *co1 = FACE_getIFCo(f, curLvl, S, x + 1, y + 0);
-					const float *co2 = FACE_getIFCo(f, curLvl, S, x + 1, y + 1);
-					const float *co3 = FACE_getIFCo(f, curLvl, S, x + 0, y + 1);
-					float *co = FACE_getIFCo(f, nextLvl, S, fx, fy);
-
-					VertDataAvg4(co, co0, co1, co2, co3, ss);
-				}
+				int fx = x * 2;
+				int fy = y * 2 + 1;
+				const float *co0 = FACE_getIFCo(f, curLvl, S, x, y + 0);
+				const float *co1 = FACE_getIFCo(f, curLvl, S, x, y + 1);
+				const float *co2 = FACE_getIFCo(f, nextLvl, S, fx - 1, fy);
+				const float *co3 = FACE_getIFCo(f, nextLvl, S, fx + 1, fy);
+				float *co  = FACE_getIFCo(f, nextLvl, S, fx, fy);
+
+				VertDataAvg4(co, co0, co1, co2, co3, ss);
 			}
 		}
 
-		/* interior edge midpoints
-		 * - old interior edge points
-		 * - new interior face midpoints
-		 */
-		for (S = 0; S < f->numVerts; S++) {
+		/* horizontal */
+		for (y = 1; y < gridSize - 1; y++) {
 			for (x = 0; x < gridSize - 1; x++) {
 				int fx = x * 2 + 1;
-				const float *co0 = FACE_getIECo(f, curLvl, S, x + 0);
-				const float *co1 = FACE_getIECo(f, curLvl, S, x + 1);
-				const float *co2 = FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx);
-				const float *co3 = FACE_getIFCo(f, nextLvl, S, fx, 1);
-				float *co  = FACE_getIECo(f, nextLvl, S, fx);
-				
+				int fy = y * 2;
+				const float *co0 = FACE_getIFCo(f, curLvl, S, x + 0, y);
+				const float *co1 = FACE_getIFCo(f, curLvl, S, x + 1, y);
+				const float *co2 = FACE_getIFCo(f, nextLvl, S, fx, fy - 1);
+				const float *co3 = FACE_getIFCo(f, nextLvl, S, fx, fy + 1);
+				float *co  = FACE_getIFCo(f, nextLvl, S, fx, fy);
+
 				VertDataAvg4(co, co0, co1, co2, co3, ss);
 			}
+		}
+	}
+}
 
-			/* interior face interior edge midpoints
-			 * - old interior face points
-			 * - new interior face midpoints
-			 */
+static void ccgSubSurf__calcSubdivLevel_interior_faces_edges_centerpoints_shift_func(
+        void *userdata, void *userdata_chunk, int ptrIdx)
+{
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurfCalcSubdivChunk *chunk = userdata_chunk;
+	CCGSubSurf *ss = data->ss;
+	CCGFace *f = data->effectedF[ptrIdx];
+	int subdivLevels = ss->subdivLevels;
+	int curLvl = data->curLvl;
+	int nextLvl = curLvl + 1;
+	int gridSize = ccg_gridsize(curLvl);
+	int vertDataSize = ss->meshIFC.vertDataSize;
+	float *q, *r;
+	int S, x, y;
 
-			/* vertical */
-			for (x = 1; x < gridSize - 1; x++) {
-				for (y = 0; y < gridSize - 1; y++) {
-					int fx = x * 2;
-					int fy = y * 2 + 1;
-					const float *co0 = FACE_getIFCo(f, curLvl, S, x, y + 0);
-					const float *co1 = FACE_getIFCo(f, curLvl, S, x, y + 1);
-					const float *co2 = FACE_getIFCo(f, nextLvl, S, fx - 1, fy);
-					const float *co3 = FACE_getIFCo(f, nextLvl, S, fx + 1, fy);
-					float *co  = FACE_getIFCo(f, nextLvl, S, fx, fy);
-
-					VertDataAvg4(co, co0, co1, co2, co3, ss);
-				}
-			}
+	/* scratch buffers are allocated once per task, freed in the reduce func */
+	if (chunk->q == NULL) {
+		chunk->q = MEM_mallocN(ss->meshIFC.vertDataSize, "CCGSubsurf q");
+		chunk->r = MEM_mallocN(ss->meshIFC.vertDataSize, "CCGSubsurf r");
+	}
+	q = chunk->q;
+	r = chunk->r;
 
-			/* horizontal */
+	/* interior center point shift
+	 * - old face center point (shifting)
+	 * - old interior edge points
+	 * - new interior face midpoints
+	 */
+	VertDataZero(q, ss);
+	for (S = 0; S < f->numVerts; S++) {
+		VertDataAdd(q, FACE_getIFCo(f, nextLvl, S, 1, 1), ss);
+	}
+	VertDataMulN(q, 1.0f / f->numVerts, ss);
+	VertDataZero(r, ss);
+	for (S = 0; S < f->numVerts; S++) {
+		VertDataAdd(r, FACE_getIECo(f, curLvl, S, 1), ss);
+	}
+	VertDataMulN(r, 1.0f / f->numVerts, ss);
+
+	VertDataMulN((float *)FACE_getCenterData(f), f->numVerts - 2.0f, ss);
+	VertDataAdd((float *)FACE_getCenterData(f), q, ss);
+	VertDataAdd((float *)FACE_getCenterData(f), r, ss);
+	VertDataMulN((float *)FACE_getCenterData(f), 1.0f / f->numVerts, ss);
+
+	for (S = 0; S < f->numVerts; S++) {
+		/* interior face shift
+		 * - old interior face point (shifting)
+		 * - new interior edge midpoints
+		 * - new interior face midpoints
+		 */
+		for (x = 1; x < gridSize - 1; x++) {
 			for (y = 1; y < gridSize - 1; y++) {
-				for (x = 0; x < gridSize - 1; x++) {
-					int fx = x * 2 + 1;
-					int fy = y * 2;
-					const float *co0 = FACE_getIFCo(f, curLvl, S, x + 0, y);
-					const float *co1 = FACE_getIFCo(f, curLvl, S, x + 1, y);
-					const float *co2 = FACE_getIFCo(f, nextLvl, S, fx, fy - 1);
-					const float *co3 = FACE_getIFCo(f, nextLvl, S, fx, fy + 1);
-					float *co  = FACE_getIFCo(f, nextLvl, S, fx, fy);
-
-					VertDataAvg4(co, co0, co1, co2, co3, ss);
-				}
+				int fx = x * 2;
+				int fy = y * 2;
+				const float *co = FACE_getIFCo(f, curLvl, S, x, y);
+				float *nCo = FACE_getIFCo(f, nextLvl, S, fx, fy);
+				
+				VertDataAvg4(q,
+				             FACE_getIFCo(f, nextLvl, S, fx - 1, fy - 1),
+				             FACE_getIFCo(f, nextLvl, S, fx + 1, fy - 1),
+				             FACE_getIFCo(f, nextLvl, S, fx + 1, fy + 1),
+				             FACE_getIFCo(f, nextLvl, S, fx - 1, fy + 1),
+				             ss);
+
+				VertDataAvg4(r,
+				             FACE_getIFCo(f, nextLvl, S, fx - 1, fy + 0),
+				             FACE_getIFCo(f, nextLvl, S, fx + 1, fy + 0),
+				             FACE_getIFCo(f, nextLvl, S, fx + 0, fy - 1),
+				             FACE_getIFCo(f, nextLvl, S, fx + 0, fy + 1),
+				             ss);
+
+				VertDataCopy(nCo, co, ss);
+				VertDataSub(nCo, q, ss);
+				VertDataMulN(nCo, 0.25f, ss);
+				VertDataAdd(nCo, r, ss);
 			}
 		}
+
+		/* interior edge interior shift
+		 * - old interior edge point (shifting)
+		 * - new interior edge midpoints
+		 * - new interior face midpoints
+		 */
+		for (x = 1; x < gridSize - 1; x++) {
+			int fx = x * 2;
+			const float *co = FACE_getIECo(f, curLvl, S, x);
+			float *nCo = FACE_getIECo(f, nextLvl, S, fx);
+			
+			VertDataAvg4(q,
+			             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx - 1),
+			             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx + 1),
+			             FACE_getIFCo(f, nextLvl, S, fx + 1, +1),
+			             FACE_getIFCo(f, nextLvl, S, fx - 1, +1), ss);
+
+			VertDataAvg4(r,
+			             FACE_getIECo(f, nextLvl, S, fx - 1),
+			             FACE_getIECo(f, nextLvl, S, fx + 1),
+			             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx),
+			             FACE_getIFCo(f, nextLvl, S, fx, 1),
+			             ss);
+
+			VertDataCopy(nCo, co, ss);
+			VertDataSub(nCo, q, ss);
+			VertDataMulN(nCo, 0.25f, ss);
+			VertDataAdd(nCo, r, ss);
+		}
+	}
+}
+
+static void ccgSubSurf__calcSubdivLevel_interior_faces_edges_centerpoints_shift_free(
+        void *UNUSED(userdata), void *userdata_chunk)
+{
+	CCGSubSurfCalcSubdivChunk *chunk = userdata_chunk;
+
+	if (chunk->q) {
+		MEM_freeN(chunk->q);
+		MEM_freeN(chunk->r);
+	}
+}
+
+static void ccgSubSurf__calcSubdivLevel_edges_copydata_func(void *userdata, int i)
+{
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurf *ss = data->ss;
+	CCGEdge *e = data->effectedE[i];
+	int nextLvl = data->curLvl + 1;
+	int edgeSize = ccg_edgesize(nextLvl);
+	int vertDataSize = ss->meshIFC.vertDataSize;
+
+
+	VertDataCopy(EDGE_getCo(e, nextLvl, 0), VERT_getCo(e->v0, nextLvl), ss);
+	VertDataCopy(EDGE_getCo(e, nextLvl, edgeSize - 1), VERT_getCo(e->v1, nextLvl), ss);
+}
+
+static void ccgSubSurf__calcSubdivLevel_interior_faces_edges_copydata_func(void *userdata, int i)
+{
+	CCGSubSurfCalcSubdivData *data = userdata;
+	CCGSubSurf *ss = data->ss;
+	CCGFace *f = data->effectedF[i];
+	int subdivLevels = ss->subdivLevels;
+	int nextLvl = data->curLvl + 1;
+	int gridSize = ccg_gridsize(nextLvl);
+	int cornerIdx = gridSize - 1;
+	int vertDataSize = ss->meshIFC.vertDataSize;
+	int S, x;
+
+	for (S = 0; S < f->numVerts; S++) {
+		CCGEdge *e = FACE_getEdges(f)[S];
+		CCGEdge *prevE = FACE_getEdges(f)[(S + f->numVerts - 1) % f->numVerts];
+
+		VertDataCopy(FACE_getIFCo(f, nextLvl, S, 0, 0), (float *)FACE_getCenterData(f), ss);
+		VertDataCopy(FACE_getIECo(f, nextLvl, S, 0), (float *)FACE_getCenterData(f), ss);
+		VertDataCopy(FACE_getIFCo(f, nextLvl, S, cornerIdx, cornerIdx), VERT_getCo(FACE_getVerts(f)[S], nextLvl), ss);
+		VertDataCopy(FACE_getIECo(f, nextLvl, S, cornerIdx), EDGE_getCo(FACE_getEdges(f)[S], nextLvl, cornerIdx), ss);
+		for (x = 1; x < gridSize - 1; x++) {
+			float *co = FACE_getIECo(f, nextLvl, S, x);
+			VertDataCopy(FACE_getIFCo(f, nextLvl, S, x, 0), co, ss);
+			VertDataCopy(FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 0, x), co, ss);
+		}
+		for (x = 0; x < gridSize - 1; x++) {
+			int eI = gridSize - 1 - x;
+			VertDataCopy(FACE_getIFCo(f, nextLvl, S, cornerIdx, x), _edge_getCoVert(e, FACE_getVerts(f)[S], nextLvl, eI, vertDataSize), ss);
+			VertDataCopy(FACE_getIFCo(f, nextLvl, S, x, cornerIdx), _edge_getCoVert(prevE, FACE_getVerts(f)[S], nextLvl, eI, vertDataSize), ss);
+		}
 	}
+}
+
+static void ccgSubSurf__calcSubdivLevel(CCGSubSurf *ss,
+                                        CCGVert **effectedV, CCGEdge **effectedE, CCGFace **effectedF,
+                                        int numEffectedV, int numEffectedE, int numEffectedF, int curLvl)
+{
+	int subdivLevels = ss->subdivLevels;
+	int edgeSize = ccg_edgesize(curLvl);
+	int nextLvl = curLvl + 1;
+	int ptrIdx;
+	int vertDataSize = ss->meshIFC.vertDataSize;
+	float *q = ss->q, *r = ss->r;
+	CCGSubSurfCalcSubdivData data = {ss, effectedE, effectedF, curLvl};
+
+	BLI_task_parallel_range(0, numEffectedF, &data, ccgSubSurf__calcSubdivLevel_interior_faces_edges_midpoints_func,
+	                        ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedF));
 
 	/* exterior edge midpoints
 	 * - old exterior edge points
@@ -1994,151 +2211,23 @@ static void ccgSubSurf__calcSubdivLevel(CCGSubSurf *ss,
 		}
 	}
 
-#pragma omp parallel private(ptrIdx) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
 	{
-		float *q, *r;
-
-#pragma omp critical
-		{
-			q = MEM_mallocN(ss->meshIFC.vertDataSize, "CCGSubsurf q");
-			r = MEM_mallocN(ss->meshIFC.vertDataSize, "CCGSubsurf r");
-		}
-
-#pragma omp for schedule(static)
-		for (ptrIdx = 0; ptrIdx < numEffectedF; ptrIdx++) {
-			CCGFace *f = (CCGFace *) effectedF[ptrIdx];
-			int S, x, y;
-
-			/* interior center point shift
-			 * - old face center point (shifting)
-			 * - old interior edge points
-			 * - new interior face midpoints
-			 */
-			VertDataZero(q, ss);
-			for (S = 0; S < f->numVerts; S++) {
-				VertDataAdd(q, FACE_getIFCo(f, nextLvl, S, 1, 1), ss);
-			}
-			VertDataMulN(q, 1.0f / f->numVerts, ss);
-			VertDataZero(r, ss);
-			for (S = 0; S < f->numVerts; S++) {
-				VertDataAdd(r, FACE_getIECo(f, curLvl, S, 1), ss);
-			}
-			VertDataMulN(r, 1.0f / f->numVerts, ss);
-
-			VertDataMulN((float *)FACE_getCenterData(f), f->numVerts - 2.0f, ss);
-			VertDataAdd((float *)FACE_getCenterData(f), q, ss);
-			VertDataAdd((float *)FACE_getCenterData(f), r, ss);
-			VertDataMulN((float *)FACE_getCenterData(f), 1.0f / f->numVerts, ss);
-
-			for (S = 0; S < f->numVerts; S++) {
-				/* interior face shift
-				 * - old interior face point (shifting)
-				 * - new interior edge midpoints
-				 * - new interior face midpoints
-				 */
-				for (x = 1; x < gridSize - 1; x++) {
-					for (y = 1; y < gridSize - 1; y++) {
-						int fx = x * 2;
-						int fy = y * 2;
-						const float *co = FACE_getIFCo(f, curLvl, S, x, y);
-						float *nCo = FACE_getIFCo(f, nextLvl, S, fx, fy);
-						
-						VertDataAvg4(q,
-						             FACE_getIFCo(f, nextLvl, S, fx - 1, fy - 1),
-						             FACE_getIFCo(f, nextLvl, S, fx + 1, fy - 1),
-						             FACE_getIFCo(f, nextLvl, S, fx + 1, fy + 1),
-						             FACE_getIFCo(f, nextLvl, S, fx - 1, fy + 1),
-						             ss);
-
-						VertDataAvg4(r,
-						             FACE_getIFCo(f, nextLvl, S, fx - 1, fy + 0),
-						             FACE_getIFCo(f, nextLvl, S, fx + 1, fy + 0),
-						             FACE_getIFCo(f, nextLvl, S, fx + 0, fy - 1),
-						             FACE_getIFCo(f, nextLvl, S, fx + 0, fy + 1),
-						             ss);
-
-						VertDataCopy(nCo, co, ss);
-						VertDataSub(nCo, q, ss);
-						VertDataMulN(nCo, 0.25f, ss);
-						VertDataAdd(nCo, r, ss);
-					}
-				}
+		CCGSubSurfCalcSubdivChunk chunk = {NULL, NULL};
 
-				/* interior edge interior shift
-				 * - old interior edge point (shifting)
-				 * - new interior edge midpoints
-				 * - new interior face midpoints
-				 */
-				for (x = 1; x < gridSize - 1; x++) {
-					int fx = x * 2;
-					const float *co = FACE_getIECo(f, curLvl, S, x);
-					float *nCo = FACE_getIECo(f, nextLvl, S, fx);
-					
-					VertDataAvg4(q,
-					             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx - 1),
-					             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx + 1),
-					             FACE_getIFCo(f, nextLvl, S, fx + 1, +1),
-					             FACE_getIFCo(f, nextLvl, S, fx - 1, +1), ss);
-
-					VertDataAvg4(r,
-					             FACE_getIECo(f, nextLvl, S, fx - 1),
-					             FACE_getIECo(f, nextLvl, S, fx + 1),
-					             FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 1, fx),
-					             FACE_getIFCo(f, nextLvl, S, fx, 1),
-					             ss);
-
-					VertDataCopy(nCo, co, ss);
-					VertDataSub(nCo, q, ss);
-					VertDataMulN(nCo, 0.25f, ss);
-					VertDataAdd(nCo, r, ss);
-				}
-			}
-		}
-
-#pragma omp critical
-		{
-			MEM_freeN(q);
-			MEM_freeN(r);
-		}
+		BLI_task_parallel_range_reduce(0, numEffectedF, &data, &chunk, sizeof(chunk),
+		                               ccgSubSurf__calcSubdivLevel_interior_faces_edges_centerpoints_shift_func,
+		                               ccgSubSurf__calcSubdivLevel_interior_faces_edges_centerpoints_shift_free,
+		                               ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedF));
 	}
 
 	/* copy down */
 	edgeSize = ccg_edgesize(nextLvl);
-	gridSize = ccg_gridsize(nextLvl);
-	cornerIdx = gridSize - 1;
 
-#pragma omp parallel for private(i) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
-	for (i = 0; i < numEffectedE; i++) {
-		CCGEdge *e = effectedE[i];
-		VertDataCopy(EDGE_getCo(e, nextLvl, 0), VERT_getCo(e->v0, nextLvl), ss);
-		VertDataCopy(EDGE_getCo(e, nextLvl, edgeSize - 1), VERT_getCo(e->v1, nextLvl), ss);
-	}
-
-#pragma omp parallel for private(i) if (numEffectedF * edgeSize * edgeSize * 4 >= CCG_OMP_LIMIT)
-	for (i = 0; i < numEffectedF; i++) {
-		CCGFace *f = effectedF[i];
-		int S, x;
+	BLI_task_parallel_range(0, numEffectedE, &data, ccgSubSurf__calcSubdivLevel_edges_copydata_func,
+	                        ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedE));
 
-		for (S = 0; S < f->numVerts; S++) {
-			CCGEdge *e = FACE_getEdges(f)[S];
-			CCGEdge *prevE = FACE_getEdges(f)[(S + f->numVerts - 1) % f->numVerts];
-
-			VertDataCopy(FACE_getIFCo(f, nextLvl, S, 0, 0), (float *)FACE_getCenterData(f), ss);
-			VertDataCopy(FACE_getIECo(f, nextLvl, S, 0), (float *)FACE_getCenterData(f), ss);
-			VertDataCopy(FACE_getIFCo(f, nextLvl, S, cornerIdx, cornerIdx), VERT_getCo(FACE_getVerts(f)[S], nextLvl), ss);
-			VertDataCopy(FACE_getIECo(f, nextLvl, S, cornerIdx), EDGE_getCo(FACE_getEdges(f)[S], nextLvl, cornerIdx), ss);
-			for (x = 1; x < gridSize - 1; x++) {
-				float *co = FACE_getIECo(f, nextLvl, S, x);
-				VertDataCopy(FACE_getIFCo(f, nextLvl, S, x, 0), co, ss);
-				VertDataCopy(FACE_getIFCo(f, nextLvl, (S + 1) % f->numVerts, 0, x), co, ss);
-			}
-			for (x = 0; x < gridSize - 1; x++) {
-				int eI = gridSize - 1 - x;
-				VertDataCopy(FACE_getIFCo(f, nextLvl, S, cornerIdx, x), _edge_getCoVert(e, FACE_getVerts(f)[S], nextLvl, eI, vertDataSize), ss);
-				VertDataCopy(FACE_getIFCo(f, nextLvl, S, x, cornerIdx), _edge_getCoVert(prevE, FACE_getVerts(f)[S], nextLvl, eI, vertDataSize), ss);
-			}
-		}
-	}
+	BLI_task_parallel_range(0, numEffectedF, &data, ccgSubSurf__calcSubdivLevel_interior_faces_edges_copydata_func,
+	                        ccg_task_min_chunk(numEffectedF, edgeSize, numEffectedF));
 }
 
 
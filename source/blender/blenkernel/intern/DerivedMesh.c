@@ -48,6 +48,7 @@
 #include "BLI_memarena.h"
 #include "BLI_utildefines.h"
 #include "BLI_linklist.h"
+#include "BLI_task.h"
 
 #include "BKE_pbvh.h"
 #include "BKE_cdderivedmesh.h"
@@ -1444,6 +1445,26 @@ static void dm_ensure_display_normals(DerivedMesh *dm)
  * - don't apply the key
  * - apply deform modifiers and input vertexco
  */
+/* fills the vert, edge and poly CD_ORIGINDEX layers, one per iteration */
+#define DM_ORIGINDEX_LAYERS 3
+
+static void dm_origindex_init_func(void *userdata, int iter)
+{
+	DerivedMesh *dm = userdata;
+
+	switch (iter) {
+		case 0:
+			range_vn_i(DM_get_vert_data_layer(dm, CD_ORIGINDEX), dm->numVertData, 0);
+			break;
+		case 1:
+			range_vn_i(DM_get_edge_data_layer(dm, CD_ORIGINDEX), dm->numEdgeData, 0);
+			break;
+		case 2:
+			range_vn_i(DM_get_poly_data_layer(dm, CD_ORIGINDEX), dm->numPolyData, 0);
+			break;
+	}
+}
+
 static void mesh_calc_modifiers(Scene *scene, Object *ob, float (*inputVertexCos)[3],
                                 DerivedMesh **deform_r, DerivedMesh **final_r,
                                 int useRenderParams, int useDeform,
@@ -1708,20 +1729,17 @@ static void mesh_calc_modifiers(Scene *scene, Object *ob, float (*inputVertexCos
 				 * data by using generic DM_copy_vert_data() functions.
 				 */
 				if (needMapping || (nextmask & CD_MASK_ORIGINDEX)) {
+					/* every layer gets its own task on big meshes, below BKE_MESH_OMP_LIMIT a
+					 * chunk of all layers fills them one after another on this thread */
+					const int min_chunk = (dm->numVertData + dm->numEdgeData + dm->numPolyData >= BKE_MESH_OMP_LIMIT) ?
+					                      1 : DM_ORIGINDEX_LAYERS;
+
 					/* calc */
 					DM_add_vert_layer(dm, CD_ORIGINDEX, CD_CALLOC, NULL);
 					DM_add_edge_layer(dm, CD_ORIGINDEX, CD_CALLOC, NULL);
 					DM_add_poly_layer(dm, CD_ORIGINDEX, CD_CALLOC, NULL);
 
-#pragma omp parallel sections if (dm->numVertData + dm->numEdgeData + dm->numPolyData >= BKE_MESH_OMP_LIMIT)
-					{
-#pragma omp section
-						{ range_vn_i(DM_get_vert_data_layer(dm, CD_ORIGINDEX), dm->numVertData, 0); }
-#pragma omp section
-						{ range_vn_i(DM_get_edge_data_layer(dm, CD_ORIGINDEX), dm->numEdgeData, 0); }
-#pragma omp section
-						{ range_vn_i(DM_get_poly_data_layer(dm, CD_ORIGINDEX), dm->numPolyData, 0); }
-					}
+					BLI_task_parallel_range(0, DM_ORIGINDEX_LAYERS, dm, dm_origindex_init_func, min_chunk);
 				}
 			}
 
@@ -46,6 +46,7 @@
 #include "BLI_linklist.h"
 #include "BLI_linklist_stack.h"
 #include "BLI_alloca.h"
+#include "BLI_task.h"
 
 #include "BKE_customdata.h"
 #include "BKE_mesh.h"
@@ -213,6 +214,21 @@ static void mesh_calc_normals_poly_accum(MPoly *mp, MLoop *ml,
 
 }
 
+typedef struct MeshCalcPolyNormalsData {
+	MVert *mverts;
+	MLoop *mloop;
+	MPoly *mpolys;
+	float (*pnors)[3];
+} MeshCalcPolyNormalsData;
+
+static void mesh_calc_poly_normal_func(void *userdata, int i)
+{
+	MeshCalcPolyNormalsData *data = userdata;
+	MPoly *mp = &data->mpolys[i];
+
+	BKE_mesh_calc_poly_normal(mp, data->mloop + mp->loopstart, data->mverts, data->pnors[i]);
+}
+
 void BKE_mesh_calc_normals_poly(MVert *mverts, int numVerts, MLoop *mloop, MPoly *mpolys,
                                 int UNUSED(numLoops), int numPolys, float (*r_polynors)[3],
                                 const bool only_face_normals)
@@ -223,12 +239,11 @@ void BKE_mesh_calc_normals_poly(MVert *mverts, int numVerts, MLoop *mloop, MPoly
 	MPoly *mp;
 
 	if (only_face_normals) {
+		MeshCalcPolyNormalsData data = {mverts, mloop, mpolys, pnors};
+
 		BLI_assert(pnors != NULL);
 
-#pragma omp parallel for if (numPolys > BKE_MESH_OMP_LIMIT)
-		for (i = 0; i < numPolys; i++) {
-			BKE_mesh_calc_poly_normal(&mpolys[i], mloop + mpolys[i].loopstart, mverts, pnors[i]);
-		}
+		BLI_task_parallel_range(0, numPolys, &data, mesh_calc_poly_normal_func, BKE_MESH_TASK_CHUNK);
 		return;
 	}
 
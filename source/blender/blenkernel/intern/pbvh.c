@@ -30,6 +30,7 @@
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_task.h"
 
 #include "BKE_pbvh.h"
 #include "BKE_ccg.h"
@@ -45,6 +46,8 @@
 
 #include "pbvh_intern.h"
 
+#include "atomic_ops.h"
+
 #define LEAF_LIMIT 10000
 
 //#define PERFCNTRS
@@ -892,11 +895,104 @@ static bool update_search_cb(PBVHNode *node, void *data_v)
 	return 1;
 }
 
+typedef struct PBVHUpdateData {
+	PBVH *bvh;
+	PBVHNode **nodes;
+	int flag;
+	float (*vnor)[3];
+	float (*face_nors)[3];
+} PBVHUpdateData;
+
+/* vertices are shared between nodes, so their normals are accumulated atomically */
+static void pbvh_atomic_add_fl(float *p, const float x)
+{
+	union { float f; uint32_t i; } oldval, newval;
+
+	do {
+		oldval.f = *(volatile float *)p;
+		newval.f = oldval.f + x;
+	} while (atomic_cas_uint32((uint32_t *)p, oldval.i, newval.i) != oldval.i);
+}
+
+static void pbvh_update_normals_accum_func(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+	float (*vnor)[3] = data->vnor;
+	float (*face_nors)[3] = data->face_nors;
+
+	if ((node->flag & PBVH_UpdateNormals)) {
+		int i, j, totface, *faces;
+
+		faces = node->prim_indices;
+		totface = node->totprim;
+
+		for (i = 0; i < totface; ++i) {
+			MFace *f = bvh->faces + faces[i];
+			float fn[3];
+			unsigned int *fv = &f->v1;
+			int sides = (f->v4) ? 4 : 3;
+
+			if (f->v4)
+				normal_quad_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
+				               bvh->verts[f->v3].co, bvh->verts[f->v4].co);
+			else
+				normal_tri_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
+				              bvh->verts[f->v3].co);
+
+			for (j = 0; j < sides; ++j) {
+				int v = fv[j];
+
+				if (bvh->verts[v].flag & ME_VERT_PBVH_UPDATE) {
+					pbvh_atomic_add_fl(&vnor[v][0], fn[0]);
+					pbvh_atomic_add_fl(&vnor[v][1], fn[1]);
+					pbvh_atomic_add_fl(&vnor[v][2], fn[2]);
+				}
+			}
+
+			if (face_nors)
+				copy_v3_v3(face_nors[faces[i]], fn);
+		}
+	}
+}
+
+static void pbvh_update_normals_store_func(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+
+	if (node->flag & PBVH_UpdateNormals) {
+		int i, *verts, totvert;
+
+		verts = node->vert_indices;
+		totvert = node->uniq_verts;
+
+		for (i = 0; i < totvert; ++i) {
+			const int v = verts[i];
+			MVert *mvert = &bvh->verts[v];
+
+			if (mvert->flag & ME_VERT_PBVH_UPDATE) {
+				float no[3];
+
+				copy_v3_v3(no, data->vnor[v]);
+				normalize_v3(no);
+				normal_float_to_short_v3(mvert->no, no);
+
+				mvert->flag &= ~ME_VERT_PBVH_UPDATE;
+			}
+		}
+
+		node->flag &= ~PBVH_UpdateNormals;
+	}
+}
+
 static void pbvh_update_normals(PBVH *bvh, PBVHNode **nodes,
                                 int totnode, float (*face_nors)[3])
 {
+	PBVHUpdateData data;
 	float (*vnor)[3];
-	int n;
 
 	if (bvh->type == PBVH_BMESH) {
 		pbvh_bmesh_normals_update(nodes, totnode);
@@ -920,101 +1016,42 @@ static void pbvh_update_normals(PBVH *bvh, PBVHNode **nodes,
 	 *   can only update vertices marked with ME_VERT_PBVH_UPDATE.
 	 */
 
-#pragma omp parallel for private(n) schedule(static)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if ((node->flag & PBVH_UpdateNormals)) {
-			int i, j, totface, *faces;
-
-			faces = node->prim_indices;
-			totface = node->totprim;
-
-			for (i = 0; i < totface; ++i) {
-				MFace *f = bvh->faces + faces[i];
-				float fn[3];
-				unsigned int *fv = &f->v1;
-				int sides = (f->v4) ? 4 : 3;
-
-				if (f->v4)
-					normal_quad_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
-					               bvh->verts[f->v3].co, bvh->verts[f->v4].co);
-				else
-					normal_tri_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
-					              bvh->verts[f->v3].co);
-
-				for (j = 0; j < sides; ++j) {
-					int v = fv[j];
-
-					if (bvh->verts[v].flag & ME_VERT_PBVH_UPDATE) {
-						/* this seems like it could be very slow but profile
-						 * does not show this, so just leave it for now? */
-#pragma omp atomic
-						vnor[v][0] += fn[0];
-#pragma omp atomic
-						vnor[v][1] += fn[1];
-#pragma omp atomic
-						vnor[v][2] += fn[2];
-					}
-				}
-
-				if (face_nors)
-					copy_v3_v3(face_nors[faces[i]], fn);
-			}
-		}
-	}
-
-#pragma omp parallel for private(n) schedule(static)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if (node->flag & PBVH_UpdateNormals) {
-			int i, *verts, totvert;
-
-			verts = node->vert_indices;
-			totvert = node->uniq_verts;
+	data.bvh = bvh;
+	data.nodes = nodes;
+	data.flag = 0;
+	data.vnor = vnor;
+	data.face_nors = face_nors;
 
-			for (i = 0; i < totvert; ++i) {
-				const int v = verts[i];
-				MVert *mvert = &bvh->verts[v];
+	BLI_task_parallel_range(0, totnode, &data, pbvh_update_normals_accum_func, 1);
+	BLI_task_parallel_range(0, totnode, &data, pbvh_update_normals_store_func, 1);
 
-				if (mvert->flag & ME_VERT_PBVH_UPDATE) {
-					float no[3];
+	MEM_freeN(vnor);
+}
 
-					copy_v3_v3(no, vnor[v]);
-					normalize_v3(no);
-					normal_float_to_short_v3(mvert->no, no);
+static void pbvh_update_BB_redraw_func(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+	const int flag = data->flag;
 
-					mvert->flag &= ~ME_VERT_PBVH_UPDATE;
-				}
-			}
+	if ((flag & PBVH_UpdateBB) && (node->flag & PBVH_UpdateBB))
+		/* don't clear flag yet, leave it for flushing later */
+		update_node_vb(bvh, node);
 
-			node->flag &= ~PBVH_UpdateNormals;
-		}
-	}
+	if ((flag & PBVH_UpdateOriginalBB) && (node->flag & PBVH_UpdateOriginalBB))
+		node->orig_vb = node->vb;
 
-	MEM_freeN(vnor);
+	if ((flag & PBVH_UpdateRedraw) && (node->flag & PBVH_UpdateRedraw))
+		node->flag &= ~PBVH_UpdateRedraw;
 }
 
 void pbvh_update_BB_redraw(PBVH *bvh, PBVHNode **nodes, int totnode, int flag)
 {
-	int n;
+	PBVHUpdateData data = {bvh, nodes, flag, NULL, NULL};
 
 	/* update BB, redraw flag */
-#pragma omp parallel for private(n) schedule(static)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if ((flag & PBVH_UpdateBB) && (node->flag & PBVH_UpdateBB))
-			/* don't clear flag yet, leave it for flushing later */
-			update_node_vb(bvh, node);
-
-		if ((flag & PBVH_UpdateOriginalBB) && (node->flag & PBVH_UpdateOriginalBB))
-			node->orig_vb = node->vb;
-
-		if ((flag & PBVH_UpdateRedraw) && (node->flag & PBVH_UpdateRedraw))
-			node->flag &= ~PBVH_UpdateRedraw;
-	}
+	BLI_task_parallel_range(0, totnode, &data, pbvh_update_BB_redraw_func, 1);
 }
 
 static void pbvh_update_draw_buffers(PBVH *bvh, PBVHNode **nodes, int totnode)
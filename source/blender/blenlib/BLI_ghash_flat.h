@@ -0,0 +1,98 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_GHASH_FLAT_H__
+#define __BLI_GHASH_FLAT_H__
+
+/** \file BLI_ghash_flat.h
+ *  \ingroup bli
+ *  \brief An open addressing (pointer -> pointer) hash table ADT.
+ *
+ * Same callbacks and semantics as #GHash, but entries are stored inline in
+ * a power of two sized array, along with a byte per bucket holding part of
+ * the hash, which lookups compare for 16 buckets at once before calling the
+ * compare callback. This avoids an allocation per entry and pointer chasing
+ * on lookup, see source/tests/performance/BLI_ghash_performance.c.
+ *
+ * \note Unlike #GHash, pointers returned by #BLI_ghash_flat_lookup_p
+ * are invalidated by inserting or removing other keys.
+ */
+
+#include "BLI_ghash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GHashFlat GHashFlat;
+
+typedef struct GHashFlatIterator {
+	GHashFlat *gh;
+	unsigned int curBucket;
+} GHashFlatIterator;
+
+GHashFlat *BLI_ghash_flat_new_ex(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+                                 const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void   BLI_ghash_flat_free(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ghash_flat_insert(GHashFlat *gh, void *key, void *val);
+bool   BLI_ghash_flat_reinsert(GHashFlat *gh, void *key, void *val, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void  *BLI_ghash_flat_lookup(GHashFlat *gh, const void *key) ATTR_WARN_UNUSED_RESULT;
+void  *BLI_ghash_flat_lookup_default(GHashFlat *gh, const void *key, void *val_default) ATTR_WARN_UNUSED_RESULT;
+void **BLI_ghash_flat_lookup_p(GHashFlat *gh, const void *key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ghash_flat_ensure_p(GHashFlat *gh, void *key, void ***r_val) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ghash_flat_remove(GHashFlat *gh, void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ghash_flat_clear(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ghash_flat_clear_ex(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+                               const unsigned int nentries_reserve);
+void  *BLI_ghash_flat_popkey(GHashFlat *gh, void *key, GHashKeyFreeFP keyfreefp) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ghash_flat_haskey(GHashFlat *gh, const void *key) ATTR_WARN_UNUSED_RESULT;
+int    BLI_ghash_flat_size(GHashFlat *gh) ATTR_WARN_UNUSED_RESULT;
+
+GHashFlat *BLI_ghash_flat_ptr_new_ex(const char *info,
+                                     const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_ptr_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_str_new_ex(const char *info,
+                                     const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_str_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_int_new_ex(const char *info,
+                                     const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHashFlat *BLI_ghash_flat_int_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+
+/* *** */
+
+/* The hash table must not be mutated while iterating. */
+void   BLI_ghash_flatIterator_init(GHashFlatIterator *ghi, GHashFlat *gh);
+void   BLI_ghash_flatIterator_step(GHashFlatIterator *ghi);
+void  *BLI_ghash_flatIterator_getKey(GHashFlatIterator *ghi) ATTR_WARN_UNUSED_RESULT;
+void  *BLI_ghash_flatIterator_getValue(GHashFlatIterator *ghi) ATTR_WARN_UNUSED_RESULT;
+void **BLI_ghash_flatIterator_getValue_p(GHashFlatIterator *ghi) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ghash_flatIterator_done(GHashFlatIterator *ghi) ATTR_WARN_UNUSED_RESULT;
+
+#define GHASH_FLAT_ITER(gh_iter_, ghash_)                                     \
+	for (BLI_ghash_flatIterator_init(&gh_iter_, ghash_);                      \
+	     BLI_ghash_flatIterator_done(&gh_iter_) == false;                     \
+	     BLI_ghash_flatIterator_step(&gh_iter_))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLI_GHASH_FLAT_H__ */
@@ -83,6 +83,10 @@ typedef struct BLI_mempool_iter {
 enum {
 	BLI_MEMPOOL_NOP = 0,
 	BLI_MEMPOOL_ALLOW_ITER = (1 << 0),
+	/* allow alloc/free from multiple threads at once, threads share a fixed set of free list caches.
+	 * note: iteration, counting and clearing are not thread-safe,
+	 * and MEM_mallocN must be thread-safe (see BLI_begin_threaded_malloc). */
+	BLI_MEMPOOL_THREADSAFE = (1 << 1),
 };
 
 void  BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL();
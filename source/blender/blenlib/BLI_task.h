@@ -34,8 +34,10 @@ extern "C" {
 
 /* Task Scheduler
  * 
- * Central scheduler that holds running threads ready to execute tasks. A single
- * queue holds the task from all pools.
+ * Central scheduler that holds running threads ready to execute tasks. Each
+ * worker thread has its own lock-free deque, holding tasks pushed from tasks
+ * running on that thread, from which idle threads steal work. A shared queue
+ * holds tasks pushed from other threads and high priority tasks.
  *
  * Init/exit must be called before/after any task pools are created/freed, and
  * must be called from the main threads. All other scheduler and pool functions
@@ -100,6 +102,29 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool);
 /* number of tasks done, for stats, don't use this to make decisions */
 size_t BLI_task_pool_tasks_done(TaskPool *pool);
 
+/* Parallel for routines
+ *
+ * Run func for every iteration in [start, stop) using the global task
+ * scheduler. Iterations are handed out in chunks that shrink as the range
+ * runs out, and never get smaller than min_chunk. Ranges shorter than
+ * min_chunk run serially on the calling thread.
+ *
+ * The reduce variant gives every worker its own copy of userdata_chunk, which
+ * is initialized from the one passed in. After all iterations are done, reduce
+ * is called for each of these copies on the calling thread, to merge them into
+ * userdata. */
+
+typedef void (*TaskParallelRangeFunc)(void *userdata, int iter);
+typedef void (*TaskParallelRangeChunkFunc)(void *userdata, void *userdata_chunk, int iter);
+typedef void (*TaskParallelRangeReduceFunc)(void *userdata, void *userdata_chunk);
+
+void BLI_task_parallel_range(int start, int stop, void *userdata,
+                             TaskParallelRangeFunc func, int min_chunk);
+void BLI_task_parallel_range_reduce(int start, int stop, void *userdata,
+                                    void *userdata_chunk, size_t userdata_chunk_size,
+                                    TaskParallelRangeChunkFunc func,
+                                    TaskParallelRangeReduceFunc reduce, int min_chunk);
+
 #ifdef __cplusplus
 }
 #endif
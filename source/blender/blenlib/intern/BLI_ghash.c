@@ -367,6 +367,40 @@ bool BLI_ghash_reinsert(GHash *gh, void *key, void *val, GHashKeyFreeFP keyfreef
 	}
 }
 
+/**
+ * Ensure \a key is in \a gh, adding it when it's missing.
+ *
+ * Avoids the #BLI_ghash_lookup_p, #BLI_ghash_insert calls (double lookups)
+ * when a value is only constructed the first time a key is seen.
+ *
+ * \param r_val  The pointer to the value of \a key, which must be initialized by the caller
+ * when the key was added.
+ * \returns true if \a key was already in \a gh.
+ */
+bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
+{
+	const unsigned int hash = ghash_keyhash(gh, key);
+	Entry *e = ghash_lookup_entry_ex(gh, key, hash);
+	const bool haskey = (e != NULL);
+	IS_GHASH_ASSERT(gh);
+
+	if (!haskey) {
+		/* entries keep their address when the buckets are resized */
+		e = (Entry *)BLI_mempool_alloc(gh->entrypool);
+		e->next = gh->buckets[hash];
+		e->key = key;
+		e->val = NULL;
+		gh->buckets[hash] = e;
+
+		if (UNLIKELY(ghash_test_expand_buckets(++gh->nentries, gh->nbuckets))) {
+			ghash_resize_buckets(gh, hashsizes[++gh->cursize]);
+		}
+	}
+
+	*r_val = &e->val;
+	return haskey;
+}
+
 /**
  * Lookup the value of \a key in \a gh.
  *
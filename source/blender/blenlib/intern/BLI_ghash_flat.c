@@ -0,0 +1,705 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/BLI_ghash_flat.c
+ *  \ingroup bli
+ *
+ * An open addressing (pointer -> pointer) hash table ADT.
+ *
+ * Entries are stored inline in a power of two sized array, next to an array
+ * with one control byte per bucket. A control byte is either empty, deleted
+ * (a tombstone) or the 7 bit fingerprint of the hash of the key in the bucket.
+ *
+ * The hash is multiplied by a 64 bit Fibonacci constant, its top bits select
+ * the home bucket and the bits below give the fingerprint, so hashes with
+ * poorly distributed low bits (aligned pointers for example) still spread well.
+ *
+ * Lookups compare the control bytes of 16 buckets at once starting from the
+ * home bucket, and only call the compare callback for matching fingerprints.
+ * Probing continues with the next 16 buckets until one of them is empty, so
+ * lookups of missing keys mostly touch the control bytes only, which are small
+ * enough to stay in cache. The first buckets are repeated after the last one
+ * so 16 control bytes can be loaded from any bucket.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_sys_types.h"  /* for intptr_t support */
+#include "BLI_utildefines.h"
+#include "BLI_ghash_flat.h"
+#include "BLI_strict_flags.h"
+
+/* buckets compared at once */
+#define GHASH_FLAT_GROUP 16
+/* smallest table */
+#define GHASH_FLAT_BUCKET_BIT_MIN 4
+/* grow when more than 7/8 of the buckets are used or deleted */
+#define GHASH_FLAT_LIMIT(nbuckets) ((nbuckets) - ((nbuckets) >> 3))
+
+#define GHASH_FLAT_EMPTY   ((unsigned char)0x80)
+#define GHASH_FLAT_DELETED ((unsigned char)0xfe)
+/* fingerprints have the high bit cleared, empty and deleted buckets set */
+#define GHASH_FLAT_IS_FULL(ctrl) (((ctrl) & 0x80) == 0)
+
+#define GHASH_FLAT_NONE UINT_MAX
+
+typedef struct FlatEntry {
+	void *key, *val;
+} FlatEntry;
+
+struct GHashFlat {
+	GHashHashFP hashfp;
+	GHashCmpFP cmpfp;
+
+	/* nbuckets + GHASH_FLAT_GROUP - 1 control bytes */
+	unsigned char *ctrl;
+	FlatEntry *entries;
+
+	unsigned int bucket_bit;
+	unsigned int nbuckets;
+	unsigned int nentries;
+	/* number of empty buckets that can still be filled before growing */
+	unsigned int growth_left;
+};
+
+
+/**
+ * Unlike #BLI_ghashutil_ptrhash this keeps the low bits, dropping them makes
+ * neighboring elements of an array share a hash, and so a home bucket.
+ */
+static unsigned int ghash_flat_ptrhash(const void *key)
+{
+	const size_t y = (size_t)key;
+	return (unsigned int)(y ^ (y >> (sizeof(void *) * 4)));
+}
+
+
+/* -------------------------------------------------------------------- */
+/* GHashFlat API */
+
+/** \name Internal Utility API
+ * \{ */
+
+/**
+ * A bit mask for each of the 16 control bytes starting at \a ctrl
+ * that are equal to \a value.
+ */
+BLI_INLINE unsigned int ghash_flat_group_match(const unsigned char *ctrl, const unsigned char value)
+{
+#ifdef __SSE2__
+	const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+	unsigned int mask = 0, j;
+
+	for (j = 0; j < GHASH_FLAT_GROUP; j++) {
+		if (ctrl[j] == value) {
+			mask |= 1u << j;
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * A bit mask for each of the 16 control bytes starting at \a ctrl
+ * that are empty or deleted.
+ */
+BLI_INLINE unsigned int ghash_flat_group_match_free(const unsigned char *ctrl)
+{
+#ifdef __SSE2__
+	return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+	unsigned int mask = 0, j;
+
+	for (j = 0; j < GHASH_FLAT_GROUP; j++) {
+		if (!GHASH_FLAT_IS_FULL(ctrl[j])) {
+			mask |= 1u << j;
+		}
+	}
+	return mask;
+#endif
+}
+
+/* index of the lowest set bit, \a mask must not be zero */
+BLI_INLINE unsigned int ghash_flat_bitscan(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int)__builtin_ctz(mask);
+#else
+	unsigned int i = 0;
+
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/* index of the highest set bit, \a mask must not be zero */
+BLI_INLINE unsigned int ghash_flat_bitscan_reverse(unsigned int mask)
+{
+#ifdef __GNUC__
+	return 31 - (unsigned int)__builtin_clz(mask);
+#else
+	unsigned int i = 0;
+
+	while (mask >>= 1) {
+		i++;
+	}
+	return i;
+#endif
+}
+
+BLI_INLINE uint64_t ghash_flat_keyhash(GHashFlat *gh, const void *key)
+{
+	return (uint64_t)gh->hashfp(key) * 11400714819323198485ull;
+}
+
+BLI_INLINE unsigned int ghash_flat_home(GHashFlat *gh, const uint64_t hash)
+{
+	return (unsigned int)(hash >> (64 - gh->bucket_bit));
+}
+
+BLI_INLINE unsigned char ghash_flat_fingerprint(GHashFlat *gh, const uint64_t hash)
+{
+	return (unsigned char)((hash >> (57 - gh->bucket_bit)) & 0x7f);
+}
+
+/**
+ * Set the control byte of bucket \a i, and its copy after the last bucket.
+ */
+BLI_INLINE void ghash_flat_set_ctrl(GHashFlat *gh, const unsigned int i, const unsigned char value)
+{
+	gh->ctrl[i] = value;
+	gh->ctrl[((i - (GHASH_FLAT_GROUP - 1)) & (gh->nbuckets - 1)) + (GHASH_FLAT_GROUP - 1)] = value;
+}
+
+static unsigned int ghash_flat_bucket_bit_reserve(const unsigned int nentries_reserve)
+{
+	unsigned int bucket_bit = GHASH_FLAT_BUCKET_BIT_MIN;
+
+	while (bucket_bit < 31 && GHASH_FLAT_LIMIT(1u << bucket_bit) < nentries_reserve) {
+		bucket_bit++;
+	}
+	return bucket_bit;
+}
+
+static void ghash_flat_buckets_alloc(GHashFlat *gh, const unsigned int bucket_bit)
+{
+	gh->bucket_bit = bucket_bit;
+	gh->nbuckets = 1u << bucket_bit;
+	gh->growth_left = GHASH_FLAT_LIMIT(gh->nbuckets) - gh->nentries;
+
+	gh->ctrl = MEM_mallocN(gh->nbuckets + GHASH_FLAT_GROUP - 1, "ghash flat ctrl");
+	gh->entries = MEM_mallocN(sizeof(*gh->entries) * gh->nbuckets, "ghash flat entries");
+
+	memset(gh->ctrl, GHASH_FLAT_EMPTY, gh->nbuckets + GHASH_FLAT_GROUP - 1);
+}
+
+/**
+ * The first empty or deleted bucket in the probe sequence of \a hash.
+ */
+BLI_INLINE unsigned int ghash_flat_find_free(GHashFlat *gh, const uint64_t hash)
+{
+	const unsigned int mask = gh->nbuckets - 1;
+	unsigned int i = ghash_flat_home(gh, hash);
+
+	for (;;) {
+		const unsigned int free = ghash_flat_group_match_free(&gh->ctrl[i]);
+
+		if (free) {
+			return (i + ghash_flat_bitscan(free)) & mask;
+		}
+		i = (i + GHASH_FLAT_GROUP) & mask;
+	}
+}
+
+/**
+ * Rebuild the buckets with 2^bucket_bit buckets, dropping deleted buckets.
+ */
+static void ghash_flat_resize(GHashFlat *gh, const unsigned int bucket_bit)
+{
+	unsigned char *ctrl_old = gh->ctrl;
+	FlatEntry *entries_old = gh->entries;
+	const unsigned int nbuckets_old = gh->nbuckets;
+	unsigned int i;
+
+	ghash_flat_buckets_alloc(gh, bucket_bit);
+
+	for (i = 0; i < nbuckets_old; i++) {
+		if (GHASH_FLAT_IS_FULL(ctrl_old[i])) {
+			const uint64_t hash = ghash_flat_keyhash(gh, entries_old[i].key);
+			const unsigned int j = ghash_flat_find_free(gh, hash);
+
+			ghash_flat_set_ctrl(gh, j, ghash_flat_fingerprint(gh, hash));
+			gh->entries[j] = entries_old[i];
+		}
+	}
+
+	MEM_freeN(ctrl_old);
+	MEM_freeN(entries_old);
+}
+
+/**
+ * Internal lookup function.
+ * \return the bucket index of \a key or #GHASH_FLAT_NONE.
+ */
+BLI_INLINE unsigned int ghash_flat_lookup_index_ex(GHashFlat *gh, const void *key,
+                                                   const uint64_t hash)
+{
+	const unsigned int mask = gh->nbuckets - 1;
+	const unsigned char fingerprint = ghash_flat_fingerprint(gh, hash);
+	unsigned int i = ghash_flat_home(gh, hash);
+
+	/* there is always an empty bucket, which ends the probing */
+	for (;;) {
+		unsigned int match = ghash_flat_group_match(&gh->ctrl[i], fingerprint);
+
+		while (match) {
+			const unsigned int j = (i + ghash_flat_bitscan(match)) & mask;
+
+			if (gh->cmpfp(key, gh->entries[j].key) == 0) {
+				return j;
+			}
+			match &= match - 1;
+		}
+
+		if (ghash_flat_group_match(&gh->ctrl[i], GHASH_FLAT_EMPTY)) {
+			return GHASH_FLAT_NONE;
+		}
+		i = (i + GHASH_FLAT_GROUP) & mask;
+	}
+}
+
+BLI_INLINE unsigned int ghash_flat_lookup_index(GHashFlat *gh, const void *key)
+{
+	return ghash_flat_lookup_index_ex(gh, key, ghash_flat_keyhash(gh, key));
+}
+
+/**
+ * \return the bucket index of the inserted key.
+ */
+BLI_INLINE unsigned int ghash_flat_insert_ex(GHashFlat *gh, void *key, void *val,
+                                             const uint64_t hash)
+{
+	unsigned int i;
+
+	BLI_assert(ghash_flat_lookup_index_ex(gh, key, hash) == GHASH_FLAT_NONE);
+
+	i = ghash_flat_find_free(gh, hash);
+
+	if (gh->ctrl[i] == GHASH_FLAT_EMPTY) {
+		if (UNLIKELY(gh->growth_left == 0)) {
+			/* grow, unless many buckets are deleted, then rebuilding is enough */
+			const unsigned int bucket_bit = (gh->nentries >= (gh->nbuckets >> 1)) ?
+			                                gh->bucket_bit + 1 : gh->bucket_bit;
+			ghash_flat_resize(gh, bucket_bit);
+			i = ghash_flat_find_free(gh, hash);
+		}
+		gh->growth_left--;
+	}
+
+	ghash_flat_set_ctrl(gh, i, ghash_flat_fingerprint(gh, hash));
+	gh->entries[i].key = key;
+	gh->entries[i].val = val;
+	gh->nentries++;
+
+	return i;
+}
+
+/**
+ * Remove the entry at bucket \a i.
+ */
+static void ghash_flat_remove_index(GHashFlat *gh, const unsigned int i)
+{
+	const unsigned int mask = gh->nbuckets - 1;
+	const unsigned int empty_before = ghash_flat_group_match(&gh->ctrl[(i - GHASH_FLAT_GROUP) & mask], GHASH_FLAT_EMPTY);
+	const unsigned int empty_after = ghash_flat_group_match(&gh->ctrl[i], GHASH_FLAT_EMPTY);
+
+	/* the bucket can be empty again if every group of 16 buckets containing it
+	 * has another empty bucket, so no probing ever continued past it */
+	if (empty_before && empty_after &&
+	    ghash_flat_bitscan(empty_after) + (GHASH_FLAT_GROUP - 1 - ghash_flat_bitscan_reverse(empty_before)) <
+	    GHASH_FLAT_GROUP)
+	{
+		ghash_flat_set_ctrl(gh, i, GHASH_FLAT_EMPTY);
+		gh->growth_left++;
+	}
+	else {
+		ghash_flat_set_ctrl(gh, i, GHASH_FLAT_DELETED);
+	}
+
+	gh->nentries--;
+}
+
+/**
+ * Run free callbacks for freeing entries.
+ */
+static void ghash_flat_free_cb(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	unsigned int i;
+
+	BLI_assert(keyfreefp || valfreefp);
+
+	for (i = 0; i < gh->nbuckets; i++) {
+		if (GHASH_FLAT_IS_FULL(gh->ctrl[i])) {
+			if (keyfreefp) keyfreefp(gh->entries[i].key);
+			if (valfreefp) valfreefp(gh->entries[i].val);
+		}
+	}
+}
+/** \} */
+
+
+/** \name Public API
+ * \{ */
+
+/**
+ * Creates a new, empty GHashFlat.
+ *
+ * \param hashfp  Hash callback.
+ * \param cmpfp  Comparison callback.
+ * \param info  Identifier string for the GHashFlat.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ * \return  An empty GHashFlat.
+ */
+GHashFlat *BLI_ghash_flat_new_ex(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+                                 const unsigned int nentries_reserve)
+{
+	GHashFlat *gh = MEM_mallocN(sizeof(*gh), info);
+
+	gh->hashfp = hashfp;
+	gh->cmpfp = cmpfp;
+	gh->nentries = 0;
+
+	ghash_flat_buckets_alloc(gh, ghash_flat_bucket_bit_reserve(nentries_reserve));
+
+	return gh;
+}
+
+/**
+ * Wraps #BLI_ghash_flat_new_ex with zero entries reserved.
+ */
+GHashFlat *BLI_ghash_flat_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+	return BLI_ghash_flat_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * \return size of the GHashFlat.
+ */
+int BLI_ghash_flat_size(GHashFlat *gh)
+{
+	return (int)gh->nentries;
+}
+
+/**
+ * Insert a key/value pair into the \a gh.
+ *
+ * \note Duplicates are not checked, the caller is expected to ensure elements are unique.
+ */
+void BLI_ghash_flat_insert(GHashFlat *gh, void *key, void *val)
+{
+	ghash_flat_insert_ex(gh, key, val, ghash_flat_keyhash(gh, key));
+}
+
+/**
+ * Inserts a new value to a key that may already be in the hash.
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_ghash_flat_reinsert(GHashFlat *gh, void *key, void *val, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	const uint64_t hash = ghash_flat_keyhash(gh, key);
+	const unsigned int i = ghash_flat_lookup_index_ex(gh, key, hash);
+
+	if (i != GHASH_FLAT_NONE) {
+		FlatEntry *e = &gh->entries[i];
+		if (keyfreefp) keyfreefp(e->key);
+		if (valfreefp) valfreefp(e->val);
+		e->key = key;
+		e->val = val;
+		return false;
+	}
+	else {
+		ghash_flat_insert_ex(gh, key, val, hash);
+		return true;
+	}
+}
+
+/**
+ * Lookup the value of \a key in \a gh.
+ *
+ * \returns the value for \a key or NULL.
+ */
+void *BLI_ghash_flat_lookup(GHashFlat *gh, const void *key)
+{
+	const unsigned int i = ghash_flat_lookup_index(gh, key);
+	return (i != GHASH_FLAT_NONE) ? gh->entries[i].val : NULL;
+}
+
+/**
+ * A version of #BLI_ghash_flat_lookup which accepts a fallback argument.
+ */
+void *BLI_ghash_flat_lookup_default(GHashFlat *gh, const void *key, void *val_default)
+{
+	const unsigned int i = ghash_flat_lookup_index(gh, key);
+	return (i != GHASH_FLAT_NONE) ? gh->entries[i].val : val_default;
+}
+
+/**
+ * Lookup a pointer to the value of \a key in \a gh.
+ *
+ * \returns the pointer to value for \a key or NULL,
+ * only valid until the next insertion or removal.
+ */
+void **BLI_ghash_flat_lookup_p(GHashFlat *gh, const void *key)
+{
+	const unsigned int i = ghash_flat_lookup_index(gh, key);
+	return (i != GHASH_FLAT_NONE) ? &gh->entries[i].val : NULL;
+}
+
+/**
+ * Ensure \a key is in \a gh, adding it when it's missing.
+ *
+ * \param r_val  The pointer to the value of \a key, which must be initialized by the caller
+ * when the key was added, only valid until the next insertion or removal.
+ * \returns true if \a key was already in \a gh.
+ */
+bool BLI_ghash_flat_ensure_p(GHashFlat *gh, void *key, void ***r_val)
+{
+	const uint64_t hash = ghash_flat_keyhash(gh, key);
+	unsigned int i = ghash_flat_lookup_index_ex(gh, key, hash);
+	const bool found = (i != GHASH_FLAT_NONE);
+
+	if (!found) {
+		i = ghash_flat_insert_ex(gh, key, NULL, hash);
+	}
+
+	*r_val = &gh->entries[i].val;
+	return found;
+}
+
+/**
+ * Remove \a key from \a gh, or return false if the key wasn't found.
+ *
+ * \param key  The key to remove.
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ * \return true if \a key was removed from \a gh.
+ */
+bool BLI_ghash_flat_remove(GHashFlat *gh, void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	const unsigned int i = ghash_flat_lookup_index(gh, key);
+
+	if (i != GHASH_FLAT_NONE) {
+		if (keyfreefp) keyfreefp(gh->entries[i].key);
+		if (valfreefp) valfreefp(gh->entries[i].val);
+		ghash_flat_remove_index(gh, i);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/**
+ * Remove \a key from \a gh, returning the value or NULL if the key wasn't found.
+ *
+ * \param key  The key to remove.
+ * \param keyfreefp  Optional callback to free the key.
+ * \return the value of \a key int \a gh or NULL.
+ */
+void *BLI_ghash_flat_popkey(GHashFlat *gh, void *key, GHashKeyFreeFP keyfreefp)
+{
+	const unsigned int i = ghash_flat_lookup_index(gh, key);
+
+	if (i != GHASH_FLAT_NONE) {
+		void *val = gh->entries[i].val;
+		if (keyfreefp) keyfreefp(gh->entries[i].key);
+		ghash_flat_remove_index(gh, i);
+		return val;
+	}
+	else {
+		return NULL;
+	}
+}
+
+/**
+ * \return true if the \a key is in \a gh.
+ */
+bool BLI_ghash_flat_haskey(GHashFlat *gh, const void *key)
+{
+	return (ghash_flat_lookup_index(gh, key) != GHASH_FLAT_NONE);
+}
+
+/**
+ * Reset \a gh clearing all entries.
+ *
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ */
+void BLI_ghash_flat_clear_ex(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+                             const unsigned int nentries_reserve)
+{
+	if (keyfreefp || valfreefp)
+		ghash_flat_free_cb(gh, keyfreefp, valfreefp);
+
+	MEM_freeN(gh->ctrl);
+	MEM_freeN(gh->entries);
+
+	gh->nentries = 0;
+	ghash_flat_buckets_alloc(gh, ghash_flat_bucket_bit_reserve(nentries_reserve));
+}
+
+/**
+ * Wraps #BLI_ghash_flat_clear_ex with zero entries reserved.
+ */
+void BLI_ghash_flat_clear(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	BLI_ghash_flat_clear_ex(gh, keyfreefp, valfreefp, 0);
+}
+
+/**
+ * Frees the GHashFlat and its members.
+ *
+ * \param gh  The GHashFlat to free.
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ */
+void BLI_ghash_flat_free(GHashFlat *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	if (keyfreefp || valfreefp)
+		ghash_flat_free_cb(gh, keyfreefp, valfreefp);
+
+	MEM_freeN(gh->ctrl);
+	MEM_freeN(gh->entries);
+	MEM_freeN(gh);
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+/* GHashFlat Iterator API */
+
+/** \name Iterator API
+ * \{ */
+
+static void ghash_flat_iterator_skip_empty(GHashFlatIterator *ghi)
+{
+	GHashFlat *gh = ghi->gh;
+
+	while (ghi->curBucket < gh->nbuckets && !GHASH_FLAT_IS_FULL(gh->ctrl[ghi->curBucket])) {
+		ghi->curBucket++;
+	}
+}
+
+/**
+ * Init an already allocated GHashFlatIterator. The hash table must not
+ * be mutated while the iterator is in use.
+ */
+void BLI_ghash_flatIterator_init(GHashFlatIterator *ghi, GHashFlat *gh)
+{
+	ghi->gh = gh;
+	ghi->curBucket = 0;
+	ghash_flat_iterator_skip_empty(ghi);
+}
+
+/**
+ * Steps the iterator to the next index.
+ */
+void BLI_ghash_flatIterator_step(GHashFlatIterator *ghi)
+{
+	ghi->curBucket++;
+	ghash_flat_iterator_skip_empty(ghi);
+}
+
+void *BLI_ghash_flatIterator_getKey(GHashFlatIterator *ghi)
+{
+	return ghi->gh->entries[ghi->curBucket].key;
+}
+
+void *BLI_ghash_flatIterator_getValue(GHashFlatIterator *ghi)
+{
+	return ghi->gh->entries[ghi->curBucket].val;
+}
+
+void **BLI_ghash_flatIterator_getValue_p(GHashFlatIterator *ghi)
+{
+	return &ghi->gh->entries[ghi->curBucket].val;
+}
+
+bool BLI_ghash_flatIterator_done(GHashFlatIterator *ghi)
+{
+	return ghi->curBucket >= ghi->gh->nbuckets;
+}
+
+/** \} */
+
+
+/** \name Convenience GHashFlat Creation Functions
+ * \{ */
+
+GHashFlat *BLI_ghash_flat_ptr_new_ex(const char *info,
+                                     const unsigned int nentries_reserve)
+{
+	return BLI_ghash_flat_new_ex(ghash_flat_ptrhash, BLI_ghashutil_ptrcmp, info,
+	                             nentries_reserve);
+}
+GHashFlat *BLI_ghash_flat_ptr_new(const char *info)
+{
+	return BLI_ghash_flat_ptr_new_ex(info, 0);
+}
+
+GHashFlat *BLI_ghash_flat_str_new_ex(const char *info,
+                                     const unsigned int nentries_reserve)
+{
+	return BLI_ghash_flat_new_ex(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, info,
+	                             nentries_reserve);
+}
+GHashFlat *BLI_ghash_flat_str_new(const char *info)
+{
+	return BLI_ghash_flat_str_new_ex(info, 0);
+}
+
+GHashFlat *BLI_ghash_flat_int_new_ex(const char *info,
+                                     const unsigned int nentries_reserve)
+{
+	return BLI_ghash_flat_new_ex(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, info,
+	                             nentries_reserve);
+}
+GHashFlat *BLI_ghash_flat_int_new(const char *info)
+{
+	return BLI_ghash_flat_int_new_ex(info, 0);
+}
+
+/** \} */
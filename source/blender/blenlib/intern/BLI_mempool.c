@@ -40,6 +40,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_spin.h"
+
 #include "BLI_strict_flags.h"  /* keep last */
 
 #ifdef WITH_MEM_VALGRIND
@@ -67,6 +69,10 @@
 /* optimize pool size */
 #define USE_CHUNK_POW2
 
+/* BLI_MEMPOOL_THREADSAFE: number of free list caches (matches BLENDER_MAX_THREADS) */
+#define MEMPOOL_TCACHE_TOT    64
+#define MEMPOOL_CACHELINE     64
+
 
 #ifndef NDEBUG
 static bool mempool_debug_memset = false;
@@ -94,6 +100,24 @@ typedef struct BLI_mempool_chunk {
 #endif
 } BLI_mempool_chunk;
 
+/**
+ * Free list caches for #BLI_MEMPOOL_THREADSAFE pools, padded to avoid false sharing.
+ * A thread locks one cache for the duration of a single alloc/free,
+ * it tries the same one each time and only moves on when it's taken.
+ *
+ * Elements are moved between caches in batches of #BLI_mempool.pchunk elements:
+ * once \a free holds a full batch it's moved into \a spare,
+ * and a previous spare batch is handed to #BLI_mempool.depot.
+ */
+typedef struct BLI_mempool_tcache {
+	BLI_freenode *free;         /* free element list */
+	BLI_freenode *spare;        /* a full batch of free elements (or NULL) */
+	unsigned int totfree;       /* number of elements in 'free' */
+	int totused;                /* allocated minus freed using this cache (may be negative) */
+	uint32_t lock;
+	char _pad[MEMPOOL_CACHELINE - (2 * sizeof(void *)) - (3 * sizeof(int))];
+} BLI_mempool_tcache;
+
 /**
  * The mempool, stores and tracks memory \a chunks and elements within those chunks \a free.
  */
@@ -115,6 +139,13 @@ struct BLI_mempool {
 #ifdef USE_TOTALLOC
 	unsigned int totalloc;          /* number of elements allocated in total */
 #endif
+
+	/* BLI_MEMPOOL_THREADSAFE only, 'free' and 'totused' are unused */
+	BLI_mempool_tcache *tcache;     /* MEMPOOL_TCACHE_TOT free list caches */
+	BLI_mempool_chunk *chunk_reserve;  /* chunks not handed to a thread yet, the tail of 'chunks' */
+	BLI_freenode **depot;           /* full batches of free elements returned by threads */
+	unsigned int depot_len, depot_alloc;
+	uint32_t depot_lock;
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -181,6 +212,40 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 	return mpchunk;
 }
 
+/**
+ * Link all elements of \a mpchunk into a free list, starting at its first element.
+ *
+ * \return The last element (its 'next' is NULL).
+ */
+static BLI_freenode *mempool_chunk_init_freelist(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
+{
+	const unsigned int esize = pool->esize;
+	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
+	unsigned int j;
+
+	/* loop through the allocated data, building the pointer structures */
+	j = pool->pchunk;
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		while (j--) {
+			curnode->next = NODE_STEP_NEXT(curnode);
+			curnode->freeword = FREEWORD;
+			curnode = curnode->next;
+		}
+	}
+	else {
+		while (j--) {
+			curnode->next = NODE_STEP_NEXT(curnode);
+			curnode = curnode->next;
+		}
+	}
+
+	/* terminate the list (rewind one) */
+	curnode = NODE_STEP_PREV(curnode);
+	curnode->next = NULL;
+
+	return curnode;
+}
+
 /**
  * Initialize a chunk and add into \a pool->chunks
  *
@@ -193,9 +258,7 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
                                        BLI_freenode *lasttail)
 {
-	const unsigned int esize = pool->esize;
 	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
-	unsigned int j;
 
 	/* append */
 	if (pool->chunk_tail) {
@@ -213,26 +276,8 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpc
 		pool->free = curnode;
 	}
 
-	/* loop through the allocated data, building the pointer structures */
-	j = pool->pchunk;
-	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
-		while (j--) {
-			curnode->next = NODE_STEP_NEXT(curnode);
-			curnode->freeword = FREEWORD;
-			curnode = curnode->next;
-		}
-	}
-	else {
-		while (j--) {
-			curnode->next = NODE_STEP_NEXT(curnode);
-			curnode = curnode->next;
-		}
-	}
-
-	/* terminate the list (rewind one)
-	 * will be overwritten if 'curnode' gets passed in again as 'lasttail' */
-	curnode = NODE_STEP_PREV(curnode);
-	curnode->next = NULL;
+	/* the last element will be overwritten if 'curnode' gets passed in again as 'lasttail' */
+	curnode = mempool_chunk_init_freelist(pool, mpchunk);
 
 #ifdef USE_TOTALLOC
 	pool->totalloc += pool->pchunk;
@@ -265,6 +310,191 @@ static void mempool_chunk_free_all(BLI_mempool_chunk *mpchunk)
 	}
 }
 
+
+/* -------------------------------------------------------------------- */
+/* BLI_MEMPOOL_THREADSAFE */
+
+/**
+ * Lock a free list cache for the calling thread, see #atomic_spin_lock_any.
+ * Caches are only held during a single alloc/free, so nothing needs freeing when threads exit.
+ */
+static BLI_mempool_tcache *mempool_tcache_acquire(BLI_mempool *pool)
+{
+	return &pool->tcache[atomic_spin_lock_any(&pool->tcache[0].lock, sizeof(*pool->tcache), MEMPOOL_TCACHE_TOT)];
+}
+
+/**
+ * Lock-free pop from \a pool->chunk_reserve.
+ *
+ * \note Reserved chunks are only added while no other thread uses the pool (create & clear)
+ * and their 'next' pointers don't change, so this can't suffer from the ABA problem.
+ */
+static BLI_mempool_chunk *mempool_chunk_reserve_pop(BLI_mempool *pool)
+{
+	BLI_mempool_chunk *mpchunk = pool->chunk_reserve, *mpchunk_prev;
+
+	while (mpchunk) {
+		mpchunk_prev = (BLI_mempool_chunk *)atomic_cas_z((size_t *)&pool->chunk_reserve,
+		                                                 (size_t)mpchunk, (size_t)mpchunk->next);
+		if (mpchunk_prev == mpchunk) {
+			break;
+		}
+		mpchunk = mpchunk_prev;
+	}
+
+	return mpchunk;
+}
+
+/**
+ * Lock-free push of a new chunk onto \a pool->chunks.
+ */
+static void mempool_chunk_push(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
+{
+	BLI_mempool_chunk *head = pool->chunks, *head_prev;
+
+	for (;;) {
+		mpchunk->next = head;
+		head_prev = (BLI_mempool_chunk *)atomic_cas_z((size_t *)&pool->chunks,
+		                                              (size_t)head, (size_t)mpchunk);
+		if (head_prev == head) {
+			break;
+		}
+		head = head_prev;
+	}
+}
+
+static void mempool_depot_push(BLI_mempool *pool, BLI_freenode *batch)
+{
+	atomic_spin_lock(&pool->depot_lock);
+	if (UNLIKELY(pool->depot_len == pool->depot_alloc)) {
+		pool->depot_alloc = pool->depot_alloc ? pool->depot_alloc * 2 : 16;
+		pool->depot = MEM_reallocN(pool->depot, sizeof(*pool->depot) * pool->depot_alloc);
+	}
+	pool->depot[pool->depot_len++] = batch;
+	atomic_spin_unlock(&pool->depot_lock);
+}
+
+static BLI_freenode *mempool_depot_pop(BLI_mempool *pool)
+{
+	BLI_freenode *batch = NULL;
+
+	atomic_spin_lock(&pool->depot_lock);
+	if (pool->depot_len) {
+		batch = pool->depot[--pool->depot_len];
+	}
+	atomic_spin_unlock(&pool->depot_lock);
+
+	return batch;
+}
+
+/**
+ * Fill the empty free list of \a tcache with a batch of elements,
+ * taken from (in order of preference) its spare batch, the depot, a reserved chunk or a new chunk.
+ */
+static void mempool_tcache_refill(BLI_mempool *pool, BLI_mempool_tcache *tcache)
+{
+	BLI_mempool_chunk *mpchunk;
+
+	BLI_assert(tcache->free == NULL);
+
+	if (tcache->spare) {
+		tcache->free = tcache->spare;
+		tcache->spare = NULL;
+	}
+	else if ((tcache->free = mempool_depot_pop(pool)) == NULL) {
+		if ((mpchunk = mempool_chunk_reserve_pop(pool)) == NULL) {
+			mpchunk = mempool_chunk_alloc(pool);
+			mempool_chunk_init_freelist(pool, mpchunk);
+			mempool_chunk_push(pool, mpchunk);
+		}
+		else if ((pool->flag & BLI_MEMPOOL_ALLOW_ITER) == 0) {
+			/* reserved chunks are only initialized up-front when iterating needs it */
+			mempool_chunk_init_freelist(pool, mpchunk);
+		}
+		tcache->free = CHUNK_DATA(mpchunk);
+	}
+
+	tcache->totfree = pool->pchunk;
+}
+
+static void *mempool_alloc_threadsafe(BLI_mempool *pool)
+{
+	BLI_mempool_tcache *tcache = mempool_tcache_acquire(pool);
+	BLI_freenode *free_pop;
+
+	if (UNLIKELY(tcache->free == NULL)) {
+		mempool_tcache_refill(pool, tcache);
+	}
+
+	free_pop = tcache->free;
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		free_pop->freeword = USEDWORD;
+	}
+
+	tcache->free = free_pop->next;
+	tcache->totfree--;
+	tcache->totused++;
+
+	atomic_spin_unlock(&tcache->lock);
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+	return (void *)free_pop;
+}
+
+static void mempool_free_threadsafe(BLI_mempool *pool, BLI_freenode *newhead)
+{
+	BLI_mempool_tcache *tcache = mempool_tcache_acquire(pool);
+
+	if (UNLIKELY(tcache->totfree == pool->pchunk)) {
+		/* the free list is a full batch, set it aside, making room for more */
+		if (tcache->spare) {
+			mempool_depot_push(pool, tcache->spare);
+		}
+		tcache->spare = tcache->free;
+		tcache->free = NULL;
+		tcache->totfree = 0;
+	}
+
+	newhead->next = tcache->free;
+	tcache->free = newhead;
+	tcache->totfree++;
+	tcache->totused--;
+
+	/* before unlocking, once unlocked another thread may allocate the element again */
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_FREE(pool, newhead);
+#endif
+
+	atomic_spin_unlock(&tcache->lock);
+}
+
+/**
+ * Hand all chunks back to the reserve and empty all thread caches,
+ * only call while no other threads use the pool.
+ */
+static void mempool_threadsafe_reset(BLI_mempool *pool)
+{
+	BLI_mempool_chunk *mpchunk;
+
+	memset(pool->tcache, 0, sizeof(*pool->tcache) * MEMPOOL_TCACHE_TOT);
+	pool->depot_len = 0;
+	pool->depot_lock = 0;
+	pool->chunk_reserve = pool->chunks;
+
+	/* iteration checks the 'freeword' of elements in chunks which weren't handed out yet */
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		for (mpchunk = pool->chunks; mpchunk; mpchunk = mpchunk->next) {
+			mempool_chunk_init_freelist(pool, mpchunk);
+		}
+	}
+}
+
+/* -------------------------------------------------------------------- */
+
 BLI_mempool *BLI_mempool_create(unsigned int esize, unsigned int totelem,
                                 unsigned int pchunk, unsigned int flag)
 {
@@ -311,7 +541,23 @@ BLI_mempool *BLI_mempool_create(unsigned int esize, unsigned int totelem,
 #endif
 	pool->totused = 0;
 
-	if (totelem) {
+	pool->tcache = NULL;
+	pool->chunk_reserve = NULL;
+	pool->depot = NULL;
+	pool->depot_len = pool->depot_alloc = 0;
+
+	if (flag & BLI_MEMPOOL_THREADSAFE) {
+		pool->tcache = MEM_mallocN(sizeof(*pool->tcache) * MEMPOOL_TCACHE_TOT, "mempool thread caches");
+
+		if (totelem) {
+			for (i = 0; i < maxchunks; i++) {
+				mempool_chunk_push(pool, mempool_chunk_alloc(pool));
+			}
+		}
+
+		mempool_threadsafe_reset(pool);
+	}
+	else if (totelem) {
 		/* allocate the actual chunks */
 		for (i = 0; i < maxchunks; i++) {
 			BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -330,6 +576,10 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 {
 	BLI_freenode *free_pop;
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		return mempool_alloc_threadsafe(pool);
+	}
+
 	if (UNLIKELY(pool->free == NULL)) {
 		/* need to allocate a new chunk */
 		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -399,6 +649,11 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 		newhead->freeword = FREEWORD;
 	}
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_free_threadsafe(pool, newhead);
+		return;
+	}
+
 	newhead->next = pool->free;
 	pool->free = newhead;
 
@@ -448,6 +703,15 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 
 int BLI_mempool_count(BLI_mempool *pool)
 {
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		int totused = 0;
+		unsigned int i;
+		for (i = 0; i < MEMPOOL_TCACHE_TOT; i++) {
+			totused += pool->tcache[i].totused;
+		}
+		return totused;
+	}
+
 	return (int)pool->totused;
 }
 
@@ -455,7 +719,7 @@ void *BLI_mempool_findelem(BLI_mempool *pool, unsigned int index)
 {
 	BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
 
-	if (index < pool->totused) {
+	if (index < (unsigned int)BLI_mempool_count(pool)) {
 		/* we could have some faster mem chunk stepping code inline */
 		BLI_mempool_iter iter;
 		void *elem;
@@ -474,7 +738,7 @@ void *BLI_mempool_findelem(BLI_mempool *pool, unsigned int index)
  * to create lookup table.
  *
  * \param pool Pool to create a table from.
- * \param data array of pointers at least the size of 'pool->totused'
+ * \param data array of pointers at least the size of #BLI_mempool_count
  */
 void BLI_mempool_as_table(BLI_mempool *pool, void **data)
 {
@@ -486,7 +750,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
 	while ((elem = BLI_mempool_iterstep(&iter))) {
 		*p++ = elem;
 	}
-	BLI_assert((unsigned int)(p - data) == pool->totused);
+	BLI_assert((int)(p - data) == BLI_mempool_count(pool));
 }
 
 /**
@@ -494,7 +758,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
  */
 void **BLI_mempool_as_tableN(BLI_mempool *pool, const char *allocstr)
 {
-	void **data = MEM_mallocN((size_t)pool->totused * sizeof(void *), allocstr);
+	void **data = MEM_mallocN((size_t)BLI_mempool_count(pool) * sizeof(void *), allocstr);
 	BLI_mempool_as_table(pool, data);
 	return data;
 }
@@ -513,7 +777,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
 		memcpy(p, elem, (size_t)esize);
 		p = NODE_STEP_NEXT(p);
 	}
-	BLI_assert((unsigned int)(p - (char *)data) == pool->totused * esize);
+	BLI_assert((unsigned int)(p - (char *)data) == (unsigned int)BLI_mempool_count(pool) * esize);
 }
 
 /**
@@ -521,7 +785,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
  */
 void *BLI_mempool_as_arrayN(BLI_mempool *pool, const char *allocstr)
 {
-	char *data = MEM_mallocN((size_t)(pool->totused * pool->esize), allocstr);
+	char *data = MEM_mallocN((size_t)BLI_mempool_count(pool) * (size_t)pool->esize, allocstr);
 	BLI_mempool_as_array(pool, data);
 	return data;
 }
@@ -641,6 +905,11 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
 		} while ((mpchunk = mpchunk_next));
 	}
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_threadsafe_reset(pool);
+		return;
+	}
+
 	/* re-initialize */
 	pool->free = NULL;
 	pool->totused = 0;
@@ -673,6 +942,13 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 {
 	mempool_chunk_free_all(pool->chunks);
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		if (pool->depot) {
+			MEM_freeN(pool->depot);
+		}
+		MEM_freeN(pool->tcache);
+	}
+
 #ifdef WITH_MEM_VALGRIND
 	VALGRIND_DESTROY_MEMPOOL(pool);
 #endif
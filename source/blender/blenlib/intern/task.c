@@ -25,13 +25,26 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "MEM_guardedalloc.h"
 
 #include "BLI_listbase.h"
+#include "BLI_mempool.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
 
+#include "atomic_ops.h"
+
+/* Number of tasks each worker thread can hold in its own deque, must be a
+ * power of two. Tasks that don't fit go to the shared queue. */
+#define TASK_DEQUE_SIZE 1024
+#define TASK_DEQUE_MASK (TASK_DEQUE_SIZE - 1)
+
+/* Number of tasks a worker thread takes from the shared queue at once, the
+ * ones it doesn't run immediately go into its deque for others to steal. */
+#define TASK_QUEUE_BATCH 8
+
 /* Types */
 
 typedef struct Task {
@@ -43,6 +56,15 @@ typedef struct Task {
 	TaskPool *pool;
 } Task;
 
+/* Lock-free work stealing deque (Chase-Lev) with fixed capacity. Only the
+ * owner thread pushes and pops at the bottom, other threads steal from the
+ * top. Indices only ever increase and are wrapped into the array. */
+typedef struct TaskDeque {
+	volatile size_t top;
+	volatile size_t bottom;
+	Task *volatile tasks[TASK_DEQUE_SIZE];
+} TaskDeque;
+
 struct TaskPool {
 	TaskScheduler *scheduler;
 
@@ -62,18 +84,98 @@ struct TaskScheduler {
 	struct TaskThread *task_threads;
 	int num_threads;
 
+	/* shared queue, for tasks pushed from outside of the worker threads,
+	 * high priority tasks and tasks that don't fit in a deque */
 	ListBase queue;
 	ThreadMutex queue_mutex;
 	ThreadCondition queue_cond;
 
+	/* number of tasks in the queue and all deques, and number of worker
+	 * threads waiting on queue_cond for them */
+	size_t num_queued;
+	size_t num_sleeping;
+
+	/* TaskThread of the calling worker thread, NULL for other threads */
+	pthread_key_t thread_key;
+
+	/* Task allocations, tasks are pushed and freed from any thread */
+	BLI_mempool *task_mempool;
+
 	volatile bool do_exit;
 };
 
 typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
+
+	TaskDeque deque;
 } TaskThread;
 
+/* Task Deque */
+
+static bool task_deque_push(TaskDeque *deque, Task *task)
+{
+	size_t bottom = deque->bottom;
+
+	if (bottom - deque->top >= TASK_DEQUE_SIZE)
+		return false;
+
+	deque->tasks[bottom & TASK_DEQUE_MASK] = task;
+
+	/* full barrier, task must be visible before the new bottom */
+	atomic_add_z((size_t *)&deque->bottom, 1);
+
+	return true;
+}
+
+static Task *task_deque_pop(TaskDeque *deque)
+{
+	/* full barrier, claim the bottom task before reading top so that
+	 * thieves racing for the same task are detected */
+	size_t bottom = atomic_sub_z((size_t *)&deque->bottom, 1);
+	size_t top = deque->top;
+	Task *task;
+
+	if ((ptrdiff_t)(bottom - top) < 0) {
+		/* was empty */
+		deque->bottom = top;
+		return NULL;
+	}
+
+	task = deque->tasks[bottom & TASK_DEQUE_MASK];
+
+	if (bottom == top) {
+		/* last task, thieves may be trying to take it too */
+		if (atomic_cas_z((size_t *)&deque->top, top, top + 1) != top)
+			task = NULL;
+
+		deque->bottom = top + 1;
+	}
+
+	return task;
+}
+
+static Task *task_deque_steal(TaskDeque *deque)
+{
+	size_t top = deque->top;
+	size_t bottom;
+	Task *task;
+
+	/* full barrier, top must be read before bottom */
+	bottom = atomic_add_z((size_t *)&deque->bottom, 0);
+
+	if ((ptrdiff_t)(bottom - top) <= 0)
+		return NULL;
+
+	task = deque->tasks[top & TASK_DEQUE_MASK];
+
+	/* fails if the owner or another thief got it first */
+	if (atomic_cas_z((size_t *)&deque->top, top, top + 1) != top)
+		return NULL;
+
+	return task;
+}
+
 /* Task Scheduler */
 
 static void task_pool_num_decrease(TaskPool *pool, size_t done)
@@ -101,25 +203,160 @@ static void task_pool_num_increase(TaskPool *pool)
 	BLI_mutex_unlock(&pool->num_mutex);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+static TaskThread *task_scheduler_current_thread(TaskScheduler *scheduler)
 {
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	if (scheduler->task_threads == NULL)
+		return NULL;
+
+	return pthread_getspecific(scheduler->thread_key);
+}
 
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+static void task_scheduler_queued_increase(TaskScheduler *scheduler)
+{
+	/* full barrier, pairs with the one in task_scheduler_thread_wait_pop:
+	 * either we see the sleeping thread or it sees the new task */
+	atomic_add_z(&scheduler->num_queued, 1);
 
-	if (!scheduler->queue.first) {
+	if (scheduler->num_sleeping) {
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		BLI_condition_notify_one(&scheduler->queue_cond);
 		BLI_mutex_unlock(&scheduler->queue_mutex);
-		BLI_assert(scheduler->do_exit);
-		return false;
 	}
-	
-	*task = scheduler->queue.first;
-	BLI_remlink(&scheduler->queue, *task);
+}
+
+static void task_run_and_free(Task *task, int thread_id)
+{
+	TaskPool *pool = task->pool;
+
+	/* canceled tasks still in a deque are skipped */
+	if (!pool->do_cancel)
+		task->run(pool, task->taskdata, thread_id);
+
+	/* delete task */
+	if (task->free_taskdata)
+		MEM_freeN(task->taskdata);
+	BLI_mempool_free(pool->scheduler->task_mempool, task);
+
+	/* notify pool task was done */
+	task_pool_num_decrease(pool, 1);
+}
 
+/* move a task taken from a deque back into the shared queue */
+static void task_scheduler_requeue(TaskScheduler *scheduler, Task *task)
+{
+	BLI_mutex_lock(&scheduler->queue_mutex);
+	BLI_addhead(&scheduler->queue, task);
 	BLI_mutex_unlock(&scheduler->queue_mutex);
+}
 
-	return true;
+/* Find a task to run. Worker threads look in their own deque first, then the
+ * shared queue, then steal from the other worker threads. When pool is given
+ * only tasks from that pool are returned, others found along the way are moved
+ * to the shared queue and r_moved is set. */
+static Task *task_scheduler_find(TaskScheduler *scheduler, TaskThread *thread,
+                                 TaskPool *pool, bool *r_moved)
+{
+	Task *task;
+	int i, offset;
+
+	/* own deque */
+	if (thread) {
+		if ((task = task_deque_pop(&thread->deque))) {
+			if (pool == NULL || task->pool == pool) {
+				atomic_sub_z(&scheduler->num_queued, 1);
+				return task;
+			}
+
+			task_scheduler_requeue(scheduler, task);
+			*r_moved = true;
+		}
+	}
+
+	/* shared queue */
+	if (scheduler->queue.first) {
+		Task *nexttask;
+		int batch = 0;
+
+		BLI_mutex_lock(&scheduler->queue_mutex);
+
+		for (task = scheduler->queue.first; task; task = task->next)
+			if (pool == NULL || task->pool == pool)
+				break;
+
+		if (task) {
+			BLI_remlink(&scheduler->queue, task);
+
+			/* workers take a few more tasks along into their own deque,
+			 * so the queue lock is taken less often */
+			if (thread && pool == NULL) {
+				Task *movetask;
+
+				for (movetask = scheduler->queue.first; movetask && batch < TASK_QUEUE_BATCH - 1; movetask = nexttask) {
+					nexttask = movetask->next;
+
+					if (!task_deque_push(&thread->deque, movetask))
+						break;
+
+					BLI_remlink(&scheduler->queue, movetask);
+					batch++;
+				}
+			}
+		}
+
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+
+		if (task) {
+			atomic_sub_z(&scheduler->num_queued, 1);
+			return task;
+		}
+	}
+
+	/* steal from other worker threads */
+	offset = (thread) ? thread->id : 0;
+
+	for (i = 0; i < scheduler->num_threads; i++) {
+		TaskThread *victim = &scheduler->task_threads[(offset + i) % scheduler->num_threads];
+
+		if (victim == thread)
+			continue;
+
+		if ((task = task_deque_steal(&victim->deque))) {
+			if (pool == NULL || task->pool == pool) {
+				atomic_sub_z(&scheduler->num_queued, 1);
+				return task;
+			}
+
+			task_scheduler_requeue(scheduler, task);
+			*r_moved = true;
+		}
+	}
+
+	return NULL;
+}
+
+static Task *task_scheduler_thread_wait_pop(TaskScheduler *scheduler, TaskThread *thread)
+{
+	while (!scheduler->do_exit) {
+		bool moved = false;
+		Task *task = task_scheduler_find(scheduler, thread, NULL, &moved);
+
+		if (task)
+			return task;
+
+		/* sleep until there are tasks queued again */
+		BLI_mutex_lock(&scheduler->queue_mutex);
+
+		atomic_add_z(&scheduler->num_sleeping, 1);
+
+		while (scheduler->num_queued == 0 && !scheduler->do_exit)
+			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+
+		atomic_sub_z(&scheduler->num_sleeping, 1);
+
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
+
+	return NULL;
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
@@ -129,21 +366,11 @@ static void *task_scheduler_thread_run(void *thread_p)
 	int thread_id = thread->id;
 	Task *task;
 
-	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
-		TaskPool *pool = task->pool;
+	pthread_setspecific(scheduler->thread_key, thread);
 
-		/* run task */
-		task->run(pool, task->taskdata, thread_id);
-
-		/* delete task */
-		if (task->free_taskdata)
-			MEM_freeN(task->taskdata);
-		MEM_freeN(task);
-
-		/* notify pool task was done */
-		task_pool_num_decrease(pool, 1);
-	}
+	/* keep popping off tasks */
+	while ((task = task_scheduler_thread_wait_pop(scheduler, thread)))
+		task_run_and_free(task, thread_id);
 
 	return NULL;
 }
@@ -160,6 +387,10 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	BLI_mutex_init(&scheduler->queue_mutex);
 	BLI_condition_init(&scheduler->queue_cond);
 
+	pthread_key_create(&scheduler->thread_key, NULL);
+
+	scheduler->task_mempool = BLI_mempool_create(sizeof(Task), 0, 512, BLI_MEMPOOL_THREADSAFE);
+
 	if (num_threads == 0) {
 		/* automatic number of threads will be main thread + num cores */
 		num_threads = BLI_system_thread_count();
@@ -213,17 +444,30 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		MEM_freeN(scheduler->threads);
 	}
 
-	/* Delete task thread data */
+	/* Delete task thread data and leftover tasks in deques */
 	if (scheduler->task_threads) {
+		int i;
+
+		for (i = 0; i < scheduler->num_threads; i++) {
+			while ((task = task_deque_pop(&scheduler->task_threads[i].deque))) {
+				if (task->free_taskdata)
+					MEM_freeN(task->taskdata);
+			}
+		}
+
 		MEM_freeN(scheduler->task_threads);
 	}
 
-	/* delete leftover tasks */
+	/* delete leftover tasks, the tasks themselves are freed with the mempool */
 	for (task = scheduler->queue.first; task; task = task->next) {
 		if (task->free_taskdata)
 			MEM_freeN(task->taskdata);
 	}
-	BLI_freelistN(&scheduler->queue);
+	BLI_listbase_clear(&scheduler->queue);
+
+	BLI_mempool_destroy(scheduler->task_mempool);
+
+	pthread_key_delete(scheduler->thread_key);
 
 	/* delete mutex/condition */
 	BLI_mutex_end(&scheduler->queue_mutex);
@@ -239,18 +483,24 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 
 static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
 {
+	TaskThread *thread = task_scheduler_current_thread(scheduler);
+
 	task_pool_num_increase(task->pool);
 
-	/* add task to queue */
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	/* tasks pushed from a running task go into the deque of its thread,
+	 * without locking, the rest into the shared queue */
+	if (!(thread && priority == TASK_PRIORITY_LOW && task_deque_push(&thread->deque, task))) {
+		BLI_mutex_lock(&scheduler->queue_mutex);
 
-	if (priority == TASK_PRIORITY_HIGH)
-		BLI_addhead(&scheduler->queue, task);
-	else
-		BLI_addtail(&scheduler->queue, task);
+		if (priority == TASK_PRIORITY_HIGH)
+			BLI_addhead(&scheduler->queue, task);
+		else
+			BLI_addtail(&scheduler->queue, task);
 
-	BLI_condition_notify_one(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
+
+	task_scheduler_queued_increase(scheduler);
 }
 
 static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
@@ -267,7 +517,8 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 		if (task->pool == pool) {
 			if (task->free_taskdata)
 				MEM_freeN(task->taskdata);
-			BLI_freelinkN(&scheduler->queue, task);
+			BLI_remlink(&scheduler->queue, task);
+			BLI_mempool_free(scheduler->task_mempool, task);
 
 			done++;
 		}
@@ -275,6 +526,8 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 
 	BLI_mutex_unlock(&scheduler->queue_mutex);
 
+	atomic_sub_z(&scheduler->num_queued, done);
+
 	/* notify done */
 	task_pool_num_decrease(pool, done);
 }
@@ -323,7 +576,7 @@ void BLI_task_pool_free(TaskPool *pool)
 void BLI_task_pool_push(TaskPool *pool, TaskRunFunction run,
 	void *taskdata, bool free_taskdata, TaskPriority priority)
 {
-	Task *task = MEM_callocN(sizeof(Task), "Task");
+	Task *task = BLI_mempool_calloc(pool->scheduler->task_mempool);
 
 	task->run = run;
 	task->taskdata = taskdata;
@@ -336,50 +589,30 @@ void BLI_task_pool_push(TaskPool *pool, TaskRunFunction run,
 void BLI_task_pool_work_and_wait(TaskPool *pool)
 {
 	TaskScheduler *scheduler = pool->scheduler;
+	TaskThread *thread = task_scheduler_current_thread(scheduler);
+	int thread_id = (thread) ? thread->id : 0;
 
 	BLI_mutex_lock(&pool->num_mutex);
 
 	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
+		Task *work_task;
+		bool moved = false;
 
 		BLI_mutex_unlock(&pool->num_mutex);
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
 		/* find task from this pool. if we get a task from another pool,
 		 * we can get into deadlock */
-
-		for (task = scheduler->queue.first; task; task = task->next) {
-			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
-				break;
-			}
-		}
-
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+		work_task = task_scheduler_find(scheduler, thread, pool, &moved);
 
 		/* if found task, do it, otherwise wait until other tasks are done */
-		if (found_task) {
-			/* run task */
-			work_task->run(pool, work_task->taskdata, 0);
-
-			/* delete task */
-			if (work_task->free_taskdata)
-				MEM_freeN(work_task->taskdata);
-			MEM_freeN(work_task);
-
-			/* notify pool task was done */
-			task_pool_num_decrease(pool, 1);
-		}
+		if (work_task)
+			task_run_and_free(work_task, thread_id);
 
 		BLI_mutex_lock(&pool->num_mutex);
 		if (pool->num == 0)
 			break;
 
-		if (!found_task)
+		if (!work_task && !moved)
 			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
 	}
 
@@ -392,11 +625,9 @@ void BLI_task_pool_cancel(TaskPool *pool)
 
 	task_scheduler_clear(pool->scheduler, pool);
 
-	/* wait until all entries are cleared */
-	BLI_mutex_lock(&pool->num_mutex);
-	while (pool->num)
-		BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-	BLI_mutex_unlock(&pool->num_mutex);
+	/* wait until all entries are cleared, tasks that are in deques can't be
+	 * removed from there but will be skipped */
+	BLI_task_pool_work_and_wait(pool);
 
 	pool->do_cancel = false;
 }
@@ -428,3 +659,156 @@ size_t BLI_task_pool_tasks_done(TaskPool *pool)
 	return pool->done;
 }
 
+
+/* Parallel range routines */
+
+typedef struct ParallelRangeState {
+	int start, stop;
+	void *userdata;
+	void *userdata_chunk;
+	size_t userdata_chunk_size;
+
+	TaskParallelRangeFunc func;
+	TaskParallelRangeChunkFunc func_chunk;
+
+	int min_chunk;
+	int num_threads;
+
+	/* offset from start of the next iteration to hand out */
+	size_t iter;
+} ParallelRangeState;
+
+static bool parallel_range_next_chunk(ParallelRangeState *state, int *r_start, int *r_stop)
+{
+	const size_t range = (size_t)(state->stop - state->start);
+
+	for (;;) {
+		size_t iter = state->iter;
+		size_t chunk;
+
+		if (iter >= range)
+			return false;
+
+		/* guided scheduling: big chunks first for less overhead, smaller ones
+		 * near the end to keep all threads busy until the range is done */
+		chunk = (range - iter) / (size_t)(state->num_threads * 2);
+		chunk = MAX2(chunk, (size_t)state->min_chunk);
+		chunk = MIN2(chunk, range - iter);
+
+		if (atomic_cas_z(&state->iter, iter, iter + chunk) == iter) {
+			*r_start = state->start + (int)iter;
+			*r_stop = state->start + (int)(iter + chunk);
+			return true;
+		}
+	}
+}
+
+static void parallel_range_func(TaskPool *pool, void *userdata_chunk, int UNUSED(threadid))
+{
+	ParallelRangeState *state = BLI_task_pool_userdata(pool);
+	int start, stop, i;
+
+	while (parallel_range_next_chunk(state, &start, &stop)) {
+		if (state->func_chunk) {
+			for (i = start; i < stop; i++)
+				state->func_chunk(state->userdata, userdata_chunk, i);
+		}
+		else {
+			for (i = start; i < stop; i++)
+				state->func(state->userdata, i);
+		}
+	}
+}
+
+static void task_parallel_range_ex(int start, int stop, void *userdata,
+                                   void *userdata_chunk, size_t userdata_chunk_size,
+                                   TaskParallelRangeFunc func,
+                                   TaskParallelRangeChunkFunc func_chunk,
+                                   TaskParallelRangeReduceFunc reduce, int min_chunk)
+{
+	TaskScheduler *scheduler;
+	TaskPool *task_pool;
+	ParallelRangeState state;
+	char *userdata_chunks = NULL;
+	int i, num_threads, num_tasks;
+
+	if (start >= stop)
+		return;
+
+	if (min_chunk < 1)
+		min_chunk = 1;
+
+	scheduler = BLI_task_scheduler_get();
+	num_threads = BLI_task_scheduler_num_threads(scheduler);
+
+	/* not worth the threading overhead for short ranges, a single task is
+	 * run directly on this thread */
+	if (num_threads == 1 || stop - start <= min_chunk)
+		num_tasks = 1;
+	else
+		num_tasks = MIN2(num_threads, (stop - start + min_chunk - 1) / min_chunk);
+
+	state.start = start;
+	state.stop = stop;
+	state.userdata = userdata;
+	state.userdata_chunk = userdata_chunk;
+	state.userdata_chunk_size = userdata_chunk_size;
+	state.func = func;
+	state.func_chunk = func_chunk;
+	state.min_chunk = min_chunk;
+	state.num_threads = num_threads;
+	state.iter = 0;
+
+	if (func_chunk) {
+		userdata_chunks = MEM_mallocN(userdata_chunk_size * (size_t)num_tasks, "parallel range chunks");
+
+		for (i = 0; i < num_tasks; i++)
+			memcpy(userdata_chunks + userdata_chunk_size * (size_t)i, userdata_chunk, userdata_chunk_size);
+	}
+
+	if (num_tasks == 1) {
+		for (i = start; i < stop; i++) {
+			if (func_chunk)
+				func_chunk(userdata, userdata_chunks, i);
+			else
+				func(userdata, i);
+		}
+	}
+	else {
+		task_pool = BLI_task_pool_create(scheduler, &state);
+
+		for (i = 0; i < num_tasks; i++) {
+			void *task_chunk = (userdata_chunks) ? userdata_chunks + userdata_chunk_size * (size_t)i : NULL;
+			BLI_task_pool_push(task_pool, parallel_range_func, task_chunk, false, TASK_PRIORITY_HIGH);
+		}
+
+		BLI_task_pool_work_and_wait(task_pool);
+		BLI_task_pool_free(task_pool);
+	}
+
+	if (userdata_chunks) {
+		if (reduce) {
+			for (i = 0; i < num_tasks; i++)
+				reduce(userdata, userdata_chunks + userdata_chunk_size * (size_t)i);
+		}
+
+		MEM_freeN(userdata_chunks);
+	}
+}
+
+void BLI_task_parallel_range(int start, int stop, void *userdata,
+                             TaskParallelRangeFunc func, int min_chunk)
+{
+	task_parallel_range_ex(start, stop, userdata, NULL, 0, func, NULL, NULL, min_chunk);
+}
+
+void BLI_task_parallel_range_reduce(int start, int stop, void *userdata,
+                                    void *userdata_chunk, size_t userdata_chunk_size,
+                                    TaskParallelRangeChunkFunc func,
+                                    TaskParallelRangeReduceFunc reduce, int min_chunk)
+{
+	BLI_assert(userdata_chunk != NULL && userdata_chunk_size != 0);
+
+	task_parallel_range_ex(start, stop, userdata, userdata_chunk, userdata_chunk_size,
+	                       NULL, func, reduce, min_chunk);
+}
@@ -42,6 +42,8 @@
 
 #include "PIL_time.h"
 
+#include "atomic_ops.h"
+
 /* for checking system threads - BLI_system_thread_count */
 #ifdef WIN32
 #  include <windows.h>
@@ -138,7 +140,9 @@ static pthread_mutex_t _movieclip_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t _colormanage_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t _fftw_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t mainid;
-static int thread_levels = 0;  /* threads can be invoked inside threads */
+/* threads can be invoked inside threads, task pools are also created from
+ * worker threads for nested parallel ranges, so only change it atomically */
+static unsigned int thread_levels = 0;
 static int num_threads_override = 0;
 
 /* just a max for security reasons */
@@ -213,7 +217,7 @@ void BLI_init_threads(ListBase *threadbase, void *(*do_thread)(void *), int tot)
 		}
 	}
 	
-	if (thread_levels == 0) {
+	if (atomic_add_uint32(&thread_levels, 1) == 1) {
 		MEM_set_lock_callback(BLI_lock_malloc_thread, BLI_unlock_malloc_thread);
 
 #ifdef USE_APPLE_OMP_FIX
@@ -223,8 +227,6 @@ void BLI_init_threads(ListBase *threadbase, void *(*do_thread)(void *), int tot)
 		thread_tls_data = pthread_getspecific(gomp_tls_key);
 #endif
 	}
-
-	thread_levels++;
 }
 
 /* amount of available threads */
@@ -343,8 +345,7 @@ void BLI_end_threads(ListBase *threadbase)
 		BLI_freelistN(threadbase);
 	}
 
-	thread_levels--;
-	if (thread_levels == 0)
+	if (atomic_sub_uint32(&thread_levels, 1) == 0)
 		MEM_set_lock_callback(NULL, NULL);
 }
 
@@ -830,10 +831,9 @@ void BLI_begin_threaded_malloc(void)
 	/* Used for debug only */
 	/* BLI_assert(thread_levels >= 0); */
 
-	if (thread_levels == 0) {
+	if (atomic_add_uint32(&thread_levels, 1) == 1) {
 		MEM_set_lock_callback(BLI_lock_malloc_thread, BLI_unlock_malloc_thread);
 	}
-	thread_levels++;
 }
 
 void BLI_end_threaded_malloc(void)
@@ -841,8 +841,7 @@ void BLI_end_threaded_malloc(void)
 	/* Used for debug only */
 	/* BLI_assert(thread_levels >= 0); */
 
-	thread_levels--;
-	if (thread_levels == 0)
+	if (atomic_sub_uint32(&thread_levels, 1) == 0)
 		MEM_set_lock_callback(NULL, NULL);
 }
 
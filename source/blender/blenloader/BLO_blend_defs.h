@@ -44,4 +44,19 @@
 
 #define ENDB BLEND_MAKE_ID('E', 'N', 'D', 'B')
 
+/* Block framed files (G_FILE_COMPRESS_FAST): the regular file stream is split in
+ * frames which are LZO compressed independently, so they can be written and read
+ * in parallel and in any order.
+ *
+ *     BLEND_FRAMES_MAGIC  8 bytes
+ * per frame:
+ *     raw size            uint32, little endian, at most BLEND_FRAME_SIZE
+ *     stored size         uint32, little endian, equal to raw size when stored uncompressed
+ *     data                stored size bytes
+ */
+#define BLEND_FRAMES_MAGIC      "BLENDLZO"
+#define BLEND_FRAMES_MAGIC_LEN  8
+#define BLEND_FRAME_HEADER_LEN  8
+#define BLEND_FRAME_SIZE        (1 << 20)
+
 #endif  /* __BLO_BLEND_DEFS_H__ */
@@ -182,7 +182,7 @@ LinkNode *BLO_blendhandle_get_previews(BlendHandle *bh, int ofblocktype, int *to
 							unsigned int *rect = NULL;
 							new_prv->rect[0] = MEM_callocN(new_prv->w[0] * new_prv->h[0] * sizeof(unsigned int), "prvrect");
 							bhead = blo_nextbhead(fd, bhead);
-							rect = (unsigned int *)(bhead + 1);
+							rect = blo_bhead_data(bhead);
 							memcpy(new_prv->rect[0], rect, bhead->len);
 						}
 						else {
@@ -193,7 +193,7 @@ LinkNode *BLO_blendhandle_get_previews(BlendHandle *bh, int ofblocktype, int *to
 							unsigned int *rect = NULL;
 							new_prv->rect[1] = MEM_callocN(new_prv->w[1] * new_prv->h[1] * sizeof(unsigned int), "prvrect");
 							bhead = blo_nextbhead(fd, bhead);
-							rect = (unsigned int *)(bhead + 1);
+							rect = blo_bhead_data(bhead);
 							memcpy(new_prv->rect[1], rect, bhead->len);
 						}
 						else {
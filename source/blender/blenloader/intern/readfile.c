@@ -45,10 +45,12 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
 #  include "BLI_winstuff.h"
+#  include "mmap_win.h"
 #endif
 
 /* allow readfile to use deprecated functionality */
@@ -107,7 +109,9 @@
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
 #include "BLI_edgehash.h"
+#include "BLI_ghash.h"
 #include "BLI_threads.h"
+#include "BLI_task.h"
 #include "BLI_mempool.h"
 
 #include "BLF_translation.h"
@@ -175,6 +179,10 @@
 
 #include <errno.h>
 
+#ifdef WITH_LZO
+#  include "minilzo.h"
+#endif
+
 /*
  * Remark: still a weak point is the newaddress() function, that doesnt solve reading from
  * multiple files at the same time
@@ -229,13 +237,15 @@
 typedef struct OldNew {
 	void *old, *newp;
 	int nr;
+	int next;  /* index of the next entry with the same old address, -1 for the last */
 } OldNew;
 
 typedef struct OldNewMap {
 	OldNew *entries;
 	int nentries, entriessize;
-	int sorted;
 	int lasthit;
+	/* old address -> index in entries (of the first entry using it) */
+	GHash *map;
 } OldNewMap;
 
 
@@ -270,36 +280,34 @@ void blo_reportf_wrap(ReportList *reports, ReportType type, const char *format,
 	}
 }
 
-static OldNewMap *oldnewmap_new(void) 
+static OldNewMap *oldnewmap_new_ex(const int entriessize)
 {
 	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
 	
-	onm->entriessize = 1024;
+	onm->entriessize = entriessize;
 	onm->entries = MEM_mallocN(sizeof(*onm->entries)*onm->entriessize, "OldNewMap.entries");
+	onm->map = BLI_ghash_ptr_new_ex("OldNewMap.map", (unsigned int)onm->entriessize);
 	
 	return onm;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
+static OldNewMap *oldnewmap_new(void) 
 {
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
+	return oldnewmap_new_ex(1024);
 }
 
-
-static void oldnewmap_sort(FileData *fd) 
+/* index of the first entry for addr, -1 when not found */
+BLI_INLINE int oldnewmap_lookup_index(OldNewMap *onm, const void *addr)
 {
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
+	void **index_p = BLI_ghash_lookup_p(onm->map, addr);
+	return index_p ? GET_INT_FROM_POINTER(*index_p) : -1;
 }
 
 /* nr is zero for data, and ID code for libdata */
 static void oldnewmap_insert(OldNewMap *onm, void *oldaddr, void *newaddr, int nr) 
 {
 	OldNew *entry;
+	void **index_p;
 	
 	if (oldaddr==NULL || newaddr==NULL) return;
 	
@@ -314,10 +322,25 @@ static void oldnewmap_insert(OldNewMap *onm, void *oldaddr, void *newaddr, int n
 		MEM_freeN(oentries);
 	}
 
+	/* the same old address may be added more than once (libdata),
+	 * lookups return the first entry as the linear search used to,
+	 * later ones are chained after it in the order they were added */
+	if (BLI_ghash_ensure_p(onm->map, oldaddr, &index_p)) {
+		OldNew *last = &onm->entries[GET_INT_FROM_POINTER(*index_p)];
+		while (last->next != -1) {
+			last = &onm->entries[last->next];
+		}
+		last->next = onm->nentries;
+	}
+	else {
+		*index_p = SET_INT_IN_POINTER(onm->nentries);
+	}
+
 	entry = &onm->entries[onm->nentries++];
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+	entry->next = -1;
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, void *oldaddr, void *newaddr, int nr)
@@ -331,6 +354,7 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, void *addr, bool increase_
 	
 	if (addr == NULL) return NULL;
 	
+	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
 	if (onm->lasthit < onm->nentries-1) {
 		OldNew *entry = &onm->entries[++onm->lasthit];
 		
@@ -341,16 +365,15 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, void *addr, bool increase_
 		}
 	}
 	
-	for (i = 0; i < onm->nentries; i++) {
+	i = oldnewmap_lookup_index(onm, addr);
+	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
 		
-		if (entry->old == addr) {
-			onm->lasthit = i;
-			
-			if (increase_users)
-				entry->nr++;
-			return entry->newp;
-		}
+		onm->lasthit = i;
+		
+		if (increase_users)
+			entry->nr++;
+		return entry->newp;
 	}
 	
 	return NULL;
@@ -359,38 +382,18 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, void *addr, bool increase_
 /* for libdata, nr has ID code, no increment */
 static void *oldnewmap_liblookup(OldNewMap *onm, void *addr, void *lib)
 {
+	int i;
+
 	if (addr == NULL) {
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		OldNew entry_s, *entry;
-
-		entry_s.old = addr;
-
-		entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		unsigned int nentries = (unsigned int)onm->nentries;
-		unsigned int i;
-		OldNew *entry;
-
-		for (i = 0, entry = onm->entries; i < nentries; i++, entry++) {
-			if (entry->old == addr) {
-				ID *id = entry->newp;
-				if (id && (!lib || id->lib)) {
-					return id;
-				}
-			}
+	/* in the rare case the first entry doesn't match, check the later
+	 * entries which were added for the same address */
+	for (i = oldnewmap_lookup_index(onm, addr); i != -1; i = onm->entries[i].next) {
+		ID *id = onm->entries[i].newp;
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -414,14 +417,25 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+	BLI_ghash_clear(onm->map, NULL, NULL);
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
+	BLI_ghash_free(onm->map, NULL, NULL);
 	MEM_freeN(onm->entries);
 	MEM_freeN(onm);
 }
 
+/* an ID block and its own datamap, waiting for direct_link_deferred */
+typedef struct DeferredDirectLink {
+	struct DeferredDirectLink *next, *prev;
+	ID *id;
+	OldNewMap *datamap;
+	/* reports of the task, appended to fd->reports after all tasks finished */
+	ReportList reports;
+} DeferredDirectLink;
+
 /***/
 
 static void read_libraries(FileData *basefd, ListBase *mainlist);
@@ -696,13 +710,31 @@ static BHeadN *get_bhead(FileData *fd)
 			/* bhead now contains the (converted) bhead structure. Now read
 			 * the associated data and put everything in a BHeadN (creative naming !)
 			 */
-			if (!fd->eof) {
+			if (!fd->eof && (fd->flags & FD_FLAGS_USE_MMAP)) {
+				/* reference the data in the mapped file, so it's only copied (and paged in)
+				 * once read_struct needs it, blocks which are never read cost nothing */
+				/* a negative length would point before the block, check it here too
+				 * since the data pointer is computed without reading anything */
+				if (bhead.len >= 0 && bhead.len <= fd->buffersize - fd->seek) {
+					new_bhead = MEM_mallocN(sizeof(BHeadN), "new_bhead");
+					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->data = (char *)fd->buffer + fd->seek;
+					new_bhead->bhead = bhead;
+					
+					fd->seek += bhead.len;
+				}
+				else {
+					fd->eof = 1;
+				}
+			}
+			else if (!fd->eof) {
 				new_bhead = MEM_mallocN(sizeof(BHeadN) + bhead.len, "new_bhead");
 				if (new_bhead) {
 					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->data = new_bhead + 1;
 					new_bhead->bhead = bhead;
 					
-					readsize = fd->read(fd, new_bhead + 1, bhead.len);
+					readsize = fd->read(fd, new_bhead->data, bhead.len);
 					
 					if (readsize != bhead.len) {
 						fd->eof = 1;
@@ -755,6 +787,13 @@ BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
 	return (prev) ? &prev->bhead : NULL;
 }
 
+void *blo_bhead_data(BHead *bhead)
+{
+	BHeadN *bheadn = (BHeadN *) (((char *) bhead) - offsetof(BHeadN, bhead));
+	
+	return bheadn->data;
+}
+
 BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 {
 	BHeadN *new_bhead = NULL;
@@ -831,7 +870,7 @@ static int read_file_dna(FileData *fd)
 		if (bhead->code == DNA1) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
 			
-			fd->filesdna = DNA_sdna_from_data(&bhead[1], bhead->len, do_endian_swap);
+			fd->filesdna = DNA_sdna_from_data(blo_bhead_data(bhead), bhead->len, do_endian_swap);
 			if (fd->filesdna) {
 				fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
 				/* used to retrieve ID names from (bhead+1) */
@@ -985,29 +1024,213 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+#ifdef WITH_LZO
+
+typedef struct ReadFrame {
+	const unsigned char *in;
+	unsigned char *out;
+	unsigned int in_len, out_len;
+	bool ok;
+} ReadFrame;
+
+static unsigned int blo_frame_uint32(const unsigned char *src)
+{
+	return ((unsigned int)src[0]) | ((unsigned int)src[1] << 8) |
+	       ((unsigned int)src[2] << 16) | ((unsigned int)src[3] << 24);
+}
+
+static void blo_frame_decompress_task(TaskPool *UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	ReadFrame *frame = taskdata;
+	
+	if (frame->in_len == frame->out_len) {
+		memcpy(frame->out, frame->in, frame->in_len);
+		frame->ok = true;
+	}
+	else {
+		lzo_uint out_len = frame->out_len;
+		int r = lzo1x_decompress_safe(frame->in, (lzo_uint)frame->in_len, frame->out, &out_len, NULL);
+		frame->ok = (r == LZO_E_OK) && (out_len == frame->out_len);
+	}
+}
+
+/* decompress a block framed file into a new buffer, frames are independent
+ * so they are decompressed in parallel. NULL when the file is corrupt */
+static char *blo_frames_decompress(const unsigned char *mem, size_t size, int *r_buffersize)
+{
+	const unsigned char *end = mem + size, *p;
+	TaskPool *task_pool;
+	ReadFrame *frames;
+	unsigned char *buffer;
+	size_t raw_size = 0;
+	int totframe = 0, i;
+	bool ok = true;
+	
+	/* validate all frame headers first */
+	for (p = mem + BLEND_FRAMES_MAGIC_LEN; p != end; totframe++) {
+		unsigned int raw_len, stored_len;
+		
+		if (end - p < BLEND_FRAME_HEADER_LEN) {
+			return NULL;
+		}
+		raw_len = blo_frame_uint32(p);
+		stored_len = blo_frame_uint32(p + 4);
+		p += BLEND_FRAME_HEADER_LEN;
+		
+		if ((raw_len > BLEND_FRAME_SIZE) || (stored_len > raw_len) || ((size_t)(end - p) < stored_len)) {
+			return NULL;
+		}
+		
+		raw_size += raw_len;
+		p += stored_len;
+	}
+	
+	if ((raw_size < SIZEOFBLENDERHEADER) || (raw_size > INT_MAX)) {
+		return NULL;
+	}
+	
+	buffer = MEM_mallocN(raw_size, "blo_frames_decompress");
+	frames = MEM_mallocN(sizeof(*frames) * (size_t)totframe, "ReadFrame");
+	task_pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+	
+	for (i = 0, p = mem + BLEND_FRAMES_MAGIC_LEN, raw_size = 0; i < totframe; i++) {
+		ReadFrame *frame = &frames[i];
+		
+		frame->out_len = blo_frame_uint32(p);
+		frame->in_len = blo_frame_uint32(p + 4);
+		frame->in = p + BLEND_FRAME_HEADER_LEN;
+		frame->out = buffer + raw_size;
+		frame->ok = false;
+		
+		BLI_task_pool_push(task_pool, blo_frame_decompress_task, frame, false, TASK_PRIORITY_LOW);
+		
+		raw_size += frame->out_len;
+		p += BLEND_FRAME_HEADER_LEN + frame->in_len;
+	}
+	
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+	
+	for (i = 0; i < totframe; i++) {
+		ok &= frames[i].ok;
+	}
+	MEM_freeN(frames);
+	
+	if (!ok) {
+		MEM_freeN(buffer);
+		return NULL;
+	}
+	
+	*r_buffersize = (int)raw_size;
+	return (char *)buffer;
+}
+
+#endif  /* WITH_LZO */
+
+/* block framed files are decompressed in memory, other uncompressed files are mapped.
+ * returns NULL and sets r_use_stream when the file has to be read through zlib */
+static FileData *blo_openblenderfile_mmap(const char *filepath, ReportList *reports, bool *r_use_stream)
+{
+	FileData *fd;
+	unsigned char magic[2];
+	size_t size;
+	void *mem;
+	int file;
+	
+	*r_use_stream = true;
+	
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+	
+	/* gzip files are inflated through zlib, FileData offsets are int */
+	size = BLI_file_descriptor_size(file);
+	if ((size < SIZEOFBLENDERHEADER) || (size > INT_MAX) ||
+	    (read(file, magic, sizeof(magic)) != sizeof(magic)) ||
+	    (magic[0] == 0x1f && magic[1] == 0x8b))
+	{
+		close(file);
+		return NULL;
+	}
+	
+	/* private and writable, endian switching is done in place (copy on write) */
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	if (mem == MAP_FAILED) {
+		close(file);
+		return NULL;
+	}
+	
+	if (memcmp(mem, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) == 0) {
+		char *buffer = NULL;
+		int buffersize = 0;
+		
+#ifdef WITH_LZO
+		buffer = blo_frames_decompress(mem, size, &buffersize);
+#endif
+		munmap(mem, size);
+		close(file);
+		
+		*r_use_stream = false;
+		if (buffer == NULL) {
+#ifdef WITH_LZO
+			BKE_reportf(reports, RPT_ERROR, "Failed to read blend file '%s', corrupt compressed data", filepath);
+#else
+			BKE_reportf(reports, RPT_ERROR, "Failed to read blend file '%s', built without LZO support", filepath);
+#endif
+			return NULL;
+		}
+		
+		fd = filedata_new();
+		fd->buffer = buffer;
+		fd->buffersize = buffersize;
+		fd->read = fd_read_from_memory;
+		
+		return fd;
+	}
+	
+	fd = filedata_new();
+	fd->filedes = file;
+	fd->buffer = mem;
+	fd->buffersize = (int)size;
+	fd->read = fd_read_from_memory;
+	fd->flags |= FD_FLAGS_USE_MMAP;
+	
+	return fd;
+}
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
-	gzFile gzfile;
-	errno = 0;
-	gzfile = BLI_gzopen(filepath, "rb");
+	bool use_stream;
+	FileData *fd = blo_openblenderfile_mmap(filepath, reports, &use_stream);
 	
-	if (gzfile == (gzFile)Z_NULL) {
-		BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
-		            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
-		return NULL;
-	}
-	else {
-		FileData *fd = filedata_new();
-		fd->gzfiledes = gzfile;
-		fd->read = fd_read_gzip_from_file;
+	if (fd == NULL) {
+		gzFile gzfile;
 		
-		/* needed for library_append and read_libraries */
-		BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+		if (!use_stream) {
+			return NULL;
+		}
 		
-		return blo_decode_and_check(fd, reports);
+		errno = 0;
+		gzfile = BLI_gzopen(filepath, "rb");
+		
+		if (gzfile == (gzFile)Z_NULL) {
+			BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
+			            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
+			return NULL;
+		}
+		
+		fd = filedata_new();
+		fd->gzfiledes = gzfile;
+		fd->read = fd_read_gzip_from_file;
 	}
+	
+	/* needed for library_append and read_libraries */
+	BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+	
+	return blo_decode_and_check(fd, reports);
 }
 
 static int fd_read_gzip_from_memory(FileData *filedata, void *buffer, unsigned int size)
@@ -1114,7 +1337,11 @@ void blo_freefiledata(FileData *fd)
 			}
 		}
 		
-		if (fd->buffer && !(fd->flags & FD_FLAGS_NOT_MY_BUFFER)) {
+		if (fd->flags & FD_FLAGS_USE_MMAP) {
+			munmap((void *)fd->buffer, (size_t)fd->buffersize);
+			fd->buffer = NULL;
+		}
+		else if (fd->buffer && !(fd->flags & FD_FLAGS_NOT_MY_BUFFER)) {
 			MEM_freeN((void *)fd->buffer);
 			fd->buffer = NULL;
 		}
@@ -1131,6 +1358,16 @@ void blo_freefiledata(FileData *fd)
 		
 		if (fd->datamap)
 			oldnewmap_free(fd->datamap);
+		if (fd->deferred_links.first) {
+			/* reading stopped before direct_link_deferred, free the data read for these blocks */
+			DeferredDirectLink *dl;
+			
+			for (dl = fd->deferred_links.first; dl; dl = dl->next) {
+				oldnewmap_free_unused(dl->datamap);
+				oldnewmap_free(dl->datamap);
+			}
+			BLI_freelistN(&fd->deferred_links);
+		}
 		if (fd->globmap)
 			oldnewmap_free(fd->globmap);
 		if (fd->imamap)
@@ -1529,12 +1766,10 @@ void blo_add_library_pointer_map(ListBase *mainlist, FileData *fd)
 /* ********** END OLD POINTERS ****************** */
 /* ********** READ FILE ****************** */
 
-static void switch_endian_structs(struct SDNA *filesdna, BHead *bhead)
+static void switch_endian_structs(struct SDNA *filesdna, BHead *bhead, char *data)
 {
 	int blocksize, nblocks;
-	char *data;
 	
-	data = (char *)(bhead+1);
 	blocksize = filesdna->typelens[ filesdna->structs[bhead->SDNAnr][0] ];
 	
 	nblocks = bhead->nr;
@@ -1550,19 +1785,42 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 	void *temp = NULL;
 	
 	if (bh->len) {
+		const bool do_endian_switch = (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN));
+		char *data = blo_bhead_data(bh);
+		char *data_aligned = NULL;
+		
+		/* data used in place from a mapped file is only 4 byte aligned, endian switching
+		 * and reconstruction access 8 byte members (pointers, doubles) so use an aligned copy */
+		if ((fd->flags & FD_FLAGS_USE_MMAP) && ((uintptr_t)data & 7) &&
+		    (do_endian_switch || fd->compflags[bh->SDNAnr] == 2))
+		{
+			data_aligned = MEM_mallocN(bh->len, blockname);
+			memcpy(data_aligned, data, bh->len);
+			data = data_aligned;
+		}
+		
 		/* switch is based on file dna */
-		if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN))
-			switch_endian_structs(fd->filesdna, bh);
+		if (do_endian_switch)
+			switch_endian_structs(fd->filesdna, bh, data);
 		
 		if (fd->compflags[bh->SDNAnr]) {	/* flag==0: doesn't exist anymore */
 			if (fd->compflags[bh->SDNAnr] == 2) {
-				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh+1));
+				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, data);
+			}
+			else if (data_aligned) {
+				/* the aligned copy is the result */
+				temp = data_aligned;
+				data_aligned = NULL;
 			}
 			else {
 				temp = MEM_mallocN(bh->len, blockname);
-				memcpy(temp, (bh+1), bh->len);
+				memcpy(temp, data, bh->len);
 			}
 		}
+		
+		if (data_aligned) {
+			MEM_freeN(data_aligned);
+		}
 	}
 
 	return temp;
@@ -7160,55 +7418,11 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
 	return bhead;
 }
 
-static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, int flag, ID **r_id)
+/* init pointers direct data, returns true when the ID has to be freed */
+static bool direct_link_libblock(FileData *fd, Main *main, ID *id)
 {
-	/* this routine reads a libblock and its direct data. Use link functions
-	 * to connect it all
-	 */
-	ID *id;
-	ListBase *lb;
-	const char *allocname;
 	bool wrong_id = false;
 	
-	/* read libblock */
-	id = read_struct(fd, bhead, "lib block");
-	if (r_id)
-		*r_id = id;
-	if (!id)
-		return blo_nextbhead(fd, bhead);
-	
-	oldnewmap_insert(fd->libmap, bhead->old, id, bhead->code);	/* for ID_ID check */
-	
-	/* do after read_struct, for dna reconstruct */
-	if (bhead->code == ID_ID) {
-		lb = which_libbase(main, GS(id->name));
-	}
-	else {
-		lb = which_libbase(main, bhead->code);
-	}
-	
-	BLI_addtail(lb, id);
-	
-	/* clear first 8 bits */
-	id->flag = (id->flag & 0xFF00) | flag | LIB_NEED_LINK;
-	id->lib = main->curlib;
-	if (id->flag & LIB_FAKEUSER) id->us= 1;
-	else id->us = 0;
-	id->icon_id = 0;
-	id->flag &= ~(LIB_ID_RECALC|LIB_ID_RECALC_DATA|LIB_DOIT);
-	
-	/* this case cannot be direct_linked: it's just the ID part */
-	if (bhead->code == ID_ID) {
-		return blo_nextbhead(fd, bhead);
-	}
-	
-	/* need a name for the mallocN, just for debugging and sane prints on leaks */
-	allocname = dataname(GS(id->name));
-	
-	/* read all data into fd->datamap */
-	bhead = read_data_into_oldnewmap(fd, bhead, allocname);
-	
-	/* init pointers direct data */
 	direct_link_id(fd, id);
 	
 	switch (GS(id->name)) {
@@ -7310,6 +7524,132 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, int flag, ID
 			break;
 	}
 	
+	return wrong_id;
+}
+
+/* Direct data of these ID types only refers to the data-blocks stored after them,
+ * so once the file is read they can be linked independently from each other. */
+static bool direct_link_is_threadsafe(const short idcode)
+{
+	return ELEM3(idcode, ID_ME, ID_NT, ID_IM);
+}
+
+static void direct_link_deferred_task(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	DeferredDirectLink *dl = taskdata;
+	/* own copy, so newdataadr() looks up this block's data only */
+	FileData fd_task = *(FileData *)BLI_task_pool_userdata(pool);
+	
+	fd_task.datamap = dl->datamap;
+	
+	/* the shared report list isn't locked, collect them per task */
+	if (fd_task.reports) {
+		dl->reports = *fd_task.reports;
+		BLI_listbase_clear(&dl->reports.list);
+		fd_task.reports = &dl->reports;
+	}
+	
+	direct_link_libblock(&fd_task, NULL, dl->id);
+	
+	oldnewmap_free_unused(dl->datamap);
+	oldnewmap_free(dl->datamap);
+}
+
+/* link direct data of all blocks read with FD_FLAGS_DEFER_DIRECT_LINK */
+static void direct_link_deferred(FileData *fd)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+	TaskPool *task_pool;
+	DeferredDirectLink *dl;
+	const double time_start = PIL_check_seconds_timer();
+	int tot = 0;
+	
+	task_pool = BLI_task_pool_create(scheduler, fd);
+	
+	for (dl = fd->deferred_links.first; dl; dl = dl->next, tot++) {
+		BLI_task_pool_push(task_pool, direct_link_deferred_task, dl, false, TASK_PRIORITY_LOW);
+	}
+	
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+	
+	/* in file order, as if linked one after the other */
+	if (fd->reports) {
+		for (dl = fd->deferred_links.first; dl; dl = dl->next) {
+			BLI_movelisttolist(&fd->reports->list, &dl->reports.list);
+		}
+	}
+	
+	BLI_freelistN(&fd->deferred_links);
+	
+	if (G.debug & G_DEBUG) {
+		printf("direct_link_deferred: %d blocks in %.6fs\n", tot, PIL_check_seconds_timer() - time_start);
+	}
+}
+
+static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, int flag, ID **r_id)
+{
+	/* this routine reads a libblock and its direct data. Use link functions
+	 * to connect it all
+	 */
+	ID *id;
+	ListBase *lb;
+	const char *allocname;
+	bool wrong_id = false;
+	
+	/* read libblock */
+	id = read_struct(fd, bhead, "lib block");
+	if (r_id)
+		*r_id = id;
+	if (!id)
+		return blo_nextbhead(fd, bhead);
+	
+	oldnewmap_insert(fd->libmap, bhead->old, id, bhead->code);	/* for ID_ID check */
+	
+	/* do after read_struct, for dna reconstruct */
+	if (bhead->code == ID_ID) {
+		lb = which_libbase(main, GS(id->name));
+	}
+	else {
+		lb = which_libbase(main, bhead->code);
+	}
+	
+	BLI_addtail(lb, id);
+	
+	/* clear first 8 bits */
+	id->flag = (id->flag & 0xFF00) | flag | LIB_NEED_LINK;
+	id->lib = main->curlib;
+	if (id->flag & LIB_FAKEUSER) id->us= 1;
+	else id->us = 0;
+	id->icon_id = 0;
+	id->flag &= ~(LIB_ID_RECALC|LIB_ID_RECALC_DATA|LIB_DOIT);
+	
+	/* this case cannot be direct_linked: it's just the ID part */
+	if (bhead->code == ID_ID) {
+		return blo_nextbhead(fd, bhead);
+	}
+	
+	/* need a name for the mallocN, just for debugging and sane prints on leaks */
+	allocname = dataname(GS(id->name));
+	
+	/* read all data into fd->datamap */
+	bhead = read_data_into_oldnewmap(fd, bhead, allocname);
+	
+	if ((fd->flags & FD_FLAGS_DEFER_DIRECT_LINK) && direct_link_is_threadsafe(GS(id->name))) {
+		/* keep the data of this block, and start a new map for the next one */
+		DeferredDirectLink *dl = MEM_mallocN(sizeof(*dl), "DeferredDirectLink");
+		dl->id = id;
+		dl->datamap = fd->datamap;
+		BLI_addtail(&fd->deferred_links, dl);
+		
+		/* small, there is one per deferred block */
+		fd->datamap = oldnewmap_new_ex(64);
+		return bhead;
+	}
+	
+	/* init pointers direct data */
+	wrong_id = direct_link_libblock(fd, main, id);
+	
 	oldnewmap_free_unused(fd->datamap);
 	oldnewmap_clear(fd->datamap);
 	
@@ -7465,46 +7805,70 @@ static void do_versions_after_linking(FileData *fd, Library *lib, Main *main)
 }
 #endif
 
+/* relink one ID type, with --debug the time spent on it is printed */
+#define LIB_LINK_TIMED(id_type)                                               \
+	if (do_timing) {                                                          \
+		const double time_id = PIL_check_seconds_timer();                     \
+		lib_link_##id_type(fd, main);                                         \
+		printf("lib_link_all: %-20s %.6fs\n", #id_type,                       \
+		       PIL_check_seconds_timer() - time_id);                          \
+	}                                                                         \
+	else {                                                                    \
+		lib_link_##id_type(fd, main);                                         \
+	} (void)0
+
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
+	const bool do_timing = (G.debug & G_DEBUG) != 0;
+	double time_start = 0.0;
+
+	if (do_timing) {
+		time_start = PIL_check_seconds_timer();
+		printf("lib_link_all: %d lib entries\n", fd->libmap->nentries);
+	}
+
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
-		lib_link_windowmanager(fd, main);
-		lib_link_screen(fd, main);
-	}
-	lib_link_scene(fd, main);
-	lib_link_object(fd, main);
-	lib_link_curve(fd, main);
-	lib_link_mball(fd, main);
-	lib_link_material(fd, main);
-	lib_link_texture(fd, main);
-	lib_link_image(fd, main);
-	lib_link_ipo(fd, main);		// XXX deprecated... still needs to be maintained for version patches still
-	lib_link_key(fd, main);
-	lib_link_world(fd, main);
-	lib_link_lamp(fd, main);
-	lib_link_latt(fd, main);
-	lib_link_text(fd, main);
-	lib_link_camera(fd, main);
-	lib_link_speaker(fd, main);
-	lib_link_sound(fd, main);
-	lib_link_group(fd, main);
-	lib_link_armature(fd, main);
-	lib_link_action(fd, main);
-	lib_link_vfont(fd, main);
-	lib_link_nodetree(fd, main);	/* has to be done after scene/materials, this will verify group nodes */
-	lib_link_brush(fd, main);
-	lib_link_particlesettings(fd, main);
-	lib_link_movieclip(fd, main);
-	lib_link_mask(fd, main);
-	lib_link_linestyle(fd, main);
-
-	lib_link_mesh(fd, main);		/* as last: tpage images with users at zero */
-	
-	lib_link_library(fd, main);		/* only init users */
-}
+		LIB_LINK_TIMED(windowmanager);
+		LIB_LINK_TIMED(screen);
+	}
+	LIB_LINK_TIMED(scene);
+	LIB_LINK_TIMED(object);
+	LIB_LINK_TIMED(curve);
+	LIB_LINK_TIMED(mball);
+	LIB_LINK_TIMED(material);
+	LIB_LINK_TIMED(texture);
+	LIB_LINK_TIMED(image);
+	LIB_LINK_TIMED(ipo);		// XXX deprecated... still needs to be maintained for version patches still
+	LIB_LINK_TIMED(key);
+	LIB_LINK_TIMED(world);
+	LIB_LINK_TIMED(lamp);
+	LIB_LINK_TIMED(latt);
+	LIB_LINK_TIMED(text);
+	LIB_LINK_TIMED(camera);
+	LIB_LINK_TIMED(speaker);
+	LIB_LINK_TIMED(sound);
+	LIB_LINK_TIMED(group);
+	LIB_LINK_TIMED(armature);
+	LIB_LINK_TIMED(action);
+	LIB_LINK_TIMED(vfont);
+	LIB_LINK_TIMED(nodetree);	/* has to be done after scene/materials, this will verify group nodes */
+	LIB_LINK_TIMED(brush);
+	LIB_LINK_TIMED(particlesettings);
+	LIB_LINK_TIMED(movieclip);
+	LIB_LINK_TIMED(mask);
+	LIB_LINK_TIMED(linestyle);
+
+	LIB_LINK_TIMED(mesh);		/* as last: tpage images with users at zero */
+	
+	LIB_LINK_TIMED(library);		/* only init users */
+
+	if (do_timing) {
+		printf("lib_link_all: total %.6fs\n", PIL_check_seconds_timer() - time_start);
+	}
+}
+
+#undef LIB_LINK_TIMED
 
 static void direct_link_keymapitem(FileData *fd, wmKeyMapItem *kmi)
 {
@@ -7597,6 +7961,12 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 	bfd->type = BLENFILETYPE_BLEND;
 	BLI_strncpy(bfd->main->name, filepath, sizeof(bfd->main->name));
 
+	/* link the direct data of independent blocks in parallel once all of them are read,
+	 * undo reads are small enough to not be worth it */
+	if (fd->memfile == NULL && BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) > 1) {
+		fd->flags |= FD_FLAGS_DEFER_DIRECT_LINK;
+	}
+
 	while (bhead) {
 		switch (bhead->code) {
 		case DATA:
@@ -7646,6 +8016,11 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 	
+	if (fd->flags & FD_FLAGS_DEFER_DIRECT_LINK) {
+		fd->flags &= ~FD_FLAGS_DEFER_DIRECT_LINK;
+		direct_link_deferred(fd);
+	}
+	
 	/* do before read_libraries, but skip undo case */
 	if (fd->memfile==NULL)
 		do_versions(fd, NULL, bfd->main);
@@ -7749,7 +8124,7 @@ static BHead *find_bhead(FileData *fd, void *old)
 
 char *bhead_id_name(FileData *fd, BHead *bhead)
 {
-	return ((char *)(bhead+1)) + fd->id_name_offs;
+	return ((char *)blo_bhead_data(bhead)) + fd->id_name_offs;
 }
 
 static ID *is_yet_read(FileData *fd, Main *mainvar, BHead *bhead)
@@ -90,6 +90,10 @@ typedef struct FileData {
 	struct OldNewMap *movieclipmap;
 	struct OldNewMap *packedmap;
 	
+	/* ID blocks waiting for their direct data to be linked in parallel,
+	 * see FD_FLAGS_DEFER_DIRECT_LINK */
+	ListBase deferred_links;
+	
 	struct BHeadSort *bheadmap;
 	int tot_bheadmap;
 	
@@ -104,6 +108,9 @@ typedef struct FileData {
 
 typedef struct BHeadN {
 	struct BHeadN *next, *prev;
+	/* the block data, directly after this struct,
+	 * or in the file itself with FD_FLAGS_USE_MMAP */
+	void *data;
 	struct BHead bhead;
 } BHeadN;
 
@@ -114,6 +121,8 @@ typedef struct BHeadN {
 #define FD_FLAGS_FILE_OK                   (1 << 3)
 #define FD_FLAGS_NOT_MY_BUFFER             (1 << 4)
 #define FD_FLAGS_NOT_MY_LIBMAP             (1 << 5)
+#define FD_FLAGS_DEFER_DIRECT_LINK         (1 << 6)
+#define FD_FLAGS_USE_MMAP                  (1 << 7)
 
 #define SIZEOFBLENDERHEADER 12
 
@@ -142,6 +151,7 @@ void blo_freefiledata(FileData *fd);
 BHead *blo_firstbhead(FileData *fd);
 BHead *blo_nextbhead(FileData *fd, BHead *thisblock);
 BHead *blo_prevbhead(FileData *fd, BHead *thisblock);
+void  *blo_bhead_data(BHead *bhead);
 
 char *bhead_id_name(FileData *fd, BHead *bhead);
 
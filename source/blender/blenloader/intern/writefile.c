@@ -145,6 +145,8 @@
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BKE_action.h"
 #include "BKE_blender.h"
@@ -180,6 +182,11 @@
 
 #include <errno.h>
 
+#ifdef WITH_LZO
+#  include "minilzo.h"
+#  define LZO_OUT_LEN(size)  ((size) + (size) / 16 + 64 + 3)
+#endif
+
 /* ********* my write, buffered writing with minimum size chunks ************ */
 
 #define MYWRITE_BUFFER_SIZE	100000
@@ -194,6 +201,18 @@ typedef struct {
 	
 	int tot, count, error, memsize;
 
+#ifdef WITH_LZO
+	/* block framed compression, see BLEND_FRAMES_MAGIC */
+	bool use_frames;
+	unsigned char *frame_buf;
+	int frame_len;
+	ListBase frames;  /* WriteFrame not written yet, in file order */
+	int totframe;
+	TaskPool *frame_pool;
+	ThreadMutex frame_mutex;
+	ThreadCondition frame_cond;
+#endif
+
 #ifdef USE_BMESH_SAVE_AS_COMPAT
 	char use_mesh_compat; /* option to save with older mesh format */
 #endif
@@ -218,11 +237,180 @@ static WriteData *writedata_new(int file)
 	return wd;
 }
 
+#ifdef WITH_LZO
+
+typedef struct WriteFrame {
+	struct WriteFrame *next, *prev;
+	unsigned char *data;
+	/* stored_len equals raw_len when compression didn't help */
+	int raw_len, stored_len;
+	bool done;
+} WriteFrame;
+
+static void writedata_frame_compress_task(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	WriteData *wd = BLI_task_pool_userdata(pool);
+	WriteFrame *frame = taskdata;
+	void *wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, "writedata_frame_wrkmem");
+	unsigned char *out = MEM_mallocN(LZO_OUT_LEN(frame->raw_len), "writedata_frame_out");
+	lzo_uint out_len = LZO_OUT_LEN(frame->raw_len);
+	int r;
+
+	r = lzo1x_1_compress(frame->data, (lzo_uint)frame->raw_len, out, &out_len, wrkmem);
+
+	if ((r == LZO_E_OK) && (out_len < (lzo_uint)frame->raw_len)) {
+		MEM_freeN(frame->data);
+		frame->data = out;
+		frame->stored_len = (int)out_len;
+	}
+	else {
+		MEM_freeN(out);
+	}
+
+	MEM_freeN(wrkmem);
+
+	BLI_mutex_lock(&wd->frame_mutex);
+	frame->done = true;
+	BLI_condition_notify_all(&wd->frame_cond);
+	BLI_mutex_unlock(&wd->frame_mutex);
+}
+
+static void writedata_frame_uint32(unsigned char *dst, unsigned int value)
+{
+	dst[0] = (unsigned char)(value);
+	dst[1] = (unsigned char)(value >> 8);
+	dst[2] = (unsigned char)(value >> 16);
+	dst[3] = (unsigned char)(value >> 24);
+}
+
+/* write out compressed frames in file order, waiting until no more than
+ * max_pending frames are left, so memory use stays bounded */
+static void writedata_frames_flush(WriteData *wd, int max_pending)
+{
+	WriteFrame *frame;
+
+	while ((frame = wd->frames.first)) {
+		unsigned char header[BLEND_FRAME_HEADER_LEN];
+		bool done;
+
+		BLI_mutex_lock(&wd->frame_mutex);
+		if (!frame->done && wd->totframe > max_pending) {
+			if (BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) > 1) {
+				while (!frame->done) {
+					BLI_condition_wait(&wd->frame_cond, &wd->frame_mutex);
+				}
+			}
+			else {
+				/* no worker threads, compress the pending frames here */
+				BLI_mutex_unlock(&wd->frame_mutex);
+				BLI_task_pool_work_and_wait(wd->frame_pool);
+				BLI_mutex_lock(&wd->frame_mutex);
+			}
+		}
+		done = frame->done;
+		BLI_mutex_unlock(&wd->frame_mutex);
+
+		if (!done) {
+			break;
+		}
+
+		writedata_frame_uint32(header, (unsigned int)frame->raw_len);
+		writedata_frame_uint32(header + 4, (unsigned int)frame->stored_len);
+
+		if (wd->error == 0) {
+			if ((write(wd->file, header, sizeof(header)) != sizeof(header)) ||
+			    (write(wd->file, frame->data, frame->stored_len) != frame->stored_len))
+			{
+				wd->error = 1;
+			}
+		}
+
+		BLI_remlink(&wd->frames, frame);
+		wd->totframe--;
+		MEM_freeN(frame->data);
+		MEM_freeN(frame);
+	}
+}
+
+/* hand the filled frame buffer over to the task pool */
+static void writedata_frame_push(WriteData *wd)
+{
+	WriteFrame *frame;
+
+	if (wd->frame_len == 0) return;
+
+	frame = MEM_mallocN(sizeof(*frame), "WriteFrame");
+	frame->data = wd->frame_buf;
+	frame->raw_len = frame->stored_len = wd->frame_len;
+	frame->done = false;
+	BLI_addtail(&wd->frames, frame);
+	wd->totframe++;
+
+	BLI_task_pool_push(wd->frame_pool, writedata_frame_compress_task, frame, false, TASK_PRIORITY_LOW);
+
+	wd->frame_buf = MEM_mallocN(BLEND_FRAME_SIZE, "writedata_frame_buf");
+	wd->frame_len = 0;
+
+	/* keep a few frames per thread in flight */
+	writedata_frames_flush(wd, 2 * BLI_task_scheduler_num_threads(BLI_task_scheduler_get()));
+}
+
+static void writedata_frame_add(WriteData *wd, const unsigned char *mem, int memlen)
+{
+	while (memlen > 0) {
+		const int len = min_ii(memlen, BLEND_FRAME_SIZE - wd->frame_len);
+
+		memcpy(wd->frame_buf + wd->frame_len, mem, len);
+		wd->frame_len += len;
+		mem += len;
+		memlen -= len;
+
+		if (wd->frame_len == BLEND_FRAME_SIZE) {
+			writedata_frame_push(wd);
+		}
+	}
+}
+
+static void writedata_frames_begin(WriteData *wd)
+{
+	wd->use_frames = true;
+	wd->frame_buf = MEM_mallocN(BLEND_FRAME_SIZE, "writedata_frame_buf");
+	wd->frame_pool = BLI_task_pool_create(BLI_task_scheduler_get(), wd);
+	BLI_mutex_init(&wd->frame_mutex);
+	BLI_condition_init(&wd->frame_cond);
+
+	if (write(wd->file, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) != BLEND_FRAMES_MAGIC_LEN)
+		wd->error = 1;
+}
+
+/* write out the remaining frames once they are compressed */
+static void writedata_frames_end(WriteData *wd)
+{
+	writedata_frame_push(wd);
+
+	BLI_task_pool_work_and_wait(wd->frame_pool);
+	writedata_frames_flush(wd, 0);
+
+	BLI_task_pool_free(wd->frame_pool);
+	wd->frame_pool = NULL;
+	BLI_condition_end(&wd->frame_cond);
+	BLI_mutex_end(&wd->frame_mutex);
+}
+
+#endif  /* WITH_LZO */
+
 static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 {
 	if ((wd == NULL) || wd->error || (mem == NULL) || memlen < 1) return;
 	if (wd->error) return;
 
+#ifdef WITH_LZO
+	if (wd->use_frames) {
+		writedata_frame_add(wd, mem, memlen);
+		return;
+	}
+#endif
+
 	/* memory based save */
 	if (wd->current) {
 		add_memfilechunk(NULL, wd->current, mem, memlen);
@@ -238,6 +426,12 @@ static void writedata_free(WriteData *wd)
 {
 	DNA_sdna_free(wd->sdna);
 
+#ifdef WITH_LZO
+	if (wd->frame_buf) {
+		MEM_freeN(wd->frame_buf);
+	}
+#endif
+
 	MEM_freeN(wd->buf);
 	MEM_freeN(wd);
 }
@@ -304,7 +498,7 @@ static void mywrite(WriteData *wd, const void *adr, int len)
  * \param current The current memory file (can be NULL).
  * \warning Talks to other functions with global parameters
  */
-static WriteData *bgnwrite(int file, MemFile *compare, MemFile *current)
+static WriteData *bgnwrite(int file, MemFile *compare, MemFile *current, int write_flags)
 {
 	WriteData *wd= writedata_new(file);
 
@@ -314,6 +508,15 @@ static WriteData *bgnwrite(int file, MemFile *compare, MemFile *current)
 	wd->current= current;
 	/* this inits comparing */
 	add_memfilechunk(compare, NULL, NULL, 0);
+
+#ifdef WITH_LZO
+	/* never for undo memfiles */
+	if ((write_flags & G_FILE_COMPRESS_FAST) && (current == NULL)) {
+		writedata_frames_begin(wd);
+	}
+#else
+	(void)write_flags;
+#endif
 	
 	return wd;
 }
@@ -332,6 +535,12 @@ static int endwrite(WriteData *wd)
 		writedata_do_write(wd, wd->buf, wd->count);
 		wd->count= 0;
 	}
+
+#ifdef WITH_LZO
+	if (wd->use_frames) {
+		writedata_frames_end(wd);
+	}
+#endif
 	
 	err= wd->error;
 	writedata_free(wd);
@@ -3335,7 +3544,7 @@ static int write_file_handle(Main *mainvar, int handle, MemFile *compare, MemFil
 
 	blo_split_main(&mainlist, mainvar);
 
-	wd= bgnwrite(handle, compare, current);
+	wd= bgnwrite(handle, compare, current, write_flags);
 
 #ifdef USE_BMESH_SAVE_AS_COMPAT
 	wd->use_mesh_compat = (write_flags & G_FILE_MESH_COMPAT) != 0;
@@ -3506,6 +3715,13 @@ int BLO_write_file(Main *mainvar, const char *filepath, int write_flags, ReportL
 
 	write_user_block= write_flags & G_FILE_USERPREFS;
 
+#ifndef WITH_LZO
+	/* block framed compression needs LZO, fall back to gzip */
+	if (write_flags & G_FILE_COMPRESS_FAST) {
+		write_flags = (write_flags & ~G_FILE_COMPRESS_FAST) | G_FILE_COMPRESS;
+	}
+#endif
+
 	if (write_flags & G_FILE_RELATIVE_REMAP)
 		BKE_bpath_relative_convert(mainvar, filepath, NULL); /* note, making relative to something OTHER then G.main->name */
 
@@ -3535,7 +3751,8 @@ int BLO_write_file(Main *mainvar, const char *filepath, int write_flags, ReportL
 		}
 	}
 
-	if (write_flags & G_FILE_COMPRESS) {
+	/* block framed files are compressed while writing */
+	if ((write_flags & G_FILE_COMPRESS) && !(write_flags & G_FILE_COMPRESS_FAST)) {
 		/* compressed files have the same ending as regular files... only from 2.4!!! */
 		char gzname[FILE_MAX+4];
 		int ret;
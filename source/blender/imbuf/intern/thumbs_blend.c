@@ -43,10 +43,103 @@
 #include "IMB_imbuf.h"
 #include "IMB_thumbs.h"
 
+#ifdef WITH_LZO
+#  include "minilzo.h"
+#endif
+
+/* reads the regular file stream from plain, gzipped or block framed files,
+ * for the latter only the frames up to the thumbnail are decompressed */
+typedef struct ThumbReader {
+	gzFile gzfile;
+	bool use_frames;
+	unsigned char *frame;
+	int frame_len, frame_pos;
+} ThumbReader;
+
+#ifdef WITH_LZO
+
+static unsigned int thumb_frame_uint32(const unsigned char *src)
+{
+	return ((unsigned int)src[0]) | ((unsigned int)src[1] << 8) |
+	       ((unsigned int)src[2] << 16) | ((unsigned int)src[3] << 24);
+}
+
+static bool thumb_reader_next_frame(ThumbReader *reader)
+{
+	unsigned char header[BLEND_FRAME_HEADER_LEN];
+	unsigned char *in;
+	unsigned int raw_len, stored_len;
+	lzo_uint out_len;
+	bool ok;
+
+	if (gzread(reader->gzfile, header, sizeof(header)) != sizeof(header))
+		return false;
+
+	raw_len = thumb_frame_uint32(header);
+	stored_len = thumb_frame_uint32(header + 4);
+
+	if ((raw_len == 0) || (raw_len > BLEND_FRAME_SIZE) || (stored_len > raw_len))
+		return false;
+
+	if (reader->frame == NULL)
+		reader->frame = MEM_mallocN(BLEND_FRAME_SIZE, "thumb_reader_frame");
+
+	if (stored_len == raw_len) {
+		ok = (gzread(reader->gzfile, reader->frame, raw_len) == (int)raw_len);
+	}
+	else {
+		in = MEM_mallocN(stored_len, "thumb_reader_in");
+		out_len = raw_len;
+		ok = (gzread(reader->gzfile, in, stored_len) == (int)stored_len) &&
+		     (lzo1x_decompress_safe(in, stored_len, reader->frame, &out_len, NULL) == LZO_E_OK) &&
+		     (out_len == raw_len);
+		MEM_freeN(in);
+	}
+
+	reader->frame_len = ok ? (int)raw_len : 0;
+	reader->frame_pos = 0;
+
+	return ok;
+}
+
+#endif  /* WITH_LZO */
+
+/* read len bytes, or skip them when buf is NULL, returns the number of bytes read */
+static int thumb_reader_read(ThumbReader *reader, void *buf, int len)
+{
+#ifdef WITH_LZO
+	if (reader->use_frames) {
+		int done = 0;
+
+		while (done < len) {
+			int chunk;
+
+			if (reader->frame_pos == reader->frame_len) {
+				if (!thumb_reader_next_frame(reader))
+					break;
+			}
+
+			chunk = MIN2(len - done, reader->frame_len - reader->frame_pos);
+			if (buf)
+				memcpy((char *)buf + done, reader->frame + reader->frame_pos, chunk);
+			reader->frame_pos += chunk;
+			done += chunk;
+		}
+
+		return done;
+	}
+#endif
+
+	if (buf == NULL)
+		return (gzseek(reader->gzfile, len, SEEK_CUR) == -1) ? 0 : len;
+
+	return gzread(reader->gzfile, buf, len);
+}
+
 /* extracts the thumbnail from between the 'REND' and the 'GLOB'
  * chunks of the header, don't use typical blend loader because its too slow */
 
-static ImBuf *loadblend_thumb(gzFile gzfile)
+static ImBuf *loadblend_thumb(ThumbReader *reader)
 {
 	char buf[12];
 	int bhead[24 / sizeof(int)]; /* max size on 64bit */
@@ -54,9 +147,26 @@ static ImBuf *loadblend_thumb(gzFile gzfile)
 	char endian_switch;
 	int sizeof_bhead;
 
-	/* read the blend file header */
-	if (gzread(gzfile, buf, 12) != 12)
+	/* read the blend file header, block framed files have the regular header
+	 * at the start of the first frame */
+	if (thumb_reader_read(reader, buf, BLEND_FRAMES_MAGIC_LEN) != BLEND_FRAMES_MAGIC_LEN)
+		return NULL;
+
+	if (strncmp(buf, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) == 0) {
+#ifdef WITH_LZO
+		reader->use_frames = true;
+		if (thumb_reader_read(reader, buf, 12) != 12)
+			return NULL;
+#else
+		return NULL;
+#endif
+	}
+	else if (thumb_reader_read(reader, buf + BLEND_FRAMES_MAGIC_LEN, 12 - BLEND_FRAMES_MAGIC_LEN) !=
+	         12 - BLEND_FRAMES_MAGIC_LEN)
+	{
 		return NULL;
+	}
+
 	if (strncmp(buf, "BLENDER", 7))
 		return NULL;
 
@@ -78,12 +188,12 @@ static ImBuf *loadblend_thumb(gzFile gzfile)
 
 	endian_switch = ((ENDIAN_ORDER != endian)) ? 1 : 0;
 
-	while (gzread(gzfile, bhead, sizeof_bhead) == sizeof_bhead) {
+	while (thumb_reader_read(reader, bhead, sizeof_bhead) == sizeof_bhead) {
 		if (endian_switch)
 			BLI_endian_switch_int32(&bhead[1]);  /* length */
 
 		if (bhead[0] == REND) {
-			gzseek(gzfile, bhead[1], SEEK_CUR); /* skip to the next */
+			thumb_reader_read(reader, NULL, bhead[1]); /* skip to the next */
 		}
 		else {
 			break;
@@ -95,7 +205,7 @@ static ImBuf *loadblend_thumb(gzFile gzfile)
 		ImBuf *img = NULL;
 		int size[2];
 
-		if (gzread(gzfile, size, sizeof(size)) != sizeof(size))
+		if (thumb_reader_read(reader, size, sizeof(size)) != sizeof(size))
 			return NULL;
 
 		if (endian_switch) {
@@ -112,7 +222,7 @@ static ImBuf *loadblend_thumb(gzFile gzfile)
 		/* finally malloc and read the data */
 		img = IMB_allocImBuf(size[0], size[1], 32, IB_rect | IB_metadata);
 	
-		if (gzread(gzfile, img->rect, bhead[1]) != bhead[1]) {
+		if (thumb_reader_read(reader, img->rect, bhead[1]) != bhead[1]) {
 			IMB_freeImBuf(img);
 			img = NULL;
 		}
@@ -133,9 +243,15 @@ ImBuf *IMB_loadblend_thumb(const char *path)
 		return NULL;
 	}
 	else {
-		ImBuf *img = loadblend_thumb(gzfile);
+		ThumbReader reader = {NULL};
+		ImBuf *img;
+
+		reader.gzfile = gzfile;
+		img = loadblend_thumb(&reader);
 
 		/* read ok! */
+		if (reader.frame)
+			MEM_freeN(reader.frame);
 		gzclose(gzfile);
 
 		return img;
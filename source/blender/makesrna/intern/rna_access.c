@@ -39,7 +39,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_utildefines.h"
 #include "BLI_dynstr.h"
-#include "BLI_ghash.h"
+#include "BLI_ghash_flat.h"
 #include "BLI_math.h"
 
 #include "BLF_api.h"
@@ -76,11 +76,11 @@ void RNA_init(void)
 
 	for (srna = BLENDER_RNA.structs.first; srna; srna = srna->cont.next) {
 		if (!srna->cont.prophash) {
-			srna->cont.prophash = BLI_ghash_str_new("RNA_init gh");
+			srna->cont.prophash = BLI_ghash_flat_str_new("RNA_init gh");
 
 			for (prop = srna->cont.properties.first; prop; prop = prop->next)
 				if (!(prop->flag & PROP_BUILTIN))
-					BLI_ghash_insert(srna->cont.prophash, (void *)prop->identifier, prop);
+					BLI_ghash_flat_insert(srna->cont.prophash, (void *)prop->identifier, prop);
 		}
 	}
 }
@@ -93,7 +93,7 @@ void RNA_exit(void)
 	
 	for (srna = BLENDER_RNA.structs.first; srna; srna = srna->cont.next) {
 		if (srna->cont.prophash) {
-			BLI_ghash_free(srna->cont.prophash, NULL, NULL);
+			BLI_ghash_flat_free(srna->cont.prophash, NULL, NULL);
 			srna->cont.prophash = NULL;
 		}
 	}
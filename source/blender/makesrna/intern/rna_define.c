@@ -40,7 +40,7 @@
 #include "DNA_sdna_types.h"
 
 #include "BLI_listbase.h"
-#include "BLI_ghash.h"
+#include "BLI_ghash_flat.h"
 
 #include "BLF_translation.h"
 
@@ -1186,7 +1186,7 @@ PropertyRNA *RNA_def_property(StructOrFunctionRNA *cont_, const char *identifier
 		prop->flag |= PROP_IDPROPERTY | PROP_RUNTIME;
 #ifdef RNA_RUNTIME
 		if (cont->prophash)
-			BLI_ghash_insert(cont->prophash, (void *)prop->identifier, prop);
+			BLI_ghash_flat_insert(cont->prophash, (void *)prop->identifier, prop);
 #endif
 	}
 
@@ -3261,7 +3261,7 @@ void RNA_def_property_duplicate_pointers(StructOrFunctionRNA *cont_, PropertyRNA
 	if (prop->identifier) {
 		if (cont->prophash) {
 			prop->identifier = BLI_strdup(prop->identifier);
-			BLI_ghash_reinsert(cont->prophash, (void *)prop->identifier, prop, NULL, NULL);
+			BLI_ghash_flat_reinsert(cont->prophash, (void *)prop->identifier, prop, NULL, NULL);
 		}
 		else {
 			prop->identifier = BLI_strdup(prop->identifier);
@@ -3410,7 +3410,7 @@ static void rna_def_property_free(StructOrFunctionRNA *cont_, PropertyRNA *prop)
 	
 	if (prop->flag & PROP_RUNTIME) {
 		if (cont->prophash)
-			BLI_ghash_remove(cont->prophash, (void *)prop->identifier, NULL, NULL);
+			BLI_ghash_flat_remove(cont->prophash, (void *)prop->identifier, NULL, NULL);
 
 		RNA_def_property_free_pointers(prop);
 		rna_freelinkN(&cont->properties, prop);
@@ -43,7 +43,7 @@ struct CollectionPropertyIterator;
 struct bContext;
 struct EnumProperty;
 struct IDProperty;
-struct GHash;
+struct GHashFlat;
 struct Main;
 struct Scene;
 
@@ -130,7 +130,7 @@ typedef void (*PropEnumSetFuncEx)(struct PointerRNA *ptr, struct PropertyRNA *pr
 typedef struct ContainerRNA {
 	void *next, *prev;
 
-	struct GHash *prophash;
+	struct GHashFlat *prophash;
 	ListBase properties;
 } ContainerRNA;
 
@@ -106,7 +106,7 @@ EnumPropertyItem property_unit_items[] = {
 #ifdef RNA_RUNTIME
 #include "MEM_guardedalloc.h"
 #include "BLI_utildefines.h"
-#include "BLI_ghash.h"
+#include "BLI_ghash_flat.h"
 
 /* Struct */
 
@@ -374,7 +374,7 @@ int rna_builtin_properties_lookup_string(PointerRNA *ptr, const char *key, Point
 
 	do {
 		if (srna->cont.prophash) {
-			prop = BLI_ghash_lookup(srna->cont.prophash, (void *)key);
+			prop = BLI_ghash_flat_lookup(srna->cont.prophash, (void *)key);
 
 			if (prop) {
 				propptr.type = &RNA_Property;
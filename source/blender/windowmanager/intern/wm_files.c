@@ -88,6 +88,7 @@
 #include "BKE_texture.h"
 
 
+#include "BLO_blend_defs.h"
 #include "BLO_readfile.h"
 #include "BLO_writefile.h"
 
@@ -328,7 +329,7 @@ static int wm_read_exotic(Scene *UNUSED(scene), const char *name)
 {
 	int len;
 	gzFile gzfile;
-	char header[7];
+	char header[BLEND_FRAMES_MAGIC_LEN];
 	int retval;
 
 	/* make sure we're not trying to read a directory.... */
@@ -345,7 +346,11 @@ static int wm_read_exotic(Scene *UNUSED(scene), const char *name)
 		else {
 			len = gzread(gzfile, header, sizeof(header));
 			gzclose(gzfile);
-			if (len == sizeof(header) && strncmp(header, "BLENDER", 7) == 0) {
+			/* regular or block framed (G_FILE_COMPRESS_FAST) blend file */
+			if (len == sizeof(header) &&
+			    (strncmp(header, "BLENDER", 7) == 0 ||
+			     strncmp(header, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) == 0))
+			{
 				retval = BKE_READ_EXOTIC_OK_BLEND;
 			}
 			else {
@@ -957,6 +962,7 @@ int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *
 		}
 
 		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_COMPRESS_FAST, G_FILE_COMPRESS_FAST);
 		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
 
 		/* prevent background mode scripts from clobbering history */
@@ -1011,7 +1017,8 @@ int wm_homefile_write_exec(bContext *C, wmOperator *op)
 	ED_editors_flush_edits(C, false);
 
 	/*  force save as regular blend file */
-	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_LOCK | G_FILE_SIGN | G_FILE_HISTORY);
+	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FAST | G_FILE_AUTOPLAY | G_FILE_LOCK | G_FILE_SIGN |
+	                            G_FILE_HISTORY);
 
 	if (BLO_write_file(CTX_data_main(C), filepath, fileflags | G_FILE_USERPREFS, op->reports, NULL) == 0) {
 		printf("fail\n");
@@ -2678,6 +2678,10 @@ static void save_set_compress(wmOperator *op)
 		else /* use userdef for new file */
 			RNA_boolean_set(op->ptr, "compress", U.flag & USER_FILECOMPRESS);
 	}
+	if (!RNA_struct_property_is_set(op->ptr, "compress_fast")) {
+		/* keep flag for existing file */
+		RNA_boolean_set(op->ptr, "compress_fast", G.save_over && (G.fileflags & G_FILE_COMPRESS_FAST));
+	}
 }
 
 static int wm_save_as_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent *UNUSED(event))
@@ -2723,6 +2727,8 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 	/* set compression flag */
 	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "compress"),
 	                 G_FILE_COMPRESS);
+	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "compress_fast"),
+	                 G_FILE_COMPRESS_FAST);
 	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "relative_remap"),
 	                 G_FILE_RELATIVE_REMAP);
 	BKE_BIT_TEST_SET(fileflags,
@@ -2776,6 +2782,9 @@ static void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	WM_operator_properties_filesel(ot, FOLDERFILE | BLENDERFILE, FILE_BLENDER, FILE_SAVE,
 	                               WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY);
 	RNA_def_boolean(ot->srna, "compress", 0, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_fast", 0, "Fast Compress",
+	                "Write .blend file compressed in blocks using multiple threads "
+	                "(can't be read by versions without support for it)");
 	RNA_def_boolean(ot->srna, "relative_remap", 1, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 	prop = RNA_def_boolean(ot->srna, "copy", 0, "Save Copy",
@@ -2852,6 +2861,9 @@ static void WM_OT_save_mainfile(wmOperatorType *ot)
 	WM_operator_properties_filesel(ot, FOLDERFILE | BLENDERFILE, FILE_BLENDER, FILE_SAVE,
 	                               WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY);
 	RNA_def_boolean(ot->srna, "compress", 0, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_fast", 0, "Fast Compress",
+	                "Write .blend file compressed in blocks using multiple threads "
+	                "(can't be read by versions without support for it)");
 	RNA_def_boolean(ot->srna, "relative_remap", 0, "Remap Relative", "Remap relative paths when saving in a different directory");
 }
 
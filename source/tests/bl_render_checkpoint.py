@@ -0,0 +1,123 @@
+# ./blender.bin --background -noaudio --factory-startup --python source/tests/bl_render_checkpoint.py
+
+# Renders the default scene with a Cycles checkpoint, then replaces the
+# buffers stored in it so that restored tiles are recognizable in the next
+# render, which continues with more samples.
+
+import os
+import struct
+import tempfile
+import unittest
+from test import support
+
+import bpy
+
+CHECKPOINT_MAGIC = b"CYCLCKPT"
+CHECKPOINT_VERSION = 3
+# value of all buffer passes in the replaced tiles, far brighter than the scene
+CHECKPOINT_VALUE = 10000.0
+
+
+def checkpoint_replace_buffers(filepath, value):
+    """Set all render buffer values in the checkpoint, returns the number of tiles."""
+    with open(filepath, "r+b") as f:
+        data = bytearray(f.read())
+
+        assert(data[:8] == CHECKPOINT_MAGIC)
+        assert(struct.unpack_from("=I", data, 8)[0] == CHECKPOINT_VERSION)
+
+        offset = 12
+        num_tiles = 0
+
+        while offset < len(data):
+            # layer name and fingerprint
+            for i in range(2):
+                size = struct.unpack_from("=I", data, offset)[0]
+                offset += 4 + size
+
+            x, y, w, h, pass_stride, num_samples, frame = struct.unpack_from("=7i", data, offset)
+            offset += 7 * 4
+
+            num_floats = w * h * pass_stride
+            struct.pack_into("=%df" % num_floats, data, offset, *([value] * num_floats))
+            offset += num_floats * 4 + w * h * 4
+            num_tiles += 1
+
+        assert(offset == len(data))
+
+        f.seek(0)
+        f.write(data)
+
+    return num_tiles
+
+
+class CheckpointTesting(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.checkpoint = os.path.join(self.directory, "checkpoint")
+        self.image = os.path.join(self.directory, "render.hdr")
+
+        scene = bpy.context.scene
+        scene.render.engine = 'CYCLES'
+        scene.render.resolution_x = 64
+        scene.render.resolution_y = 64
+        scene.render.resolution_percentage = 100
+        scene.render.tile_x = 32
+        scene.render.tile_y = 32
+        scene.render.image_settings.file_format = 'HDR'
+        scene.render.filepath = self.image
+
+        cscene = scene.cycles
+        cscene.progressive = 'PATH'
+        cscene.use_progressive_refine = False
+        cscene.checkpoint_path = self.checkpoint
+
+    def tearDown(self):
+        for filename in os.listdir(self.directory):
+            os.remove(os.path.join(self.directory, filename))
+        os.rmdir(self.directory)
+
+    def render(self, samples):
+        """Render and return the largest pixel value."""
+        bpy.context.scene.cycles.samples = samples
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(self.image)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+
+        return max(pixels)
+
+    def test_resume_more_samples(self):
+        bpy.context.scene.cycles.sampling_pattern = 'SOBOL'
+
+        self.assertLess(self.render(16), 100.0)
+        self.assertGreater(checkpoint_replace_buffers(self.checkpoint, CHECKPOINT_VALUE), 0)
+
+        # restored tiles contain the replaced values, averaged over all samples
+        self.assertGreater(self.render(32), CHECKPOINT_VALUE / 32 * 0.5)
+
+    def test_resume_more_samples_cmj(self):
+        # multi-jitter patterns depend on the number of samples, so the
+        # tiles are rendered again
+        bpy.context.scene.cycles.sampling_pattern = 'CORRELATED_MUTI_JITTER'
+
+        self.assertLess(self.render(16), 100.0)
+        self.assertGreater(checkpoint_replace_buffers(self.checkpoint, CHECKPOINT_VALUE), 0)
+
+        self.assertLess(self.render(32), 100.0)
+
+
+def test_main():
+    try:
+        support.run_unittest(CheckpointTesting)
+    except:
+        import traceback
+        traceback.print_exc()
+
+        # alert CTest we failed
+        import sys
+        sys.exit(1)
+
+if __name__ == '__main__':
+    test_main()
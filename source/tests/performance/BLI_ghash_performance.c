@@ -0,0 +1,387 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/**
+ * Micro benchmark of GHash against GHashFlat, times insert, lookup
+ * (all keys found / none found) and remove for pointer, int and string keys,
+ * and a mix like building the vertex maps of PBVH leaf nodes: mapping the
+ * vertices of the faces of a grid mesh, where each vertex is inserted once
+ * and found again by the faces around it. Checks both return the same values.
+ */
+
+/* Built by CMake with WITH_PERFORMANCE_TESTS, or by hand (from this directory):
+ * gcc -O2 -DNDEBUG -std=gnu99 -I../../../intern/guardedalloc -I../../../intern/atomic -I../../blender/blenlib
+ *     BLI_ghash_performance.c ../../blender/blenlib/intern/BLI_ghash.c
+ *     ../../blender/blenlib/intern/BLI_ghash_flat.c ../../blender/blenlib/intern/BLI_mempool.c
+ *     ../../../intern/guardedalloc/intern/mallocn.c ../../../intern/guardedalloc/intern/mallocn_guarded_impl.c
+ *     ../../../intern/guardedalloc/intern/mallocn_lockfree_impl.c
+ *     -lpthread -o BLI_ghash_performance
+ *
+ * usage: BLI_ghash_performance [totkey] [repeat]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_ghash_flat.h"
+
+enum {
+	KEY_PTR = 0,
+	KEY_INT,
+	KEY_STR,
+};
+
+static const char *key_type_names[] = {"ptr", "int", "str"};
+
+/* faces of the PBVH leaf nodes, as in pbvh.c */
+#define LEAF_LIMIT 10000
+
+typedef struct BenchTimes {
+	double insert, lookup_hit, lookup_miss, remove;
+} BenchTimes;
+
+static double time_now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+static void times_min(BenchTimes *times, const BenchTimes *times_run)
+{
+	times->insert = MIN2(times->insert, times_run->insert);
+	times->lookup_hit = MIN2(times->lookup_hit, times_run->lookup_hit);
+	times->lookup_miss = MIN2(times->lookup_miss, times_run->lookup_miss);
+	times->remove = MIN2(times->remove, times_run->remove);
+}
+
+/* keys [0, totkey) are inserted, keys [totkey, 2 * totkey) are only used for misses */
+static void **keys_create(int key_type, int totkey, char **r_strbuf, int **r_intbuf)
+{
+	void **keys = malloc(sizeof(void *) * (size_t)totkey * 2);
+	int i;
+
+	*r_strbuf = NULL;
+	*r_intbuf = NULL;
+
+	switch (key_type) {
+		case KEY_PTR:
+			/* addresses of elements, like most pointer hashes in Blender */
+			*r_intbuf = malloc(sizeof(int) * (size_t)totkey * 2);
+			for (i = 0; i < totkey * 2; i++) {
+				keys[i] = &(*r_intbuf)[i];
+			}
+			break;
+		case KEY_INT:
+			/* spread out a bit, not a dense range */
+			for (i = 0; i < totkey * 2; i++) {
+				keys[i] = SET_INT_IN_POINTER(i * 7);
+			}
+			break;
+		case KEY_STR:
+			*r_strbuf = malloc(16 * (size_t)totkey * 2);
+			for (i = 0; i < totkey * 2; i++) {
+				keys[i] = *r_strbuf + i * 16;
+				sprintf(keys[i], "Key.%09d", i);
+			}
+			break;
+	}
+
+	/* shuffle both halves, so hits and misses are looked up in random order */
+	srand(1);
+	for (i = totkey - 1; i > 0; i--) {
+		int j = rand() % (i + 1);
+		SWAP(void *, keys[i], keys[j]);
+		SWAP(void *, keys[totkey + i], keys[totkey + j]);
+	}
+
+	return keys;
+}
+
+static int bench_ghash(int key_type, void **keys, int totkey, BenchTimes *times)
+{
+	GHash *gh;
+	int i, found = 0;
+	double t;
+
+	switch (key_type) {
+		case KEY_PTR: gh = BLI_ghash_ptr_new(__func__); break;
+		case KEY_INT: gh = BLI_ghash_int_new(__func__); break;
+		default:      gh = BLI_ghash_str_new(__func__); break;
+	}
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		BLI_ghash_insert(gh, keys[i], SET_INT_IN_POINTER(i));
+	}
+	times->insert = time_now() - t;
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		found += (GET_INT_FROM_POINTER(BLI_ghash_lookup(gh, keys[i])) == i);
+	}
+	times->lookup_hit = time_now() - t;
+
+	t = time_now();
+	for (i = totkey; i < totkey * 2; i++) {
+		found += (BLI_ghash_lookup(gh, keys[i]) != NULL);
+	}
+	times->lookup_miss = time_now() - t;
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		BLI_ghash_remove(gh, keys[i], NULL, NULL);
+	}
+	times->remove = time_now() - t;
+
+	if (BLI_ghash_size(gh) != 0) {
+		found = -1;
+	}
+
+	BLI_ghash_free(gh, NULL, NULL);
+
+	return found;
+}
+
+static int bench_ghash_flat(int key_type, void **keys, int totkey, BenchTimes *times)
+{
+	GHashFlat *gh;
+	int i, found = 0;
+	double t;
+
+	switch (key_type) {
+		case KEY_PTR: gh = BLI_ghash_flat_ptr_new(__func__); break;
+		case KEY_INT: gh = BLI_ghash_flat_int_new(__func__); break;
+		default:      gh = BLI_ghash_flat_str_new(__func__); break;
+	}
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		BLI_ghash_flat_insert(gh, keys[i], SET_INT_IN_POINTER(i));
+	}
+	times->insert = time_now() - t;
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		found += (GET_INT_FROM_POINTER(BLI_ghash_flat_lookup(gh, keys[i])) == i);
+	}
+	times->lookup_hit = time_now() - t;
+
+	t = time_now();
+	for (i = totkey; i < totkey * 2; i++) {
+		found += (BLI_ghash_flat_lookup(gh, keys[i]) != NULL);
+	}
+	times->lookup_miss = time_now() - t;
+
+	t = time_now();
+	for (i = 0; i < totkey; i++) {
+		BLI_ghash_flat_remove(gh, keys[i], NULL, NULL);
+	}
+	times->remove = time_now() - t;
+
+	if (BLI_ghash_flat_size(gh) != 0) {
+		found = -1;
+	}
+
+	BLI_ghash_flat_free(gh, NULL, NULL);
+
+	return found;
+}
+
+/* vertices of the quads of a grid with \a totface faces, in rows of \a width faces */
+static int *mesh_faces_create(int totface, int width)
+{
+	int *faces = malloc(sizeof(int) * 4 * (size_t)totface);
+	int i;
+
+	for (i = 0; i < totface; i++) {
+		const int v = (i / width) * (width + 1) + (i % width);
+
+		faces[i * 4 + 0] = v;
+		faces[i * 4 + 1] = v + 1;
+		faces[i * 4 + 2] = v + width + 2;
+		faces[i * 4 + 3] = v + width + 1;
+	}
+
+	return faces;
+}
+
+/* map the vertices of each leaf to their index in the leaf, returns a checksum */
+static int bench_mesh_ghash(const int *faces, int totface, double *r_time)
+{
+	const double t = time_now();
+	int leaf, i, sum = 0;
+
+	for (leaf = 0; leaf < totface; leaf += LEAF_LIMIT) {
+		const int leaf_end = MIN2(leaf + LEAF_LIMIT, totface);
+		GHash *map = BLI_ghash_int_new_ex(__func__, 2 * (unsigned int)(leaf_end - leaf));
+		GHashIterator gh_iter;
+		int totvert = 0;
+
+		for (i = leaf * 4; i < leaf_end * 4; i++) {
+			void **val_p;
+
+			if (!BLI_ghash_ensure_p(map, SET_INT_IN_POINTER(faces[i]), &val_p)) {
+				*val_p = SET_INT_IN_POINTER(totvert++);
+			}
+			sum += GET_INT_FROM_POINTER(*val_p);
+		}
+
+		GHASH_ITER (gh_iter, map) {
+			sum += GET_INT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
+		}
+
+		BLI_ghash_free(map, NULL, NULL);
+	}
+
+	*r_time = time_now() - t;
+	return sum;
+}
+
+static int bench_mesh_ghash_flat(const int *faces, int totface, double *r_time)
+{
+	const double t = time_now();
+	int leaf, i, sum = 0;
+
+	for (leaf = 0; leaf < totface; leaf += LEAF_LIMIT) {
+		const int leaf_end = MIN2(leaf + LEAF_LIMIT, totface);
+		GHashFlat *map = BLI_ghash_flat_int_new_ex(__func__, 2 * (unsigned int)(leaf_end - leaf));
+		GHashFlatIterator gh_iter;
+		int totvert = 0;
+
+		for (i = leaf * 4; i < leaf_end * 4; i++) {
+			void **val_p;
+
+			if (!BLI_ghash_flat_ensure_p(map, SET_INT_IN_POINTER(faces[i]), &val_p)) {
+				*val_p = SET_INT_IN_POINTER(totvert++);
+			}
+			sum += GET_INT_FROM_POINTER(*val_p);
+		}
+
+		GHASH_FLAT_ITER (gh_iter, map) {
+			sum += GET_INT_FROM_POINTER(BLI_ghash_flatIterator_getKey(&gh_iter));
+		}
+
+		BLI_ghash_flat_free(map, NULL, NULL);
+	}
+
+	*r_time = time_now() - t;
+	return sum;
+}
+
+static void times_print(const char *name, const BenchTimes *times)
+{
+	printf("  %-10s %9.2f %11.2f %12.2f %9.2f\n", name,
+	       times->insert * 1e3, times->lookup_hit * 1e3,
+	       times->lookup_miss * 1e3, times->remove * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+	int totkey = 1000000;
+	int repeat = 5;
+	int error_status = 0;
+	int key_type, r;
+
+	if (argc > 1) {
+		totkey = MAX2(atoi(argv[1]), 1);
+	}
+	if (argc > 2) {
+		repeat = MAX2(atoi(argv[2]), 1);
+	}
+
+	printf("%d keys, best of %d runs, times in ms\n", totkey, repeat);
+
+	for (key_type = KEY_PTR; key_type <= KEY_STR; key_type++) {
+		BenchTimes times = {0}, times_flat = {0};
+		char *strbuf;
+		int *intbuf;
+		void **keys = keys_create(key_type, totkey, &strbuf, &intbuf);
+
+		for (r = 0; r < repeat; r++) {
+			BenchTimes times_run, times_flat_run;
+			const int found = bench_ghash(key_type, keys, totkey, &times_run);
+			const int found_flat = bench_ghash_flat(key_type, keys, totkey, &times_flat_run);
+
+			if (r == 0) {
+				times = times_run;
+				times_flat = times_flat_run;
+			}
+			else {
+				times_min(&times, &times_run);
+				times_min(&times_flat, &times_flat_run);
+			}
+
+			if (found != totkey || found_flat != totkey) {
+				printf("error: %d and %d of %d %s keys found\n", found, found_flat, totkey,
+				       key_type_names[key_type]);
+				error_status = 1;
+			}
+		}
+
+		printf("%s keys     insert  lookup hit  lookup miss    remove\n", key_type_names[key_type]);
+		times_print("GHash", &times);
+		times_print("GHashFlat", &times_flat);
+
+		free(keys);
+		free(strbuf);
+		free(intbuf);
+	}
+
+	{
+		/* as many face corners as keys */
+		const int totface = MAX2(totkey / 4, 1);
+		int *faces = mesh_faces_create(totface, 1000);
+		double time = 0.0, time_flat = 0.0;
+
+		for (r = 0; r < repeat; r++) {
+			double time_run, time_flat_run;
+			const int sum = bench_mesh_ghash(faces, totface, &time_run);
+			const int sum_flat = bench_mesh_ghash_flat(faces, totface, &time_flat_run);
+
+			time = (r == 0) ? time_run : MIN2(time, time_run);
+			time_flat = (r == 0) ? time_flat_run : MIN2(time_flat, time_flat_run);
+
+			if (sum != sum_flat) {
+				printf("error: mesh vertex maps differ\n");
+				error_status = 1;
+			}
+		}
+
+		printf("mesh leaf vertex maps\n");
+		printf("  %-10s %9.2f\n", "GHash", time * 1e3);
+		printf("  %-10s %9.2f\n", "GHashFlat", time_flat * 1e3);
+
+		free(faces);
+	}
+
+	if (MEM_get_memory_blocks_in_use() != 0) {
+		printf("error: %u blocks not freed\n", MEM_get_memory_blocks_in_use());
+		MEM_printmemlist();
+		error_status = 1;
+	}
+
+	return error_status;
+}
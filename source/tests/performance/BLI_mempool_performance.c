@@ -0,0 +1,211 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/**
+ * Thread scaling benchmark of BLI_mempool, compares a pool guarded by a
+ * spin lock with a BLI_MEMPOOL_THREADSAFE pool.
+ *
+ * Each thread does random alloc/free of 32 byte elements, after every round
+ * threads free the elements left over by their neighbor, so elements are
+ * also freed by other threads than the one allocating them.
+ */
+
+/* Built by CMake with WITH_PERFORMANCE_TESTS, or by hand (from this directory):
+ * gcc -O2 -DNDEBUG -std=gnu99 -I../../../intern/guardedalloc -I../../../intern/atomic -I../../blender/blenlib
+ *     BLI_mempool_performance.c ../../blender/blenlib/intern/BLI_mempool.c
+ *     ../../../intern/guardedalloc/intern/mallocn.c ../../../intern/guardedalloc/intern/mallocn_guarded_impl.c
+ *     ../../../intern/guardedalloc/intern/mallocn_lockfree_impl.c
+ *     -lpthread -o BLI_mempool_performance
+ *
+ * usage: BLI_mempool_performance [max_threads] [ops_per_thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_mempool.h"
+
+#define ELEM_SIZE 32
+#define SLOTS_PER_THREAD 4096
+#define MAX_THREADS 64
+#define OPS_PER_ROUND (SLOTS_PER_THREAD * 4)
+
+typedef struct BenchData {
+	BLI_mempool *pool;
+	bool use_lock;
+	pthread_spinlock_t lock;
+	pthread_barrier_t barrier;
+	int totthread, totops;
+	void **slots;  /* SLOTS_PER_THREAD per thread */
+} BenchData;
+
+typedef struct ThreadData {
+	BenchData *bench;
+	int index;
+} ThreadData;
+
+static void *bench_alloc(BenchData *bench)
+{
+	void *p;
+
+	if (bench->use_lock) {
+		pthread_spin_lock(&bench->lock);
+		p = BLI_mempool_alloc(bench->pool);
+		pthread_spin_unlock(&bench->lock);
+	}
+	else {
+		p = BLI_mempool_alloc(bench->pool);
+	}
+	return p;
+}
+
+static void bench_free(BenchData *bench, void *p)
+{
+	if (bench->use_lock) {
+		pthread_spin_lock(&bench->lock);
+		BLI_mempool_free(bench->pool, p);
+		pthread_spin_unlock(&bench->lock);
+	}
+	else {
+		BLI_mempool_free(bench->pool, p);
+	}
+}
+
+static void *bench_thread(void *userdata)
+{
+	ThreadData *td = userdata;
+	BenchData *bench = td->bench;
+	void **slots = bench->slots + td->index * SLOTS_PER_THREAD;
+	void **neighbor = bench->slots + ((td->index + 1) % bench->totthread) * SLOTS_PER_THREAD;
+	unsigned int seed = (unsigned int)td->index * 7919u + 1u;
+	int done = 0, i;
+
+	while (done < bench->totops) {
+		for (i = 0; i < OPS_PER_ROUND; i++) {
+			int slot;
+
+			seed = seed * 1103515245u + 12345u;
+			slot = (int)((seed >> 8) % SLOTS_PER_THREAD);
+
+			if (slots[slot]) {
+				bench_free(bench, slots[slot]);
+				slots[slot] = NULL;
+			}
+			else {
+				slots[slot] = bench_alloc(bench);
+				*(int *)slots[slot] = td->index;
+			}
+		}
+		done += OPS_PER_ROUND;
+
+		/* free what the neighbor allocated */
+		pthread_barrier_wait(&bench->barrier);
+		for (i = 0; i < SLOTS_PER_THREAD; i++) {
+			if (neighbor[i]) {
+				bench_free(bench, neighbor[i]);
+				neighbor[i] = NULL;
+			}
+		}
+		pthread_barrier_wait(&bench->barrier);
+	}
+
+	return NULL;
+}
+
+static double time_now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+/* returns million operations per second */
+static double bench_run(int totthread, int totops, bool use_threadsafe)
+{
+	BenchData bench;
+	ThreadData td[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	double time;
+	int i;
+
+	bench.use_lock = !use_threadsafe;
+	bench.pool = BLI_mempool_create(ELEM_SIZE, 0, 512,
+	                                use_threadsafe ? BLI_MEMPOOL_THREADSAFE : BLI_MEMPOOL_NOP);
+	bench.totthread = totthread;
+	bench.totops = totops;
+	bench.slots = calloc((size_t)(totthread * SLOTS_PER_THREAD), sizeof(void *));
+	pthread_spin_init(&bench.lock, PTHREAD_PROCESS_PRIVATE);
+	pthread_barrier_init(&bench.barrier, NULL, (unsigned int)totthread);
+
+	time = time_now();
+
+	for (i = 0; i < totthread; i++) {
+		td[i].bench = &bench;
+		td[i].index = i;
+		pthread_create(&threads[i], NULL, bench_thread, &td[i]);
+	}
+	for (i = 0; i < totthread; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	time = time_now() - time;
+
+	pthread_barrier_destroy(&bench.barrier);
+	pthread_spin_destroy(&bench.lock);
+	free(bench.slots);
+	BLI_mempool_destroy(bench.pool);
+
+	return ((double)totthread * (double)totops / time) * 1e-6;
+}
+
+int main(int argc, char *argv[])
+{
+	int max_threads = MAX_THREADS;
+	int totops = 400000;
+	int totthread;
+
+	if (argc > 1) {
+		max_threads = CLAMPIS(atoi(argv[1]), 1, MAX_THREADS);
+	}
+	if (argc > 2) {
+		totops = MAX2(atoi(argv[2]), OPS_PER_ROUND);
+	}
+
+	printf("threads   spin-locked pool   BLI_MEMPOOL_THREADSAFE   (million ops/s)\n");
+
+	for (totthread = 1; totthread <= max_threads; totthread *= 2) {
+		double locked = bench_run(totthread, totops, false);
+		double threadsafe = bench_run(totthread, totops, true);
+
+		printf("%7d   %16.1f   %22.1f\n", totthread, locked, threadsafe);
+	}
+
+	if (MEM_get_memory_blocks_in_use() != 0) {
+		printf("error: %u blocks not freed\n", MEM_get_memory_blocks_in_use());
+		MEM_printmemlist();
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/**
+ * Thread scaling benchmark of small allocations with the lock-free allocator,
+ * with or without MEM_use_slab_allocator().
+ *
+ * Each thread does random MEM_mallocN/MEM_callocN/MEM_freeN of 4..200 bytes,
+ * keeping up to SLOTS_PER_THREAD blocks alive.
+ */
+
+/* Built by CMake with WITH_PERFORMANCE_TESTS, or by hand (from this directory):
+ * gcc -O2 -DNDEBUG -std=gnu99 -I../../../intern/guardedalloc -I../../../intern/atomic -I../../blender/blenlib
+ *     MEM_slab_performance.c ../../../intern/guardedalloc/intern/mallocn.c
+ *     ../../../intern/guardedalloc/intern/mallocn_guarded_impl.c ../../../intern/guardedalloc/intern/mallocn_lockfree_impl.c
+ *     -lpthread -o MEM_slab_performance
+ *
+ * usage: MEM_slab_performance [--slab] [max_threads] [ops_per_thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+
+#define SLOTS_PER_THREAD 8192
+#define MAX_THREADS 64
+
+typedef struct ThreadData {
+	int index, totops;
+} ThreadData;
+
+static void *bench_thread(void *userdata)
+{
+	ThreadData *td = userdata;
+	void **slots = calloc(SLOTS_PER_THREAD, sizeof(void *));
+	unsigned int seed = (unsigned int)td->index * 7919u + 1u;
+	int i;
+
+	for (i = 0; i < td->totops; i++) {
+		int slot;
+
+		seed = seed * 1103515245u + 12345u;
+		slot = (int)((seed >> 8) % SLOTS_PER_THREAD);
+
+		if (slots[slot]) {
+			MEM_freeN(slots[slot]);
+			slots[slot] = NULL;
+		}
+		else {
+			const size_t size = 4 + (seed >> 24) % 197;
+
+			if (seed & 1) {
+				slots[slot] = MEM_callocN(size, "slabtest");
+			}
+			else {
+				slots[slot] = MEM_mallocN(size, "slabtest");
+				*(int *)slots[slot] = td->index;
+			}
+		}
+	}
+
+	for (i = 0; i < SLOTS_PER_THREAD; i++) {
+		if (slots[i]) {
+			MEM_freeN(slots[i]);
+		}
+	}
+	free(slots);
+
+	return NULL;
+}
+
+static double time_now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+/* returns million operations per second */
+static double bench_run(int totthread, int totops)
+{
+	ThreadData td[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	double time;
+	int i;
+
+	time = time_now();
+
+	for (i = 0; i < totthread; i++) {
+		td[i].index = i;
+		td[i].totops = totops;
+		pthread_create(&threads[i], NULL, bench_thread, &td[i]);
+	}
+	for (i = 0; i < totthread; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	time = time_now() - time;
+
+	return ((double)totthread * (double)totops / time) * 1e-6;
+}
+
+int main(int argc, char *argv[])
+{
+	int max_threads = MAX_THREADS;
+	int totops = 1000000;
+	int totthread;
+	int arg = 1;
+
+	if (argc > arg && strcmp(argv[arg], "--slab") == 0) {
+		MEM_use_slab_allocator();
+		arg++;
+	}
+	if (argc > arg) {
+		max_threads = CLAMPIS(atoi(argv[arg]), 1, MAX_THREADS);
+		arg++;
+	}
+	if (argc > arg) {
+		totops = MAX2(atoi(argv[arg]), 1);
+		arg++;
+	}
+
+	printf("threads   million ops/s\n");
+
+	for (totthread = 1; totthread <= max_threads; totthread *= 2) {
+		printf("%7d   %13.1f\n", totthread, bench_run(totthread, totops));
+	}
+
+	if (MEM_get_memory_blocks_in_use() != 0) {
+		printf("error: %u blocks not freed\n", MEM_get_memory_blocks_in_use());
+		MEM_printmemlist();
+		return 1;
+	}
+
+	return 0;
+}